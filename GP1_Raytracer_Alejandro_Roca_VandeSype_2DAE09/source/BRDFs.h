@@ -1,6 +1,7 @@
 #pragma once
 #include <cassert>
 #include "Math.h"
+#include "Sampling.h"
 #include <iostream>
 
 namespace dae
@@ -123,5 +124,40 @@ namespace dae
 			return GeometryFunction_SchlickGGX(n, v, k) * GeometryFunction_SchlickGGX(n, l, k);
 		}
 
+		/**
+		 * \brief Importance sampling of NormalDistribution_GGX ( Path tracing )
+		 * \param n Surface normal
+		 * \param roughness Roughness of the material ( Same remapping as NormalDistribution_GGX )
+		 * \param u1 Uniform random number in [0, 1)
+		 * \param u2 Uniform random number in [0, 1)
+		 * \return Half vector distributed proportional to D(h) * cos(theta h)
+		 */
+		static Vector3 SampleHalfVector_GGX(const Vector3& n, float roughness, float u1, float u2)
+		{
+			const float alphaSquared{ Square(roughness * roughness) };
+			const float cosThetaH{ sqrtf((1.f - u1) / (1.f + (alphaSquared - 1.f) * u1)) };
+			const float sinThetaH{ sqrtf(std::max(0.f, 1.f - cosThetaH * cosThetaH)) };
+			const float phi{ dae::PI_2 * u2 };
+
+			return SampleUtils::ToWorld(n, sinThetaH * cosf(phi), sinThetaH * sinf(phi), cosThetaH);
+		}
+
+		/**
+		 * \param n Surface normal
+		 * \param h Normalized half vector between v and l
+		 * \param v Normalized direction towards the viewer
+		 * \param roughness Roughness of the material
+		 * \return Probability density ( Solid angle ) of the light direction l = reflect(v, h) when h comes from SampleHalfVector_GGX
+		 */
+		static float Pdf_GGX(const Vector3& n, const Vector3& h, const Vector3& v, float roughness)
+		{
+			// Jacobian of the reflection : dwh / dwl = 1 / ( 4 |v.h| )
+			const float vDotH{ std::abs(Vector3::Dot(v, h)) };
+			if (vDotH <= 0.f)
+				return 0.f;
+
+			return NormalDistribution_GGX(n, h, roughness) * std::max(Vector3::Dot(n, h), 0.f) / (4.f * vDotH);
+		}
+
 	}
 }
\ No newline at end of file
@@ -0,0 +1,401 @@
+#include "BVH.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <execution>
+#include <numeric>
+
+namespace dae
+{
+	void BVH::Build(const std::vector<AABB>& primitiveBounds)
+	{
+		const auto startTime{ std::chrono::high_resolution_clock::now() };
+
+		Clear();
+		if (primitiveBounds.empty())
+			return;
+
+		const uint32_t primitiveCount{ static_cast<uint32_t>(primitiveBounds.size()) };
+
+		// Every primitive starts in the root, in the original order
+		m_PrimitiveIndices.resize(primitiveCount);
+		std::iota(m_PrimitiveIndices.begin(), m_PrimitiveIndices.end(), 0);
+
+		// The centroids are what we split on
+		std::vector<Vector3> centroids{};
+		centroids.reserve(primitiveCount);
+		for (const AABB& bounds : primitiveBounds)
+			centroids.emplace_back(bounds.Centroid());
+
+		// A binary tree never has more than 2N - 1 nodes
+		m_Nodes.reserve(2 * static_cast<size_t>(primitiveCount) - 1);
+
+		BVHNode root{};
+		root.leftFirst = 0;
+		root.primitiveCount = primitiveCount;
+		m_Nodes.emplace_back(root);
+
+		UpdateNodeBounds(0, primitiveBounds);
+		Subdivide(0, primitiveBounds, centroids, 0);
+
+		GroupNodesByLevel();
+		m_BuildCost = CalculateCost();
+		m_Cost = m_BuildCost;
+
+		const auto endTime{ std::chrono::high_resolution_clock::now() };
+		m_BuildTimeMs = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+	}
+
+	void BVH::Refit(const std::vector<AABB>& primitiveBounds)
+	{
+		assert(primitiveBounds.size() == m_PrimitiveIndices.size() && "BVH::Refit -> primitive count changed, use Build instead");
+
+		if (m_Nodes.empty())
+			return;
+
+		const auto startTime{ std::chrono::high_resolution_clock::now() };
+
+		// Trees set with SetNodes are only grouped once they are refitted
+		if (m_LevelOffsets.empty())
+			GroupNodesByLevel();
+
+		// Deepest level first -> the children of a node are always done before the node itself
+		// ... Nodes on the same level never depend on each other
+		for (size_t levelIdx{ m_LevelOffsets.size() - 1 }; levelIdx > 0; --levelIdx)
+		{
+			const auto levelBegin{ m_NodesByLevel.begin() + m_LevelOffsets[levelIdx - 1] };
+			const auto levelEnd{ m_NodesByLevel.begin() + m_LevelOffsets[levelIdx] };
+			const auto refitNode{ [&](uint32_t nodeIdx) { RefitNode(nodeIdx, primitiveBounds); } };
+
+			if (static_cast<uint32_t>(levelEnd - levelBegin) >= m_ParallelRefitLevelSize)
+				std::for_each(std::execution::par, levelBegin, levelEnd, refitNode);
+			else
+				std::for_each(levelBegin, levelEnd, refitNode);
+		}
+
+		m_Cost = CalculateCost();
+
+		const auto endTime{ std::chrono::high_resolution_clock::now() };
+		m_RefitTimeMs = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+	}
+
+	bool BVH::RefitOrRebuild(const std::vector<AABB>& primitiveBounds)
+	{
+		// Different primitives ( Or never built ) -> nothing to refit
+		if (m_Nodes.empty() || primitiveBounds.size() != m_PrimitiveIndices.size())
+		{
+			Build(primitiveBounds);
+			return true;
+		}
+
+		Refit(primitiveBounds);
+
+		// Primitives moved too far from where they were at build time
+		// ... Nodes overlap a lot, a new tree pays for itself
+		if (GetCostRatio() > m_RebuildThreshold)
+		{
+			Build(primitiveBounds);
+			return true;
+		}
+
+		return false;
+	}
+
+	void BVH::SetNodes(std::vector<BVHNode>&& nodes, std::vector<uint32_t>&& primitiveIndices, float buildCost)
+	{
+		Clear();
+		m_Nodes = std::move(nodes);
+		m_PrimitiveIndices = std::move(primitiveIndices);
+		m_BuildCost = buildCost;
+		m_Cost = buildCost;
+	}
+
+	void BVH::Clear()
+	{
+		m_Nodes.clear();
+		m_PrimitiveIndices.clear();
+		m_NodesByLevel.clear();
+		m_LevelOffsets.clear();
+		m_BuildTimeMs = 0.f;
+		m_BuildCost = 0.f;
+		m_Cost = 0.f;
+	}
+
+	void BVH::UpdateNodeBounds(uint32_t nodeIdx, const std::vector<AABB>& primitiveBounds)
+	{
+		BVHNode& node{ m_Nodes[nodeIdx] };
+
+		AABB nodeBounds{};
+		for (uint32_t index{ 0 }; index < node.primitiveCount; ++index)
+		{
+			nodeBounds.Grow(primitiveBounds[m_PrimitiveIndices[node.leftFirst + index]]);
+		}
+
+		node.minAABB = nodeBounds.min;
+		node.maxAABB = nodeBounds.max;
+	}
+
+	void BVH::Subdivide(uint32_t nodeIdx, const std::vector<AABB>& primitiveBounds, const std::vector<Vector3>& centroids, uint32_t depth)
+	{
+		// Copy -> m_Nodes can grow while we are subdividing
+		const BVHNode node{ m_Nodes[nodeIdx] };
+		if (node.primitiveCount <= 1 || depth >= MaxDepth)
+			return;
+
+		// Levels that median splits still need to bring this node down to MaxLeafSize
+		// ... No room left for anything else -> median split, so no leaf ends up below MaxDepth
+		// ( Degenerate SAH splits, e.g. many coincident centroids, could otherwise go arbitrarily deep )
+		uint32_t medianLevels{ 0 };
+		for (uint32_t count{ node.primitiveCount }; count > MaxLeafSize; count = (count + 1) / 2)
+			++medianLevels;
+
+		if (depth + medianLevels >= MaxDepth)
+		{
+			SplitAtMedian(nodeIdx, primitiveBounds, centroids, depth);
+			return;
+		}
+
+		// Find the cheapest split following the SAH
+		int axis{ -1 };
+		float splitPos{};
+		const float splitCost{ FindBestSplit(node, primitiveBounds, centroids, axis, splitPos) };
+
+		// Cost of NOT splitting -> intersect every primitive of this node
+		const AABB nodeBounds{ node.minAABB, node.maxAABB };
+		const float leafCost{ IntersectionCost(node.primitiveCount) * nodeBounds.HalfArea() };
+
+		uint32_t first{ node.leftFirst };
+		uint32_t last{ node.leftFirst + node.primitiveCount };
+		uint32_t middle{ first };
+
+		if (axis != -1 && (splitCost + TraversalCost() * nodeBounds.HalfArea() < leafCost || node.primitiveCount > MaxLeafSize))
+		{
+			// Partition the primitives in place around the split position
+			middle = static_cast<uint32_t>(std::partition(m_PrimitiveIndices.begin() + first, m_PrimitiveIndices.begin() + last,
+				[&](uint32_t primitiveIdx) { return centroids[primitiveIdx][axis] < splitPos; }) - m_PrimitiveIndices.begin());
+		}
+		else if (node.primitiveCount > MaxLeafSize)
+		{
+			// All centroids are on top of each other -> no SAH split possible
+			// ... Split in half so leaves stay small
+			middle = first + node.primitiveCount / 2;
+		}
+		else
+		{
+			// Splitting is more expensive than keeping the leaf
+			return;
+		}
+
+		// One side empty -> splitting doesn't help
+		if (middle == first || middle == last)
+		{
+			if (node.primitiveCount <= MaxLeafSize)
+				return;
+
+			middle = first + node.primitiveCount / 2;
+		}
+
+		CreateChildren(nodeIdx, middle, primitiveBounds, centroids, depth);
+	}
+
+	void BVH::SplitAtMedian(uint32_t nodeIdx, const std::vector<AABB>& primitiveBounds, const std::vector<Vector3>& centroids, uint32_t depth)
+	{
+		const BVHNode& node{ m_Nodes[nodeIdx] };
+		const uint32_t first{ node.leftFirst };
+		const uint32_t middle{ first + node.primitiveCount / 2 };
+
+		// Halves along the longest axis of the node
+		const Vector3 extent{ node.maxAABB - node.minAABB };
+		const int axis{ extent.x > extent.y && extent.x > extent.z ? 0 : (extent.y > extent.z ? 1 : 2) };
+		std::nth_element(m_PrimitiveIndices.begin() + first, m_PrimitiveIndices.begin() + middle, m_PrimitiveIndices.begin() + first + node.primitiveCount,
+			[&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+
+		CreateChildren(nodeIdx, middle, primitiveBounds, centroids, depth);
+	}
+
+	void BVH::CreateChildren(uint32_t nodeIdx, uint32_t middle, const std::vector<AABB>& primitiveBounds, const std::vector<Vector3>& centroids, uint32_t depth)
+	{
+		const uint32_t first{ m_Nodes[nodeIdx].leftFirst };
+		const uint32_t last{ first + m_Nodes[nodeIdx].primitiveCount };
+
+		// Create the child nodes next to each other
+		const uint32_t leftChildIdx{ static_cast<uint32_t>(m_Nodes.size()) };
+
+		BVHNode leftChild{};
+		leftChild.leftFirst = first;
+		leftChild.primitiveCount = middle - first;
+
+		BVHNode rightChild{};
+		rightChild.leftFirst = middle;
+		rightChild.primitiveCount = last - middle;
+
+		m_Nodes.emplace_back(leftChild);
+		m_Nodes.emplace_back(rightChild);
+
+		// Parent becomes an inner node
+		m_Nodes[nodeIdx].leftFirst = leftChildIdx;
+		m_Nodes[nodeIdx].primitiveCount = 0;
+
+		UpdateNodeBounds(leftChildIdx, primitiveBounds);
+		UpdateNodeBounds(leftChildIdx + 1, primitiveBounds);
+
+		Subdivide(leftChildIdx, primitiveBounds, centroids, depth + 1);
+		Subdivide(leftChildIdx + 1, primitiveBounds, centroids, depth + 1);
+	}
+
+	float BVH::FindBestSplit(const BVHNode& node, const std::vector<AABB>& primitiveBounds, const std::vector<Vector3>& centroids,
+		int& bestAxis, float& bestSplitPos) const
+	{
+		struct Bin
+		{
+			AABB bounds{};
+			uint32_t primitiveCount{};
+		};
+
+		float bestCost{ FLT_MAX };
+
+		for (int axis{ 0 }; axis < 3; ++axis)
+		{
+			// Bin over the centroid bounds, NOT the node bounds ( Tighter )
+			float boundsMin{ FLT_MAX };
+			float boundsMax{ -FLT_MAX };
+			for (uint32_t index{ 0 }; index < node.primitiveCount; ++index)
+			{
+				const float centroid{ centroids[m_PrimitiveIndices[node.leftFirst + index]][axis] };
+				boundsMin = std::min(boundsMin, centroid);
+				boundsMax = std::max(boundsMax, centroid);
+			}
+
+			if (boundsMin == boundsMax)
+				continue;	// Flat on this axis
+
+			Bin bins[m_BinCount]{};
+			const float scale{ m_BinCount / (boundsMax - boundsMin) };
+			for (uint32_t index{ 0 }; index < node.primitiveCount; ++index)
+			{
+				const uint32_t primitiveIdx{ m_PrimitiveIndices[node.leftFirst + index] };
+				const int binIdx{ std::min(m_BinCount - 1, static_cast<int>((centroids[primitiveIdx][axis] - boundsMin) * scale)) };
+
+				++bins[binIdx].primitiveCount;
+				bins[binIdx].bounds.Grow(primitiveBounds[primitiveIdx]);
+			}
+
+			// Sweep from both sides to get the area and count on each side of every plane
+			float leftArea[m_BinCount - 1]{};
+			float rightArea[m_BinCount - 1]{};
+			uint32_t leftCount[m_BinCount - 1]{};
+			uint32_t rightCount[m_BinCount - 1]{};
+
+			AABB leftBox{};
+			AABB rightBox{};
+			uint32_t leftSum{ 0 };
+			uint32_t rightSum{ 0 };
+			for (int binIdx{ 0 }; binIdx < m_BinCount - 1; ++binIdx)
+			{
+				leftSum += bins[binIdx].primitiveCount;
+				leftCount[binIdx] = leftSum;
+				leftBox.Grow(bins[binIdx].bounds);
+				leftArea[binIdx] = leftBox.IsValid() ? leftBox.HalfArea() : 0.f;
+
+				rightSum += bins[m_BinCount - 1 - binIdx].primitiveCount;
+				rightCount[m_BinCount - 2 - binIdx] = rightSum;
+				rightBox.Grow(bins[m_BinCount - 1 - binIdx].bounds);
+				rightArea[m_BinCount - 2 - binIdx] = rightBox.IsValid() ? rightBox.HalfArea() : 0.f;
+			}
+
+			const float binWidth{ (boundsMax - boundsMin) / m_BinCount };
+			for (int planeIdx{ 0 }; planeIdx < m_BinCount - 1; ++planeIdx)
+			{
+				if (leftCount[planeIdx] == 0 || rightCount[planeIdx] == 0)
+					continue;
+
+				const float cost{ IntersectionCost(leftCount[planeIdx]) * leftArea[planeIdx]
+					+ IntersectionCost(rightCount[planeIdx]) * rightArea[planeIdx] };
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplitPos = boundsMin + binWidth * (planeIdx + 1);
+				}
+			}
+		}
+
+		return bestCost;
+	}
+
+	void BVH::RefitNode(uint32_t nodeIdx, const std::vector<AABB>& primitiveBounds)
+	{
+		BVHNode& node{ m_Nodes[nodeIdx] };
+		if (node.IsLeaf())
+		{
+			UpdateNodeBounds(nodeIdx, primitiveBounds);
+			return;
+		}
+
+		const BVHNode& leftChild{ m_Nodes[node.leftFirst] };
+		const BVHNode& rightChild{ m_Nodes[node.leftFirst + 1] };
+		node.minAABB = Vector3::Min(leftChild.minAABB, rightChild.minAABB);
+		node.maxAABB = Vector3::Max(leftChild.maxAABB, rightChild.maxAABB);
+	}
+
+	void BVH::GroupNodesByLevel()
+	{
+		// Breadth first -> every level ends up contiguous
+		// ... m_LevelOffsets[i] is where level i ends ( Level 0 = root )
+		m_NodesByLevel.clear();
+		m_NodesByLevel.reserve(m_Nodes.size());
+		m_LevelOffsets.clear();
+		m_LevelOffsets.push_back(0);
+
+		m_NodesByLevel.push_back(0);
+		uint32_t levelBegin{ 0 };
+		while (levelBegin < m_NodesByLevel.size())
+		{
+			const uint32_t levelEnd{ static_cast<uint32_t>(m_NodesByLevel.size()) };
+			m_LevelOffsets.push_back(levelEnd);
+
+			for (uint32_t index{ levelBegin }; index < levelEnd; ++index)
+			{
+				const BVHNode& node{ m_Nodes[m_NodesByLevel[index]] };
+				if (node.IsLeaf())
+					continue;
+
+				m_NodesByLevel.push_back(node.leftFirst);
+				m_NodesByLevel.push_back(node.leftFirst + 1);
+			}
+
+			levelBegin = levelEnd;
+		}
+	}
+
+	float BVH::CalculateCost() const
+	{
+		if (m_Nodes.empty())
+			return 0.f;
+
+		// SAH cost of the whole tree : same costs as the build ( Traversal = 1, intersection = 1 per primitive )
+		// ... Divided by the root area so it doesn't depend on the scale of the scene
+		const float cost{ std::transform_reduce(std::execution::par, m_Nodes.begin(), m_Nodes.end(), 0.f, std::plus<>{},
+			[this](const BVHNode& node)
+			{
+				const AABB nodeBounds{ node.minAABB, node.maxAABB };
+				return nodeBounds.HalfArea() * (node.IsLeaf() ? IntersectionCost(node.primitiveCount) : 1.f);
+			}) };
+
+		const float rootArea{ AABB{ m_Nodes[0].minAABB, m_Nodes[0].maxAABB }.HalfArea() };
+		return rootArea > 0.f ? cost / rootArea : cost;
+	}
+
+	float BVH::IntersectionCost(uint32_t primitiveCount) const
+	{
+		// A partially filled block costs as much as a full one
+		return static_cast<float>((primitiveCount + m_PrimitiveBlockSize - 1) / m_PrimitiveBlockSize);
+	}
+
+	float BVH::TraversalCost() const
+	{
+		// One box test costs about as much as one block of primitives, without blocks the tree is split as far as the SAH allows
+		return m_PrimitiveBlockSize > 1 ? 1.f : 0.f;
+	}
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+#pragma region AABB
+	struct AABB
+	{
+		Vector3 min{ FLT_MAX, FLT_MAX, FLT_MAX };
+		Vector3 max{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		void Grow(const Vector3& point)
+		{
+			min = Vector3::Min(min, point);
+			max = Vector3::Max(max, point);
+		}
+
+		void Grow(const AABB& other)
+		{
+			min = Vector3::Min(min, other.min);
+			max = Vector3::Max(max, other.max);
+		}
+
+		// Half of the surface area ( The factor 2 cancels out in the SAH anyway )
+		float HalfArea() const
+		{
+			const Vector3 extent{ max - min };
+			return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+		}
+
+		Vector3 Centroid() const
+		{
+			return (min + max) * 0.5f;
+		}
+
+		bool IsValid() const
+		{
+			return min.x <= max.x && min.y <= max.y && min.z <= max.z;
+		}
+	};
+#pragma endregion
+
+#pragma region BVH
+	// Flat BVH node ( 32 bytes -> 2 nodes per cache line )
+	// Inner node : leftFirst = index of the left child, the right child is always leftFirst + 1
+	// Leaf node  : leftFirst = first entry in the primitive index list
+	struct BVHNode
+	{
+		Vector3 minAABB{};
+		uint32_t leftFirst{};
+		Vector3 maxAABB{};
+		uint32_t primitiveCount{};
+
+		bool IsLeaf() const { return primitiveCount > 0; }
+	};
+
+	// Bounding Volume Hierarchy built with the Surface Area Heuristic (binned)
+	// It only works on primitive bounds, so it can be used for triangles or any other primitive
+	class BVH final
+	{
+	public:
+		BVH() = default;
+		~BVH() = default;
+
+		// Build the hierarchy from the bounds of each primitive
+		void Build(const std::vector<AABB>& primitiveBounds);
+		// Keep the tree topology, only recompute the node bounds ( Same primitives, new bounds )
+		// ... Bottom-up, one depth level at a time, the nodes of a level are refitted in parallel
+		void Refit(const std::vector<AABB>& primitiveBounds);
+		// Refit, but rebuild when the SAH cost got too much worse than right after the last build
+		// ... Returns true when a full rebuild happened
+		bool RefitOrRebuild(const std::vector<AABB>& primitiveBounds);
+		// Tree that was built earlier ( Scene bundles ) : nodes and primitive indices as GetNodes / GetPrimitiveIndices gave them
+		// ... buildCost = GetBuildCost of that tree, so RefitOrRebuild still compares against it
+		void SetNodes(std::vector<BVHNode>&& nodes, std::vector<uint32_t>&& primitiveIndices, float buildCost);
+		void Clear();
+
+		const std::vector<BVHNode>& GetNodes() const { return m_Nodes; }
+		const std::vector<uint32_t>& GetPrimitiveIndices() const { return m_PrimitiveIndices; }
+
+		uint32_t GetNodeCount() const { return static_cast<uint32_t>(m_Nodes.size()); }
+		size_t GetMemoryUsage() const { return m_Nodes.size() * sizeof(BVHNode) + m_PrimitiveIndices.size() * sizeof(uint32_t); }
+		float GetBuildTime() const { return m_BuildTimeMs; }
+		float GetRefitTime() const { return m_RefitTimeMs; }
+		float GetBuildCost() const { return m_BuildCost; }
+		// SAH cost of the current tree, relative to the cost right after the last build ( 1 = as good as new )
+		float GetCostRatio() const { return m_BuildCost > 0.f ? m_Cost / m_BuildCost : 1.f; }
+		void SetRebuildThreshold(float costRatio) { m_RebuildThreshold = costRatio; }
+		// Primitives are intersected this many at a time ( SIMD blocks ) -> the SAH prices a leaf per block, not per primitive
+		// ... Call before Build
+		void SetPrimitiveBlockSize(uint32_t blockSize) { m_PrimitiveBlockSize = std::max(blockSize, 1u); }
+		bool IsEmpty() const { return m_Nodes.empty(); }
+
+		static constexpr uint32_t MaxLeafSize{ 8 };
+		// Deepest level a leaf can be on ( Root = 0 ), the traversal stacks are sized for it
+		static constexpr uint32_t MaxDepth{ 64 };
+		static constexpr float DefaultRebuildThreshold{ 1.5f };
+
+	private:
+		std::vector<BVHNode> m_Nodes{};
+		std::vector<uint32_t> m_PrimitiveIndices{};	// Primitives sorted so every leaf references a contiguous range
+		float m_BuildTimeMs{};
+		float m_RefitTimeMs{};
+
+		// Node indices grouped per depth level ( Root first ), used to refit level by level
+		std::vector<uint32_t> m_NodesByLevel{};
+		std::vector<uint32_t> m_LevelOffsets{};
+
+		float m_BuildCost{};
+		float m_Cost{};
+		float m_RebuildThreshold{ DefaultRebuildThreshold };
+		uint32_t m_PrimitiveBlockSize{ 1 };
+
+		static constexpr int m_BinCount{ 16 };
+		// Smaller levels are refitted on the calling thread, the parallel overhead isn't worth it
+		static constexpr uint32_t m_ParallelRefitLevelSize{ 512 };
+
+		void UpdateNodeBounds(uint32_t nodeIdx, const std::vector<AABB>& primitiveBounds);
+		void Subdivide(uint32_t nodeIdx, const std::vector<AABB>& primitiveBounds, const std::vector<Vector3>& centroids, uint32_t depth);
+		void SplitAtMedian(uint32_t nodeIdx, const std::vector<AABB>& primitiveBounds, const std::vector<Vector3>& centroids, uint32_t depth);
+		// Turns the node into an inner node : [first, middle) left, [middle, last) right, then subdivides both
+		void CreateChildren(uint32_t nodeIdx, uint32_t middle, const std::vector<AABB>& primitiveBounds, const std::vector<Vector3>& centroids, uint32_t depth);
+		float FindBestSplit(const BVHNode& node, const std::vector<AABB>& primitiveBounds, const std::vector<Vector3>& centroids,
+			int& bestAxis, float& bestSplitPos) const;
+		void RefitNode(uint32_t nodeIdx, const std::vector<AABB>& primitiveBounds);
+		void GroupNodesByLevel();
+		float CalculateCost() const;
+		float IntersectionCost(uint32_t primitiveCount) const;
+		float TraversalCost() const;
+	};
+#pragma endregion
+}
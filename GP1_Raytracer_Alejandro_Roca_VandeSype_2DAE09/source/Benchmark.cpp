@@ -0,0 +1,444 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include "Math.h"
+#include "ObjLoader.h"
+#include "Renderer.h"
+#include "RenderTarget.h"
+#include "Scene.h"
+#include "Statistics.h"
+#include "Timer.h"
+#include "ToneMapping.h"
+
+namespace dae
+{
+	namespace
+	{
+		struct RunResult
+		{
+			std::string sceneName{};
+			int width{};
+			int height{};
+			uint32_t threadCount{};
+			std::vector<float> frameTimes{};	// Milliseconds
+			RayCounters counters{};
+		};
+
+		// Same path for every run : one slow sideways sweep while turning left and right
+		// ... Starts and ends at the camera of the scene, so the view stays on the scene content
+		void ApplyCameraPath(Camera& camera, const Vector3& startOrigin, const Vector3& startForward, uint32_t frameIdx, uint32_t frameCount)
+		{
+			const float phase{ PI_2 * frameIdx / frameCount };
+			const float yaw{ 0.2f * sinf(phase) };
+
+			camera.origin = startOrigin + Vector3{ 1.5f * sinf(phase), 0.5f * (1.f - cosf(phase)), 0.f };
+			camera.forward = Matrix::CreateRotationY(yaw).TransformVector(startForward).Normalized();
+			camera.hasChanged = true;
+		}
+
+		// Nearest rank on sorted values ( percentile in [0, 1] )
+		float GetPercentile(const std::vector<float>& sortedValues, float percentile)
+		{
+			const size_t rank{ static_cast<size_t>(std::ceil(percentile * sortedValues.size())) };
+			return sortedValues[std::clamp(rank, size_t{ 1 }, sortedValues.size()) - 1];
+		}
+
+		bool RunScene(const BenchmarkSettings& settings, const std::string& sceneName, int width, int height, uint32_t threadCount,
+			RunResult& result)
+		{
+			// New scene every run -> the animations always start at the same time
+			const std::unique_ptr<Scene> pScene{ CreateScene(sceneName) };
+			if (!pScene)
+				return false;
+			pScene->Initialize();
+
+			MemoryRenderTarget renderTarget{ width, height };
+			Renderer renderer{ &renderTarget, threadCount };
+			renderer.SetMaxAccumulatedSamples(1);
+
+			Timer timer{};
+			timer.SetFixedTimeStep(settings.frameTime);
+			timer.Reset();
+			timer.Start();
+
+			Camera& camera{ pScene->GetCamera() };
+			const Vector3 startOrigin{ camera.origin };
+			const Vector3 startForward{ camera.forward };
+
+			result.sceneName = sceneName;
+			result.width = width;
+			result.height = height;
+			result.threadCount = renderer.GetThreadCount();
+			result.frameTimes.reserve(settings.frameCount);
+
+			for (uint32_t frameIdx{ 0 }; frameIdx < settings.warmupFrames + settings.frameCount; ++frameIdx)
+			{
+				const bool isWarmup{ frameIdx < settings.warmupFrames };
+
+				pScene->Update(&timer);
+				ApplyCameraPath(camera, startOrigin, startForward, isWarmup ? 0 : frameIdx - settings.warmupFrames, settings.frameCount);
+
+				// Only the rendering is measured ( Scene update excluded )
+				const auto startTime{ std::chrono::high_resolution_clock::now() };
+
+				renderer.Render(pScene.get());
+
+				const auto endTime{ std::chrono::high_resolution_clock::now() };
+
+				if (!isWarmup)
+				{
+					result.frameTimes.emplace_back(std::chrono::duration<float, std::milli>(endTime - startTime).count());
+					result.counters += renderer.GetFrameCounters();
+				}
+
+				timer.Update();
+			}
+
+			return true;
+		}
+
+		void WriteRun(std::ostream& output, const RunResult& result)
+		{
+			std::vector<float> sortedTimes{ result.frameTimes };
+			std::sort(sortedTimes.begin(), sortedTimes.end());
+
+			const float totalTime{ std::accumulate(sortedTimes.begin(), sortedTimes.end(), 0.f) };
+			const uint64_t rayCount{ result.counters.GetRayCount() };
+			const uint64_t testCount{ result.counters.GetPrimitiveTestCount() };
+
+			output << "\t\t{\n"
+				<< "\t\t\t\"name\": \"" << result.sceneName << '_' << result.width << 'x' << result.height << "_t" << result.threadCount << "\",\n"
+				<< "\t\t\t\"scene\": \"" << result.sceneName << "\",\n"
+				<< "\t\t\t\"width\": " << result.width << ",\n"
+				<< "\t\t\t\"height\": " << result.height << ",\n"
+				<< "\t\t\t\"threads\": " << result.threadCount << ",\n"
+				<< "\t\t\t\"mean_ms\": " << totalTime / sortedTimes.size() << ",\n"
+				<< "\t\t\t\"p50_ms\": " << GetPercentile(sortedTimes, 0.5f) << ",\n"
+				<< "\t\t\t\"p95_ms\": " << GetPercentile(sortedTimes, 0.95f) << ",\n"
+				<< "\t\t\t\"p99_ms\": " << GetPercentile(sortedTimes, 0.99f) << ",\n"
+				<< "\t\t\t\"primary_rays\": " << result.counters.primaryRays << ",\n"
+				<< "\t\t\t\"shadow_rays\": " << result.counters.shadowRays << ",\n"
+				<< "\t\t\t\"bounce_rays\": " << result.counters.bounceRays << ",\n"
+				<< "\t\t\t\"aabb_tests\": " << result.counters.aabbTests << ",\n"
+				<< "\t\t\t\"triangle_tests\": " << result.counters.triangleTests << ",\n"
+				<< "\t\t\t\"sphere_tests\": " << result.counters.sphereTests << ",\n"
+				<< "\t\t\t\"plane_tests\": " << result.counters.planeTests << ",\n"
+				<< "\t\t\t\"shading_calls\": " << result.counters.shadingCalls << ",\n"
+				<< "\t\t\t\"rays_per_second\": " << (totalTime > 0.f ? rayCount / (totalTime / 1000.f) : 0.f) << ",\n"
+				<< "\t\t\t\"primitive_tests_per_ray\": " << (rayCount > 0 ? static_cast<double>(testCount) / rayCount : 0.0) << ",\n"
+				<< "\t\t\t\"frame_times_ms\": [";
+
+			for (size_t frameIdx{ 0 }; frameIdx < result.frameTimes.size(); ++frameIdx)
+				output << (frameIdx == 0 ? "" : ", ") << result.frameTimes[frameIdx];
+
+			output << "]\n\t\t}";
+		}
+
+		// Keeps the results of the math kernels alive
+		volatile float g_MathSink{};
+
+		// Nanoseconds per vector, best of a few runs ( Less noise than the mean )
+		template<typename Kernel>
+		double MeasureKernel(const Kernel& kernel, const float* pResults, int vectorCount)
+		{
+			constexpr int runCount{ 7 };
+			constexpr int repetitions{ 2000 };
+
+			double bestTime{ DBL_MAX };
+			for (int runIdx{ 0 }; runIdx < runCount; ++runIdx)
+			{
+				const auto startTime{ std::chrono::high_resolution_clock::now() };
+				for (int repetition{ 0 }; repetition < repetitions; ++repetition)
+				{
+					kernel();
+					g_MathSink = g_MathSink + pResults[repetition % vectorCount];
+				}
+				const auto endTime{ std::chrono::high_resolution_clock::now() };
+
+				bestTime = std::min(bestTime, std::chrono::duration<double, std::nano>(endTime - startTime).count());
+			}
+
+			return bestTime / (static_cast<double>(repetitions) * vectorCount);
+		}
+
+		void PrintKernel(const char* name, double nanoseconds, double referenceNanoseconds)
+		{
+			std::ostringstream line{};
+			line << std::left << std::setw(34) << name << std::right << std::fixed << std::setprecision(3)
+				<< std::setw(8) << nanoseconds << " ns / vector  ( x" << std::setprecision(2) << referenceNanoseconds / nanoseconds << " )";
+			std::cout << line.str() << std::endl;
+		}
+	}
+
+	namespace Benchmark
+	{
+		bool Run(const BenchmarkSettings& settings, const std::string& outputPath)
+		{
+			if (settings.frameCount == 0)
+				return false;
+
+#ifndef RAY_STATISTICS
+			std::cout << "RAY_STATISTICS is not defined, the ray and primitive test counts will be 0" << std::endl;
+#endif
+
+			// 0 -> hardware threads, every count only once ( 1 and 0 are the same on a single core )
+			std::vector<uint32_t> threadCounts{};
+			for (uint32_t threadCount : settings.threadCounts)
+			{
+				if (threadCount == 0)
+					threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+				if (std::find(threadCounts.begin(), threadCounts.end(), threadCount) == threadCounts.end())
+					threadCounts.emplace_back(threadCount);
+			}
+
+			std::vector<RunResult> results{};
+			for (const std::string& sceneName : settings.sceneNames)
+			{
+				for (const std::pair<int, int>& resolution : settings.resolutions)
+				{
+					for (uint32_t threadCount : threadCounts)
+					{
+						RunResult result{};
+						if (!RunScene(settings, sceneName, resolution.first, resolution.second, threadCount, result))
+						{
+							std::cout << "Unknown scene " << sceneName << std::endl;
+							return false;
+						}
+
+						std::vector<float> sortedTimes{ result.frameTimes };
+						std::sort(sortedTimes.begin(), sortedTimes.end());
+						// Own stream -> the formatting doesn't stick to std::cout
+						std::ostringstream line{};
+						line << std::left << std::setw(12) << sceneName << std::right << std::setw(5) << result.width << 'x'
+							<< std::left << std::setw(5) << result.height << std::right << std::setw(3) << result.threadCount << " threads : p50 "
+							<< std::fixed << std::setprecision(2) << GetPercentile(sortedTimes, 0.5f) << " ms, p95 "
+							<< GetPercentile(sortedTimes, 0.95f) << " ms, p99 " << GetPercentile(sortedTimes, 0.99f) << " ms";
+						std::cout << line.str() << std::endl;
+
+						results.emplace_back(std::move(result));
+					}
+				}
+			}
+
+			// Written by hand, the layout is fixed and flat
+			std::ostringstream output{};
+			output << std::setprecision(6)
+				<< "{\n"
+				<< "\t\"version\": 1,\n"
+				<< "\t\"warmup_frames\": " << settings.warmupFrames << ",\n"
+				<< "\t\"frames\": " << settings.frameCount << ",\n"
+				<< "\t\"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n"
+				<< "\t\"ray_statistics\": " << (Statistics::IsEnabled ? "true" : "false") << ",\n"
+				<< "\t\"runs\": [\n";
+			for (size_t runIdx{ 0 }; runIdx < results.size(); ++runIdx)
+			{
+				WriteRun(output, results[runIdx]);
+				output << (runIdx + 1 < results.size() ? ",\n" : "\n");
+			}
+			output << "\t]\n}\n";
+
+			std::ofstream file{ outputPath };
+			if (!file)
+			{
+				std::cout << "Could not write " << outputPath << std::endl;
+				return false;
+			}
+			file << output.str();
+
+			std::cout << "Benchmark results -> " << outputPath << std::endl;
+			return static_cast<bool>(file);
+		}
+
+		void RunMath()
+		{
+#if defined(MATH_AVX2)
+			std::cout << "Math backend : AVX2" << std::endl;
+#elif defined(MATH_SSE)
+			std::cout << "Math backend : SSE" << std::endl;
+#else
+			std::cout << "Math backend : scalar" << std::endl;
+#endif
+
+			// Small enough to stay in L1 ( The kernels are measured, not the memory ), multiple of 8
+			constexpr int vectorCount{ 512 };
+
+			std::mt19937 generator{ 42 };
+			std::uniform_real_distribution<float> distribution{ -1.f, 1.f };
+
+			std::vector<Vector3> a(vectorCount), b(vectorCount), transformed(vectorCount);
+			std::vector<float> ax(vectorCount), ay(vectorCount), az(vectorCount);
+			std::vector<float> bx(vectorCount), by(vectorCount), bz(vectorCount);
+			std::vector<float> outX(vectorCount), outY(vectorCount), outZ(vectorCount), dots(vectorCount);
+			for (int idx{ 0 }; idx < vectorCount; ++idx)
+			{
+				a[idx] = Vector3{ distribution(generator), distribution(generator), distribution(generator) };
+				b[idx] = Vector3{ distribution(generator), distribution(generator), distribution(generator) };
+				ax[idx] = a[idx].x; ay[idx] = a[idx].y; az[idx] = a[idx].z;
+				bx[idx] = b[idx].x; by[idx] = b[idx].y; bz[idx] = b[idx].z;
+			}
+
+			const Matrix matrix{ Matrix::CreateScale(1.f, 2.f, 0.5f) * Matrix::CreateRotation(0.3f, 1.1f, -0.4f)
+				* Matrix::CreateTranslation(1.f, -2.f, 3.f) };
+
+			// Dot products
+			const double dotScalar{ MeasureKernel([&]()
+				{
+					for (int idx{ 0 }; idx < vectorCount; ++idx)
+						dots[idx] = Vector3::Dot(a[idx], b[idx]);
+				}, dots.data(), vectorCount) };
+			const double dot4{ MeasureKernel([&]()
+				{
+					for (int idx{ 0 }; idx < vectorCount; idx += 4)
+						VectorBatch::Dot4(&a[idx], &b[idx], &dots[idx]);
+				}, dots.data(), vectorCount) };
+			const double dot8{ MeasureKernel([&]()
+				{
+					for (int idx{ 0 }; idx < vectorCount; idx += 8)
+						VectorBatch::Dot8(&a[idx], &b[idx], &dots[idx]);
+				}, dots.data(), vectorCount) };
+			const double dotSoA{ MeasureKernel([&]()
+				{
+					VectorBatch::Dot(ax.data(), ay.data(), az.data(), bx.data(), by.data(), bz.data(), dots.data(), vectorCount);
+				}, dots.data(), vectorCount) };
+
+			PrintKernel("Vector3::Dot", dotScalar, dotScalar);
+			PrintKernel("VectorBatch::Dot4", dot4, dotScalar);
+			PrintKernel("VectorBatch::Dot8", dot8, dotScalar);
+			PrintKernel("VectorBatch::Dot ( SoA )", dotSoA, dotScalar);
+
+			// Points ( AoS, like the mesh positions )
+			const double pointScalar{ MeasureKernel([&]()
+				{
+					for (int idx{ 0 }; idx < vectorCount; ++idx)
+						transformed[idx] = matrix.TransformPoint(a[idx]);
+				}, &transformed[0].x, vectorCount) };
+			const double pointBatch{ MeasureKernel([&]()
+				{
+					VectorBatch::TransformPoints(matrix, a.data(), transformed.data(), vectorCount);
+				}, &transformed[0].x, vectorCount) };
+
+			PrintKernel("Matrix::TransformPoint", pointScalar, pointScalar);
+			PrintKernel("VectorBatch::TransformPoints", pointBatch, pointScalar);
+
+			// Directions ( SoA, like the ray packets )
+			const double vectorScalar{ MeasureKernel([&]()
+				{
+					for (int idx{ 0 }; idx < vectorCount; ++idx)
+					{
+						const Vector3 direction{ matrix.TransformVector(ax[idx], ay[idx], az[idx]) };
+						outX[idx] = direction.x;
+						outY[idx] = direction.y;
+						outZ[idx] = direction.z;
+					}
+				}, outX.data(), vectorCount) };
+			const double vectorBatch{ MeasureKernel([&]()
+				{
+					VectorBatch::TransformVectors(matrix, ax.data(), ay.data(), az.data(), outX.data(), outY.data(), outZ.data(), vectorCount);
+				}, outX.data(), vectorCount) };
+
+			PrintKernel("Matrix::TransformVector ( SoA )", vectorScalar, vectorScalar);
+			PrintKernel("VectorBatch::TransformVectors", vectorBatch, vectorScalar);
+
+			// HDR colors -> 32 bit pixels ( Display pass of the renderer, brighter than 1 half of the time )
+			MemoryRenderTarget target{ vectorCount, 1 };
+			std::vector<ColorRGB> colors(vectorCount);
+			for (int idx{ 0 }; idx < vectorCount; ++idx)
+				colors[idx] = ColorRGB{ std::abs(a[idx].x) * 2.f, std::abs(a[idx].y) * 2.f, std::abs(a[idx].z) * 2.f };
+			uint32_t* pPixels{ target.GetPixels() };
+			const float* pPixelValues{ reinterpret_cast<const float*>(pPixels) };
+
+			const double packScalar{ MeasureKernel([&]()
+				{
+					for (int idx{ 0 }; idx < vectorCount; ++idx)
+					{
+						ColorRGB color{ colors[idx] };
+						color.MaxToOne();
+						pPixels[idx] = target.PackColor(static_cast<uint8_t>(color.r * 255), static_cast<uint8_t>(color.g * 255),
+							static_cast<uint8_t>(color.b * 255));
+					}
+				}, pPixelValues, vectorCount) };
+
+			PrintKernel("MaxToOne + PackColor", packScalar, packScalar);
+			for (bool sRGB : { false, true })
+			{
+				for (ToneMapper toneMapper : { ToneMapper::MaxToOne, ToneMapper::ACES })
+				{
+					DisplayMapper mapper{};
+					mapper.Update(target, DisplaySettings{ 1.f, toneMapper, sRGB });
+					const double packBatch{ MeasureKernel([&]()
+						{
+							mapper.PackPixels(colors.data(), pPixels, vectorCount);
+						}, pPixelValues, vectorCount) };
+
+					const std::string name{ std::string{ "DisplayMapper " } + (toneMapper == ToneMapper::ACES ? "ACES" : "MaxToOne")
+						+ (sRGB ? " sRGB" : " linear") };
+					PrintKernel(name.c_str(), packBatch, packScalar);
+				}
+			}
+		}
+
+		bool RunOBJ(const std::string& filePath)
+		{
+			using Clock = std::chrono::high_resolution_clock;
+			constexpr int runCount{ 3 };
+
+			// Best of a few runs -> the file is in the page cache for all of them, the disk isn't measured
+			const auto measure{ [](const auto& load)
+				{
+					float bestTime{ FLT_MAX };
+					for (int runIdx{ 0 }; runIdx < runCount; ++runIdx)
+					{
+						const auto startTime{ Clock::now() };
+						if (!load())
+							return -1.f;
+						bestTime = std::min(bestTime, std::chrono::duration<float, std::milli>(Clock::now() - startTime).count());
+					}
+					return bestTime;
+				} };
+
+			ObjMesh mesh{};
+			const float parseTime{ measure([&]() { return ObjLoader::Load(filePath, mesh, false); }) };
+			if (parseTime < 0.f)
+				return false;
+
+			const std::string cachePath{ ObjLoader::GetCachePath(filePath) };
+			const auto writeStart{ Clock::now() };
+			if (!ObjLoader::WriteCache(cachePath, filePath, mesh))
+			{
+				std::cout << "Could not write " << cachePath << std::endl;
+				return false;
+			}
+			const float writeTime{ std::chrono::duration<float, std::milli>(Clock::now() - writeStart).count() };
+
+			ObjMesh cachedMesh{};
+			const float cacheTime{ measure([&]() { return ObjLoader::ReadCache(cachePath, filePath, cachedMesh); }) };
+			if (cacheTime < 0.f || cachedMesh.indices != mesh.indices)
+			{
+				std::cout << "Could not read back " << cachePath << std::endl;
+				return false;
+			}
+
+			std::error_code error{};
+			const float megabytes{ std::filesystem::file_size(filePath, error) / (1024.f * 1024.f) };
+			std::cout << filePath << " : " << megabytes << " MB, " << mesh.positions.size() << " positions, " << mesh.GetTriangleCount() << " triangles"
+				<< ( mesh.texCoords.empty() ? "" : ", texture coordinates" ) << ( mesh.vertexNormals.empty() ? "" : ", vertex normals" ) << "\n"
+				<< "Parse       " << parseTime << " ms ( " << megabytes * 1000.f / parseTime << " MB/s )\n"
+				<< "Write cache " << writeTime << " ms\n"
+				<< "Read cache  " << cacheTime << " ms ( x" << parseTime / cacheTime << " )" << std::endl;
+			return true;
+		}
+	}
+}
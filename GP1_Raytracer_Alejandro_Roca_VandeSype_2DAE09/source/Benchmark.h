@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace dae
+{
+	// Every scene x resolution x thread count is rendered along the same camera path
+	// ... Compare the JSON of two builds with Benchmark.py ( Regression check against a stored baseline )
+	struct BenchmarkSettings
+	{
+		std::vector<std::string> sceneNames{ "W1", "W2", "W3", "W4Test", "W4Reference", "W4Bunny" };
+		std::vector<std::pair<int, int>> resolutions{ { 320, 240 }, { 640, 480 } };
+		std::vector<uint32_t> threadCounts{ 1, 0 };		// 0 = one per hardware thread
+		uint32_t warmupFrames{ 3 };						// Rendered but not measured ( Thread pool and caches warm up )
+		uint32_t frameCount{ 30 };
+		float frameTime{ 1.f / 30.f };					// Animation time step, the same for every run
+	};
+
+	namespace Benchmark
+	{
+		// Runs every combination and writes the results to outputPath, returns false when a scene is unknown or the file can't be written
+		bool Run(const BenchmarkSettings& settings, const std::string& outputPath);
+
+		// Microbenchmark of the math kernels : per vector loops against the VectorBatch versions, printed to the console
+		void RunMath();
+
+		// Loads an OBJ file from its text and from its binary cache ( Which is rewritten ), times printed to the console
+		bool RunOBJ(const std::string& filePath);
+	}
+}
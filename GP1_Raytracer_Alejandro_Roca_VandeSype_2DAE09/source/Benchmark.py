@@ -0,0 +1,79 @@
+"""Runs the headless benchmark and compares it against a stored baseline.
+
+Usage ( From this folder, the scenes load their meshes from Resources/ ) :
+    python Benchmark.py --exe <RayTracer_Headless> [--baseline benchmark_baseline.json] [--threshold 0.10]
+    python Benchmark.py --exe <RayTracer_Headless> --update-baseline
+    python Benchmark.py --results benchmark_results.json      ( Only compare, no new run )
+
+Any other option ( --scene, --width, --height, --threads, --frames ) is passed to the executable.
+Exits with 1 when a run got slower than the threshold allows ( p50 frame time ).
+"""
+
+import argparse
+import json
+import os
+import shutil
+import subprocess
+import sys
+
+
+def load_runs(path):
+    with open(path) as file:
+        return {run["name"]: run for run in json.load(file)["runs"]}
+
+
+def compare(results_path, baseline_path, threshold):
+    results = load_runs(results_path)
+    baseline = load_runs(baseline_path)
+
+    regressions = 0
+    print(f"{'run':<28}{'base p50':>10}{'p50':>10}{'change':>9}{'base p95':>10}{'p95':>10}{'tests/ray':>11}")
+    for name, run in results.items():
+        base = baseline.get(name)
+        if base is None:
+            print(f"{name:<28}{'-':>10}{run['p50_ms']:>10.2f}{'new':>9}")
+            continue
+
+        change = run["p50_ms"] / base["p50_ms"] - 1.0 if base["p50_ms"] > 0 else 0.0
+        is_regression = change > threshold
+        regressions += is_regression
+        print(f"{name:<28}{base['p50_ms']:>10.2f}{run['p50_ms']:>10.2f}{change:>+9.1%}"
+              f"{base['p95_ms']:>10.2f}{run['p95_ms']:>10.2f}{run['primitive_tests_per_ray']:>11.2f}"
+              + ("  << REGRESSION" if is_regression else ""))
+
+    for name in baseline.keys() - results.keys():
+        print(f"{name:<28} missing from the results")
+
+    print(f"{regressions} regression(s) above {threshold:.0%}")
+    return regressions == 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Raytracer benchmark with a regression check")
+    parser.add_argument("--exe", help="RayTracer_Headless executable")
+    parser.add_argument("--results", default="benchmark_results.json", help="JSON written by the run")
+    parser.add_argument("--baseline", default="benchmark_baseline.json", help="Stored reference results")
+    parser.add_argument("--threshold", type=float, default=0.10, help="Allowed p50 slowdown ( 0.10 = 10%% )")
+    parser.add_argument("--update-baseline", action="store_true", help="Store the results as the new baseline")
+    args, exe_args = parser.parse_known_args()
+
+    if args.exe:
+        command = [args.exe, "--benchmark", args.results] + exe_args
+        print(" ".join(command))
+        if subprocess.call(command) != 0:
+            return 1
+
+    if args.update_baseline:
+        shutil.copyfile(args.results, args.baseline)
+        print(f"Baseline updated -> {args.baseline}")
+        return 0
+
+    if not os.path.exists(args.baseline):
+        print(f"No baseline at {args.baseline}, store one with --update-baseline")
+        return 1
+
+    return 0 if compare(args.results, args.baseline, args.threshold) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,7 +1,9 @@
 #pragma once
 #include <cassert>
+#ifndef HEADLESS
 #include <SDL_keyboard.h>
 #include <SDL_mouse.h>
+#endif
 
 #include "Math.h"
 #include "Timer.h"
@@ -40,6 +42,9 @@ namespace dae
 
 		Matrix cameraToWorld{};
 
+		// Set whenever the view changes ( Moved, rotated, other FOV ), the renderer resets it after using it
+		bool hasChanged{ true };
+
 		// Returns the Camera ONB matrix
 		Matrix CalculateCameraToWorld()
 		{
@@ -72,6 +77,10 @@ namespace dae
 			return cameraToWorld;
 		}
 
+		// HEADLESS ( No window ) -> no input, the camera stays where the scene put it
+#ifdef HEADLESS
+		void Update(Timer*) {}
+#else
 		void Update(Timer* pTimer)
 		{
 			const float deltaTime = pTimer->GetElapsed();
@@ -83,11 +92,21 @@ namespace dae
 			int mouseX{}, mouseY{};
 			const uint32_t mouseState = SDL_GetRelativeMouseState(&mouseX, &mouseY);
 
+			const Vector3 previousOrigin{ origin };
+			const float previousPitch{ totalPitch };
+			const float previousYaw{ totalYaw };
+
 			canRotate = true;
 			UpdateMovement(pKeyboardState, mouseX, mouseY);
 
 			if(canRotate)
 				UpdateRotation(mouseX, mouseY);
+
+			if (origin.x != previousOrigin.x || origin.y != previousOrigin.y || origin.z != previousOrigin.z
+				|| totalPitch != previousPitch || totalYaw != previousYaw)
+			{
+				hasChanged = true;
+			}
 		}
 
 		void UpdateMovement(const uint8_t* pKeyboardState, const int mouseX, const int mouseY)
@@ -164,6 +183,7 @@ namespace dae
 			forward.Normalize();
 			
 		}
+#endif // HEADLESS
 
 
 		void UpdateFovAngle(const float newFovAngle)
@@ -173,6 +193,7 @@ namespace dae
 				// Calculate the fov with the new fov Angle
 				fovAngle = newFovAngle;
 				fov = tan((fovAngle * TO_RADIANS) / 2);
+				hasChanged = true;
 			}
 		}
 	};
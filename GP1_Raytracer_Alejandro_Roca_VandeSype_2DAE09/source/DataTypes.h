@@ -2,7 +2,10 @@
 #include <cassert>
 
 #include "Math.h"
+#include "BVH.h"
+#include "WideBVH.h"
 #include "vector"
+#include <memory>
 
 namespace dae
 {
@@ -54,62 +57,83 @@ namespace dae
 		unsigned char materialIndex{};
 	};
 
-	struct TriangleMesh
+	// 8 triangles in SoA, precomputed for Moller-Trumbore ( v0 + the 2 edges leaving it )
+	// One block per BVH leaf, unused lanes stay degenerate ( Zero edges never hit )
+	struct alignas(32) TriangleBlock
 	{
-		TriangleMesh() = default;
-		TriangleMesh(const std::vector<Vector3>& _positions, const std::vector<int>& _indices, TriangleCullMode _cullMode):
-		positions(_positions), indices(_indices), cullMode(_cullMode)
+		static constexpr int Width{ 8 };
+
+		float v0X[Width]{};
+		float v0Y[Width]{};
+		float v0Z[Width]{};
+		float edge1X[Width]{};
+		float edge1Y[Width]{};
+		float edge1Z[Width]{};
+		float edge2X[Width]{};
+		float edge2Y[Width]{};
+		float edge2Z[Width]{};
+
+		void SetTriangle(int lane, const Vector3& v0, const Vector3& v1, const Vector3& v2)
 		{
-			//Calculate Normals
-			CalculateNormals();
+			const Vector3 edge1{ v1 - v0 };
+			const Vector3 edge2{ v2 - v0 };
+
+			v0X[lane] = v0.x;
+			v0Y[lane] = v0.y;
+			v0Z[lane] = v0.z;
+			edge1X[lane] = edge1.x;
+			edge1Y[lane] = edge1.y;
+			edge1Z[lane] = edge1.z;
+			edge2X[lane] = edge2.x;
+			edge2Y[lane] = edge2.y;
+			edge2Z[lane] = edge2.z;
+		}
 
-			//Update Transforms
-			UpdateTransforms();
+		// Same normal as Triangle ( Not flipped towards the ray )
+		Vector3 GetNormal(int lane) const
+		{
+			const Vector3 edge1{ edge1X[lane], edge1Y[lane], edge1Z[lane] };
+			const Vector3 edge2{ edge2X[lane], edge2Y[lane], edge2Z[lane] };
+			return Vector3::Cross(edge1, edge2).Normalized();
 		}
+	};
 
-		TriangleMesh(const std::vector<Vector3>& _positions, const std::vector<int>& _indices, const std::vector<Vector3>& _normals, TriangleCullMode _cullMode) :
-			positions(_positions), indices(_indices), normals(_normals), cullMode(_cullMode)
+	// Object-space triangle data, shared between every mesh instance that uses it
+	// Never transformed -> the BVH only has to be built once
+	struct MeshGeometry
+	{
+		MeshGeometry() = default;
+		MeshGeometry(const std::vector<Vector3>& _positions, const std::vector<int>& _indices) :
+			positions(_positions), indices(_indices)
 		{
-			UpdateTransforms();
+			CalculateNormals();
+			UpdateBVH();
+		}
+
+		MeshGeometry(const std::vector<Vector3>& _positions, const std::vector<int>& _indices, const std::vector<Vector3>& _normals) :
+			positions(_positions), normals(_normals), indices(_indices)
+		{
+			UpdateBVH();
 		}
 
 		std::vector<Vector3> positions{};
 		std::vector<Vector3> normals{};
 		std::vector<int> indices{};
-		unsigned char materialIndex{};
 
-		TriangleCullMode cullMode{TriangleCullMode::BackFaceCulling};
+		// Object-space AABB
+		Vector3 minAABB{};
+		Vector3 maxAABB{};
 
-		Matrix rotationTransform{};
-		Matrix translationTransform{};
-		Matrix scaleTransform{};
-
-		// AABB-Ray Intersection optimiz
-		Vector3 minAABB;
-		Vector3 maxAABB;
+		// Acceleration structure over the object-space triangles
+		BVH bvh{};
+#ifdef USE_WIDE_BVH
+		// Collapsed 4-wide copy of the BVH, the one that is traversed
+		WideBVH wideBVH{};
+		// Leaf triangles packed per leaf, in the order of the wide BVH
+		std::vector<TriangleBlock> triangleBlocks{};
+#endif
 
-		Vector3 transformedMinAABB;
-		Vector3 transformedMaxAABB;
-
-		std::vector<Vector3> transformedPositions{};
-		std::vector<Vector3> transformedNormals{};
-
-		void Translate(const Vector3& translation)
-		{
-			translationTransform = Matrix::CreateTranslation(translation);
-		}
-
-		void RotateY(float yaw)
-		{		
-			rotationTransform = Matrix::CreateRotationY(yaw);
-		}
-
-		void Scale(const Vector3& scale)
-		{
-			scaleTransform = Matrix::CreateScale(scale);
-		}
-
-		void AppendTriangle(const Triangle& triangle, bool ignoreTransformUpdate = false)
+		void AppendTriangle(const Triangle& triangle)
 		{
 			int startIndex = static_cast<int>(positions.size());
 
@@ -122,10 +146,6 @@ namespace dae
 			indices.push_back(++startIndex);
 
 			normals.push_back(triangle.normal);
-
-			//Not ideal, but making sure all vertices are updated
-			if(!ignoreTransformUpdate)
-				UpdateTransforms();
 		}
 
 		void CalculateNormals()
@@ -144,101 +164,328 @@ namespace dae
 			}
 		}
 
-		void UpdateTransforms()
+		// Call once the triangles are filled in ( Or whenever triangles are added / removed )
+		void UpdateBVH()
 		{
-			//Calculate Final Transform 
-			//... left-hand system -> SRT ( NOT TRS )
-			const auto finalTransform{ scaleTransform * rotationTransform * translationTransform };
+#ifdef USE_WIDE_BVH
+			bvh.SetPrimitiveBlockSize(TriangleBlock::Width);
+#endif
+			bvh.Build(CalculateTriangleBounds());
+			UpdateAABB();
+#ifdef USE_WIDE_BVH
+			wideBVH.Build(bvh);
+			UpdateTriangleBlocks();
+#endif
+		}
 
-			//Transform Positions (positions > transformedPositions)
-			//...
-			transformedPositions.clear();
-			transformedPositions.reserve(positions.size());
-			for (const auto& position : positions)
+		// Call after moving vertices in place ( Same triangles, new positions )
+		// ... Only refits the node bounds, the tree is rebuilt when its quality dropped too much
+		// ... Instances using this geometry still need UpdateTransforms for their world AABB
+		void RefitBVH()
+		{
+			const bool isRebuilt{ bvh.RefitOrRebuild(CalculateTriangleBounds()) };
+			UpdateAABB();
+#ifdef USE_WIDE_BVH
+			// Same binary tree -> same wide nodes and leaves, only the quantized boxes and the vertices change ( In place )
+			if (!isRebuilt && wideBVH.Refit(bvh))
+				RefitTriangleBlocks();
+			else
 			{
-				transformedPositions.emplace_back(finalTransform.TransformPoint(position));
+				wideBVH.Build(bvh);
+				UpdateTriangleBlocks();
 			}
+#endif
+		}
 
-			// Update AABB
-			UpdateTransformedAABB(finalTransform);
+#ifdef USE_WIDE_BVH
+		// Every leaf starts on a multiple of 8 in the wide BVH primitive list -> one block per leaf
+		void UpdateTriangleBlocks()
+		{
+			static_assert(WideBVH::LeafAlignment == TriangleBlock::Width, "One triangle block per wide BVH leaf");
+			triangleBlocks.assign(wideBVH.GetPrimitiveIndices().size() / TriangleBlock::Width, TriangleBlock{});
+			RefitTriangleBlocks();
+		}
 
-			//Transform Normals (normals > transformedNormals)
-			//...
-			transformedNormals.clear();
-			transformedNormals.reserve(normals.size());
-			for (const auto& normal : normals)
+		// Same leaves, moved vertices : rewrites the triangles of the blocks, the padding slots stay empty
+		void RefitTriangleBlocks()
+		{
+			const std::vector<uint32_t>& primitiveIndices{ wideBVH.GetPrimitiveIndices() };
+			for (size_t slot{ 0 }; slot < primitiveIndices.size(); ++slot)
 			{
-				transformedNormals.emplace_back(finalTransform.TransformVector(normal));
+				const uint32_t triangleIdx{ primitiveIndices[slot] };
+				if (triangleIdx == WideBVH::InvalidPrimitive)
+					continue;
+
+				const size_t index{ triangleIdx * size_t{ 3 } };
+				triangleBlocks[slot / TriangleBlock::Width].SetTriangle(static_cast<int>(slot % TriangleBlock::Width),
+					positions[indices[index]], positions[indices[index + 1]], positions[indices[index + 2]]);
 			}
 		}
+#endif
+
+		std::vector<AABB> CalculateTriangleBounds() const
+		{
+			std::vector<AABB> triangleBounds{};
+			triangleBounds.reserve(indices.size() / 3);
+			for (size_t index{ 0 }; index + 2 < indices.size(); index += 3)
+			{
+				AABB bounds{};
+				bounds.Grow(positions[indices[index]]);
+				bounds.Grow(positions[indices[index + 1]]);
+				bounds.Grow(positions[indices[index + 2]]);
+				triangleBounds.emplace_back(bounds);
+			}
 
-		// AABB-Ray Intersection optimiz
+			return triangleBounds;
+		}
 
 		// Calculate the object-space AABB
 		void UpdateAABB()
 		{
-			// Update the AABB logic
-			if (positions.size() > 0)
+			if (bvh.IsEmpty())
 			{
-				// Min and max will be the 0 position at start
-				minAABB = positions[0];
-				maxAABB = positions[0];
-				for (const auto& position : positions)
-				{
-					minAABB = Vector3::Min(position, minAABB);
-					maxAABB = Vector3::Max(position, maxAABB);
-				}
+				minAABB = {};
+				maxAABB = {};
+				return;
 			}
+
+			// The root of the BVH already encloses every triangle
+			minAABB = bvh.GetNodes()[0].minAABB;
+			maxAABB = bvh.GetNodes()[0].maxAABB;
+		}
+	};
+
+	// Instance of a MeshGeometry : the geometry is shared, only the transform is per instance
+	// Rays are moved into object space instead of moving the triangles into world space
+	struct TriangleMesh
+	{
+		TriangleMesh() :
+			pGeometry(std::make_shared<MeshGeometry>())
+		{
+		}
+
+		TriangleMesh(const std::shared_ptr<MeshGeometry>& _pGeometry, TriangleCullMode _cullMode) :
+			pGeometry(_pGeometry), cullMode(_cullMode)
+		{
+			UpdateTransforms();
+		}
+
+		TriangleMesh(const std::vector<Vector3>& _positions, const std::vector<int>& _indices, TriangleCullMode _cullMode):
+			pGeometry(std::make_shared<MeshGeometry>(_positions, _indices)), cullMode(_cullMode)
+		{
+			//Update Transforms
+			UpdateTransforms();
+		}
+
+		TriangleMesh(const std::vector<Vector3>& _positions, const std::vector<int>& _indices, const std::vector<Vector3>& _normals, TriangleCullMode _cullMode) :
+			pGeometry(std::make_shared<MeshGeometry>(_positions, _indices, _normals)), cullMode(_cullMode)
+		{
+			UpdateTransforms();
+		}
+
+		std::shared_ptr<MeshGeometry> pGeometry{};
+		unsigned char materialIndex{};
+
+		TriangleCullMode cullMode{TriangleCullMode::BackFaceCulling};
+
+		Matrix rotationTransform{};
+		Matrix translationTransform{};
+		Matrix scaleTransform{};
+
+		// Object -> World and World -> Object
+		Matrix worldTransform{};
+		Matrix inverseTransform{};
+
+		// World-space AABB
+		Vector3 transformedMinAABB;
+		Vector3 transformedMaxAABB;
+
+		// Set when the instance moved, so the scene knows its top-level structure is outdated
+		bool transformChanged{ true };
+
+		void Translate(const Vector3& translation)
+		{
+			translationTransform = Matrix::CreateTranslation(translation);
+		}
+
+		void RotateY(float yaw)
+		{		
+			rotationTransform = Matrix::CreateRotationY(yaw);
+		}
+
+		void Scale(const Vector3& scale)
+		{
+			scaleTransform = Matrix::CreateScale(scale);
+		}
+
+		// Only the matrices and the world AABB change -> cost doesn't depend on the triangle count
+		void UpdateTransforms()
+		{
+			// Geometry filled in without building its BVH
+			if (pGeometry->bvh.IsEmpty() && !pGeometry->indices.empty())
+				pGeometry->UpdateBVH();
+
+			//Calculate Final Transform 
+			//... left-hand system -> SRT ( NOT TRS )
+			worldTransform = scaleTransform * rotationTransform * translationTransform;
+			inverseTransform = Matrix::Inverse(worldTransform);
+
+			// Update AABB
+			UpdateTransformedAABB(worldTransform);
+
+			transformChanged = true;
 		}
 
 		// Calculate the world-space AABB
 		void UpdateTransformedAABB(const Matrix& finalTransform)
 		{
+			const Vector3& minAABB{ pGeometry->minAABB };
+			const Vector3& maxAABB{ pGeometry->maxAABB };
+
 			// AABB update : Be careful -> transform the 8 vertices of the aabb
 			// and calculate new min and max
-			Vector3 tMinAABB{ finalTransform.TransformPoint(minAABB) };
+			Vector3 corners[8];
+			for (int corner{ 0 }; corner < 8; ++corner)
+			{
+				corners[corner] = Vector3{
+					(corner & 1) ? maxAABB.x : minAABB.x,
+					(corner & 2) ? maxAABB.y : minAABB.y,
+					(corner & 4) ? maxAABB.z : minAABB.z };
+			}
+			VectorBatch::TransformPoints(finalTransform, corners, corners, 8);
+
+			Vector3 tMinAABB{ corners[0] };
 			Vector3 tMaxAABB{ tMinAABB };
-			
-			// (xmax, ymin, zmin)
-			Vector3 tAABB{ finalTransform.TransformPoint(maxAABB.x, minAABB.y, minAABB.z) };
-			tMinAABB = Vector3::Min(tAABB, tMinAABB);
-			tMaxAABB = Vector3::Max(tAABB, tMaxAABB);
-
-			//(xmax, ymin, zmax)
-			tAABB = finalTransform.TransformPoint(maxAABB.x, minAABB.y, maxAABB.z);
-			tMinAABB = Vector3::Min(tAABB, tMinAABB);
-			tMaxAABB = Vector3::Max(tAABB, tMaxAABB);
-
-			//(xmin, ymin, zmax)
-			tAABB = finalTransform.TransformPoint(minAABB.x, minAABB.y, maxAABB.z);
-			tMinAABB = Vector3::Min(tAABB, tMinAABB);
-			tMaxAABB = Vector3::Max(tAABB, tMaxAABB);
-
-			//(xmin, ymax, zmin)
-			tAABB = finalTransform.TransformPoint(minAABB.x, maxAABB.y, minAABB.z);
-			tMinAABB = Vector3::Min(tAABB, tMinAABB);
-			tMaxAABB = Vector3::Max(tAABB, tMaxAABB);
-
-			//(xmax, ymax, zmin)
-			tAABB = finalTransform.TransformPoint(maxAABB.x, maxAABB.y, minAABB.z);
-			tMinAABB = Vector3::Min(tAABB, tMinAABB);
-			tMaxAABB = Vector3::Max(tAABB, tMaxAABB);
-
-			// (xmax, ymax, zmax)
-			tAABB = finalTransform.TransformPoint(maxAABB);
-			tMinAABB = Vector3::Min(tAABB, tMinAABB);
-			tMaxAABB = Vector3::Max(tAABB, tMaxAABB);
-
-			// (xmin, ymax, zmax)
-			tAABB = finalTransform.TransformPoint(minAABB.x, maxAABB.y, minAABB.z);
-			tMinAABB = Vector3::Min(tAABB, tMinAABB);
-			tMaxAABB = Vector3::Max(tAABB, tMaxAABB);
+			for (int corner{ 1 }; corner < 8; ++corner)
+			{
+				tMinAABB = Vector3::Min(corners[corner], tMinAABB);
+				tMaxAABB = Vector3::Max(corners[corner], tMaxAABB);
+			}
 
 			transformedMinAABB = tMinAABB;
 			transformedMaxAABB = tMaxAABB;
 		}
 
 	};
+
+	// 8 spheres in SoA, one block per wide BVH leaf ( Same layout idea as TriangleBlock )
+	// Unused lanes get a negative squared radius -> never hit
+	struct alignas(32) SphereBlock
+	{
+		static constexpr int Width{ 8 };
+
+		float centerX[Width]{};
+		float centerY[Width]{};
+		float centerZ[Width]{};
+		float radiusSquared[Width]{ -1.f, -1.f, -1.f, -1.f, -1.f, -1.f, -1.f, -1.f };
+	};
+
+	// Lots of spheres ( Particles ) stored in SoA, with a BVH of their own
+	// The whole set is a single primitive of the scene top-level BVH
+	struct SphereSet
+	{
+		std::vector<float> centerX{};
+		std::vector<float> centerY{};
+		std::vector<float> centerZ{};
+		std::vector<float> radiusSquared{};
+		std::vector<unsigned char> materialIndices{};
+
+		// World AABB of every sphere
+		Vector3 minAABB{};
+		Vector3 maxAABB{};
+
+		BVH bvh{};
+#ifdef USE_WIDE_BVH
+		WideBVH wideBVH{};
+		std::vector<SphereBlock> sphereBlocks{};
+#endif
+
+		// Set when the spheres moved, so the scene knows its top-level structure is outdated
+		bool boundsChanged{ true };
+
+		void AddSphere(const Vector3& center, float radius, unsigned char materialIndex)
+		{
+			centerX.push_back(center.x);
+			centerY.push_back(center.y);
+			centerZ.push_back(center.z);
+			radiusSquared.push_back(radius * radius);
+			materialIndices.push_back(materialIndex);
+		}
+
+		void Reserve(size_t sphereCount)
+		{
+			centerX.reserve(sphereCount);
+			centerY.reserve(sphereCount);
+			centerZ.reserve(sphereCount);
+			radiusSquared.reserve(sphereCount);
+			materialIndices.reserve(sphereCount);
+		}
+
+		uint32_t GetSphereCount() const { return static_cast<uint32_t>(centerX.size()); }
+		Vector3 GetCenter(uint32_t sphereIdx) const { return { centerX[sphereIdx], centerY[sphereIdx], centerZ[sphereIdx] }; }
+
+		// Call once the spheres are added
+		void UpdateBVH()
+		{
+#ifdef USE_WIDE_BVH
+			bvh.SetPrimitiveBlockSize(SphereBlock::Width);
+#endif
+			bvh.Build(CalculateSphereBounds());
+			UpdateAcceleration();
+		}
+
+		// Call after moving the spheres in place ( Same spheres, new centers / radii )
+		void RefitBVH()
+		{
+			bvh.RefitOrRebuild(CalculateSphereBounds());
+			UpdateAcceleration();
+		}
+
+		std::vector<AABB> CalculateSphereBounds() const
+		{
+			std::vector<AABB> sphereBounds(centerX.size());
+			for (uint32_t sphereIdx{ 0 }; sphereIdx < sphereBounds.size(); ++sphereIdx)
+			{
+				const float radius{ sqrtf(radiusSquared[sphereIdx]) };
+				const Vector3 extent{ radius, radius, radius };
+				sphereBounds[sphereIdx] = { GetCenter(sphereIdx) - extent, GetCenter(sphereIdx) + extent };
+			}
+
+			return sphereBounds;
+		}
+
+		// Bounds, wide BVH and sphere blocks, all derived from the binary BVH
+		void UpdateAcceleration()
+		{
+			// The root of the BVH already encloses every sphere
+			minAABB = bvh.IsEmpty() ? Vector3{} : bvh.GetNodes()[0].minAABB;
+			maxAABB = bvh.IsEmpty() ? Vector3{} : bvh.GetNodes()[0].maxAABB;
+			boundsChanged = true;
+
+#ifdef USE_WIDE_BVH
+			wideBVH.Build(bvh);
+
+			// Every leaf starts on a multiple of 8 in the wide BVH primitive list -> one block per leaf
+			static_assert(WideBVH::LeafAlignment == SphereBlock::Width, "One sphere block per wide BVH leaf");
+			const std::vector<uint32_t>& primitiveIndices{ wideBVH.GetPrimitiveIndices() };
+
+			sphereBlocks.assign(primitiveIndices.size() / SphereBlock::Width, SphereBlock{});
+			for (size_t slot{ 0 }; slot < primitiveIndices.size(); ++slot)
+			{
+				const uint32_t sphereIdx{ primitiveIndices[slot] };
+				if (sphereIdx == WideBVH::InvalidPrimitive)
+					continue;
+
+				SphereBlock& block{ sphereBlocks[slot / SphereBlock::Width] };
+				const size_t lane{ slot % SphereBlock::Width };
+				block.centerX[lane] = centerX[sphereIdx];
+				block.centerY[lane] = centerY[sphereIdx];
+				block.centerZ[lane] = centerZ[sphereIdx];
+				block.radiusSquared[lane] = radiusSquared[sphereIdx];
+			}
+#endif
+		}
+	};
 #pragma endregion
 #pragma region LIGHT
 	enum class LightType
@@ -267,6 +514,53 @@ namespace dae
 		float max{ FLT_MAX };
 	};
 
+	// Rays that share one origin ( Primary rays of a block of pixels )
+	// Directions in SoA so SIMD lanes can carry the rays, the frustum bounds all of them
+	struct RayPacket
+	{
+		static constexpr int MaxRays{ 64 };
+
+		// Only the first rayCount directions are filled in
+		Vector3 origin{};
+		alignas(32) float directionX[MaxRays];
+		alignas(32) float directionY[MaxRays];
+		alignas(32) float directionZ[MaxRays];
+		int rayCount{};
+
+		float min{ 0.0001f };
+		float max{ FLT_MAX };
+
+		// Inward normals of the 4 side planes, they all go through the origin
+		Vector3 frustumNormals[4]{};
+
+		void AddRay(const Vector3& direction)
+		{
+			directionX[rayCount] = direction.x;
+			directionY[rayCount] = direction.y;
+			directionZ[rayCount] = direction.z;
+			++rayCount;
+		}
+
+		Ray GetRay(int rayIdx) const
+		{
+			return Ray{ origin, Vector3{ directionX[rayIdx], directionY[rayIdx], directionZ[rayIdx] }, min, max };
+		}
+
+		// Corner rays in order around the packet -> every other ray lies in between
+		void CalculateFrustum(const Vector3 (&cornerDirections)[4])
+		{
+			const Vector3 center{ cornerDirections[0] + cornerDirections[1] + cornerDirections[2] + cornerDirections[3] };
+			for (int planeIdx{ 0 }; planeIdx < 4; ++planeIdx)
+			{
+				Vector3 normal{ Vector3::Cross(cornerDirections[planeIdx], cornerDirections[(planeIdx + 1) % 4]) };
+				if (Vector3::Dot(normal, center) < 0.f)
+					normal = -normal;
+
+				frustumNormals[planeIdx] = normal.Normalized();
+			}
+		}
+	};
+
 	struct HitRecord
 	{
 		Vector3 origin{};
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+#include <immintrin.h>
+
+namespace dae
+{
+	// Cheaper versions of the transcendentals the shading uses ( Fast shading mode, see ShadingMode )
+	// ... Polynomials fitted on [0, 1) + the float exponent bits, no range checks : finite, positive inputs only
+	namespace FastMath
+	{
+		inline uint32_t FloatToBits(float value)
+		{
+			uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			return bits;
+		}
+
+		inline float BitsToFloat(uint32_t bits)
+		{
+			float value;
+			std::memcpy(&value, &bits, sizeof(value));
+			return value;
+		}
+
+		// log2(x) for x > 0 ( Absolute error < 2e-5 )
+		inline float Log2(float x)
+		{
+			const uint32_t bits{ FloatToBits(x) };
+			const float exponent{ static_cast<float>(static_cast<int>(bits >> 23) - 127) };
+
+			// Mantissa in [1, 2) -> log2(1 + t), t in [0, 1)
+			const float t{ BitsToFloat((bits & 0x007FFFFF) | 0x3F800000) - 1.f };
+			const float polynomial{ t * (1.4418799f + t * (-0.7088652f + t * (0.4152456f + t * (-0.1935165f + t * 0.0452683f)))) };
+			return exponent + polynomial;
+		}
+
+		// 2^x ( Relative error < 4e-6, 0 below -126 )
+		inline float Exp2(float x)
+		{
+			if (x < -126.f)
+				return 0.f;
+
+			// Integer part straight into the exponent bits, polynomial for the fraction in [0, 1)
+			const float integer{ floorf(x) };
+			const float t{ x - integer };
+			const float polynomial{ 1.0000036f + t * (0.6929696f + t * (0.2416213f + t * (0.0517177f + t * 0.0136840f))) };
+			return polynomial * BitsToFloat(static_cast<uint32_t>(static_cast<int>(integer) + 127) << 23);
+		}
+
+		// base^exponent for base >= 0 ( Phong lobe )
+		inline float Pow(float base, float exponent)
+		{
+			if (base <= 0.f)
+				return 0.f;
+
+			return Exp2(exponent * Log2(base));
+		}
+
+		// 1 / sqrt(x) : hardware estimate + one Newton step ( Relative error ~1e-7 )
+		inline float InvSqrt(float x)
+		{
+			const float estimate{ _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x))) };
+			return estimate * (1.5f - 0.5f * x * estimate * estimate);
+		}
+	}
+}
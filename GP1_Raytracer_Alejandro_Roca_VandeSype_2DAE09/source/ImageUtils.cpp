@@ -0,0 +1,216 @@
+#include "ImageUtils.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+#include "RenderTarget.h"
+
+namespace dae
+{
+	namespace
+	{
+		// Rows top to bottom, 3 bytes per pixel, optionally prefixed by one byte per row ( PNG filter type )
+		std::vector<uint8_t> GetRGBRows(const RenderTarget& target, bool rowPrefix)
+		{
+			const int width{ target.GetWidth() };
+			const int height{ target.GetHeight() };
+
+			std::vector<uint8_t> rows{};
+			rows.reserve(static_cast<size_t>(width * 3 + (rowPrefix ? 1 : 0)) * height);
+			for (int y{ 0 }; y < height; ++y)
+			{
+				if (rowPrefix)
+					rows.emplace_back(static_cast<uint8_t>(0));
+
+				for (int x{ 0 }; x < width; ++x)
+				{
+					uint8_t r{}, g{}, b{};
+					target.UnpackColor(target.GetPixels()[x + y * width], r, g, b);
+					rows.insert(rows.end(), { r, g, b });
+				}
+			}
+			return rows;
+		}
+
+		void WriteBigEndian(std::vector<uint8_t>& data, uint32_t value)
+		{
+			data.insert(data.end(), { static_cast<uint8_t>(value >> 24), static_cast<uint8_t>(value >> 16),
+				static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value) });
+		}
+
+		void WriteLittleEndian(std::vector<uint8_t>& data, uint32_t value, int byteCount)
+		{
+			for (int byteIdx{ 0 }; byteIdx < byteCount; ++byteIdx)
+				data.emplace_back(static_cast<uint8_t>(value >> (8 * byteIdx)));
+		}
+
+		uint32_t CalculateCRC(const uint8_t* pData, size_t size)
+		{
+			static const std::array<uint32_t, 256> table{ []
+				{
+					std::array<uint32_t, 256> crcTable{};
+					for (uint32_t n{ 0 }; n < 256; ++n)
+					{
+						uint32_t c{ n };
+						for (int bit{ 0 }; bit < 8; ++bit)
+							c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+						crcTable[n] = c;
+					}
+					return crcTable;
+				}() };
+
+			uint32_t crc{ 0xffffffffu };
+			for (size_t idx{ 0 }; idx < size; ++idx)
+				crc = table[(crc ^ pData[idx]) & 0xff] ^ (crc >> 8);
+			return crc ^ 0xffffffffu;
+		}
+
+		// Length, type, data, CRC of type + data
+		void WritePNGChunk(std::vector<uint8_t>& file, const char type[4], const std::vector<uint8_t>& data)
+		{
+			WriteBigEndian(file, static_cast<uint32_t>(data.size()));
+
+			const size_t typeStart{ file.size() };
+			file.insert(file.end(), type, type + 4);
+			file.insert(file.end(), data.begin(), data.end());
+
+			WriteBigEndian(file, CalculateCRC(file.data() + typeStart, file.size() - typeStart));
+		}
+
+		bool WriteFile(const std::string& filePath, const std::vector<uint8_t>& data)
+		{
+			std::ofstream file{ filePath, std::ios::binary };
+			if (!file)
+				return false;
+
+			file.write(reinterpret_cast<const char*>(data.data()), data.size());
+			return static_cast<bool>(file);
+		}
+	}
+
+	namespace ImageUtils
+	{
+		bool SaveImage(const RenderTarget& target, const std::string& filePath)
+		{
+			const size_t extensionStart{ filePath.find_last_of('.') };
+			if (extensionStart == std::string::npos)
+				return false;
+
+			std::string extension{ filePath.substr(extensionStart + 1) };
+			std::transform(extension.begin(), extension.end(), extension.begin(),
+				[](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+
+			if (extension == "ppm")
+				return SavePPM(target, filePath);
+			if (extension == "png")
+				return SavePNG(target, filePath);
+			if (extension == "bmp")
+				return SaveBMP(target, filePath);
+
+			return false;
+		}
+
+		bool SavePPM(const RenderTarget& target, const std::string& filePath)
+		{
+			// Binary PPM ( P6 ) : text header followed by the raw RGB rows
+			const std::string header{ "P6\n" + std::to_string(target.GetWidth()) + " " + std::to_string(target.GetHeight()) + "\n255\n" };
+
+			std::vector<uint8_t> data{ header.begin(), header.end() };
+			const std::vector<uint8_t> rows{ GetRGBRows(target, false) };
+			data.insert(data.end(), rows.begin(), rows.end());
+
+			return WriteFile(filePath, data);
+		}
+
+		bool SavePNG(const RenderTarget& target, const std::string& filePath)
+		{
+			std::vector<uint8_t> file{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+			// Header : size, 8 bits per channel, RGB, no interlacing
+			std::vector<uint8_t> header{};
+			WriteBigEndian(header, static_cast<uint32_t>(target.GetWidth()));
+			WriteBigEndian(header, static_cast<uint32_t>(target.GetHeight()));
+			header.insert(header.end(), { 8, 2, 0, 0, 0 });
+			WritePNGChunk(file, "IHDR", header);
+
+			// Image data : zlib stream made of stored ( Uncompressed ) deflate blocks of at most 65535 bytes
+			const std::vector<uint8_t> rows{ GetRGBRows(target, true) };
+			constexpr size_t maxBlockSize{ 65535 };
+
+			std::vector<uint8_t> imageData{ 0x78, 0x01 };
+			imageData.reserve(rows.size() + rows.size() / maxBlockSize * 5 + 16);
+			size_t offset{ 0 };
+			do
+			{
+				const size_t blockSize{ std::min(rows.size() - offset, maxBlockSize) };
+				const bool isLastBlock{ offset + blockSize == rows.size() };
+
+				imageData.emplace_back(static_cast<uint8_t>(isLastBlock ? 1 : 0));
+				WriteLittleEndian(imageData, static_cast<uint32_t>(blockSize), 2);
+				WriteLittleEndian(imageData, static_cast<uint32_t>(~blockSize), 2);
+				imageData.insert(imageData.end(), rows.begin() + offset, rows.begin() + offset + blockSize);
+
+				offset += blockSize;
+			} while (offset < rows.size());
+
+			// Adler-32 checksum of the uncompressed data
+			uint32_t a{ 1 }, b{ 0 };
+			for (uint8_t value : rows)
+			{
+				a = (a + value) % 65521;
+				b = (b + a) % 65521;
+			}
+			WriteBigEndian(imageData, (b << 16) | a);
+
+			WritePNGChunk(file, "IDAT", imageData);
+			WritePNGChunk(file, "IEND", {});
+
+			return WriteFile(filePath, file);
+		}
+
+		bool SaveBMP(const RenderTarget& target, const std::string& filePath)
+		{
+			// 24 bit BMP : rows bottom to top, BGR, every row padded to a multiple of 4 bytes
+			const int width{ target.GetWidth() };
+			const int height{ target.GetHeight() };
+			const uint32_t rowSize{ (static_cast<uint32_t>(width) * 3 + 3) / 4 * 4 };
+			const uint32_t pixelDataSize{ rowSize * height };
+			constexpr uint32_t headerSize{ 14 + 40 };
+
+			std::vector<uint8_t> file{ 'B', 'M' };
+			file.reserve(headerSize + pixelDataSize);
+			WriteLittleEndian(file, headerSize + pixelDataSize, 4);
+			WriteLittleEndian(file, 0, 4);
+			WriteLittleEndian(file, headerSize, 4);
+
+			WriteLittleEndian(file, 40, 4);
+			WriteLittleEndian(file, static_cast<uint32_t>(width), 4);
+			WriteLittleEndian(file, static_cast<uint32_t>(height), 4);
+			WriteLittleEndian(file, 1, 2);		// Planes
+			WriteLittleEndian(file, 24, 2);		// Bits per pixel
+			WriteLittleEndian(file, 0, 4);		// No compression
+			WriteLittleEndian(file, pixelDataSize, 4);
+			WriteLittleEndian(file, 2835, 4);	// 72 DPI
+			WriteLittleEndian(file, 2835, 4);
+			WriteLittleEndian(file, 0, 4);
+			WriteLittleEndian(file, 0, 4);
+
+			for (int y{ height - 1 }; y >= 0; --y)
+			{
+				for (int x{ 0 }; x < width; ++x)
+				{
+					uint8_t r{}, g{}, b{};
+					target.UnpackColor(target.GetPixels()[x + y * width], r, g, b);
+					file.insert(file.end(), { b, g, r });
+				}
+				file.resize(file.size() + (rowSize - width * 3), 0);
+			}
+
+			return WriteFile(filePath, file);
+		}
+	}
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <string>
+
+namespace dae
+{
+	class RenderTarget;
+
+	namespace ImageUtils
+	{
+		// Format picked from the extension : .ppm, .png or .bmp ( Anything else -> false )
+		// ... All of them return true when the file was written
+		bool SaveImage(const RenderTarget& target, const std::string& filePath);
+
+		bool SavePPM(const RenderTarget& target, const std::string& filePath);
+		// Uncompressed PNG ( Stored deflate blocks ) -> no zlib needed, the files are about as big as a BMP
+		bool SavePNG(const RenderTarget& target, const std::string& filePath);
+		bool SaveBMP(const RenderTarget& target, const std::string& filePath);
+	}
+}
@@ -0,0 +1,179 @@
+#include "LightBVH.h"
+
+#include <algorithm>
+
+#include "BVH.h"
+#include "DataTypes.h"
+
+namespace dae
+{
+	void LightBVH::Build(const std::vector<Light>& lights)
+	{
+		Clear();
+
+		std::vector<uint32_t> pointLights{};
+		for (uint32_t lightIdx{ 0 }; lightIdx < lights.size(); ++lightIdx)
+		{
+			if (lights[lightIdx].type == LightType::Directional)
+				m_DirectionalLights.emplace_back(lightIdx);
+			else
+				pointLights.emplace_back(lightIdx);
+		}
+
+		m_PointLightCount = static_cast<uint32_t>(pointLights.size());
+		m_LightLeaves.resize(lights.size(), UINT32_MAX);
+		if (pointLights.empty())
+			return;
+
+		// One light per leaf -> exactly 2N - 1 nodes
+		m_Nodes.reserve(2 * pointLights.size() - 1);
+		m_Parents.reserve(2 * pointLights.size() - 1);
+
+		m_Nodes.emplace_back();
+		m_Parents.emplace_back(UINT32_MAX);
+		Subdivide(0, lights, pointLights, 0, m_PointLightCount);
+	}
+
+	void LightBVH::Clear()
+	{
+		m_Nodes.clear();
+		m_DirectionalLights.clear();
+		m_Parents.clear();
+		m_LightLeaves.clear();
+		m_PointLightCount = 0;
+	}
+
+	void LightBVH::Subdivide(uint32_t nodeIdx, const std::vector<Light>& lights, std::vector<uint32_t>& lightIndices, uint32_t first, uint32_t count)
+	{
+		AABB bounds{};
+		float power{ 0.f };
+		for (uint32_t idx{ first }; idx < first + count; ++idx)
+		{
+			const Light& light{ lights[lightIndices[idx]] };
+			bounds.Grow(light.origin);
+			power += light.intensity * (light.color.r + light.color.g + light.color.b) / 3.f;
+		}
+
+		// ( No reference into m_Nodes, the children are added below )
+		m_Nodes[nodeIdx].minAABB = bounds.min;
+		m_Nodes[nodeIdx].maxAABB = bounds.max;
+		m_Nodes[nodeIdx].power = power;
+
+		if (count == 1)
+		{
+			m_Nodes[nodeIdx].leftFirst = lightIndices[first];
+			m_Nodes[nodeIdx].isLeaf = true;
+			m_LightLeaves[lightIndices[first]] = nodeIdx;
+			return;
+		}
+
+		// Split in the middle of the longest axis ( Median -> balanced tree, every pick takes log2(N) steps )
+		const Vector3 extent{ bounds.max - bounds.min };
+		int axis{ 0 };
+		if (extent.y > extent[axis])
+			axis = 1;
+		if (extent.z > extent[axis])
+			axis = 2;
+
+		const uint32_t middle{ first + count / 2 };
+		std::nth_element(lightIndices.begin() + first, lightIndices.begin() + middle, lightIndices.begin() + first + count,
+			[&](uint32_t a, uint32_t b) { return lights[a].origin[axis] < lights[b].origin[axis]; });
+
+		const uint32_t leftIdx{ static_cast<uint32_t>(m_Nodes.size()) };
+		m_Nodes[nodeIdx].leftFirst = leftIdx;
+		m_Nodes.emplace_back();
+		m_Nodes.emplace_back();
+		m_Parents.emplace_back(nodeIdx);
+		m_Parents.emplace_back(nodeIdx);
+
+		Subdivide(leftIdx, lights, lightIndices, first, middle - first);
+		Subdivide(leftIdx + 1, lights, lightIndices, middle, first + count - middle);
+	}
+
+	float LightBVH::GetImportance(const LightBVHNode& node, const Vector3& origin, const Vector3& normal) const
+	{
+		// Node seen as a sphere around its bounds
+		const Vector3 center{ (node.minAABB + node.maxAABB) * 0.5f };
+		const float radiusSquared{ (node.maxAABB - center).SqrMagnitude() };
+
+		const Vector3 toCenter{ center - origin };
+		const float distanceSquared{ toCenter.SqrMagnitude() };
+
+		// Most optimistic angle between the normal and any light in the node
+		// ... Inside the sphere the lights can be in any direction
+		float cosBound{ 1.f };
+		if (distanceSquared > radiusSquared)
+		{
+			const float distance{ sqrtf(distanceSquared) };
+			const float normalAngle{ acosf(std::clamp(Vector3::Dot(normal, toCenter) / distance, -1.f, 1.f)) };
+			const float sphereAngle{ asinf(sqrtf(radiusSquared / distanceSquared)) };
+
+			const float closestAngle{ std::max(normalAngle - sphereAngle, 0.f) };
+			if (closestAngle >= PI_DIV_2)
+				return 0.f;		// Whole node below the horizon
+
+			cosBound = cosf(closestAngle);
+		}
+
+		// Not closer than the node size -> a big node right next to the point doesn't take every pick
+		return node.power * cosBound / std::max(distanceSquared, std::max(radiusSquared, 0.0001f));
+	}
+
+	bool LightBVH::Sample(const Vector3& origin, const Vector3& normal, float u, uint32_t& lightIdx, float& pmf) const
+	{
+		if (m_Nodes.empty())
+			return false;
+
+		pmf = 1.f;
+		uint32_t nodeIdx{ 0 };
+		while (!m_Nodes[nodeIdx].isLeaf)
+		{
+			const uint32_t leftIdx{ m_Nodes[nodeIdx].leftFirst };
+			const float leftImportance{ GetImportance(m_Nodes[leftIdx], origin, normal) };
+			const float rightImportance{ GetImportance(m_Nodes[leftIdx + 1], origin, normal) };
+			if (leftImportance + rightImportance <= 0.f)
+				return false;
+
+			// Pick a child and stretch u back to [0, 1) for the next step ( One random number for the whole descent )
+			const float leftProbability{ leftImportance / (leftImportance + rightImportance) };
+			if (u < leftProbability)
+			{
+				u = std::min(u / leftProbability, 1.f - FLT_EPSILON);
+				pmf *= leftProbability;
+				nodeIdx = leftIdx;
+			}
+			else
+			{
+				u = std::min((u - leftProbability) / (1.f - leftProbability), 1.f - FLT_EPSILON);
+				pmf *= 1.f - leftProbability;
+				nodeIdx = leftIdx + 1;
+			}
+		}
+
+		lightIdx = m_Nodes[nodeIdx].leftFirst;
+		return true;
+	}
+
+	float LightBVH::GetPmf(const Vector3& origin, const Vector3& normal, uint32_t lightIdx) const
+	{
+		if (lightIdx >= m_LightLeaves.size() || m_LightLeaves[lightIdx] == UINT32_MAX)
+			return 0.f;
+
+		// Product of the child probabilities on the way from the leaf up to the root
+		float pmf{ 1.f };
+		uint32_t nodeIdx{ m_LightLeaves[lightIdx] };
+		while (m_Parents[nodeIdx] != UINT32_MAX)
+		{
+			const uint32_t leftIdx{ m_Nodes[m_Parents[nodeIdx]].leftFirst };
+			const float leftImportance{ GetImportance(m_Nodes[leftIdx], origin, normal) };
+			const float rightImportance{ GetImportance(m_Nodes[leftIdx + 1], origin, normal) };
+			if (leftImportance + rightImportance <= 0.f)
+				return 0.f;
+
+			pmf *= GetImportance(m_Nodes[nodeIdx], origin, normal) / (leftImportance + rightImportance);
+			nodeIdx = m_Parents[nodeIdx];
+		}
+
+		return pmf;
+	}
+}
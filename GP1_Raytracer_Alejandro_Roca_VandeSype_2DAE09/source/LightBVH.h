@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	struct Light;
+
+	// Light node : bounds and total power of the point lights below it
+	// Inner node : leftFirst = index of the left child, the right child is always leftFirst + 1
+	// Leaf node  : leftFirst = index of its light in the scene light list ( One light per leaf )
+	struct LightBVHNode
+	{
+		Vector3 minAABB{};
+		uint32_t leftFirst{};
+		Vector3 maxAABB{};
+		float power{};
+		bool isLeaf{};
+	};
+
+	// Hierarchy over the point lights of a scene, to shade with a few lights picked at random instead of all of them
+	// ... Every step down the tree picks a child in proportion to its estimated contribution to the shaded point
+	// ... ( Power, distance, and whether the node is above the horizon of the surface normal )
+	// Directional lights can't be bounded in space, they are kept in a separate list and always shaded
+	class LightBVH final
+	{
+	public:
+		LightBVH() = default;
+		~LightBVH() = default;
+
+		void Build(const std::vector<Light>& lights);
+		void Clear();
+
+		/**
+		 * \brief Picks one point light for a surface point
+		 * \param origin Surface point
+		 * \param normal Surface normal ( Lights below the horizon are never picked )
+		 * \param u Uniform random number in [0, 1)
+		 * \param lightIdx Picked light, index in the scene light list
+		 * \param pmf Probability of picking that light ( Divide its contribution by it -> unbiased )
+		 * \return false when no point light can light the surface point
+		 */
+		bool Sample(const Vector3& origin, const Vector3& normal, float u, uint32_t& lightIdx, float& pmf) const;
+		// Probability that Sample picks lightIdx ( 0 for directional lights )
+		float GetPmf(const Vector3& origin, const Vector3& normal, uint32_t lightIdx) const;
+
+		const std::vector<uint32_t>& GetDirectionalLights() const { return m_DirectionalLights; }
+		uint32_t GetPointLightCount() const { return m_PointLightCount; }
+
+	private:
+		std::vector<LightBVHNode> m_Nodes{};
+		std::vector<uint32_t> m_DirectionalLights{};
+		// Only for GetPmf : walk up from the leaf of a light
+		std::vector<uint32_t> m_Parents{};
+		std::vector<uint32_t> m_LightLeaves{};
+		uint32_t m_PointLightCount{};
+
+		void Subdivide(uint32_t nodeIdx, const std::vector<Light>& lights, std::vector<uint32_t>& lightIndices, uint32_t first, uint32_t count);
+		float GetImportance(const LightBVHNode& node, const Vector3& origin, const Vector3& normal) const;
+	};
+}
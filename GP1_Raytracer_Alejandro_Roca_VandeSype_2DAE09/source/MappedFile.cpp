@@ -0,0 +1,142 @@
+#include "MappedFile.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace dae
+{
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+
+	MappedFile::MappedFile(MappedFile&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+	{
+		if (this == &other)
+			return *this;
+
+		Close();
+		m_pData = std::exchange(other.m_pData, nullptr);
+		m_Size = std::exchange(other.m_Size, 0);
+		m_IsOpen = std::exchange(other.m_IsOpen, false);
+#ifdef _WIN32
+		m_FileHandle = std::exchange(other.m_FileHandle, nullptr);
+		m_MappingHandle = std::exchange(other.m_MappingHandle, nullptr);
+#endif
+		return *this;
+	}
+
+#ifdef _WIN32
+	bool MappedFile::Open(const std::string& filePath)
+	{
+		Close();
+
+		const HANDLE file{ CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr) };
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size{};
+		if (!GetFileSizeEx(file, &size))
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		// A mapping of 0 bytes is an error on Windows
+		m_FileHandle = file;
+		m_IsOpen = true;
+		if (size.QuadPart == 0)
+			return true;
+
+		m_MappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (m_MappingHandle)
+			m_pData = static_cast<const char*>(MapViewOfFile(m_MappingHandle, FILE_MAP_READ, 0, 0, 0));
+		if (!m_pData)
+		{
+			Close();
+			return false;
+		}
+
+		m_Size = static_cast<size_t>(size.QuadPart);
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (m_pData)
+			UnmapViewOfFile(m_pData);
+		if (m_MappingHandle)
+			CloseHandle(m_MappingHandle);
+		if (m_FileHandle)
+			CloseHandle(m_FileHandle);
+
+		m_pData = nullptr;
+		m_MappingHandle = nullptr;
+		m_FileHandle = nullptr;
+		m_Size = 0;
+		m_IsOpen = false;
+	}
+#else
+	bool MappedFile::Open(const std::string& filePath)
+	{
+		Close();
+
+		const int file{ open(filePath.c_str(), O_RDONLY) };
+		if (file < 0)
+			return false;
+
+		struct stat status {};
+		if (fstat(file, &status) != 0)
+		{
+			close(file);
+			return false;
+		}
+
+		// A mapping of 0 bytes is an error, an empty file just has no data
+		m_IsOpen = true;
+		if (status.st_size > 0)
+		{
+			void* pMapping{ mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0) };
+			if (pMapping == MAP_FAILED)
+				m_IsOpen = false;
+			else
+			{
+				// Read front to back -> let the kernel read ahead
+				madvise(pMapping, static_cast<size_t>(status.st_size), MADV_SEQUENTIAL);
+				m_pData = static_cast<const char*>(pMapping);
+				m_Size = static_cast<size_t>(status.st_size);
+			}
+		}
+
+		// The mapping stays valid without the descriptor
+		close(file);
+		return m_IsOpen;
+	}
+
+	void MappedFile::Close()
+	{
+		if (m_pData)
+			munmap(const_cast<char*>(m_pData), m_Size);
+
+		m_pData = nullptr;
+		m_Size = 0;
+		m_IsOpen = false;
+	}
+#endif
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace dae
+{
+	// Read-only view of a whole file, mapped into memory instead of read into a buffer
+	// ... The OS pages it in on first access, so parsing and copying straight from it costs no extra read pass
+	class MappedFile final
+	{
+	public:
+		MappedFile() = default;
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+		// false when the file can't be opened or mapped ( An empty file opens, with no data )
+		bool Open(const std::string& filePath);
+		void Close();
+
+		bool IsOpen() const { return m_IsOpen; }
+		const char* GetData() const { return m_pData; }
+		size_t GetSize() const { return m_Size; }
+		std::string_view GetText() const { return { m_pData, m_Size }; }
+
+	private:
+		const char* m_pData{ nullptr };
+		size_t m_Size{ 0 };
+		bool m_IsOpen{ false };
+#ifdef _WIN32
+		void* m_FileHandle{ nullptr };
+		void* m_MappingHandle{ nullptr };
+#endif
+	};
+}
@@ -1,164 +1,341 @@
 #pragma once
+#include <algorithm>
+#include <cstdint>
 #include "Math.h"
 #include "DataTypes.h"
 #include "BRDFs.h"
+#include "FastMath.h"
+#include "Wavefront.h"
 
 namespace dae
 {
-#pragma region Material BASE
-	class Material
+#pragma region Material TABLE
+	enum class MaterialType : uint8_t
 	{
-	public:
-		Material() = default;
-		virtual ~Material() = default;
-
-		Material(const Material&) = delete;
-		Material(Material&&) noexcept = delete;
-		Material& operator=(const Material&) = delete;
-		Material& operator=(Material&&) noexcept = delete;
+		SolidColor,
+		Lambert,
+		LambertPhong,
+		CookTorrence
+	};
 
-		/**
-		 * \brief Function used to calculate the correct color for the specific material and its parameters
-		 * \param hitRecord current hitrecord
-		 * \param l light direction
-		 * \param v view direction
-		 * \return color
-		 */
-		virtual ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) = 0;
+	enum class ShadingMode : uint8_t
+	{
+		Exact,		// BRDFs.h as written
+		Fast		// Same BRDFs with FastMath approximations ( Image error bounded by Unit_Tests )
 	};
-#pragma endregion
 
-#pragma region Material SOLID COLOR
-	//SOLID COLOR
-	//===========
-	class Material_SolidColor final : public Material
+	// One entry of the scene material table ( Scene::GetMaterials, indexed by HitRecord::materialIndex )
+	// ... Plain parameters + a type tag : the whole table is one flat array, shading switches on the tag
+	// ... ( No heap object per material, no virtual call per light )
+	// Every type only reads its own parameters
+	struct Material
 	{
-	public:
-		Material_SolidColor(const ColorRGB& color): m_Color(color)
+		MaterialType type{ MaterialType::SolidColor };
+		ColorRGB color{ colors::White };		// Solid color, diffuse color ( Lambert, Phong ) or albedo ( Cook-Torrance )
+		float diffuseReflectance{ 1.f };		// kd
+		float specularReflectance{ 0.f };		// ks
+		float phongExponent{ 1.f };
+		float metalness{ 0.f };
+		float roughness{ 1.f };					// [1.0 > 0.0] >> [ROUGH > SMOOTH]
+
+		static Material SolidColor(const ColorRGB& color)
 		{
+			Material material{};
+			material.type = MaterialType::SolidColor;
+			material.color = color;
+			return material;
 		}
 
-		ColorRGB Shade(const HitRecord& hitRecord, const Vector3& l, const Vector3& v) override
+		static Material Lambert(const ColorRGB& diffuseColor, float diffuseReflectance)
 		{
-			return m_Color;
+			Material material{};
+			material.type = MaterialType::Lambert;
+			material.color = diffuseColor;
+			material.diffuseReflectance = diffuseReflectance;
+			return material;
 		}
 
-	private:
-		ColorRGB m_Color{colors::White};
-	};
-#pragma endregion
-
-#pragma region Material LAMBERT
-	//LAMBERT
-	//=======
-	class Material_Lambert final : public Material
-	{
-	public:
-		Material_Lambert(const ColorRGB& diffuseColor, float diffuseReflectance) :
-			m_DiffuseColor(diffuseColor), m_DiffuseReflectance(diffuseReflectance){}
-
-		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+		static Material LambertPhong(const ColorRGB& diffuseColor, float kd, float ks, float phongExponent)
 		{
-			return BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor);
+			Material material{};
+			material.type = MaterialType::LambertPhong;
+			material.color = diffuseColor;
+			material.diffuseReflectance = kd;
+			material.specularReflectance = ks;
+			material.phongExponent = phongExponent;
+			return material;
 		}
 
-	private:
-		ColorRGB m_DiffuseColor{colors::White};
-		float m_DiffuseReflectance{1.f}; //kd
+		static Material CookTorrence(const ColorRGB& albedo, float metalness, float roughness)
+		{
+			Material material{};
+			material.type = MaterialType::CookTorrence;
+			material.color = albedo;
+			material.metalness = metalness;
+			material.roughness = roughness;
+			return material;
+		}
 	};
 #pragma endregion
 
-#pragma region Material LAMBERT PHONG
-	//LAMBERT-PHONG
-	//=============
-	class Material_LambertPhong final : public Material
+	namespace MaterialUtils
 	{
-	public:
-		Material_LambertPhong(const ColorRGB& diffuseColor, float kd, float ks, float phongExponent):
-			m_DiffuseColor(diffuseColor), m_DiffuseReflectance(kd), m_SpecularReflectance(ks),
-			m_PhongExponent(phongExponent)
+#pragma region BRDF PER TYPE
+		// n = normal, l = light direction ( Away from the surface ), v = view direction ( Towards the surface )
+		inline ColorRGB Shade_SolidColor(const Material& material)
 		{
+			return material.color;
 		}
 
-		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+		inline ColorRGB Shade_Lambert(const Material& material)
 		{
-			// BRDF linearity property -> Reflectivity based on multiple BRDF's
-			// All vectors need to point the same direction
-			return BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor) + BRDF::Phong(m_SpecularReflectance,
-				m_PhongExponent, l, v, hitRecord.normal);
-
+			return BRDF::Lambert(material.diffuseReflectance, material.color);
 		}
 
-	private:
-		ColorRGB m_DiffuseColor{colors::White};
-		float m_DiffuseReflectance{0.5f}; //kd
-		float m_SpecularReflectance{0.5f}; //ks
-		float m_PhongExponent{1.f}; //Phong Exponent
-	};
-#pragma endregion
-
-#pragma region Material COOK TORRENCE
-	//COOK TORRENCE
-	class Material_CookTorrence final : public Material
-	{
-	public:
-		Material_CookTorrence(const ColorRGB& albedo, float metalness, float roughness):
-			m_Albedo(albedo), m_Metalness(metalness), m_Roughness(roughness)
+		inline ColorRGB Shade_LambertPhong(const Material& material, const Vector3& n, const Vector3& l, const Vector3& v)
 		{
+			// BRDF linearity property -> Reflectivity based on multiple BRDF's
+			// All vectors need to point the same direction
+			return BRDF::Lambert(material.diffuseReflectance, material.color) + BRDF::Phong(material.specularReflectance,
+				material.phongExponent, l, v, n);
 		}
 
-		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+		inline ColorRGB Shade_CookTorrence(const Material& material, const Vector3& n, const Vector3& l, const Vector3& v)
 		{
 			// Calculate the F0 ( Base reflectivity of the surface )
-			ColorRGB f0{0.04f, 0.04f, 0.04f};
+			ColorRGB f0{ 0.04f, 0.04f, 0.04f };
 
-			if (m_Metalness != 0)
+			if (material.metalness != 0)
 			{
 				// Use Albedo color for metals (Since we are not implementing textures )
-				f0 = m_Albedo;
+				f0 = material.color;
 			}
 
 			// Half-Vector between view direction and light direction
 			// View direction needs to be oriented towards camera
 			Vector3 vectorAdd{ -v + l };
-			Vector3 halfVector{ vectorAdd / vectorAdd.Magnitude()};
+			Vector3 halfVector{ vectorAdd / vectorAdd.Magnitude() };
 
 			// ** Calculate Fresnel **  -> How much light is reflected and refracted
-			ColorRGB fresnel{ BRDF::FresnelFunction_Schlick(halfVector, -v, f0)};
+			ColorRGB fresnel{ BRDF::FresnelFunction_Schlick(halfVector, -v, f0) };
 
 			//// ** Calculate Normal **  -> Determine how rough the material is
-			float normal{ BRDF::NormalDistribution_GGX(hitRecord.normal, halfVector, m_Roughness) };
+			float normal{ BRDF::NormalDistribution_GGX(n, halfVector, material.roughness) };
 
-			//// ** Calculate Geometry **  -> Shadowing (blocking incoming light ) and Masking 
+			//// ** Calculate Geometry **  -> Shadowing (blocking incoming light ) and Masking
 			//// (blocking the scattered light)
-			float geometry { BRDF::GeometryFunction_Smith(hitRecord.normal, -v, l, m_Roughness)};
+			float geometry{ BRDF::GeometryFunction_Smith(n, -v, l, material.roughness) };
 
-			//return { geometry, geometry, geometry };
 			//// ** SPECULAR -> COOK-TORRANCE **
 			//// (DFG) / 4 ( Dot(v,n) Dot(l,n) )
 			ColorRGB dfg{ normal * fresnel * geometry };
-			ColorRGB cookTorrance{ dfg / ( 4.f * Vector3::Dot(-v, hitRecord.normal) * Vector3::Dot(l, hitRecord.normal) ) };
+			ColorRGB cookTorrance{ dfg / (4.f * Vector3::Dot(-v, n) * Vector3::Dot(l, n)) };
 
 			//// Determine Diffuse reflectance (kd)
 			//// If not metal is the inverse of the fresnel
 			ColorRGB kd{ 1.f - fresnel.r,   1.f - fresnel.g,  1.f - fresnel.b };
-			if (m_Metalness != 0)
+			if (material.metalness != 0)
 			{
-				// If it is metal -> Cancel out 
+				// If it is metal -> Cancel out
 				kd.r = kd.g = kd.b = 0;
 			}
 
 			//// Calculate Diffuse
-			ColorRGB diffuse{ BRDF::Lambert(kd, m_Albedo) };
+			ColorRGB diffuse{ BRDF::Lambert(kd, material.color) };
 
 			return (kd * diffuse) + (fresnel * cookTorrance);
+		}
+
+		// Fast shading mode : same result as Shade_LambertPhong, powf replaced by FastMath::Pow
+		inline ColorRGB Shade_LambertPhong_Fast(const Material& material, const Vector3& n, const Vector3& l, const Vector3& v)
+		{
+			const Vector3 reflect{ l - (2.f * Vector3::Dot(n, l) * n) };
+			const float cosAngle{ std::max(0.f, Vector3::Dot(reflect, v)) };
+			const float specular{ material.specularReflectance * FastMath::Pow(cosAngle, material.phongExponent) };
 
+			return BRDF::Lambert(material.diffuseReflectance, material.color) + ColorRGB{ specular, specular, specular };
 		}
 
-	private:
-		ColorRGB m_Albedo{0.955f, 0.637f, 0.538f}; //Copper
-		float m_Metalness{1.0f};
-		float m_Roughness{0.1f}; // [1.0 > 0.0] >> [ROUGH > SMOOTH]
-	};
+		// Fast shading mode : same result as Shade_CookTorrence
+		// ... Fresnel power with multiplications, Smith numerators cancelled against the 4 ( n.v ) ( n.l ) denominator
+		// ... -> one square root estimate and one division, no powf
+		inline ColorRGB Shade_CookTorrence_Fast(const Material& material, const Vector3& n, const Vector3& l, const Vector3& v)
+		{
+			const Vector3 toViewer{ -v };
+			Vector3 halfVector{ toViewer + l };
+			halfVector *= FastMath::InvSqrt(halfVector.SqrMagnitude());
+
+			const float nDotV{ Vector3::Dot(n, toViewer) };
+			const float nDotL{ Vector3::Dot(n, l) };
+			const float nDotH{ Vector3::Dot(n, halfVector) };
+
+			// Schlick : f0 + ( 1 - f0 ) ( 1 - h.v )^5
+			const bool isMetal{ material.metalness != 0 };
+			const ColorRGB f0{ isMetal ? material.color : ColorRGB{ 0.04f, 0.04f, 0.04f } };
+			const float oneMinusCos{ 1.f - Vector3::Dot(halfVector, toViewer) };
+			const float oneMinusCosSquared{ oneMinusCos * oneMinusCos };
+			const float fresnelFactor{ oneMinusCosSquared * oneMinusCosSquared * oneMinusCos };
+			const ColorRGB fresnel{ f0.r + (1.f - f0.r) * fresnelFactor, f0.g + (1.f - f0.g) * fresnelFactor,
+				f0.b + (1.f - f0.b) * fresnelFactor };
+
+			// D * G / ( 4 ( n.v ) ( n.l ) ), 0 where Smith clamps a direction below the surface
+			float specular{ 0.f };
+			if (nDotV > 0.f && nDotL > 0.f)
+			{
+				const float alphaSquared{ Square(material.roughness * material.roughness) };
+				const float normalDenominator{ nDotH * nDotH * (alphaSquared - 1.f) + 1.f };
+				const float k{ Square(material.roughness * material.roughness + 1.f) / 8.f };
+				specular = alphaSquared / (normalDenominator * normalDenominator * PI * 4.f
+					* (nDotV * (1.f - k) + k) * (nDotL * (1.f - k) + k));
+			}
+
+			// Fresnel on the specular term twice, like Shade_CookTorrence
+			const ColorRGB kd{ isMetal ? ColorRGB{} : ColorRGB{ 1.f - fresnel.r, 1.f - fresnel.g, 1.f - fresnel.b } };
+			return (kd * BRDF::Lambert(kd, material.color)) + (fresnel * fresnel * specular);
+		}
+
+		// Share of the GGX lobe : metals only reflect, dielectrics by how much Fresnel reflects vs the diffuse albedo
+		inline float GetSpecularProbability_CookTorrence(const Material& material, const Vector3& n, const Vector3& toViewer)
+		{
+			if (material.metalness != 0)
+				return 1.f;
+
+			const ColorRGB fresnel{ BRDF::FresnelFunction_Schlick(n, toViewer, ColorRGB{ 0.04f, 0.04f, 0.04f }) };
+			const float specular{ (fresnel.r + fresnel.g + fresnel.b) / 3.f };
+			const float diffuse{ (1.f - specular) * (material.color.r + material.color.g + material.color.b) / 3.f };
+
+			// Never 0 or 1 -> both lobes keep a chance to sample
+			return std::clamp(specular / std::max(specular + diffuse, FLT_EPSILON), 0.1f, 0.9f);
+		}
+
+		inline bool Sample_CookTorrence(const Material& material, const Vector3& n, const Vector3& v, Random& random, Vector3& l, float& pdf)
+		{
+			const Vector3 toViewer{ -v };
+
+			// Pick a lobe : GGX reflection around a sampled half vector, or the Lambert lobe
+			const float specularProbability{ GetSpecularProbability_CookTorrence(material, n, toViewer) };
+			if (random.NextFloat() < specularProbability)
+			{
+				const Vector3 halfVector{ BRDF::SampleHalfVector_GGX(n, material.roughness, random.NextFloat(), random.NextFloat()) };
+				l = 2.f * Vector3::Dot(toViewer, halfVector) * halfVector - toViewer;
+			}
+			else
+			{
+				l = SampleUtils::SampleCosineHemisphere(n, random.NextFloat(), random.NextFloat());
+			}
+
+			if (Vector3::Dot(n, l) <= 0.f)
+				return false;	// Reflected below the surface
+
+			// Shade returns diffuse + specular -> pdf of the mixture of both lobes, whichever one was picked
+			// ... ( One-sample MIS with the balance heuristic : no lobe gets a direction it can't explain )
+			const Vector3 halfVector{ (toViewer + l).Normalized() };
+			pdf = (1.f - specularProbability) * SampleUtils::CosineHemispherePdf(n, l)
+				+ specularProbability * BRDF::Pdf_GGX(n, halfVector, toViewer, material.roughness);
+			return pdf > 0.f;
+		}
 #pragma endregion
+
+		/**
+		 * \brief Function used to calculate the correct color for the specific material and its parameters
+		 * \param material entry of the material table
+		 * \param hitRecord current hitrecord
+		 * \param l light direction
+		 * \param v view direction
+		 * \param mode exact BRDFs or their FastMath versions
+		 * \return color
+		 */
+		inline ColorRGB Shade(const Material& material, const HitRecord& hitRecord, const Vector3& l, const Vector3& v,
+			ShadingMode mode = ShadingMode::Exact)
+		{
+			switch (material.type)
+			{
+			case MaterialType::Lambert:
+				return Shade_Lambert(material);
+			case MaterialType::LambertPhong:
+				if (mode == ShadingMode::Fast)
+					return Shade_LambertPhong_Fast(material, hitRecord.normal, l, v);
+				return Shade_LambertPhong(material, hitRecord.normal, l, v);
+			case MaterialType::CookTorrence:
+				if (mode == ShadingMode::Fast)
+					return Shade_CookTorrence_Fast(material, hitRecord.normal, l, v);
+				return Shade_CookTorrence(material, hitRecord.normal, l, v);
+			case MaterialType::SolidColor:
+			default:
+				return Shade_SolidColor(material);
+			}
+		}
+
+		/**
+		 * \brief Importance sampling of the direction the light comes from ( Path tracing ), Lambert lobe by default
+		 * \param material entry of the material table
+		 * \param hitRecord current hitrecord, normal on the side of the viewer
+		 * \param v view direction ( Same as Shade )
+		 * \param random random numbers of the path
+		 * \param l sampled light direction ( Same as Shade, away from the surface )
+		 * \param pdf probability density of l ( Solid angle )
+		 * \return false when the material doesn't scatter light
+		 */
+		inline bool Sample(const Material& material, const HitRecord& hitRecord, const Vector3& v, Random& random, Vector3& l, float& pdf)
+		{
+			switch (material.type)
+			{
+			case MaterialType::SolidColor:
+				return false;	// Debug color, not a real BRDF -> no indirect bounces ( Its constant value would add energy )
+			case MaterialType::CookTorrence:
+				return Sample_CookTorrence(material, hitRecord.normal, v, random, l, pdf);
+			case MaterialType::Lambert:
+			case MaterialType::LambertPhong:
+			default:
+				l = SampleUtils::SampleCosineHemisphere(hitRecord.normal, random.NextFloat(), random.NextFloat());
+				pdf = SampleUtils::CosineHemispherePdf(hitRecord.normal, l);
+				return pdf > 0.f;
+			}
+		}
+
+		// Batch loop of one material type, the switch happens once per batch instead of once per entry
+		template<typename ShadeFunction>
+		void ShadeEach(ShadingBatch& batch, ShadeFunction shade)
+		{
+			for (uint32_t idx{ 0 }; idx < batch.count; ++idx)
+			{
+				batch.SetBRDF(idx, shade(batch.GetNormal(idx), batch.GetLight(idx), batch.GetView(idx)));
+			}
+		}
+
+		/**
+		 * \brief Shade for every entry of a batch ( Wavefront mode, all entries use this material )
+		 * \param material entry of the material table
+		 * \param batch normals, light and view directions in, BRDFs out
+		 * \param mode exact BRDFs or their FastMath versions
+		 */
+		inline void ShadeBatch(const Material& material, ShadingBatch& batch, ShadingMode mode = ShadingMode::Exact)
+		{
+			switch (material.type)
+			{
+			case MaterialType::Lambert:
+			case MaterialType::SolidColor:
+			{
+				// Same BRDF for every direction
+				const ColorRGB brdf{ material.type == MaterialType::Lambert ? Shade_Lambert(material) : Shade_SolidColor(material) };
+				std::fill_n(batch.brdfR, batch.count, brdf.r);
+				std::fill_n(batch.brdfG, batch.count, brdf.g);
+				std::fill_n(batch.brdfB, batch.count, brdf.b);
+				break;
+			}
+			case MaterialType::LambertPhong:
+				if (mode == ShadingMode::Fast)
+					ShadeEach(batch, [&](const Vector3& n, const Vector3& l, const Vector3& v) { return Shade_LambertPhong_Fast(material, n, l, v); });
+				else
+					ShadeEach(batch, [&](const Vector3& n, const Vector3& l, const Vector3& v) { return Shade_LambertPhong(material, n, l, v); });
+				break;
+			case MaterialType::CookTorrence:
+				if (mode == ShadingMode::Fast)
+					ShadeEach(batch, [&](const Vector3& n, const Vector3& l, const Vector3& v) { return Shade_CookTorrence_Fast(material, n, l, v); });
+				else
+					ShadeEach(batch, [&](const Vector3& n, const Vector3& l, const Vector3& v) { return Shade_CookTorrence(material, n, l, v); });
+				break;
+			}
+		}
+	}
 }
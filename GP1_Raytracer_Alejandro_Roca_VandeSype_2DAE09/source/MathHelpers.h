@@ -2,6 +2,18 @@
 #include <cmath>
 #include <float.h>
 
+// SIMD backend of the math headers ( Matrix, VectorBatch ) : define SCALAR_MATH to force the plain C++ fallback
+#if !defined(SCALAR_MATH) && (defined(__SSE2__) || defined(_M_X64))
+#define MATH_SSE
+#endif
+#if defined(MATH_SSE) && defined(__AVX2__)
+#define MATH_AVX2
+#endif
+
+#ifdef MATH_SSE
+#include <immintrin.h>
+#endif
+
 namespace dae
 {
 	/* --- CONSTANTS --- */
@@ -26,6 +38,6 @@ namespace dae
 
 	inline bool AreEqual(float a, float b, float epsilon = FLT_EPSILON)
 	{
-		return abs(a - b) < epsilon;
+		return std::abs(a - b) < epsilon;
 	}
 }
\ No newline at end of file
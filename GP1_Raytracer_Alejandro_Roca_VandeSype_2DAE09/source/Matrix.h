@@ -1,51 +1,322 @@
 #pragma once
+#include <cassert>
+#include <cmath>
+#include <type_traits>
+
+#include "MathHelpers.h"
 #include "Vector3.h"
 #include "Vector4.h"
 
+// Header only, like Vector3 : the transforms inline into the mesh traversal
+// ... MATH_SSE -> rows as SSE registers at run time, the scalar code runs at compile time and with SCALAR_MATH
+
 namespace dae {
 	struct Matrix
 	{
 		Matrix() = default;
-		Matrix(
+		constexpr Matrix(
 			const Vector3& xAxis,
 			const Vector3& yAxis,
 			const Vector3& zAxis,
-			const Vector3& t);
+			const Vector3& t) :
+			Matrix({ xAxis, 0 }, { yAxis, 0 }, { zAxis, 0 }, { t, 1 })
+		{
+		}
 
-		Matrix(
+		constexpr Matrix(
 			const Vector4& xAxis,
 			const Vector4& yAxis,
 			const Vector4& zAxis,
-			const Vector4& t);
-
-		Matrix(const Matrix& m);
-
-		Vector3 TransformVector(const Vector3& v) const;
-		Vector3 TransformVector(float x, float y, float z) const;
-		Vector3 TransformPoint(const Vector3& p) const;
-		Vector3 TransformPoint(float x, float y, float z) const;
-		const Matrix& Transpose();
-
-		Vector3 GetAxisX() const;
-		Vector3 GetAxisY() const;
-		Vector3 GetAxisZ() const;
-		Vector3 GetTranslation() const;
-
-		static Matrix CreateTranslation(float x, float y, float z);
-		static Matrix CreateTranslation(const Vector3& t);
-		static Matrix CreateRotationX(float pitch);
-		static Matrix CreateRotationY(float yaw);
-		static Matrix CreateRotationZ(float roll);
-		static Matrix CreateRotation(float pitch, float yaw, float roll);
-		static Matrix CreateRotation(const Vector3& r);
-		static Matrix CreateScale(float sx, float sy, float sz);
-		static Matrix CreateScale(const Vector3& s);
-		static Matrix Transpose(const Matrix& m);
-
-		Vector4& operator[](int index);
-		Vector4 operator[](int index) const;
-		Matrix operator*(const Matrix& m) const;
-		const Matrix& operator*=(const Matrix& m);
+			const Vector4& t)
+		{
+			data[0] = xAxis;
+			data[1] = yAxis;
+			data[2] = zAxis;
+			data[3] = t;
+		}
+
+		constexpr Matrix(const Matrix& m)
+		{
+			data[0] = m[0];
+			data[1] = m[1];
+			data[2] = m[2];
+			data[3] = m[3];
+		}
+
+		constexpr Matrix& operator=(const Matrix& m) = default;
+
+		constexpr Vector3 TransformVector(const Vector3& v) const
+		{
+			return TransformVector(v.x, v.y, v.z);
+		}
+
+		constexpr Vector3 TransformVector(float x, float y, float z) const
+		{
+#ifdef MATH_SSE
+			if (!std::is_constant_evaluated())
+			{
+				// x * row0 + y * row1 + z * row2, same order as the scalar version
+				const __m128 result{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(LoadRow(0), _mm_set1_ps(x)), _mm_mul_ps(LoadRow(1), _mm_set1_ps(y))),
+					_mm_mul_ps(LoadRow(2), _mm_set1_ps(z))) };
+				return StoreVector3(result);
+			}
+#endif
+			return Vector3{
+				data[0].x * x + data[1].x * y + data[2].x * z,
+				data[0].y * x + data[1].y * y + data[2].y * z,
+				data[0].z * x + data[1].z * y + data[2].z * z
+			};
+		}
+
+		constexpr Vector3 TransformPoint(const Vector3& p) const
+		{
+			return TransformPoint(p.x, p.y, p.z);
+		}
+
+		constexpr Vector3 TransformPoint(float x, float y, float z) const
+		{
+#ifdef MATH_SSE
+			if (!std::is_constant_evaluated())
+			{
+				const __m128 result{ _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(LoadRow(0), _mm_set1_ps(x)), _mm_mul_ps(LoadRow(1), _mm_set1_ps(y))),
+					_mm_mul_ps(LoadRow(2), _mm_set1_ps(z))), LoadRow(3)) };
+				return StoreVector3(result);
+			}
+#endif
+			return Vector3{
+				data[0].x * x + data[1].x * y + data[2].x * z + data[3].x,
+				data[0].y * x + data[1].y * y + data[2].y * z + data[3].y,
+				data[0].z * x + data[1].z * y + data[2].z * z + data[3].z,
+			};
+		}
+
+		constexpr const Matrix& Transpose()
+		{
+			Matrix result{};
+			for (int r{ 0 }; r < 4; ++r)
+			{
+				for (int c{ 0 }; c < 4; ++c)
+				{
+					result[r][c] = data[c][r];
+				}
+			}
+
+			data[0] = result[0];
+			data[1] = result[1];
+			data[2] = result[2];
+			data[3] = result[3];
+
+			return *this;
+		}
+
+		const Matrix& Inverse()
+		{
+			//Optimized Inverse as explained in FGED1 - used widely in other libraries too.
+			const Vector3 a = data[0];
+			const Vector3 b = data[1];
+			const Vector3 c = data[2];
+			const Vector3 d = data[3];
+
+			const float x = data[0][3];
+			const float y = data[1][3];
+			const float z = data[2][3];
+			const float w = data[3][3];
+
+			Vector3 s = Vector3::Cross(a, b);
+			Vector3 t = Vector3::Cross(c, d);
+			Vector3 u = a * y - b * x;
+			Vector3 v = c * w - d * z;
+
+			const float det = Vector3::Dot(s, v) + Vector3::Dot(t, u);
+			assert((!AreEqual(det, 0.f)) && "ERROR: determinant is 0, there is no INVERSE!");
+			const float invDet = 1.f / det;
+
+			s *= invDet; t *= invDet; u *= invDet; v *= invDet;
+
+			const Vector3 r0 = Vector3::Cross(b, v) + t * y;
+			const Vector3 r1 = Vector3::Cross(v, a) - t * x;
+			const Vector3 r2 = Vector3::Cross(d, u) + s * w;
+			//Vector3 r3 = Vector3::Cross(u, c) - s * z;
+
+			data[0] = Vector4{ r0.x, r1.x, r2.x, 0.f };
+			data[1] = Vector4{ r0.y, r1.y, r2.y, 0.f };
+			data[2] = Vector4{ r0.z, r1.z, r2.z, 0.f };
+			data[3] = { -Vector3::Dot(b, t),Vector3::Dot(a, t),-Vector3::Dot(d, s),Vector3::Dot(c, s) };
+
+			return *this;
+		}
+
+		constexpr Vector3 GetAxisX() const
+		{
+			return data[0];
+		}
+
+		constexpr Vector3 GetAxisY() const
+		{
+			return data[1];
+		}
+
+		constexpr Vector3 GetAxisZ() const
+		{
+			return data[2];
+		}
+
+		constexpr Vector3 GetTranslation() const
+		{
+			return data[3];
+		}
+
+		static constexpr Matrix CreateTranslation(float x, float y, float z)
+		{
+			return CreateTranslation(Vector3{ x, y, z });
+		}
+
+		static constexpr Matrix CreateTranslation(const Vector3& t)
+		{
+			return { Vector3::UnitX, Vector3::UnitY, Vector3::UnitZ, t };
+		}
+
+		static Matrix CreateRotationX(float pitch)
+		{
+			Matrix xRotMatrix;
+
+			// std:: -> float overload in every translation unit ( The plain name can be the double one, depending on the includes )
+			float cosP{ std::cos(pitch) };
+			float sinP{ std::sin(pitch) };
+
+			// Left-handed coord system
+			xRotMatrix.data[1][1] = cosP;
+			xRotMatrix.data[1][2] = sinP;
+			xRotMatrix.data[2][1] = -sinP;
+			xRotMatrix.data[2][2] = cosP;
+
+			return xRotMatrix;
+		}
+
+		static Matrix CreateRotationY(float yaw)
+		{
+			Matrix yRotMatrix;
+
+			float cosY{ std::cos(yaw) };
+			float sinY{ std::sin(yaw) };
+
+			yRotMatrix.data[0][0] = cosY;
+			yRotMatrix.data[0][2] = -sinY;
+			yRotMatrix.data[2][0] = sinY;
+			yRotMatrix.data[2][2] = cosY;
+
+			return yRotMatrix;
+		}
+
+		static Matrix CreateRotationZ(float roll)
+		{
+			Matrix zRotMatrix;
+
+			float cosR{ std::cos(roll) };
+			float sinR{ std::sin(roll) };
+
+			zRotMatrix.data[0][0] = cosR;
+			zRotMatrix.data[0][1] = sinR;
+			zRotMatrix.data[1][0] = -sinR;
+			zRotMatrix.data[1][1] = cosR;
+
+			return zRotMatrix;
+		}
+
+		static Matrix CreateRotation(float pitch, float yaw, float roll)
+		{
+			return CreateRotation({ pitch, yaw, roll });
+		}
+
+		static Matrix CreateRotation(const Vector3& r)
+		{
+			Matrix xRotation{ CreateRotationX(r.x) };
+			Matrix yRotation{ CreateRotationY(r.y) };
+			Matrix zRotation{ CreateRotationZ(r.z) };
+
+			return xRotation * yRotation * zRotation;
+		}
+
+		static constexpr Matrix CreateScale(float sx, float sy, float sz)
+		{
+			Matrix scaleMatrix;
+			scaleMatrix.data[0][0] = sx;
+			scaleMatrix.data[1][1] = sy;
+			scaleMatrix.data[2][2] = sz;
+
+			return scaleMatrix;
+		}
+
+		static constexpr Matrix CreateScale(const Vector3& s)
+		{
+			return CreateScale(s.x, s.y, s.z);
+		}
+
+		static constexpr Matrix Transpose(const Matrix& m)
+		{
+			Matrix out{ m };
+			out.Transpose();
+
+			return out;
+		}
+
+		static Matrix Inverse(const Matrix& m)
+		{
+			Matrix out{ m };
+			out.Inverse();
+
+			return out;
+		}
+
+#pragma region Operator Overloads
+		constexpr Vector4& operator[](int index)
+		{
+			assert(index <= 3 && index >= 0);
+			return data[index];
+		}
+
+		constexpr Vector4 operator[](int index) const
+		{
+			assert(index <= 3 && index >= 0);
+			return data[index];
+		}
+
+		constexpr Matrix operator*(const Matrix& m) const
+		{
+			Matrix result{};
+#ifdef MATH_SSE
+			if (!std::is_constant_evaluated())
+			{
+				// Row r of the result = data[r].x * m[0] + data[r].y * m[1] + ... ( Same sums as the dot products below )
+				for (int r{ 0 }; r < 4; ++r)
+				{
+					const __m128 row{ _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(data[r].x), m.LoadRow(0)),
+						_mm_mul_ps(_mm_set1_ps(data[r].y), m.LoadRow(1))), _mm_mul_ps(_mm_set1_ps(data[r].z), m.LoadRow(2))),
+						_mm_mul_ps(_mm_set1_ps(data[r].w), m.LoadRow(3))) };
+					_mm_storeu_ps(&result.data[r].x, row);
+				}
+				return result;
+			}
+#endif
+			Matrix m_transposed = Transpose(m);
+
+			for (int r{ 0 }; r < 4; ++r)
+			{
+				for (int c{ 0 }; c < 4; ++c)
+				{
+					result[r][c] = Vector4::Dot(data[r], m_transposed[c]);
+				}
+			}
+
+			return result;
+		}
+
+		constexpr const Matrix& operator*=(const Matrix& m)
+		{
+			*this = *this * m;
+			return *this;
+		}
+#pragma endregion
 
 	private:
 
@@ -62,5 +333,19 @@ namespace dae {
 		// v1x v1y v1z v1w
 		// v2x v2y v2z v2w
 		// v3x v3y v3z v3w
+
+#ifdef MATH_SSE
+		__m128 LoadRow(int index) const
+		{
+			return _mm_loadu_ps(&data[index].x);
+		}
+
+		static Vector3 StoreVector3(__m128 value)
+		{
+			alignas(16) float components[4];
+			_mm_store_ps(components, value);
+			return { components[0], components[1], components[2] };
+		}
+#endif
 	};
-}
\ No newline at end of file
+}
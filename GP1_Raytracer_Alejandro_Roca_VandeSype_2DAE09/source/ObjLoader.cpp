@@ -0,0 +1,519 @@
+#include "ObjLoader.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+#include "MappedFile.h"
+
+namespace dae
+{
+	namespace
+	{
+		constexpr int NoIndex{ -1 };
+
+		// One face corner, already turned into 0-based indices ( NoIndex when the corner doesn't have that attribute )
+		struct Corner
+		{
+			int position{ NoIndex };
+			int texCoord{ NoIndex };
+			int normal{ NoIndex };
+		};
+
+		struct Chunk
+		{
+			std::string_view text{};
+
+			// Counting pass : how many of each vertex statement the chunk holds
+			size_t positionCount{ 0 };
+			size_t texCoordCount{ 0 };
+			size_t normalCount{ 0 };
+
+			// Where they go in the arrays of the whole file ( Prefix sums of the counts )
+			size_t positionOffset{ 0 };
+			size_t texCoordOffset{ 0 };
+			size_t normalOffset{ 0 };
+			size_t triangleOffset{ 0 };
+
+			// Parsing pass : triangles as 3 corners each
+			std::vector<Corner> corners{};
+			bool hasTexCoords{ false };
+			bool hasNormals{ false };
+
+			// First malformed line of the chunk
+			const char* pError{ nullptr };
+			const char* errorMessage{ nullptr };
+		};
+
+		// Calls lineFunction for every line without its line end, stops when it returns false
+		template<typename LineFunction>
+		bool ForEachLine(std::string_view text, LineFunction&& lineFunction)
+		{
+			size_t start{ 0 };
+			while (start < text.size())
+			{
+				size_t end{ text.find('\n', start) };
+				if (end == std::string_view::npos)
+					end = text.size();
+
+				std::string_view line{ text.substr(start, end - start) };
+				if (!line.empty() && line.back() == '\r')
+					line.remove_suffix(1);
+				if (!lineFunction(line))
+					return false;
+
+				start = end + 1;
+			}
+			return true;
+		}
+
+		bool IsSpace(char character)
+		{
+			return character == ' ' || character == '\t';
+		}
+
+		const char* SkipSpaces(const char* pCurrent, const char* pEnd)
+		{
+			while (pCurrent < pEnd && IsSpace(*pCurrent))
+				++pCurrent;
+			return pCurrent;
+		}
+
+		// "v", "vt", "f", ... ( Empty for blank lines )
+		std::string_view GetKeyword(std::string_view line, const char*& pArguments)
+		{
+			const char* pEnd{ line.data() + line.size() };
+			const char* pStart{ SkipSpaces(line.data(), pEnd) };
+			const char* pCurrent{ pStart };
+			while (pCurrent < pEnd && !IsSpace(*pCurrent))
+				++pCurrent;
+
+			pArguments = pCurrent;
+			return { pStart, static_cast<size_t>(pCurrent - pStart) };
+		}
+
+		bool ParseFloat(const char*& pCurrent, const char* pEnd, float& value)
+		{
+			pCurrent = SkipSpaces(pCurrent, pEnd);
+			// from_chars doesn't take a leading '+'
+			if (pCurrent < pEnd && *pCurrent == '+')
+				++pCurrent;
+
+			const std::from_chars_result result{ std::from_chars(pCurrent, pEnd, value) };
+			if (result.ec != std::errc{})
+				return false;
+
+			pCurrent = result.ptr;
+			return true;
+		}
+
+		// 1-based index ( Negative -> counted back from the last element read so far ) -> 0-based index in [0, totalCount)
+		// ... Positive indices may point ahead, to vertices further down the file
+		bool ParseIndex(const char*& pCurrent, const char* pEnd, size_t readCount, size_t totalCount, int& index)
+		{
+			int value{};
+			const std::from_chars_result result{ std::from_chars(pCurrent, pEnd, value) };
+			if (result.ec != std::errc{})
+				return false;
+			pCurrent = result.ptr;
+
+			const int64_t resolved{ value > 0 ? int64_t{ value } - 1 : static_cast<int64_t>(readCount) + value };
+			if (value == 0 || resolved < 0 || resolved >= static_cast<int64_t>(totalCount))
+				return false;
+
+			index = static_cast<int>(resolved);
+			return true;
+		}
+
+		// Counting pass : only looks at the keyword of each line
+		void CountVertices(Chunk& chunk)
+		{
+			ForEachLine(chunk.text, [&chunk](std::string_view line)
+				{
+					const char* pArguments{};
+					const std::string_view keyword{ GetKeyword(line, pArguments) };
+					if (keyword == "v")
+						++chunk.positionCount;
+					else if (keyword == "vt")
+						++chunk.texCoordCount;
+					else if (keyword == "vn")
+						++chunk.normalCount;
+					return true;
+				});
+		}
+
+		// Parsing pass : vertices go straight to their place in the file arrays, faces into the chunk
+		// ... The offsets are known from the counting pass, so relative indices resolve right away
+		void ParseChunk(Chunk& chunk, std::vector<Vector3>& positions, std::vector<TexCoord>& texCoords, std::vector<Vector3>& normals)
+		{
+			size_t positionCount{ chunk.positionOffset };
+			size_t texCoordCount{ chunk.texCoordOffset };
+			size_t normalCount{ chunk.normalOffset };
+
+			ForEachLine(chunk.text, [&](std::string_view line)
+				{
+					const char* pEnd{ line.data() + line.size() };
+					const char* pCurrent{};
+					const std::string_view keyword{ GetKeyword(line, pCurrent) };
+
+					// Extra values ( v with w or a color, vt with w ) are ignored
+					if (keyword == "v")
+					{
+						Vector3& position{ positions[positionCount++] };
+						if (ParseFloat(pCurrent, pEnd, position.x) && ParseFloat(pCurrent, pEnd, position.y) && ParseFloat(pCurrent, pEnd, position.z))
+							return true;
+						chunk.errorMessage = "expected 3 coordinates after v";
+					}
+					else if (keyword == "vt")
+					{
+						// v is optional ( 1D textures )
+						TexCoord& texCoord{ texCoords[texCoordCount++] };
+						if (ParseFloat(pCurrent, pEnd, texCoord.u))
+						{
+							const char* pValue{ pCurrent };
+							if (!ParseFloat(pValue, pEnd, texCoord.v))
+								texCoord.v = 0.f;
+							return true;
+						}
+						chunk.errorMessage = "expected a texture coordinate after vt";
+					}
+					else if (keyword == "vn")
+					{
+						Vector3& normal{ normals[normalCount++] };
+						if (ParseFloat(pCurrent, pEnd, normal.x) && ParseFloat(pCurrent, pEnd, normal.y) && ParseFloat(pCurrent, pEnd, normal.z))
+							return true;
+						chunk.errorMessage = "expected 3 coordinates after vn";
+					}
+					else if (keyword == "f")
+					{
+						// Fan around the first corner : (0, 1, 2), (0, 2, 3), ...
+						Corner first{}, previous{};
+						int cornerCount{ 0 };
+						while (true)
+						{
+							pCurrent = SkipSpaces(pCurrent, pEnd);
+							if (pCurrent == pEnd)
+								break;
+
+							// v, v/vt, v//vn or v/vt/vn
+							Corner corner{};
+							bool isValid{ ParseIndex(pCurrent, pEnd, positionCount, positions.size(), corner.position) };
+							if (isValid && pCurrent < pEnd && *pCurrent == '/')
+							{
+								++pCurrent;
+								if (pCurrent < pEnd && *pCurrent != '/')
+									isValid = ParseIndex(pCurrent, pEnd, texCoordCount, texCoords.size(), corner.texCoord);
+								if (isValid && pCurrent < pEnd && *pCurrent == '/')
+								{
+									++pCurrent;
+									isValid = ParseIndex(pCurrent, pEnd, normalCount, normals.size(), corner.normal);
+								}
+							}
+							if (!isValid || (pCurrent < pEnd && !IsSpace(*pCurrent)))
+							{
+								chunk.errorMessage = "invalid or out of range face index";
+								break;
+							}
+
+							chunk.hasTexCoords |= corner.texCoord != NoIndex;
+							chunk.hasNormals |= corner.normal != NoIndex;
+
+							if (cornerCount == 0)
+								first = corner;
+							else if (cornerCount >= 2)
+								chunk.corners.insert(chunk.corners.end(), { first, previous, corner });
+							previous = corner;
+							++cornerCount;
+						}
+
+						if (!chunk.errorMessage && cornerCount >= 3)
+							return true;
+						if (!chunk.errorMessage)
+							chunk.errorMessage = "a face needs at least 3 corners";
+					}
+					else
+					{
+						// Comments, objects, groups, smoothing groups, materials, lines, ...
+						return true;
+					}
+
+					chunk.pError = line.data();
+					return false;
+				});
+		}
+
+		struct CacheHeader
+		{
+			uint32_t magic{};
+			uint32_t version{};
+			uint64_t sourceSize{};
+			int64_t sourceWriteTime{};
+			uint64_t positionCount{};
+			uint64_t triangleCount{};
+			uint32_t hasTexCoords{};
+			uint32_t hasVertexNormals{};
+		};
+
+		constexpr uint32_t CacheMagic{ 0x48534D52 };		// "RMSH"
+		constexpr uint32_t CacheVersion{ 1 };
+
+		// Arrays are stored as they are in memory, one after the other behind the header
+		static_assert(std::is_trivially_copyable_v<Vector3> && sizeof(Vector3) == 3 * sizeof(float), "Vector3 is written as 3 floats");
+		static_assert(std::is_trivially_copyable_v<TexCoord> && sizeof(TexCoord) == 2 * sizeof(float), "TexCoord is written as 2 floats");
+
+		bool GetSourceStamp(const std::string& sourcePath, uint64_t& size, int64_t& writeTime)
+		{
+			std::error_code error{};
+			size = std::filesystem::file_size(sourcePath, error);
+			if (error)
+				return false;
+
+			const std::filesystem::file_time_type time{ std::filesystem::last_write_time(sourcePath, error) };
+			writeTime = static_cast<int64_t>(time.time_since_epoch().count());
+			return !error;
+		}
+
+		size_t GetCacheSize(const CacheHeader& header)
+		{
+			const size_t cornerCount{ static_cast<size_t>(header.triangleCount) * 3 };
+			return sizeof(CacheHeader)
+				+ static_cast<size_t>(header.positionCount) * sizeof(Vector3)
+				+ cornerCount * sizeof(int)
+				+ static_cast<size_t>(header.triangleCount) * sizeof(Vector3)
+				+ (header.hasTexCoords ? cornerCount * sizeof(TexCoord) : 0)
+				+ (header.hasVertexNormals ? cornerCount * sizeof(Vector3) : 0);
+		}
+
+		template<typename Type>
+		void ReadArray(const char*& pCurrent, std::vector<Type>& values, size_t count)
+		{
+			values.resize(count);
+			if (count > 0)
+				std::memcpy(values.data(), pCurrent, count * sizeof(Type));
+			pCurrent += count * sizeof(Type);
+		}
+
+		template<typename Type>
+		void WriteArray(std::ofstream& file, const std::vector<Type>& values)
+		{
+			file.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(Type)));
+		}
+	}
+
+	namespace ObjLoader
+	{
+		bool Load(const std::string& filePath, ObjMesh& mesh, bool useCache)
+		{
+			const std::string cachePath{ GetCachePath(filePath) };
+			if (useCache && ReadCache(cachePath, filePath, mesh))
+				return true;
+
+			MappedFile file{};
+			if (!file.Open(filePath))
+			{
+				std::cout << "Could not open " << filePath << std::endl;
+				return false;
+			}
+
+			std::string error{};
+			if (!Parse(file.GetText(), mesh, DefaultChunkSize, &error))
+			{
+				std::cout << "Could not parse " << filePath << " : " << error << std::endl;
+				return false;
+			}
+
+			// Not being able to write the cache only costs the next run a parse
+			if (useCache && !WriteCache(cachePath, filePath, mesh))
+				std::cout << "Could not write the mesh cache " << cachePath << std::endl;
+
+			return true;
+		}
+
+		bool Parse(std::string_view text, ObjMesh& mesh, size_t chunkSize, std::string* pError)
+		{
+			mesh = ObjMesh{};
+
+			// Chunks end right after a line end -> no line is split between two of them
+			std::vector<Chunk> chunks{};
+			chunkSize = std::max(chunkSize, size_t{ 1 });
+			for (size_t start{ 0 }; start < text.size();)
+			{
+				size_t end{ std::min(start + chunkSize, text.size()) };
+				if (end < text.size())
+				{
+					const size_t lineEnd{ text.find('\n', end - 1) };
+					end = lineEnd == std::string_view::npos ? text.size() : lineEnd + 1;
+				}
+
+				chunks.emplace_back().text = text.substr(start, end - start);
+				start = end;
+			}
+
+			// Pass 1 : count the vertices of every chunk, so each one knows where its vertices start
+			std::for_each(std::execution::par, chunks.begin(), chunks.end(), CountVertices);
+
+			size_t positionCount{ 0 }, texCoordCount{ 0 }, normalCount{ 0 };
+			for (Chunk& chunk : chunks)
+			{
+				chunk.positionOffset = positionCount;
+				chunk.texCoordOffset = texCoordCount;
+				chunk.normalOffset = normalCount;
+				positionCount += chunk.positionCount;
+				texCoordCount += chunk.texCoordCount;
+				normalCount += chunk.normalCount;
+			}
+
+			// Pass 2 : parse, every chunk writes its own range of the vertex arrays
+			mesh.positions.resize(positionCount);
+			std::vector<TexCoord> texCoordValues(texCoordCount);
+			std::vector<Vector3> normalValues(normalCount);
+			std::for_each(std::execution::par, chunks.begin(), chunks.end(), [&](Chunk& chunk)
+				{
+					ParseChunk(chunk, mesh.positions, texCoordValues, normalValues);
+				});
+
+			const auto errorChunk{ std::find_if(chunks.begin(), chunks.end(), [](const Chunk& chunk) { return chunk.pError != nullptr; }) };
+			if (errorChunk != chunks.end())
+			{
+				if (pError)
+				{
+					const size_t lineNumber{ static_cast<size_t>(std::count(text.data(), errorChunk->pError, '\n')) + 1 };
+					*pError = "line " + std::to_string(lineNumber) + " : " + errorChunk->errorMessage;
+				}
+				mesh = ObjMesh{};
+				return false;
+			}
+
+			size_t triangleCount{ 0 };
+			bool hasTexCoords{ false }, hasNormals{ false };
+			for (Chunk& chunk : chunks)
+			{
+				chunk.triangleOffset = triangleCount;
+				triangleCount += chunk.corners.size() / 3;
+				hasTexCoords |= chunk.hasTexCoords;
+				hasNormals |= chunk.hasNormals;
+			}
+
+			// Pass 3 : corners -> indices, face normals and the per corner attributes
+			mesh.indices.resize(triangleCount * 3);
+			mesh.normals.resize(triangleCount);
+			if (hasTexCoords)
+				mesh.texCoords.resize(triangleCount * 3);
+			if (hasNormals)
+				mesh.vertexNormals.resize(triangleCount * 3);
+
+			std::for_each(std::execution::par, chunks.begin(), chunks.end(), [&](const Chunk& chunk)
+				{
+					for (size_t cornerIdx{ 0 }; cornerIdx < chunk.corners.size(); cornerIdx += 3)
+					{
+						const size_t triangleIdx{ chunk.triangleOffset + cornerIdx / 3 };
+						for (size_t vertexIdx{ 0 }; vertexIdx < 3; ++vertexIdx)
+						{
+							const Corner& corner{ chunk.corners[cornerIdx + vertexIdx] };
+							const size_t index{ triangleIdx * 3 + vertexIdx };
+							mesh.indices[index] = corner.position;
+							if (hasTexCoords)
+								mesh.texCoords[index] = corner.texCoord != NoIndex ? texCoordValues[corner.texCoord] : TexCoord{};
+							if (hasNormals)
+								mesh.vertexNormals[index] = corner.normal != NoIndex ? normalValues[corner.normal] : Vector3{};
+						}
+
+						// Same normal MeshGeometry::CalculateNormals gives
+						const Vector3& v0{ mesh.positions[chunk.corners[cornerIdx].position] };
+						const Vector3& v1{ mesh.positions[chunk.corners[cornerIdx + 1].position] };
+						const Vector3& v2{ mesh.positions[chunk.corners[cornerIdx + 2].position] };
+						mesh.normals[triangleIdx] = Vector3::Cross(v1 - v0, v2 - v0).Normalized();
+					}
+				});
+
+			return true;
+		}
+
+		std::string GetCachePath(const std::string& filePath)
+		{
+			return filePath + ".meshcache";
+		}
+
+		bool ReadCache(const std::string& cachePath, const std::string& sourcePath, ObjMesh& mesh)
+		{
+			MappedFile file{};
+			if (!file.Open(cachePath) || file.GetSize() < sizeof(CacheHeader))
+				return false;
+
+			CacheHeader header{};
+			std::memcpy(&header, file.GetData(), sizeof(CacheHeader));
+
+			uint64_t sourceSize{};
+			int64_t sourceWriteTime{};
+			if (header.magic != CacheMagic || header.version != CacheVersion || GetCacheSize(header) != file.GetSize()
+				|| !GetSourceStamp(sourcePath, sourceSize, sourceWriteTime) || header.sourceSize != sourceSize || header.sourceWriteTime != sourceWriteTime)
+				return false;
+
+			// Plain copies out of the mapping, in the order they were written
+			const size_t cornerCount{ static_cast<size_t>(header.triangleCount) * 3 };
+			const char* pCurrent{ file.GetData() + sizeof(CacheHeader) };
+			ObjMesh cached{};
+			ReadArray(pCurrent, cached.positions, static_cast<size_t>(header.positionCount));
+			ReadArray(pCurrent, cached.indices, cornerCount);
+			ReadArray(pCurrent, cached.normals, static_cast<size_t>(header.triangleCount));
+			ReadArray(pCurrent, cached.texCoords, header.hasTexCoords ? cornerCount : 0);
+			ReadArray(pCurrent, cached.vertexNormals, header.hasVertexNormals ? cornerCount : 0);
+
+			// A damaged cache must not index outside of the positions
+			const int positionCount{ static_cast<int>(cached.positions.size()) };
+			if (!std::all_of(std::execution::par_unseq, cached.indices.begin(), cached.indices.end(),
+				[positionCount](int index) { return index >= 0 && index < positionCount; }))
+				return false;
+
+			mesh = std::move(cached);
+			return true;
+		}
+
+		bool WriteCache(const std::string& cachePath, const std::string& sourcePath, const ObjMesh& mesh)
+		{
+			CacheHeader header{};
+			header.magic = CacheMagic;
+			header.version = CacheVersion;
+			if (!GetSourceStamp(sourcePath, header.sourceSize, header.sourceWriteTime))
+				return false;
+			header.positionCount = mesh.positions.size();
+			header.triangleCount = mesh.GetTriangleCount();
+			header.hasTexCoords = !mesh.texCoords.empty();
+			header.hasVertexNormals = !mesh.vertexNormals.empty();
+
+			// Written next to it first -> another run never maps a half written cache
+			const std::string temporaryPath{ cachePath + ".tmp" };
+			bool isWritten{ false };
+			{
+				std::ofstream file{ temporaryPath, std::ios::binary | std::ios::trunc };
+				if (!file)
+					return false;
+
+				file.write(reinterpret_cast<const char*>(&header), sizeof(CacheHeader));
+				WriteArray(file, mesh.positions);
+				WriteArray(file, mesh.indices);
+				WriteArray(file, mesh.normals);
+				WriteArray(file, mesh.texCoords);
+				WriteArray(file, mesh.vertexNormals);
+				file.close();
+				isWritten = !file.fail();
+			}
+
+			std::error_code error{};
+			if (isWritten)
+				std::filesystem::rename(temporaryPath, cachePath, error);
+			if (!isWritten || error)
+			{
+				std::filesystem::remove(temporaryPath, error);
+				return false;
+			}
+			return true;
+		}
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Vector3.h"
+
+namespace dae
+{
+	struct TexCoord
+	{
+		float u{};
+		float v{};
+	};
+
+	// Triangulated contents of an OBJ file, ready to hand to a MeshGeometry
+	// ... Polygons are split into triangle fans around their first corner
+	struct ObjMesh
+	{
+		std::vector<Vector3> positions{};		// Every "v" in file order, the indices point straight into it
+		std::vector<int> indices{};				// 3 per triangle
+		std::vector<Vector3> normals{};			// 1 per triangle, from the winding ( The normal the renderer shades with )
+
+		// 3 per triangle ( One per corner ), empty when no face references a "vt" / "vn"
+		// ... Corners without one get { 0, 0 } / a zero normal
+		std::vector<TexCoord> texCoords{};
+		std::vector<Vector3> vertexNormals{};
+
+		size_t GetTriangleCount() const { return indices.size() / 3; }
+	};
+
+	namespace ObjLoader
+	{
+		// Text is split in chunks of about this size ( Cut at line ends ), every chunk is parsed on its own thread
+		constexpr size_t DefaultChunkSize{ 1 << 20 };
+
+		// Loads from the binary cache next to the file when it is still up to date
+		// ... Otherwise the OBJ is memory-mapped and parsed, and the cache is (re)written for the next run
+		// ... Returns false when the file can't be read or has malformed lines ( The reason is printed )
+		bool Load(const std::string& filePath, ObjMesh& mesh, bool useCache = true);
+
+		// Parses OBJ text that is already in memory ( v, vt, vn and f in all its forms : v, v/vt, v//vn, v/vt/vn,
+		// negative indices relative to the end ). Other statements ( o, g, s, usemtl, ... ) are skipped
+		bool Parse(std::string_view text, ObjMesh& mesh, size_t chunkSize = DefaultChunkSize, std::string* pError = nullptr);
+
+		// "bunny.obj" -> "bunny.obj.meshcache"
+		std::string GetCachePath(const std::string& filePath);
+
+		// The cache remembers size and write time of the OBJ it was made from, a changed file invalidates it
+		bool ReadCache(const std::string& cachePath, const std::string& sourcePath, ObjMesh& mesh);
+		bool WriteCache(const std::string& cachePath, const std::string& sourcePath, const ObjMesh& mesh);
+	}
+}
@@ -0,0 +1,12 @@
+#include "RenderTarget.h"
+
+namespace dae
+{
+	MemoryRenderTarget::MemoryRenderTarget(int width, int height)
+	{
+		m_Width = width;
+		m_Height = height;
+		m_Buffer.resize(static_cast<size_t>(width) * height);
+		m_pPixels = m_Buffer.data();
+	}
+}
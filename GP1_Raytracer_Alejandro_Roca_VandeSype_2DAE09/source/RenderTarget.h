@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dae
+{
+	// 32 bit pixels the renderer writes the final image into
+	// ... The channel layout is given by the target ( Shifts + alpha mask ), so the renderer doesn't depend on SDL
+	class RenderTarget
+	{
+	public:
+		virtual ~RenderTarget() = default;
+
+		RenderTarget(const RenderTarget&) = delete;
+		RenderTarget(RenderTarget&&) noexcept = delete;
+		RenderTarget& operator=(const RenderTarget&) = delete;
+		RenderTarget& operator=(RenderTarget&&) noexcept = delete;
+
+		// Called once the frame is finished ( Show it on screen, ... )
+		virtual void Present() {}
+
+		uint32_t* GetPixels() const { return m_pPixels; }
+		int GetWidth() const { return m_Width; }
+		int GetHeight() const { return m_Height; }
+
+		uint32_t PackColor(uint8_t r, uint8_t g, uint8_t b) const
+		{
+			return (static_cast<uint32_t>(r) << m_RedShift) | (static_cast<uint32_t>(g) << m_GreenShift)
+				| (static_cast<uint32_t>(b) << m_BlueShift) | m_AlphaMask;
+		}
+
+		uint8_t GetRedShift() const { return m_RedShift; }
+		uint8_t GetGreenShift() const { return m_GreenShift; }
+		uint8_t GetBlueShift() const { return m_BlueShift; }
+		uint32_t GetAlphaMask() const { return m_AlphaMask; }
+
+		void UnpackColor(uint32_t pixel, uint8_t& r, uint8_t& g, uint8_t& b) const
+		{
+			r = static_cast<uint8_t>(pixel >> m_RedShift);
+			g = static_cast<uint8_t>(pixel >> m_GreenShift);
+			b = static_cast<uint8_t>(pixel >> m_BlueShift);
+		}
+
+	protected:
+		RenderTarget() = default;
+
+		// Rows are tightly packed : pixel (x, y) is at m_pPixels[x + y * m_Width]
+		uint32_t* m_pPixels{ nullptr };
+		int m_Width{};
+		int m_Height{};
+
+		uint8_t m_RedShift{ 16 };
+		uint8_t m_GreenShift{ 8 };
+		uint8_t m_BlueShift{ 0 };
+		uint32_t m_AlphaMask{ 0 };
+	};
+
+	// Render target in plain memory ( Offline / headless rendering )
+	class MemoryRenderTarget final : public RenderTarget
+	{
+	public:
+		MemoryRenderTarget(int width, int height);
+		~MemoryRenderTarget() override = default;
+
+	private:
+		std::vector<uint32_t> m_Buffer{};
+	};
+}
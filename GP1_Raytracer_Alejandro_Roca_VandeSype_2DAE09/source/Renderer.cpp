@@ -1,111 +1,842 @@
-//External includes
-#include "SDL.h"
-#include "SDL_surface.h"
-
 //Project includes
 #include "Renderer.h"
+#include "ImageUtils.h"
 #include "Math.h"
 #include "Matrix.h"
 #include "Material.h"
+#include "RenderTarget.h"
+#include "Sampling.h"
 #include "Scene.h"
+#include "Statistics.h"
+#include "ThreadPool.h"
 #include "Utils.h"
 
  // For multithread ( Parallel execution )
 #define PARALLEL_EXECUTION
-#include <execution>	
+#include <chrono>
+#include <cmath>
 
 using namespace dae;
 
-Renderer::Renderer(SDL_Window * pWindow) :
-	m_pWindow(pWindow),
-	m_pBuffer(SDL_GetWindowSurface(pWindow)),
+namespace
+{
+	// Perceived brightness ( Rec. 709 weights )
+	float Luminance(const ColorRGB& color)
+	{
+		return 0.2126f * color.r + 0.7152f * color.g + 0.0722f * color.b;
+	}
+
+	// Blue ( Cheap ) -> green -> yellow -> red ( maxCost or more )
+	// ... Logarithmic, otherwise everything but the most expensive pixels ends up blue
+	ColorRGB GetHeatmapColor(uint64_t cost, float maxCost)
+	{
+		static const ColorRGB stops[4]{ { 0.f, 0.f, 1.f }, { 0.f, 1.f, 0.f }, { 1.f, 1.f, 0.f }, { 1.f, 0.f, 0.f } };
+
+		const float position{ std::min(std::log2(1.f + cost) / std::log2(1.f + maxCost), 1.f) * 3.f };
+		const int stopIdx{ std::min(static_cast<int>(position), 2) };
+
+		return ColorRGB::Lerp(stops[stopIdx], stops[stopIdx + 1], position - stopIdx);
+	}
+}
+
+Renderer::Renderer(RenderTarget* pRenderTarget, uint32_t threadCount) :
+	m_pRenderTarget(pRenderTarget),
+	m_pThreadPool(std::make_unique<ThreadPool>(threadCount)),
+	m_ShadingMode{ ShadingMode::Exact },
 	m_CurrentLightingMode{ LightingMode::Combined },
 	m_ShadowsEnabled{ true }
 {
 	//Initialize
-	SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
-	m_pBufferPixels = static_cast<uint32_t*>(m_pBuffer->pixels);
+	m_WindowWidth = m_pRenderTarget->GetWidth();
+	m_WindowHeight = m_pRenderTarget->GetHeight();
+	m_pBufferPixels = m_pRenderTarget->GetPixels();
 
-	m_aspectRatio = m_Width / static_cast<float>(m_Height);
+	m_aspectRatio = m_WindowWidth / static_cast<float>(m_WindowHeight);
+	m_WindowColors.resize(static_cast<size_t>(m_WindowWidth) * m_WindowHeight);
 
-	// Calculate the amount of pixels needed based on the width and height 
-	uint32_t amountOfPixels{ static_cast<uint32_t>(m_Width * m_Height) };
-	m_pixelIndices.reserve(amountOfPixels);
+	SetRenderResolution(m_WindowWidth, m_WindowHeight);
+}
 
-	for (uint32_t index{}; index < amountOfPixels; ++index)
-		m_pixelIndices.emplace_back(index);
+void Renderer::SetRenderResolution(int width, int height)
+{
+	m_Width = width;
+	m_Height = height;
 
+	CreateTiles();
 
+	// Buffers only grow, going back to a bigger resolution doesn't reallocate
+	const size_t pixelCount{ static_cast<size_t>(m_Width) * m_Height };
+	m_AccumulationBuffer.resize(pixelCount);
+	m_FrameColors.resize(pixelCount);
+	m_PixelVariances.resize(pixelCount);
+	m_PixelSampleCounts.assign(pixelCount, 1);
+	m_DisplayColors.resize(pixelCount);
+	m_AdaptiveRayBudget = static_cast<uint32_t>(pixelCount / 4);
 }
 
-void Renderer::Render(Scene* pScene) const
+// Defined here, ThreadPool is only forward declared in the header
+Renderer::~Renderer() = default;
+
+void Renderer::Render(Scene* pScene)
 {
+	// Make sure the acceleration structure matches the scene before shooting any ray
+	const bool sceneChanged{ pScene->UpdateAccelerationStructure() };
+
 	Camera& camera = pScene->GetCamera();
-	auto& materials = pScene->GetMaterials();
-	auto& lights = pScene->GetLights();
+
+	// ** CHANGE DETECTION ** 
+	// ... Anything different from the previous frame throws the accumulated samples away
+	bool viewChanged{ sceneChanged || camera.hasChanged || m_SettingsChanged || pScene != m_pLastScene };
+	camera.hasChanged = false;
+	m_SettingsChanged = false;
+	m_pLastScene = pScene;
+
+	// ** DYNAMIC RESOLUTION **
+	// ... Snap to steps, so the resolution doesn't change ( And the accumulation reset ) on every small variation
+	const bool stillView{ !viewChanged && m_AccumulationMode == AccumulationMode::Progressive };
+	float resolutionScale{ 1.f };
+	if (m_DynamicResolution && !stillView)
+		resolutionScale = std::round(m_ResolutionScale / m_ResolutionScaleStep) * m_ResolutionScaleStep;
+
+	const int renderWidth{ std::max(static_cast<int>(m_WindowWidth * resolutionScale), 1) };
+	const int renderHeight{ std::max(static_cast<int>(m_WindowHeight * resolutionScale), 1) };
+	if (renderWidth != m_Width || renderHeight != m_Height)
+	{
+		SetRenderResolution(renderWidth, renderHeight);
+		viewChanged = true;
+	}
+
+	m_FrameTraced = false;
+	m_FrameCounters = {};
+	if (viewChanged)
+	{
+		m_AccumulatedSamples = 0;
+	}
+	else if (m_AccumulationMode == AccumulationMode::SkipUnchanged
+		|| (m_AccumulationMode == AccumulationMode::Progressive && m_AccumulatedSamples >= m_MaxAccumulatedSamples))
+	{
+		// Same image as on screen -> nothing to trace, only show it again when the display settings changed
+		if (m_DisplayChanged)
+		{
+			ResolveDisplay();
+			m_pRenderTarget->Present();
+		}
+		return;
+	}
+	m_FrameTraced = true;
+
+	// First sample through the pixel centers ( Same image as without accumulation )
+	// ... the next ones follow the R2 sequence, spread evenly over the pixel
+	m_SampleOffsetX = 0.5f;
+	m_SampleOffsetY = 0.5f;
+	if (m_AccumulationMode == AccumulationMode::Progressive && m_AccumulatedSamples > 0)
+	{
+		m_SampleOffsetX = std::fmod(0.5f + m_AccumulatedSamples * 0.7548776662f, 1.f);
+		m_SampleOffsetY = std::fmod(0.5f + m_AccumulatedSamples * 0.5698402910f, 1.f);
+	}
 
 	// Calculate the camera ONB matrix before "shooting" any ray into the scene
 	// This way we know in which direction and position the camera is 
 	const Matrix cameraToWorld{ camera.CalculateCameraToWorld() };
 
-#ifdef PARALLEL_EXECUTION
-	// Parallel logic
+	if (UseWavefront())
+		RenderWavefront(pScene, cameraToWorld, camera.origin);
+	else
+		ForEachTile([&](uint32_t tileIdx) { RenderTile(pScene, tileIdx, cameraToWorld, camera.origin); });
 
-	// Execute renderPixel for each pixel
-	std::for_each(std::execution::par, m_pixelIndices.begin(), m_pixelIndices.end(),
-		[&](int i)
-		{ RenderPixel(pScene, i, cameraToWorld, camera.origin); } );
-
-#else // Synchronous logic (no multithreading)
+	// Only refine frames traced through the pixel centers
+	// ... Later progressive frames are jittered, the accumulation anti-aliases those already
+	if (m_AdaptiveMode != AdaptiveMode::Off
+		&& (m_AccumulationMode != AccumulationMode::Progressive || m_AccumulatedSamples == 0))
+	{
+		RenderAdaptiveSamples(pScene, cameraToWorld, camera.origin);
+	}
 
-	for (uint32_t pixelIdx{}; pixelIdx < m_pixelIndices.size(); ++pixelIdx)
+	if (m_AdaptiveMode == AdaptiveMode::ShowSamples)
 	{
-		RenderPixel(pScene, pixelIdx, cameraToWorld, camera.origin);
+		ForEachTile([&](uint32_t tileIdx) { ShowTileSampleCounts(tileIdx); });
 	}
-#endif // PARALLEL_EXECUTION
+
+	ResolveDisplay();
+
+	++m_AccumulatedSamples;
+
+#ifdef RAY_STATISTICS
+	// Every thread is idle now -> safe to merge their counters
+	m_FrameCounters = Statistics::CollectCounters();
+#endif
 
 	//@END
-	//Update SDL Surface
-	SDL_UpdateWindowSurface(m_pWindow);
+	//Show the frame ( SDL window, ... )
+	m_pRenderTarget->Present();
+
+}
+
+
+void Renderer::RenderTile(Scene* pScene, uint32_t tileIndex, const Matrix& cameraToWorld, const Vector3& cameraOrigin) const
+{
+	const auto startTime{ std::chrono::high_resolution_clock::now() };
+	const Tile& tile{ m_Tiles[tileIndex] };
+
+	// The heatmap needs the cost of every single ray
+	if (m_PacketSize > 1 && m_CurrentLightingMode != LightingMode::TraversalCost)
+	{
+		// The tile size is a multiple of the packet size -> packets never cross tiles
+		for (uint32_t py{ tile.startY }; py < tile.endY; py += m_PacketSize)
+		{
+			for (uint32_t px{ tile.startX }; px < tile.endX; px += m_PacketSize)
+			{
+				RenderPacket(pScene, px, py, cameraToWorld, cameraOrigin);
+			}
+		}
+	}
+	else
+	{
+		for (uint32_t py{ tile.startY }; py < tile.endY; ++py)
+		{
+			for (uint32_t px{ tile.startX }; px < tile.endX; ++px)
+			{
+				RenderPixel(pScene, px, py, cameraToWorld, cameraOrigin);
+			}
+		}
+	}
+
+	const auto endTime{ std::chrono::high_resolution_clock::now() };
+	m_TileTimes[tileIndex] = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+}
+
+void Renderer::RenderPixel(Scene* pScene, uint32_t px, uint32_t py, const Matrix& cameraToWorld, const Vector3& cameraOrigin) const
+{
+	// Ray we are casting from the camera towards each pixel
+	Ray viewRay{ cameraOrigin , CalculateRayDirection(pScene, px, py, cameraToWorld) };
+
+	WritePixel(px, py, TraceViewRay(pScene, viewRay, GetSampleSeed(px, py, 0)));
+}
+
+void Renderer::RenderPacket(Scene* pScene, uint32_t startX, uint32_t startY, const Matrix& cameraToWorld, const Vector3& cameraOrigin) const
+{
+	// Block of m_PacketSize x m_PacketSize pixels ( Smaller at the right and bottom edges )
+	const uint32_t endX{ std::min(startX + m_PacketSize, static_cast<uint32_t>(m_Width)) };
+	const uint32_t endY{ std::min(startY + m_PacketSize, static_cast<uint32_t>(m_Height)) };
+
+	// All primary rays of the block share the camera origin
+	RayPacket packet;
+	packet.origin = cameraOrigin;
+	for (uint32_t py{ startY }; py < endY; ++py)
+	{
+		for (uint32_t px{ startX }; px < endX; ++px)
+		{
+			packet.AddRay(CalculateRayDirection(pScene, px, py, cameraToWorld));
+		}
+	}
+
+	const Vector3 cornerDirections[4]{
+		CalculateRayDirection(pScene, startX, startY, cameraToWorld),
+		CalculateRayDirection(pScene, endX - 1, startY, cameraToWorld),
+		CalculateRayDirection(pScene, endX - 1, endY - 1, cameraToWorld),
+		CalculateRayDirection(pScene, startX, endY - 1, cameraToWorld) };
+	packet.CalculateFrustum(cornerDirections);
+
+	HitRecord closestHits[RayPacket::MaxRays]{};
+	pScene->GetClosestHits(packet, closestHits);
+#ifdef RAY_STATISTICS
+	Statistics::GetThreadCounters().primaryRays += (endX - startX) * (endY - startY);
+#endif
+
+	int rayIdx{ 0 };
+	for (uint32_t py{ startY }; py < endY; ++py)
+	{
+		for (uint32_t px{ startX }; px < endX; ++px)
+		{
+			WritePixel(px, py, Integrate(pScene, packet.GetRay(rayIdx), closestHits[rayIdx], GetSampleSeed(px, py, 0)));
+			++rayIdx;
+		}
+	}
+}
+
+ColorRGB Renderer::TraceViewRay(Scene* pScene, const Ray& viewRay, uint64_t seed) const
+{
+#ifdef RAY_STATISTICS
+	RayCounters& counters{ Statistics::GetThreadCounters() };
+	const uint64_t startCost{ counters.GetTraversalCost() };
+	++counters.primaryRays;
+#endif
+
+	// HitRecord containing more info about potential hit
+	HitRecord closestHit{};
+	pScene->GetClosestHit(viewRay, closestHit);
+	const ColorRGB color{ Integrate(pScene, viewRay, closestHit, seed) };
+
+#ifdef RAY_STATISTICS
+	if (m_CurrentLightingMode == LightingMode::TraversalCost)
+		return GetHeatmapColor(counters.GetTraversalCost() - startCost, m_HeatmapMaxCost);
+#endif
+	return color;
+}
+
+ColorRGB Renderer::Integrate(Scene* pScene, const Ray& viewRay, const HitRecord& closestHit, uint64_t seed) const
+{
+	if (m_Integrator == Integrator::Direct)
+		return ShadePixel(pScene, viewRay, closestHit, seed);
+
+	return TracePath(pScene, viewRay, closestHit, seed);
+}
+
+uint64_t Renderer::GetSampleSeed(uint32_t px, uint32_t py, uint32_t subSampleIdx) const
+{
+	// Sub-samples of the adaptive pass in the high bits, they never collide with the frame samples
+	return SampleUtils::GetSeed(px + py * m_Width, m_AccumulatedSamples | (subSampleIdx << 24));
+}
+
+ColorRGB Renderer::TracePath(Scene* pScene, const Ray& viewRay, const HitRecord& closestHit, uint64_t seed) const
+{
+	const std::vector<Material>& materials{ pScene->GetMaterials() };
+	Random random{ seed };
+
+	// Light carried back to the camera, and how much of it the previous bounces let through
+	ColorRGB radiance{};
+	ColorRGB throughput{ 1.f, 1.f, 1.f };
+
+	Ray ray{ viewRay };
+	HitRecord hit{ closestHit };
+	for (uint32_t bounce{ 0 }; hit.didHit; ++bounce)
+	{
+		const Material& material{ materials[hit.materialIndex] };
+
+		// Both sides of a surface reflect, shade the side the ray arrives from
+		if (Vector3::Dot(hit.normal, ray.direction) > 0.f)
+			hit.normal = -hit.normal;
+
+		// ** NEXT EVENT ESTIMATION ** -> every light is sampled directly at every bounce
+		// ... They are all points or directions, a bounce can never hit one, so light sampling alone gets their full weight
+		radiance += throughput * SampleLights(pScene, hit, ray.direction, material, random);
+
+		if (bounce + 1 >= m_MaxBounces)
+			break;
+
+		// ** BRDF SAMPLING ** -> the next direction, importance sampled by the material
+		// ... or uniform over the hemisphere for the reference : never refused, only the debug color stops there ( Same as Sample )
+		Vector3 bounceDirection{};
+		float pdf{};
+		if (m_Integrator == Integrator::PathTracingUniform)
+		{
+			if (material.type == MaterialType::SolidColor)
+				break;
+
+			bounceDirection = SampleUtils::SampleUniformHemisphere(hit.normal, random.NextFloat(), random.NextFloat());
+			pdf = SampleUtils::UniformHemispherePdf;
+		}
+		else if (!MaterialUtils::Sample(material, hit, ray.direction, random, bounceDirection, pdf))
+			break;
+
+		const float cosAngle{ Vector3::Dot(hit.normal, bounceDirection) };
+		if (cosAngle <= 0.f || pdf <= 0.f)
+			break;
+
+		throughput *= MaterialUtils::Shade(material, hit, bounceDirection, ray.direction, m_ShadingMode) * (cosAngle / pdf);
+
+		// ** RUSSIAN ROULETTE ** -> dim paths stop early, the survivors are boosted so the average stays the same
+		if (bounce + 1 >= m_RouletteStartBounce)
+		{
+			const float survivalProbability{ std::min(std::max(throughput.r, std::max(throughput.g, throughput.b)), 0.95f) };
+			if (random.NextFloat() >= survivalProbability)
+				break;
+
+			throughput *= 1.f / survivalProbability;
+		}
+
+		ray = Ray{ hit.origin + (hit.normal * 0.001f), bounceDirection };
+		hit = HitRecord{};
+		pScene->GetClosestHit(ray, hit);
+#ifdef RAY_STATISTICS
+		++Statistics::GetThreadCounters().bounceRays;
+#endif
+	}
+
+	return radiance;
+}
+
+ColorRGB Renderer::SampleLights(Scene* pScene, const HitRecord& hit, const Vector3& viewDirection, const Material& material, Random& random) const
+{
+#ifdef RAY_STATISTICS
+	++Statistics::GetThreadCounters().shadingCalls;
+#endif
+	ColorRGB radiance{};
+
+	const bool useLightBVH{ UseLightBVH(pScene) };
+	const uint32_t lightSampleCount{ GetLightSampleCount(pScene, useLightBVH) };
+	for (uint32_t sampleIdx{ 0 }; sampleIdx < lightSampleCount; ++sampleIdx)
+	{
+		size_t lightIdx{};
+		float weight{};
+		if (!GetLightSample(pScene, hit, useLightBVH, sampleIdx, random, lightIdx, weight))
+			continue;
+
+		const Light& light{ pScene->GetLights()[lightIdx] };
+
+		Vector3 lightDirection{ LightUtils::GetDirectionToLight(light, hit.origin) };
+		const float lightDistance{ lightDirection.Normalize() };
+
+		const float cosAngle{ Vector3::Dot(hit.normal, lightDirection) };
+		if (cosAngle <= 0.f)
+			continue;
+
+		if (m_ShadowsEnabled)
+		{
+			Ray lightRay{ hit.origin + (hit.normal * 0.001f), lightDirection };
+			lightRay.max = light.type == LightType::Directional ? FLT_MAX : lightDistance;
+#ifdef RAY_STATISTICS
+			++Statistics::GetThreadCounters().shadowRays;
+#endif
+			if (pScene->IsOccluded(lightRay, lightIdx))
+				continue;
+		}
+
+		radiance += LightUtils::GetRadiance(light, hit.origin) * MaterialUtils::Shade(material, hit, lightDirection, viewDirection, m_ShadingMode) * (cosAngle * weight);
+	}
+
+	return radiance;
+}
+
+bool Renderer::UseLightBVH(const Scene* pScene) const
+{
+	switch (m_LightSampling)
+	{
+		case LightSampling::All:
+			return false;
+		case LightSampling::LightBVH:
+			return true;
+		case LightSampling::Auto:
+		default:
+			return pScene->GetLightBVH().GetPointLightCount() > m_ManyLightsThreshold;
+	}
+}
+
+uint32_t Renderer::GetLightSampleCount(const Scene* pScene, bool useLightBVH) const
+{
+	if (!useLightBVH)
+		return static_cast<uint32_t>(pScene->GetLights().size());
+
+	const LightBVH& lightBVH{ pScene->GetLightBVH() };
+	return static_cast<uint32_t>(lightBVH.GetDirectionalLights().size()) + (lightBVH.GetPointLightCount() > 0 ? m_LightSampleCount : 0);
+}
+
+bool Renderer::GetLightSample(const Scene* pScene, const HitRecord& hit, bool useLightBVH, uint32_t sampleIdx, Random& random,
+	size_t& lightIdx, float& weight) const
+{
+	weight = 1.f;
+	if (!useLightBVH)
+	{
+		lightIdx = sampleIdx;
+		return true;
+	}
+
+	// Directional lights first, all of them
+	const LightBVH& lightBVH{ pScene->GetLightBVH() };
+	const std::vector<uint32_t>& directionalLights{ lightBVH.GetDirectionalLights() };
+	if (sampleIdx < directionalLights.size())
+	{
+		lightIdx = directionalLights[sampleIdx];
+		return true;
+	}
+
+	// Then the point lights picked by the hierarchy, every pick stands in for all of them
+	uint32_t pickedIdx{};
+	float pmf{};
+	if (!lightBVH.Sample(hit.origin, hit.normal, random.NextFloat(), pickedIdx, pmf))
+		return false;
+
+	lightIdx = pickedIdx;
+	weight = 1.f / (pmf * m_LightSampleCount);
+	return true;
+}
+
+void Renderer::CycleLightSampling()
+{
+	switch (m_LightSampling)
+	{
+		case LightSampling::Auto:
+			std::cout << "LIGHT SAMPLING : Every light" << std::endl;
+			m_LightSampling = LightSampling::All;
+			break;
+		case LightSampling::All:
+			std::cout << "LIGHT SAMPLING : Light BVH ( " << m_LightSampleCount << " point lights per hit )" << std::endl;
+			m_LightSampling = LightSampling::LightBVH;
+			break;
+		case LightSampling::LightBVH:
+			std::cout << "LIGHT SAMPLING : Auto ( Light BVH above " << m_ManyLightsThreshold << " point lights )" << std::endl;
+			m_LightSampling = LightSampling::Auto;
+			break;
+	}
+
+	m_SettingsChanged = true;
+}
+
+bool Renderer::UseWavefront() const
+{
+	return m_Wavefront && m_Integrator == Integrator::Direct && m_CurrentLightingMode != LightingMode::TraversalCost;
+}
+
+void Renderer::RunChunks(uint32_t itemCount, const std::function<void(uint32_t, uint32_t)>& task) const
+{
+	const uint32_t taskCount{ (itemCount + m_WavefrontTaskSize - 1) / m_WavefrontTaskSize };
+	RunTasks(taskCount, [&](uint32_t taskIdx)
+		{ task(taskIdx * m_WavefrontTaskSize, std::min((taskIdx + 1) * m_WavefrontTaskSize, itemCount)); });
+}
+
+void Renderer::RenderWavefront(Scene* pScene, const Matrix& cameraToWorld, const Vector3& cameraOrigin)
+{
+	const std::vector<Material>& materials{ pScene->GetMaterials() };
+
+	// Same light samples as ShadePixel
+	const bool useLightBVH{ UseLightBVH(pScene) && m_CurrentLightingMode != LightingMode::Radiance
+		&& m_CurrentLightingMode != LightingMode::BRDF };
+	const uint32_t lightSampleCount{ GetLightSampleCount(pScene, useLightBVH) };
+
+	// Fewer pixels per wave with many light samples per pixel, but never less than a tile
+	const uint32_t maxWaveRays{ std::max(m_WavefrontSlotCount / std::max(lightSampleCount, 1u), m_TileSize * m_TileSize) };
+
+	// No tile timings in this mode
+	std::fill(m_TileTimes.begin(), m_TileTimes.end(), 0.f);
+
+	uint32_t firstTile{ 0 };
+	while (firstTile < GetTileCount())
+	{
+		// ** WAVE ** -> as many tiles in Morton order as the queues allow ( Rays close on screen stay close in the queue )
+		uint32_t rayCount{ 0 };
+		uint32_t endTile{ firstTile };
+		m_WaveTileOffsets.clear();
+		while (endTile < GetTileCount())
+		{
+			const Tile& tile{ m_Tiles[endTile] };
+			const uint32_t tilePixelCount{ static_cast<uint32_t>(tile.endX - tile.startX) * (tile.endY - tile.startY) };
+			if (endTile > firstTile && rayCount + tilePixelCount > maxWaveRays)
+				break;
+
+			m_WaveTileOffsets.emplace_back(rayCount);
+			rayCount += tilePixelCount;
+			++endTile;
+		}
+
+		const uint32_t slotCount{ rayCount * lightSampleCount };
+		m_RayQueue.Resize(rayCount);
+		m_ShadowQueue.Resize(slotCount);
+
+		// ** GENERATE ** -> primary ray of every pixel
+		RunTasks(endTile - firstTile, [&](uint32_t waveTileIdx)
+			{ GeneratePrimaryRays(pScene, firstTile + waveTileIdx, m_WaveTileOffsets[waveTileIdx], cameraToWorld); });
+
+		// ** EXTEND ** -> closest hits
+		RunChunks(rayCount, [&](uint32_t first, uint32_t end) { ExtendRays(pScene, cameraOrigin, first, end); });
+
+		// ** SHADOW RAYS ** -> one slot per light sample of every hit, then the visibility of all of them
+		RunChunks(rayCount, [&](uint32_t first, uint32_t end) { GenerateShadowRays(pScene, first, end, lightSampleCount, useLightBVH); });
+		if (m_ShadowsEnabled)
+			RunChunks(rayCount, [&](uint32_t first, uint32_t end) { TraceShadowRays(pScene, first, end, lightSampleCount); });
+
+		// ** SORT + SHADE ** -> the lit slots grouped by material, every batch with a single material call
+		SortByMaterial(slotCount, lightSampleCount);
+		RunTasks(static_cast<uint32_t>(m_ShadeRanges.size()), [&](uint32_t rangeIdx)
+			{ ShadeBatch(pScene, materials, m_ShadeRanges[rangeIdx], lightSampleCount); });
+
+		// ** RESOLVE ** -> sum of the light samples of every pixel
+		RunChunks(rayCount, [&](uint32_t first, uint32_t end) { ResolvePixels(first, end, lightSampleCount); });
+
+		firstTile = endTile;
+	}
+}
+
+void Renderer::GeneratePrimaryRays(Scene* pScene, uint32_t tileIndex, uint32_t firstRay, const Matrix& cameraToWorld)
+{
+	const Tile& tile{ m_Tiles[tileIndex] };
+
+	uint32_t rayIdx{ firstRay };
+	for (uint32_t py{ tile.startY }; py < tile.endY; ++py)
+	{
+		for (uint32_t px{ tile.startX }; px < tile.endX; ++px)
+		{
+			const Vector3 direction{ CalculateRayDirection(pScene, px, py, cameraToWorld) };
+			m_RayQueue.pixelIndices[rayIdx] = px + py * m_Width;
+			m_RayQueue.directionX[rayIdx] = direction.x;
+			m_RayQueue.directionY[rayIdx] = direction.y;
+			m_RayQueue.directionZ[rayIdx] = direction.z;
+			++rayIdx;
+		}
+	}
+}
+
+void Renderer::ExtendRays(Scene* pScene, const Vector3& cameraOrigin, uint32_t first, uint32_t end)
+{
+#ifdef RAY_STATISTICS
+	Statistics::GetThreadCounters().primaryRays += end - first;
+#endif
+	for (uint32_t rayIdx{ first }; rayIdx < end; ++rayIdx)
+	{
+		HitRecord closestHit{};
+		pScene->GetClosestHit(Ray{ cameraOrigin, m_RayQueue.GetDirection(rayIdx) }, closestHit);
+
+		m_RayQueue.didHit[rayIdx] = closestHit.didHit;
+		m_RayQueue.hitX[rayIdx] = closestHit.origin.x;
+		m_RayQueue.hitY[rayIdx] = closestHit.origin.y;
+		m_RayQueue.hitZ[rayIdx] = closestHit.origin.z;
+		m_RayQueue.normalX[rayIdx] = closestHit.normal.x;
+		m_RayQueue.normalY[rayIdx] = closestHit.normal.y;
+		m_RayQueue.normalZ[rayIdx] = closestHit.normal.z;
+		m_RayQueue.materialIndices[rayIdx] = closestHit.materialIndex;
+	}
+}
+
+void Renderer::GenerateShadowRays(Scene* pScene, uint32_t first, uint32_t end, uint32_t lightSampleCount, bool useLightBVH)
+{
+	const std::vector<Light>& lights{ pScene->GetLights() };
+	const bool keepBackFacing{ m_CurrentLightingMode == LightingMode::Radiance || m_CurrentLightingMode == LightingMode::BRDF };
+
+	for (uint32_t rayIdx{ first }; rayIdx < end; ++rayIdx)
+	{
+		const uint32_t firstSlot{ rayIdx * lightSampleCount };
+		std::fill_n(m_ShadowQueue.states.begin() + firstSlot, lightSampleCount, ShadowQueue::State::Empty);
+		if (!m_RayQueue.didHit[rayIdx])
+			continue;
+
+		HitRecord hit{};
+		hit.origin = m_RayQueue.GetHit(rayIdx);
+		hit.normal = m_RayQueue.GetNormal(rayIdx);
+
+		// Same random numbers as ShadePixel for this pixel
+		const uint32_t pixelIdx{ m_RayQueue.pixelIndices[rayIdx] };
+		Random random{ GetSampleSeed(pixelIdx % m_Width, pixelIdx / m_Width, 0) };
+
+		for (uint32_t sampleIdx{ 0 }; sampleIdx < lightSampleCount; ++sampleIdx)
+		{
+			size_t lightIdx{};
+			float weight{};
+			if (!GetLightSample(pScene, hit, useLightBVH, sampleIdx, random, lightIdx, weight))
+				continue;
+
+			const Light& light{ lights[lightIdx] };
+			const Vector3 lightDirection{ LightUtils::GetDirectionToLight(light, hit.origin).Normalized() };
+			const float cosAngle{ Vector3::Dot(hit.normal, lightDirection) };
+			if (cosAngle < 0 && !keepBackFacing)
+				continue;
+
+			const uint32_t slot{ firstSlot + sampleIdx };
+			m_ShadowQueue.lightIndices[slot] = static_cast<uint32_t>(lightIdx);
+			m_ShadowQueue.weights[slot] = weight;
+			m_ShadowQueue.lightX[slot] = lightDirection.x;
+			m_ShadowQueue.lightY[slot] = lightDirection.y;
+			m_ShadowQueue.lightZ[slot] = lightDirection.z;
+			m_ShadowQueue.cosines[slot] = cosAngle;
+
+			if (!m_ShadowsEnabled)
+			{
+				m_ShadowQueue.states[slot] = ShadowQueue::State::Lit;
+				continue;
+			}
+
+			// Small offset to avoid self-shadowing, the ray stops at the light
+			const Vector3 originOffset{ hit.origin + (hit.normal * 0.001f) };
+			const Vector3 toLight{ LightUtils::GetDirectionToLight(light, originOffset) };
+			const Vector3 shadowDirection{ toLight.Normalized() };
+
+			m_ShadowQueue.originX[slot] = originOffset.x;
+			m_ShadowQueue.originY[slot] = originOffset.y;
+			m_ShadowQueue.originZ[slot] = originOffset.z;
+			m_ShadowQueue.directionX[slot] = shadowDirection.x;
+			m_ShadowQueue.directionY[slot] = shadowDirection.y;
+			m_ShadowQueue.directionZ[slot] = shadowDirection.z;
+			m_ShadowQueue.maxDistances[slot] = toLight.Magnitude();
+			m_ShadowQueue.states[slot] = ShadowQueue::State::Pending;
+		}
+	}
+}
+
+void Renderer::TraceShadowRays(Scene* pScene, uint32_t first, uint32_t end, uint32_t lightSampleCount)
+{
+#ifdef RAY_STATISTICS
+	RayCounters& counters{ Statistics::GetThreadCounters() };
+#endif
+	// Light by light : neighbouring pixels towards the same light take the same way through the BVH
+	// ... ( And mostly hit the same cached occluder )
+	for (uint32_t sampleIdx{ 0 }; sampleIdx < lightSampleCount; ++sampleIdx)
+	{
+		for (uint32_t rayIdx{ first }; rayIdx < end; ++rayIdx)
+		{
+			const uint32_t slot{ rayIdx * lightSampleCount + sampleIdx };
+			if (m_ShadowQueue.states[slot] != ShadowQueue::State::Pending)
+				continue;
+
+			Ray lightRay{ { m_ShadowQueue.originX[slot], m_ShadowQueue.originY[slot], m_ShadowQueue.originZ[slot] },
+				{ m_ShadowQueue.directionX[slot], m_ShadowQueue.directionY[slot], m_ShadowQueue.directionZ[slot] } };
+			lightRay.max = m_ShadowQueue.maxDistances[slot];
+
+#ifdef RAY_STATISTICS
+			++counters.shadowRays;
+#endif
+			const bool isOccluded{ pScene->IsOccluded(lightRay, m_ShadowQueue.lightIndices[slot]) };
+			m_ShadowQueue.states[slot] = isOccluded ? ShadowQueue::State::Empty : ShadowQueue::State::Lit;
+		}
+	}
+}
+
+void Renderer::SortByMaterial(uint32_t slotCount, uint32_t lightSampleCount)
+{
+	// Counting sort on the material index of the hit ( 256 materials at most )
+	uint32_t materialStarts[257]{};
+	for (uint32_t slot{ 0 }; slot < slotCount; ++slot)
+	{
+		if (m_ShadowQueue.states[slot] == ShadowQueue::State::Lit)
+			++materialStarts[m_RayQueue.materialIndices[slot / lightSampleCount] + 1];
+	}
+
+	for (uint32_t materialIdx{ 0 }; materialIdx < 256; ++materialIdx)
+		materialStarts[materialIdx + 1] += materialStarts[materialIdx];
 
+	m_ShadeOrder.resize(materialStarts[256]);
+	uint32_t materialEnds[256]{};
+	std::copy_n(materialStarts, 256, materialEnds);
+	for (uint32_t slot{ 0 }; slot < slotCount; ++slot)
+	{
+		if (m_ShadowQueue.states[slot] == ShadowQueue::State::Lit)
+			m_ShadeOrder[materialEnds[m_RayQueue.materialIndices[slot / lightSampleCount]]++] = slot;
+	}
+
+	// Every material in batches that fit a ShadingBatch, one task each
+	m_ShadeRanges.clear();
+	for (uint32_t materialIdx{ 0 }; materialIdx < 256; ++materialIdx)
+	{
+		for (uint32_t start{ materialStarts[materialIdx] }; start < materialStarts[materialIdx + 1]; start += ShadingBatch::MaxSize)
+		{
+			const uint32_t count{ std::min(materialStarts[materialIdx + 1] - start, ShadingBatch::MaxSize) };
+			m_ShadeRanges.emplace_back(ShadeRange{ start, count, static_cast<unsigned char>(materialIdx) });
+		}
+	}
 }
 
+void Renderer::ShadeBatch(Scene* pScene, const std::vector<Material>& materials, const ShadeRange& range, uint32_t lightSampleCount)
+{
+	// Gather -> shade the whole batch -> scatter the contributions back to the slots
+	ShadingBatch batch;
+	batch.count = range.count;
+	for (uint32_t idx{ 0 }; idx < range.count; ++idx)
+	{
+		const uint32_t slot{ m_ShadeOrder[range.start + idx] };
+		const uint32_t rayIdx{ slot / lightSampleCount };
+
+		batch.normalX[idx] = m_RayQueue.normalX[rayIdx];
+		batch.normalY[idx] = m_RayQueue.normalY[rayIdx];
+		batch.normalZ[idx] = m_RayQueue.normalZ[rayIdx];
+		batch.lightX[idx] = m_ShadowQueue.lightX[slot];
+		batch.lightY[idx] = m_ShadowQueue.lightY[slot];
+		batch.lightZ[idx] = m_ShadowQueue.lightZ[slot];
+		batch.viewX[idx] = m_RayQueue.directionX[rayIdx];
+		batch.viewY[idx] = m_RayQueue.directionY[rayIdx];
+		batch.viewZ[idx] = m_RayQueue.directionZ[rayIdx];
+	}
+
+	MaterialUtils::ShadeBatch(materials[range.materialIndex], batch, m_ShadingMode);
+
+	const std::vector<Light>& lights{ pScene->GetLights() };
+	for (uint32_t idx{ 0 }; idx < range.count; ++idx)
+	{
+		const uint32_t slot{ m_ShadeOrder[range.start + idx] };
+		const ColorRGB BRDF{ batch.brdfR[idx], batch.brdfG[idx], batch.brdfB[idx] };
+		const float viewAngle{ m_ShadowQueue.cosines[slot] };
+		const float weight{ m_ShadowQueue.weights[slot] };
 
-void Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, const Matrix& cameraToWorld, const Vector3& cameraOrigin) const
+		// Same lighting equation as ShadePixel
+		ColorRGB color{};
+		switch (m_CurrentLightingMode)
+		{
+		case LightingMode::ObservedArea:
+			color = ColorRGB{ viewAngle, viewAngle, viewAngle } * weight;
+			break;
+		case LightingMode::Radiance:
+			color = LightUtils::GetRadiance(lights[m_ShadowQueue.lightIndices[slot]], m_RayQueue.GetHit(slot / lightSampleCount));
+			break;
+		case LightingMode::BRDF:
+			color = BRDF;
+			break;
+		case LightingMode::Combined:
+			color = LightUtils::GetRadiance(lights[m_ShadowQueue.lightIndices[slot]], m_RayQueue.GetHit(slot / lightSampleCount))
+				* BRDF * (viewAngle * weight);
+			break;
+		case LightingMode::TraversalCost:
+			break;
+		}
+
+		m_ShadowQueue.colorR[slot] = color.r;
+		m_ShadowQueue.colorG[slot] = color.g;
+		m_ShadowQueue.colorB[slot] = color.b;
+	}
+}
+
+void Renderer::ResolvePixels(uint32_t first, uint32_t end, uint32_t lightSampleCount) const
 {
-	std::vector<dae::Material*> materials{ pScene->GetMaterials() };
+#ifdef RAY_STATISTICS
+	Statistics::GetThreadCounters().shadingCalls += end - first;
+#endif
+	for (uint32_t rayIdx{ first }; rayIdx < end; ++rayIdx)
+	{
+		// Light order of the pixel, whatever order the batches were shaded in
+		ColorRGB finalColor{};
+		for (uint32_t slot{ rayIdx * lightSampleCount }; slot < (rayIdx + 1) * lightSampleCount; ++slot)
+		{
+			if (m_ShadowQueue.states[slot] == ShadowQueue::State::Lit)
+				finalColor += m_ShadowQueue.GetColor(slot);
+		}
+		const uint32_t pixelIdx{ m_RayQueue.pixelIndices[rayIdx] };
+		WritePixel(pixelIdx % m_Width, pixelIdx / m_Width, finalColor);
+	}
+}
 
-	const uint32_t px{ pixelIndex % m_Width };
-	const uint32_t py{ pixelIndex / m_Width };
+Vector3 Renderer::CalculateRayDirection(Scene* pScene, uint32_t px, uint32_t py, const Matrix& cameraToWorld) const
+{
+	return CalculateRayDirection(pScene, px, py, cameraToWorld, m_SampleOffsetX, m_SampleOffsetY);
+}
 
+Vector3 Renderer::CalculateRayDirection(Scene* pScene, uint32_t px, uint32_t py, const Matrix& cameraToWorld, 
+	float offsetX, float offsetY) const
+{
 	// For each pixel
 			//... Ray calculation ( Take aspect ratio and FOV into account )
-			//... Add half of the pixel size to get the center of the pixel
+			//... Add the sample offset inside the pixel ( Half of the pixel size -> center of the pixel )
 	Vector3 rayDirection{};
-	rayDirection.x = (2.f * ((static_cast<float>(px) + 0.5f) / static_cast<float>(m_Width)) - 1.f) * m_aspectRatio 
+	rayDirection.x = (2.f * ((static_cast<float>(px) + offsetX) / static_cast<float>(m_Width)) - 1.f) * m_aspectRatio 
 		* pScene->GetCamera().fov;
-	rayDirection.y = (1.f - 2.f * (static_cast<float>(py) + 0.5f) / static_cast<float>(m_Height)) * pScene->GetCamera().fov;
+	rayDirection.y = (1.f - 2.f * (static_cast<float>(py) + offsetY) / static_cast<float>(m_Height)) * pScene->GetCamera().fov;
 	rayDirection.z = 1.f;
 
 	// Transform this ray direction using the Camera ONB matrix, so we take into account 
 	// the camera rotation / position
-	rayDirection = cameraToWorld.TransformVector(rayDirection).Normalized();
+	return cameraToWorld.TransformVector(rayDirection).Normalized();
+}
 
-	// Ray we are casting from the camera towards each pixel
-	Ray viewRay{ cameraOrigin , rayDirection };
+ColorRGB Renderer::ShadePixel(Scene* pScene, const Ray& viewRay, const HitRecord& closestHit, uint64_t seed) const
+{
+#ifdef RAY_STATISTICS
+	++Statistics::GetThreadCounters().shadingCalls;
+#endif
+	const Material& material{ pScene->GetMaterials()[closestHit.materialIndex] };
 
 	// Color to write to the color buffer ( default = black)
 	ColorRGB finalColor{};
 
-	// HitRecord containing more info about potential hit
-	HitRecord closestHit{};
-	pScene->GetClosestHit(viewRay, closestHit);
-
 	// SHADING 
 	if (closestHit.didHit)
 	{
-		for (size_t index{ 0 }; index < pScene->GetLights().size(); ++index)
+		// Radiance and BRDF also show the lights behind the surface, the light BVH never picks those
+		const bool useLightBVH{ UseLightBVH(pScene) && m_CurrentLightingMode != LightingMode::Radiance
+			&& m_CurrentLightingMode != LightingMode::BRDF };
+		Random random{ seed };
+
+		const uint32_t lightSampleCount{ GetLightSampleCount(pScene, useLightBVH) };
+		for (uint32_t sampleIdx{ 0 }; sampleIdx < lightSampleCount; ++sampleIdx)
 		{
+			size_t index{};
+			float weight{};
+			if (!GetLightSample(pScene, closestHit, useLightBVH, sampleIdx, random, index, weight))
+				continue;
+
 			// Light direction ( From point to light)
 			Vector3 lightDirection{ LightUtils::GetDirectionToLight(pScene->GetLights()[index], closestHit.origin) };
 
@@ -133,8 +864,11 @@ void Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, const Matrix& cam
 				lightRay.max = lightRay.direction.Magnitude();
 				lightRay.direction = lightRay.direction.Normalized();
 
+#ifdef RAY_STATISTICS
+				++Statistics::GetThreadCounters().shadowRays;
+#endif
 				// Check if the ray hits
-				if (pScene->DoesHit(lightRay))
+				if (pScene->IsOccluded(lightRay, index))
 				{
 					// Shadowed -> Skip next color
 					continue;
@@ -142,7 +876,7 @@ void Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, const Matrix& cam
 			}
 
 			// ** LIGHT SCATTERING ** based on the material from the objects from the scene
-			const ColorRGB BRDF{ materials[closestHit.materialIndex]->Shade(closestHit, lightDirection.Normalized(), viewRay.direction) };
+			const ColorRGB BRDF{ MaterialUtils::Shade(material, closestHit, lightDirection.Normalized(), viewRay.direction, m_ShadingMode) };
 
 			//finalColor += BRDF;			// BRDF ONLY
 			// ** LIGHTING EQUATION **
@@ -150,7 +884,7 @@ void Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, const Matrix& cam
 			switch (m_CurrentLightingMode)
 			{
 			case dae::Renderer::LightingMode::ObservedArea:
-				finalColor += ColorRGB{ viewAngle, viewAngle, viewAngle }; // ObservedArea Only 
+				finalColor += ColorRGB{ viewAngle, viewAngle, viewAngle } * weight; // ObservedArea Only 
 				break;
 			case dae::Renderer::LightingMode::Radiance:
 				finalColor += LightUtils::GetRadiance(pScene->GetLights()[index], closestHit.origin); // Incident Radiance Only
@@ -159,31 +893,536 @@ void Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, const Matrix& cam
 				finalColor += BRDF;			// BRDF ONLY
 				break;
 			case dae::Renderer::LightingMode::Combined:
-				finalColor += LightUtils::GetRadiance(pScene->GetLights()[index], closestHit.origin) * BRDF * viewAngle;
+				finalColor += LightUtils::GetRadiance(pScene->GetLights()[index], closestHit.origin) * BRDF * (viewAngle * weight);
 				break;
+			case dae::Renderer::LightingMode::TraversalCost:
+				break;		// Color from the counters ( TraceViewRay ), the shadow rays above still count
 			}
 
 		}
 	}
 
+	// Not clamped : the display pass tone maps it
+	return finalColor;
+}
+
+void Renderer::WritePixel(uint32_t px, uint32_t py, const ColorRGB& color) const
+{
 	//Update Color in Buffer 
-	finalColor.MaxToOne(); // Clamp final color to prevent color overflow
-	m_pBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBuffer->format,
-		static_cast<uint8_t>(finalColor.r * 255),
-		static_cast<uint8_t>(finalColor.g * 255),
-		static_cast<uint8_t>(finalColor.b * 255));
+	const uint32_t pixelIdx{ px + (py * m_Width) };
+	m_FrameColors[pixelIdx] = color;
+
+	ColorRGB displayColor{ color };
+	if (m_AccumulationMode == AccumulationMode::Progressive)
+	{
+		// First sample overwrites -> no need to clear the buffer when the view changes
+		if (m_AccumulatedSamples == 0)
+			m_AccumulationBuffer[pixelIdx] = color;
+		else
+			m_AccumulationBuffer[pixelIdx] += color;
 
+		// Show the average of all samples so far
+		const ColorRGB& accumulatedColor{ m_AccumulationBuffer[pixelIdx] };
+		displayColor = accumulatedColor * (1.f / static_cast<float>(m_AccumulatedSamples + 1));
+	}
+
+	// Samples aren't clamped ( That would bias the average ), the display pass tone maps what is shown
+	WriteDisplayColor(pixelIdx, displayColor);
 }
 
-bool Renderer::SaveBufferToImage() const
+void Renderer::WriteDisplayColor(uint32_t pixelIdx, const ColorRGB& color) const
 {
-	return SDL_SaveBMP(m_pBuffer, "RayTracing_Buffer.bmp");
+	m_DisplayColors[pixelIdx] = color;
+}
+
+void Renderer::ResolveDisplay()
+{
+	// Debug views ( Heatmap, adaptive samples ) show their colors as they are
+	const bool isDebugView{ m_CurrentLightingMode == LightingMode::TraversalCost || m_AdaptiveMode == AdaptiveMode::ShowSamples };
+	m_DisplayMapper.Update(*m_pRenderTarget, isDebugView ? DisplaySettings{} : m_DisplaySettings);
+	m_DisplayChanged = false;
+
+	// Lower resolution than the window -> upscale to the window first ( Still HDR )
+	const std::vector<ColorRGB>& windowColors{ IsUpscaling() ? m_WindowColors : m_DisplayColors };
+
+	// Bands of rows of the window, as high as a tile
+	const uint32_t bandCount{ (m_WindowHeight + m_TileSize - 1) / m_TileSize };
+	RunTasks(bandCount, [&](uint32_t bandIdx)
+		{
+			const uint32_t startRow{ bandIdx * m_TileSize };
+			const uint32_t endRow{ std::min(startRow + m_TileSize, static_cast<uint32_t>(m_WindowHeight)) };
+			if (IsUpscaling())
+				UpscaleRows(startRow, endRow);
+
+			const size_t firstPixel{ static_cast<size_t>(startRow) * m_WindowWidth };
+			m_DisplayMapper.PackPixels(&windowColors[firstPixel], m_pBufferPixels + firstPixel, (endRow - startRow) * m_WindowWidth);
+		});
+}
+
+void Renderer::UpscaleRows(uint32_t startRow, uint32_t endRow)
+{
+	const float scaleX{ m_Width / static_cast<float>(m_WindowWidth) };
+	const float scaleY{ m_Height / static_cast<float>(m_WindowHeight) };
+
+	for (uint32_t py{ startRow }; py < endRow; ++py)
+	{
+		// Position in the render buffer, relative to the pixel centers
+		const float sourceY{ (py + 0.5f) * scaleY - 0.5f };
+		const int y0{ std::clamp(static_cast<int>(std::floor(sourceY)), 0, m_Height - 1) };
+		const int y1{ std::min(y0 + 1, m_Height - 1) };
+		const float fracY{ std::clamp(sourceY - y0, 0.f, 1.f) };
+
+		for (uint32_t px{ 0 }; px < static_cast<uint32_t>(m_WindowWidth); ++px)
+		{
+			const float sourceX{ (px + 0.5f) * scaleX - 0.5f };
+			const int x0{ std::clamp(static_cast<int>(std::floor(sourceX)), 0, m_Width - 1) };
+			const int x1{ std::min(x0 + 1, m_Width - 1) };
+			const float fracX{ std::clamp(sourceX - x0, 0.f, 1.f) };
+
+			const ColorRGB* samples[4]{
+				&m_DisplayColors[x0 + y0 * m_Width], &m_DisplayColors[x1 + y0 * m_Width],
+				&m_DisplayColors[x0 + y1 * m_Width], &m_DisplayColors[x1 + y1 * m_Width] };
+			float weights[4]{
+				(1.f - fracX) * (1.f - fracY), fracX * (1.f - fracY),
+				(1.f - fracX) * fracY, fracX * fracY };
+
+			// ** EDGE AWARE ** 
+			// ... Bilinear, but samples that differ from the nearest one lose weight -> edges stay sharp instead of blurred
+			const int nearestIdx{ static_cast<int>(std::max_element(weights, weights + 4) - weights) };
+			const float nearestLuminance{ Luminance(*samples[nearestIdx]) };
+
+			ColorRGB color{};
+			float weightSum{ 0.f };
+			for (int sampleIdx{ 0 }; sampleIdx < 4; ++sampleIdx)
+			{
+				const float weight{ weights[sampleIdx] 
+					/ (1.f + m_UpscaleEdgeSharpness * std::abs(Luminance(*samples[sampleIdx]) - nearestLuminance)) };
+				color += *samples[sampleIdx] * weight;
+				weightSum += weight;
+			}
+			color *= 1.f / weightSum;
+
+			m_WindowColors[px + py * m_WindowWidth] = color;
+		}
+	}
+}
+
+void Renderer::RenderAdaptiveSamples(Scene* pScene, const Matrix& cameraToWorld, const Vector3& cameraOrigin)
+{
+	// Neighbours can be in other tiles -> the whole first pass has to be done before estimating
+	ForEachTile([&](uint32_t tileIdx) { EstimateTileVariance(tileIdx); });
+
+	SelectAdaptivePixels();
+
+	if (m_AdaptiveRayCount > 0)
+		ForEachTile([&](uint32_t tileIdx) { RefineTile(pScene, tileIdx, cameraToWorld, cameraOrigin); });
+}
+
+void Renderer::EstimateTileVariance(uint32_t tileIndex) const
+{
+	const Tile& tile{ m_Tiles[tileIndex] };
+	for (int py{ tile.startY }; py < tile.endY; ++py)
+	{
+		for (int px{ tile.startX }; px < tile.endX; ++px)
+		{
+			// Luminance variance of the 3x3 neighbourhood ( Clipped at the screen borders )
+			// ... Of the clamped colors : the HDR highlights would take the whole budget
+			float sum{ 0.f };
+			float sumSquared{ 0.f };
+			int count{ 0 };
+			for (int y{ std::max(py - 1, 0) }; y <= std::min(py + 1, m_Height - 1); ++y)
+			{
+				for (int x{ std::max(px - 1, 0) }; x <= std::min(px + 1, m_Width - 1); ++x)
+				{
+					ColorRGB color{ m_FrameColors[x + y * m_Width] };
+					color.MaxToOne();
+					const float luminance{ Luminance(color) };
+					sum += luminance;
+					sumSquared += luminance * luminance;
+					++count;
+				}
+			}
+
+			const float mean{ sum / count };
+			m_PixelVariances[px + py * m_Width] = std::max(sumSquared / count - mean * mean, 0.f);
+		}
+	}
+}
+
+void Renderer::SelectAdaptivePixels()
+{
+	constexpr uint32_t extraSamples{ m_AdaptiveStrata * m_AdaptiveStrata };
+
+	m_AdaptiveCandidates.clear();
+	for (uint32_t pixelIdx{ 0 }; pixelIdx < m_PixelVariances.size(); ++pixelIdx)
+	{
+		if (m_PixelVariances[pixelIdx] > m_AdaptiveVarianceThreshold)
+			m_AdaptiveCandidates.emplace_back(pixelIdx);
+	}
+
+	// Over budget -> only keep the pixels with the highest variance
+	const size_t maxPixelCount{ m_AdaptiveRayBudget / extraSamples };
+	if (m_AdaptiveCandidates.size() > maxPixelCount)
+	{
+		std::nth_element(m_AdaptiveCandidates.begin(), m_AdaptiveCandidates.begin() + maxPixelCount, m_AdaptiveCandidates.end(),
+			[this](uint32_t a, uint32_t b) { return m_PixelVariances[a] > m_PixelVariances[b]; });
+		m_AdaptiveCandidates.resize(maxPixelCount);
+	}
+
+	std::fill(m_PixelSampleCounts.begin(), m_PixelSampleCounts.end(), static_cast<uint8_t>(1));
+	for (uint32_t pixelIdx : m_AdaptiveCandidates)
+		m_PixelSampleCounts[pixelIdx] = static_cast<uint8_t>(1 + extraSamples);
+
+	m_AdaptiveRayCount = static_cast<uint32_t>(m_AdaptiveCandidates.size()) * extraSamples;
+}
+
+void Renderer::RefineTile(Scene* pScene, uint32_t tileIndex, const Matrix& cameraToWorld, const Vector3& cameraOrigin) const
+{
+	const Tile& tile{ m_Tiles[tileIndex] };
+	for (uint32_t py{ tile.startY }; py < tile.endY; ++py)
+	{
+		for (uint32_t px{ tile.startX }; px < tile.endX; ++px)
+		{
+			const uint32_t pixelIdx{ px + py * m_Width };
+			const uint8_t sampleCount{ m_PixelSampleCounts[pixelIdx] };
+			if (sampleCount <= 1)
+				continue;
+
+			// Start from the sample of the first pass, add one sample in the center of every stratum
+			ColorRGB colorSum{ m_FrameColors[pixelIdx] };
+			for (uint32_t stratumY{ 0 }; stratumY < m_AdaptiveStrata; ++stratumY)
+			{
+				for (uint32_t stratumX{ 0 }; stratumX < m_AdaptiveStrata; ++stratumX)
+				{
+					const float offsetX{ (stratumX + 0.5f) / m_AdaptiveStrata };
+					const float offsetY{ (stratumY + 0.5f) / m_AdaptiveStrata };
+					const Ray viewRay{ cameraOrigin, CalculateRayDirection(pScene, px, py, cameraToWorld, offsetX, offsetY) };
+					colorSum += TraceViewRay(pScene, viewRay, GetSampleSeed(px, py, 1 + stratumX + stratumY * m_AdaptiveStrata));
+				}
+			}
+
+			WritePixel(px, py, colorSum * (1.f / sampleCount));
+		}
+	}
+}
+
+void Renderer::ShowTileSampleCounts(uint32_t tileIndex) const
+{
+	const Tile& tile{ m_Tiles[tileIndex] };
+	for (uint32_t py{ tile.startY }; py < tile.endY; ++py)
+	{
+		for (uint32_t px{ tile.startX }; px < tile.endX; ++px)
+		{
+			// Straight to the screen, the accumulation buffer keeps the real image
+			const uint32_t pixelIdx{ px + py * m_Width };
+			const float grey{ Luminance(m_FrameColors[pixelIdx]) * 0.3f };
+			WriteDisplayColor(pixelIdx, m_PixelSampleCounts[pixelIdx] > 1 ? ColorRGB{ 1.f, 0.1f, 0.1f } : ColorRGB{ grey, grey, grey });
+		}
+	}
+}
+
+bool Renderer::SaveBufferToImage(const std::string& filePath) const
+{
+	return ImageUtils::SaveImage(*m_pRenderTarget, filePath);
 }
 
 
 void Renderer::ToggleShadows()
 {
 	m_ShadowsEnabled = !m_ShadowsEnabled;
+	m_SettingsChanged = true;
+}
+
+void Renderer::CycleAccumulationMode()
+{
+	switch (m_AccumulationMode)
+	{
+	case AccumulationMode::Off:
+		std::cout << "ACCUMULATION MODE : Skip unchanged frames" << std::endl;
+		m_AccumulationMode = AccumulationMode::SkipUnchanged;
+		break;
+	case AccumulationMode::SkipUnchanged:
+		std::cout << "ACCUMULATION MODE : Progressive ( Max " << m_MaxAccumulatedSamples << " samples )" << std::endl;
+		m_AccumulationMode = AccumulationMode::Progressive;
+		break;
+	case AccumulationMode::Progressive:
+		std::cout << "ACCUMULATION MODE : Off ( Trace every frame )" << std::endl;
+		m_AccumulationMode = AccumulationMode::Off;
+		break;
+	}
+
+	m_SettingsChanged = true;
+}
+
+void Renderer::CycleAdaptiveSampling()
+{
+	switch (m_AdaptiveMode)
+	{
+	case AdaptiveMode::Off:
+		std::cout << "ADAPTIVE SAMPLING : On ( Budget " << m_AdaptiveRayBudget << " extra rays per frame )" << std::endl;
+		m_AdaptiveMode = AdaptiveMode::On;
+		break;
+	case AdaptiveMode::On:
+		std::cout << "ADAPTIVE SAMPLING : Show samples ( Last frame : " << m_AdaptiveRayCount << " extra rays )" << std::endl;
+		m_AdaptiveMode = AdaptiveMode::ShowSamples;
+		break;
+	case AdaptiveMode::ShowSamples:
+		std::cout << "ADAPTIVE SAMPLING : Off" << std::endl;
+		m_AdaptiveMode = AdaptiveMode::Off;
+		break;
+	}
+
+	m_SettingsChanged = true;
+}
+
+void Renderer::ToggleDynamicResolution()
+{
+	m_DynamicResolution = !m_DynamicResolution;
+	m_ResolutionScale = 1.f;
+
+	if (m_DynamicResolution)
+		std::cout << "DYNAMIC RESOLUTION : On ( Target " << m_TargetFrameTime * 1000.f << " ms )" << std::endl;
+	else
+		std::cout << "DYNAMIC RESOLUTION : Off" << std::endl;
+}
+
+void Renderer::UpdateResolutionScale(float frameTime)
+{
+	m_LastFrameTime = frameTime;
+
+	// Frames that didn't trace anything say nothing about the cost of a frame
+	if (!m_DynamicResolution || !m_FrameTraced || frameTime <= 0.f)
+		return;
+
+	// The cost scales with the pixel count -> estimate the full resolution cost, then the scale that fits the target
+	const float pixelRatio{ (m_Width * m_Height) / static_cast<float>(m_WindowWidth * m_WindowHeight) };
+	const float fullResolutionTime{ frameTime / pixelRatio };
+	const float wantedScale{ std::sqrt(m_TargetFrameTime / fullResolutionTime) };
+
+	// Halfway there every frame, one slow frame shouldn't make the resolution jump
+	m_ResolutionScale = std::clamp(m_ResolutionScale + (wantedScale - m_ResolutionScale) * 0.5f, m_MinResolutionScale, 1.f);
+}
+
+void Renderer::ToggleShadingMode()
+{
+	m_ShadingMode = m_ShadingMode == ShadingMode::Exact ? ShadingMode::Fast : ShadingMode::Exact;
+	m_SettingsChanged = true;
+
+	if (m_ShadingMode == ShadingMode::Fast)
+		std::cout << "SHADING : Fast ( FastMath BRDFs )" << std::endl;
+	else
+		std::cout << "SHADING : Exact" << std::endl;
+}
+
+void Renderer::CycleToneMapper()
+{
+	switch (m_DisplaySettings.toneMapper)
+	{
+	case ToneMapper::MaxToOne:
+		std::cout << "TONE MAPPING : Reinhard" << std::endl;
+		m_DisplaySettings.toneMapper = ToneMapper::Reinhard;
+		break;
+	case ToneMapper::Reinhard:
+		std::cout << "TONE MAPPING : ACES" << std::endl;
+		m_DisplaySettings.toneMapper = ToneMapper::ACES;
+		break;
+	case ToneMapper::ACES:
+		std::cout << "TONE MAPPING : Max to one" << std::endl;
+		m_DisplaySettings.toneMapper = ToneMapper::MaxToOne;
+		break;
+	}
+	m_DisplayChanged = true;
+}
+
+void Renderer::ToggleSRGB()
+{
+	m_DisplaySettings.sRGB = !m_DisplaySettings.sRGB;
+	m_DisplayChanged = true;
+
+	std::cout << "OUTPUT ENCODING : " << (m_DisplaySettings.sRGB ? "sRGB" : "Linear") << std::endl;
+}
+
+void Renderer::AdjustExposure(float stops)
+{
+	m_DisplaySettings.exposure *= std::exp2(stops);
+	m_DisplayChanged = true;
+
+	std::cout << "EXPOSURE : " << m_DisplaySettings.exposure << std::endl;
+}
+
+void Renderer::ToggleWavefront()
+{
+	m_Wavefront = !m_Wavefront;
+
+	if (m_Wavefront)
+		std::cout << "WAVEFRONT : On ( Direct integrator only, material sorted shading )" << std::endl;
+	else
+		std::cout << "WAVEFRONT : Off ( Tiles )" << std::endl;
+}
+
+void Renderer::CyclePacketMode()
+{
+	// Off -> 2x2 -> 4x4 -> 8x8 -> Off
+	m_PacketSize = m_PacketSize >= 8 ? 1 : m_PacketSize * 2;
+	static_assert(m_TileSize % 8 == 0, "Packets have to fit in the tiles");
+
+	if (m_PacketSize > 1)
+		std::cout << "PACKET MODE : " << m_PacketSize << "x" << m_PacketSize << std::endl;
+	else
+		std::cout << "PACKET MODE : Off ( Single rays )" << std::endl;
+}
+
+void Renderer::SetThreadCount(uint32_t threadCount)
+{
+	m_pThreadPool->SetThreadCount(threadCount);
+}
+
+uint32_t Renderer::GetThreadCount() const
+{
+	return m_pThreadPool->GetThreadCount();
+}
+
+void Renderer::CycleThreadCount()
+{
+	// 1 -> 2 -> 4 -> ... -> all hardware threads -> 1
+	const uint32_t maxThreadCount{ std::max(std::thread::hardware_concurrency(), 1u) };
+	const uint32_t threadCount{ GetThreadCount() };
+	SetThreadCount(threadCount >= maxThreadCount ? 1 : std::min(threadCount * 2, maxThreadCount));
+
+	std::cout << "RENDER THREADS : " << GetThreadCount() << std::endl;
+}
+
+void Renderer::GetTileBounds(uint32_t tileIndex, uint32_t& startX, uint32_t& startY, uint32_t& endX, uint32_t& endY) const
+{
+	const Tile& tile{ m_Tiles[tileIndex] };
+	startX = tile.startX;
+	startY = tile.startY;
+	endX = tile.endX;
+	endY = tile.endY;
+}
+
+void Renderer::PrintTileTimes() const
+{
+	if (m_TileTimes.empty())
+		return;
+
+	const auto slowestTile{ std::max_element(m_TileTimes.begin(), m_TileTimes.end()) };
+	const Tile& tile{ m_Tiles[slowestTile - m_TileTimes.begin()] };
+
+	float totalTime{ 0.f };
+	for (float tileTime : m_TileTimes)
+		totalTime += tileTime;
+
+	std::cout << "TILES : " << m_Tiles.size() << " tiles of " << m_TileSize << "x" << m_TileSize << " on " << GetThreadCount()
+		<< " threads | avg " << totalTime / m_TileTimes.size() << " ms, max " << *slowestTile << " ms ( Tile at "
+		<< tile.startX << ", " << tile.startY << " ), total " << totalTime << " ms" << std::endl;
+}
+
+void Renderer::PrintRayStatistics() const
+{
+#ifdef RAY_STATISTICS
+	const RayCounters& counters{ m_FrameCounters };
+	const uint64_t rayCount{ std::max(counters.GetRayCount(), uint64_t{ 1 }) };
+
+	std::cout << "RAYS : " << counters.primaryRays << " primary, " << counters.shadowRays << " shadow, " << counters.bounceRays
+		<< " bounce | TESTS per ray : "
+		<< static_cast<double>(counters.aabbTests) / rayCount << " boxes, " << static_cast<double>(counters.triangleTests) / rayCount
+		<< " triangles, " << static_cast<double>(counters.sphereTests) / rayCount << " spheres, "
+		<< static_cast<double>(counters.planeTests) / rayCount << " planes | " << counters.shadingCalls << " shading calls" << std::endl;
+#else
+	std::cout << "RAYS : build with RAY_STATISTICS defined to count them" << std::endl;
+#endif
+}
+
+void Renderer::SetTraversalCostView(bool enabled)
+{
+#ifdef RAY_STATISTICS
+	m_CurrentLightingMode = enabled ? LightingMode::TraversalCost : LightingMode::Combined;
+	m_SettingsChanged = true;
+#else
+	if (enabled)
+		std::cout << "The traversal cost view needs a build with RAY_STATISTICS defined" << std::endl;
+#endif
+}
+
+void Renderer::CreateTiles()
+{
+	// Spread the bits of a 16 bit value over the even bits ( Morton code building block )
+	const auto spreadBits{ [](uint32_t value)
+		{
+			value &= 0x0000ffff;
+			value = (value | (value << 8)) & 0x00ff00ff;
+			value = (value | (value << 4)) & 0x0f0f0f0f;
+			value = (value | (value << 2)) & 0x33333333;
+			value = (value | (value << 1)) & 0x55555555;
+			return value;
+		} };
+
+	const uint32_t tilesPerRow{ (m_Width + m_TileSize - 1) / m_TileSize };
+	const uint32_t tilesPerColumn{ (m_Height + m_TileSize - 1) / m_TileSize };
+
+	std::vector<std::pair<uint32_t, Tile>> mortonTiles{};
+	mortonTiles.reserve(tilesPerRow * tilesPerColumn);
+	for (uint32_t tileY{ 0 }; tileY < tilesPerColumn; ++tileY)
+	{
+		for (uint32_t tileX{ 0 }; tileX < tilesPerRow; ++tileX)
+		{
+			// Smaller tiles at the right and bottom edges
+			Tile tile{};
+			tile.startX = static_cast<uint16_t>(tileX * m_TileSize);
+			tile.startY = static_cast<uint16_t>(tileY * m_TileSize);
+			tile.endX = static_cast<uint16_t>(std::min((tileX + 1) * m_TileSize, static_cast<uint32_t>(m_Width)));
+			tile.endY = static_cast<uint16_t>(std::min((tileY + 1) * m_TileSize, static_cast<uint32_t>(m_Height)));
+
+			mortonTiles.emplace_back(spreadBits(tileX) | (spreadBits(tileY) << 1), tile);
+		}
+	}
+
+	std::sort(mortonTiles.begin(), mortonTiles.end(),
+		[](const auto& a, const auto& b) { return a.first < b.first; });
+
+	m_Tiles.clear();
+	for (const auto& mortonTile : mortonTiles)
+		m_Tiles.emplace_back(mortonTile.second);
+
+	m_TileTimes.assign(m_Tiles.size(), 0.f);
+}
+
+void Renderer::RunTasks(uint32_t taskCount, const std::function<void(uint32_t)>& task) const
+{
+#ifdef PARALLEL_EXECUTION
+	// Parallel logic
+	// ... Handed out by the thread pool ( Work stealing between the render threads )
+	m_pThreadPool->Run(taskCount, task);
+
+#else // Synchronous logic (no multithreading)
+
+	for (uint32_t taskIdx{}; taskIdx < taskCount; ++taskIdx)
+	{
+		task(taskIdx);
+	}
+#endif // PARALLEL_EXECUTION
+}
+
+void Renderer::CycleIntegrator()
+{
+	switch (m_Integrator)
+	{
+		case Integrator::Direct:
+			std::cout << "INTEGRATOR : Path Tracing ( Importance sampled )" << std::endl;
+			m_Integrator = Integrator::PathTracing;
+			break;
+		case Integrator::PathTracing:
+			std::cout << "INTEGRATOR : Path Tracing ( Uniform hemisphere, reference for the convergence )" << std::endl;
+			m_Integrator = Integrator::PathTracingUniform;
+			break;
+		case Integrator::PathTracingUniform:
+			std::cout << "INTEGRATOR : Direct Lighting" << std::endl;
+			m_Integrator = Integrator::Direct;
+			break;
+	}
+
+	m_SettingsChanged = true;
 }
 
 void Renderer::CycleLightingMode()
@@ -203,8 +1442,16 @@ void Renderer::CycleLightingMode()
 			m_CurrentLightingMode = LightingMode::Combined;
 			break;
 		case dae::Renderer::LightingMode::Combined:
+#ifdef RAY_STATISTICS
+			std::cout << "LIGHTING MODE : Traversal Cost ( Blue = cheap, red = " << m_HeatmapMaxCost << "+ box and primitive tests )" << std::endl;
+			m_CurrentLightingMode = LightingMode::TraversalCost;
+			break;
+#endif
+		case dae::Renderer::LightingMode::TraversalCost:
 			std::cout << "LIGHTING MODE : Observed Area" << std::endl;
 			m_CurrentLightingMode = LightingMode::ObservedArea;
 			break;
 	}
+
+	m_SettingsChanged = true;
 }
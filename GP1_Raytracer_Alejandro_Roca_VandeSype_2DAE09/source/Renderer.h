@@ -1,10 +1,15 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
 #include <vector>
 
-struct SDL_Window;
-struct SDL_Surface;
+#include "ColorRGB.h"
+#include "Statistics.h"
+#include "ToneMapping.h"
+#include "Wavefront.h"
 
 
 namespace dae
@@ -12,36 +17,306 @@ namespace dae
 	class Scene;
 	struct Matrix;
 	struct Vector3;
+	struct Ray;
+	struct HitRecord;
+	struct Material;
+	enum class ShadingMode : uint8_t;
+	class Random;
+	class ThreadPool;
+	class RenderTarget;
 
 	class Renderer final
 	{
 	public:
-		Renderer(SDL_Window* pWindow);
-		~Renderer() = default;
+		// The image goes into pRenderTarget ( Not owned, has to outlive the renderer )
+		// threadCount 0 -> one render thread per hardware thread
+		Renderer(RenderTarget* pRenderTarget, uint32_t threadCount = 0);
+		~Renderer();
 
 		Renderer(const Renderer&) = delete;
 		Renderer(Renderer&&) noexcept = delete;
 		Renderer& operator=(const Renderer&) = delete;
 		Renderer& operator=(Renderer&&) noexcept = delete;
 
-		void Render(Scene* pScene) const;
-		void RenderPixel(Scene* pScene, uint32_t pixelIndex, const Matrix& cameraToWorld, const Vector3& cameraOrigin) const;	  // Process each pixel
-		bool SaveBufferToImage() const;
+		// Traces the frame, unless nothing changed since the previous one ( See AccumulationMode )
+		void Render(Scene* pScene);
+		void RenderTile(Scene* pScene, uint32_t tileIndex, const Matrix& cameraToWorld, const Vector3& cameraOrigin) const;	  // Process a screen tile
+		void RenderPixel(Scene* pScene, uint32_t px, uint32_t py, const Matrix& cameraToWorld, const Vector3& cameraOrigin) const;	  // Process each pixel
+		void RenderPacket(Scene* pScene, uint32_t startX, uint32_t startY, const Matrix& cameraToWorld, const Vector3& cameraOrigin) const;	  // Process a block of pixels at once
+		// Format from the extension ( .bmp, .png or .ppm ), returns true when the file was written
+		bool SaveBufferToImage(const std::string& filePath = "RayTracing_Buffer.bmp") const;
+
+		// THREADING
+		void SetThreadCount(uint32_t threadCount);
+		uint32_t GetThreadCount() const;
+		void CycleThreadCount();
+
+		// Time spent on every tile during the last frame ( In milliseconds, same order as the tiles )
+		const std::vector<float>& GetTileTimes() const { return m_TileTimes; }
+		uint32_t GetTileCount() const { return static_cast<uint32_t>(m_Tiles.size()); }
+		void GetTileBounds(uint32_t tileIndex, uint32_t& startX, uint32_t& startY, uint32_t& endX, uint32_t& endY) const;
+		void PrintTileTimes() const;
+
+		// RAY STATISTICS
+		// Counters of all threads during the last traced frame ( Empty without RAY_STATISTICS )
+		const RayCounters& GetFrameCounters() const { return m_FrameCounters; }
+		void PrintRayStatistics() const;
+		// Heatmap of the traversal cost instead of the shading ( Off -> back to the combined lighting )
+		void SetTraversalCostView(bool enabled);
 
 		// LIGHTING
 		void CycleLightingMode();
+
+		// INTEGRATOR
+		enum class Integrator
+		{
+			Direct,					// One shadow ray per light, see LightingMode
+			PathTracing,			// Global illumination : light sampling at every hit + importance sampled bounces
+			PathTracingUniform		// Same paths with naive bounces ( Uniform hemisphere ), to compare the noise against
+		};
+		void CycleIntegrator();
+		void SetIntegrator(Integrator integrator) { m_Integrator = integrator; m_SettingsChanged = true; }
+
+		// LIGHT SAMPLING
+		enum class LightSampling
+		{
+			All,			// One shadow ray per light
+			LightBVH,		// A few lights per hit, picked by the scene light BVH
+			Auto			// LightBVH when the scene has many point lights
+		};
+		void CycleLightSampling();
+		void SetLightSampling(LightSampling lightSampling) { m_LightSampling = lightSampling; m_SettingsChanged = true; }
 		void ToggleShadows();
 
-	private:
-		SDL_Window* m_pWindow{};
+		// PRIMARY RAYS
+		void CyclePacketMode();
+
+		// SHADING
+		// Exact BRDFs or their FastMath versions ( Path sampling pdfs always stay exact )
+		void ToggleShadingMode();
+		void SetShadingMode(ShadingMode shadingMode) { m_ShadingMode = shadingMode; m_SettingsChanged = true; }
+
+		// WAVEFRONT
+		void ToggleWavefront();
+		void SetWavefront(bool enabled) { m_Wavefront = enabled; }
+
+		// ACCUMULATION
+		void CycleAccumulationMode();
+		uint32_t GetAccumulatedSamples() const { return m_AccumulatedSamples; }
+		void SetMaxAccumulatedSamples(uint32_t sampleCount) { m_MaxAccumulatedSamples = sampleCount; }
+		// The next frame starts from scratch, even if nothing changed
+		void ResetAccumulation() { m_SettingsChanged = true; }
+
+		// ADAPTIVE SAMPLING
+		void CycleAdaptiveSampling();
+		// Extra rays traced on top of one per pixel during the last adaptive pass
+		uint32_t GetAdaptiveRayCount() const { return m_AdaptiveRayCount; }
+		void SetAdaptiveSampleBudget(uint32_t rayBudget) { m_AdaptiveRayBudget = rayBudget; }
 
-		SDL_Surface* m_pBuffer{};
+		// DISPLAY
+		// The traced colors stay linear HDR : exposure, tone mapping and sRGB only change how they are shown ( Nothing is traced again )
+		void CycleToneMapper();
+		void ToggleSRGB();
+		void AdjustExposure(float stops);	// Exposure x 2^stops
+		void SetDisplaySettings(const DisplaySettings& settings) { m_DisplaySettings = settings; m_DisplayChanged = true; }
+		const DisplaySettings& GetDisplaySettings() const { return m_DisplaySettings; }
+
+		// DYNAMIC RESOLUTION
+		void ToggleDynamicResolution();
+		// Feed the duration of the last frame ( Timer elapsed, in seconds ) -> picks the resolution of the next one
+		void UpdateResolutionScale(float frameTime);
+		void SetTargetFrameTime(float frameTime) { m_TargetFrameTime = frameTime; }
+		bool IsDynamicResolutionEnabled() const { return m_DynamicResolution; }
+		// Render resolution / window resolution ( 1 = full resolution )
+		float GetResolutionScale() const { return m_Width / static_cast<float>(m_WindowWidth); }
+		float GetLastFrameTime() const { return m_LastFrameTime; }
+
+	private:
+		RenderTarget* m_pRenderTarget{};
 		uint32_t* m_pBufferPixels{}; // This will change every frame
 
+		// Resolution the rays are traced at ( Lower than the window with dynamic resolution )
 		int m_Width{};
 		int m_Height{};
+		int m_WindowWidth{};
+		int m_WindowHeight{};
 		float m_aspectRatio{};
-		std::vector<uint32_t> m_pixelIndices{};
+
+		// Primary rays traced per block of m_PacketSize x m_PacketSize pixels ( 1 = single rays )
+		uint32_t m_PacketSize{ 1 };
+
+		// Screen split in tiles, one task per tile
+		// ... Stored in Morton order ( Z curve ) -> tiles next to each other in the list are also close on screen
+		struct Tile
+		{
+			uint16_t startX;
+			uint16_t startY;
+			uint16_t endX;
+			uint16_t endY;
+		};
+		static constexpr uint32_t m_TileSize{ 16 };	// Multiple of the biggest packet size
+		std::vector<Tile> m_Tiles{};
+		mutable std::vector<float> m_TileTimes{};
+		std::unique_ptr<ThreadPool> m_pThreadPool{};
+
+		void CreateTiles();
+		// Runs task(taskIdx) for every taskIdx in [0, taskCount), on the thread pool when PARALLEL_EXECUTION is defined
+		void RunTasks(uint32_t taskCount, const std::function<void(uint32_t)>& task) const;
+		void ForEachTile(const std::function<void(uint32_t)>& task) const { RunTasks(GetTileCount(), task); }
+
+		// ACCUMULATION
+		enum class AccumulationMode
+		{
+			Off,				// Trace every frame
+			SkipUnchanged,		// Only trace when the camera, the scene or a setting changed
+			Progressive			// Still view -> add a jittered sample per frame and show the average ( Anti-aliasing )
+		};
+
+		AccumulationMode m_AccumulationMode{ AccumulationMode::Progressive };
+		uint32_t m_MaxAccumulatedSamples{ 256 };	// Converged -> stop tracing
+
+		// Sum of the samples of every pixel, only used in progressive mode
+		mutable std::vector<ColorRGB> m_AccumulationBuffer{};
+		uint32_t m_AccumulatedSamples{ 0 };		// Samples in the buffer ( Not counting the frame being traced )
+		const Scene* m_pLastScene{ nullptr };
+		bool m_SettingsChanged{ true };
+
+		// Position of the primary ray inside its pixel, the same for every pixel of a frame ( 0.5 = center )
+		float m_SampleOffsetX{ 0.5f };
+		float m_SampleOffsetY{ 0.5f };
+
+		void WritePixel(uint32_t px, uint32_t py, const ColorRGB& color) const;
+
+		// ADAPTIVE SAMPLING
+		// After the first pass every pixel gets a variance estimate from its 3x3 neighbourhood
+		// ... The pixels above the threshold ( Edges, specular highlights ) get extra stratified samples
+		// ... The highest variances win when there are more candidates than the per-frame budget allows
+		enum class AdaptiveMode
+		{
+			Off,
+			On,
+			ShowSamples		// Red = pixels that got extra samples, the rest in dimmed grey
+		};
+
+		AdaptiveMode m_AdaptiveMode{ AdaptiveMode::On };
+		static constexpr uint32_t m_AdaptiveStrata{ 2 };			// Extra samples on a 2x2 grid inside the pixel
+		static constexpr float m_AdaptiveVarianceThreshold{ 0.002f };	// Luminance variance
+		uint32_t m_AdaptiveRayBudget{};			// Extra rays per frame, default a quarter of the pixel count
+		uint32_t m_AdaptiveRayCount{};
+
+		mutable std::vector<ColorRGB> m_FrameColors{};		// Color of every pixel in the frame being traced ( Before accumulation )
+		mutable std::vector<float> m_PixelVariances{};
+		std::vector<uint8_t> m_PixelSampleCounts{};		// Samples per pixel in the last adaptive pass
+		std::vector<uint32_t> m_AdaptiveCandidates{};
+
+		void RenderAdaptiveSamples(Scene* pScene, const Matrix& cameraToWorld, const Vector3& cameraOrigin);
+		void EstimateTileVariance(uint32_t tileIndex) const;
+		void SelectAdaptivePixels();
+		void RefineTile(Scene* pScene, uint32_t tileIndex, const Matrix& cameraToWorld, const Vector3& cameraOrigin) const;
+		void ShowTileSampleCounts(uint32_t tileIndex) const;
+
+		// DYNAMIC RESOLUTION
+		// Moving -> trace at a lower resolution so the frame fits in the target frame time, then upscale to the window
+		// ... Still view in progressive mode -> back to full resolution, there is time to accumulate
+		bool m_DynamicResolution{ false };
+		float m_TargetFrameTime{ 1.f / 30.f };
+		float m_ResolutionScale{ 1.f };					// Wanted by the controller, the render resolution snaps to steps
+		float m_LastFrameTime{};
+		bool m_FrameTraced{ false };
+		static constexpr float m_MinResolutionScale{ 0.25f };
+		static constexpr float m_ResolutionScaleStep{ 1.f / 16.f };
+		static constexpr float m_UpscaleEdgeSharpness{ 32.f };	// Higher -> less blending across luminance edges
+
+		std::vector<ColorRGB> m_WindowColors{};		// Output of the upscale, at window resolution
+
+		void SetRenderResolution(int width, int height);
+		bool IsUpscaling() const { return m_Width != m_WindowWidth || m_Height != m_WindowHeight; }
+		void UpscaleRows(uint32_t startRow, uint32_t endRow);
+
+		// DISPLAY
+		// Linear HDR color shown for every pixel at render resolution ( Accumulated average, not clamped )
+		// ... ResolveDisplay turns it into the pixels of the render target once the frame is traced
+		mutable std::vector<ColorRGB> m_DisplayColors{};
+		DisplaySettings m_DisplaySettings{};
+		DisplayMapper m_DisplayMapper{};
+		bool m_DisplayChanged{ false };
+
+		void WriteDisplayColor(uint32_t pixelIdx, const ColorRGB& color) const;
+		void ResolveDisplay();
+
+		// Offset inside the pixel ( 0.5 = center ), the overload without offset uses the sample offset of the frame
+		Vector3 CalculateRayDirection(Scene* pScene, uint32_t px, uint32_t py, const Matrix& cameraToWorld) const;
+		Vector3 CalculateRayDirection(Scene* pScene, uint32_t px, uint32_t py, const Matrix& cameraToWorld, float offsetX, float offsetY) const;
+		ColorRGB ShadePixel(Scene* pScene, const Ray& viewRay, const HitRecord& closestHit, uint64_t seed) const;
+		// Closest hit + shading of one primary ray ( Or its traversal cost in the heatmap mode )
+		ColorRGB TraceViewRay(Scene* pScene, const Ray& viewRay, uint64_t seed) const;
+		// Color of a primary ray hit with the current integrator
+		ColorRGB Integrate(Scene* pScene, const Ray& viewRay, const HitRecord& closestHit, uint64_t seed) const;
+		// Random seed of a pixel sample ( subSampleIdx > 0 -> extra samples of the adaptive pass )
+		uint64_t GetSampleSeed(uint32_t px, uint32_t py, uint32_t subSampleIdx) const;
+
+		// PATH TRACING
+		Integrator m_Integrator{ Integrator::Direct };
+		static constexpr uint32_t m_MaxBounces{ 8 };
+		static constexpr uint32_t m_RouletteStartBounce{ 3 };	// Russian roulette from this bounce on
+
+		ColorRGB TracePath(Scene* pScene, const Ray& viewRay, const HitRecord& closestHit, uint64_t seed) const;
+		// Light arriving directly from the lights and reflected towards the viewer ( Shadow ray per light sample )
+		ColorRGB SampleLights(Scene* pScene, const HitRecord& hit, const Vector3& viewDirection, const Material& material, Random& random) const;
+
+		// LIGHT SAMPLING
+		// Many lights -> every hit shades the directional lights + a fixed number of point lights picked by the light BVH
+		// ... Each pick is weighted by 1 / its probability, so the average is the same as shading all of them
+		LightSampling m_LightSampling{ LightSampling::Auto };
+		static constexpr uint32_t m_LightSampleCount{ 2 };		// Point lights ( Shadow rays ) per hit
+		static constexpr uint32_t m_ManyLightsThreshold{ 16 };	// Auto : light BVH above this many point lights
+
+		bool UseLightBVH(const Scene* pScene) const;
+		// Every light without the light BVH, otherwise the directional lights + m_LightSampleCount picks
+		uint32_t GetLightSampleCount(const Scene* pScene, bool useLightBVH) const;
+		// Light to shade with for sample sampleIdx, and the weight of its contribution, false when nothing can be picked
+		bool GetLightSample(const Scene* pScene, const HitRecord& hit, bool useLightBVH, uint32_t sampleIdx, Random& random,
+			size_t& lightIdx, float& weight) const;
+
+		// WAVEFRONT
+		// The frame in waves of tiles, every stage runs over the whole wave before the next one starts
+		// ... Generate ( Primary rays ) -> extend ( Closest hits ) -> shadow rays -> sort by material -> shade -> resolve
+		// ... Every material shades its lit light samples in contiguous batches ( Dispatched by one switch in MaterialUtils::ShadeBatch per batch, not per light )
+		// ... Direct integrator only, the path tracer and the heatmap keep the tiles
+		bool m_Wavefront{ false };
+		static constexpr uint32_t m_WavefrontSlotCount{ 1 << 14 };	// Light samples per wave ( Queues fit in L2 ), the pixels of a wave follow from it
+		static constexpr uint32_t m_WavefrontTaskSize{ 256 };		// Queue entries per task
+
+		// Batch of the sorted light samples, all with the same material
+		struct ShadeRange
+		{
+			uint32_t start;
+			uint32_t count;
+			unsigned char materialIndex;
+		};
+
+		RayQueue m_RayQueue{};
+		ShadowQueue m_ShadowQueue{};
+		std::vector<uint32_t> m_WaveTileOffsets{};		// First queue entry of every tile in the wave
+		std::vector<uint32_t> m_ShadeOrder{};			// Lit slots, sorted by material
+		std::vector<ShadeRange> m_ShadeRanges{};
+
+		bool UseWavefront() const;
+		void RenderWavefront(Scene* pScene, const Matrix& cameraToWorld, const Vector3& cameraOrigin);
+		// Runs task(first, end) over [0, itemCount) in pieces of m_WavefrontTaskSize
+		void RunChunks(uint32_t itemCount, const std::function<void(uint32_t, uint32_t)>& task) const;
+
+		// Stages, over the primary rays [first, end) of the wave
+		void GeneratePrimaryRays(Scene* pScene, uint32_t tileIndex, uint32_t firstRay, const Matrix& cameraToWorld);
+		void ExtendRays(Scene* pScene, const Vector3& cameraOrigin, uint32_t first, uint32_t end);
+		void GenerateShadowRays(Scene* pScene, uint32_t first, uint32_t end, uint32_t lightSampleCount, bool useLightBVH);
+		void TraceShadowRays(Scene* pScene, uint32_t first, uint32_t end, uint32_t lightSampleCount);
+		void SortByMaterial(uint32_t slotCount, uint32_t lightSampleCount);
+		void ShadeBatch(Scene* pScene, const std::vector<Material>& materials, const ShadeRange& range, uint32_t lightSampleCount);
+		void ResolvePixels(uint32_t first, uint32_t end, uint32_t lightSampleCount) const;
+
+		// SHADING
+		ShadingMode m_ShadingMode;
 
 		// LIGHTING
 		enum class LightingMode
@@ -49,11 +324,16 @@ namespace dae
 			ObservedArea,		// Lambert Cosine Law
 			Radiance,			// Incident Radiance
 			BRDF,				// Scattering of the Light
-			Combined			// ObservedArea * Radiance * BRDF
+			Combined,			// ObservedArea * Radiance * BRDF
+			TraversalCost		// Heatmap of the boxes and primitives every pixel tests, shadow rays included ( RAY_STATISTICS only )
 		};
 
 		LightingMode m_CurrentLightingMode;
 		bool m_ShadowsEnabled;
 
+		// RAY STATISTICS
+		RayCounters m_FrameCounters{};
+		static constexpr float m_HeatmapMaxCost{ 512.f };		// Tests per pixel shown in red, the scale is logarithmic
+
 	};
 }
@@ -0,0 +1,32 @@
+#include "SDLRenderTarget.h"
+
+#include <cassert>
+
+#include "SDL.h"
+#include "SDL_surface.h"
+
+namespace dae
+{
+	SDLRenderTarget::SDLRenderTarget(SDL_Window* pWindow) :
+		m_pWindow{ pWindow },
+		m_pSurface{ SDL_GetWindowSurface(pWindow) }
+	{
+		// The renderer writes whole 32 bit pixels, rows without padding
+		assert(m_pSurface->format->BytesPerPixel == 4 && m_pSurface->pitch == m_pSurface->w * 4);
+
+		m_pPixels = static_cast<uint32_t*>(m_pSurface->pixels);
+		m_Width = m_pSurface->w;
+		m_Height = m_pSurface->h;
+
+		// Same values SDL_MapRGB would give
+		m_RedShift = m_pSurface->format->Rshift;
+		m_GreenShift = m_pSurface->format->Gshift;
+		m_BlueShift = m_pSurface->format->Bshift;
+		m_AlphaMask = m_pSurface->format->Amask;
+	}
+
+	void SDLRenderTarget::Present()
+	{
+		SDL_UpdateWindowSurface(m_pWindow);
+	}
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "RenderTarget.h"
+
+struct SDL_Window;
+struct SDL_Surface;
+
+namespace dae
+{
+	// Renders straight into the surface of an SDL window
+	class SDLRenderTarget final : public RenderTarget
+	{
+	public:
+		explicit SDLRenderTarget(SDL_Window* pWindow);
+		~SDLRenderTarget() override = default;
+
+		void Present() override;
+
+	private:
+		SDL_Window* m_pWindow{};
+		SDL_Surface* m_pSurface{};
+	};
+}
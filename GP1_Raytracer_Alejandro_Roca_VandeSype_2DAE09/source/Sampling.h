@@ -0,0 +1,94 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include "Math.h"
+
+namespace dae
+{
+	// Small and fast random numbers for Monte Carlo sampling ( PCG32, O'Neill )
+	// ... Seeded per pixel and sample, so an image doesn't depend on which thread traced which tile
+	class Random final
+	{
+	public:
+		explicit Random(uint64_t seed)
+		{
+			NextUInt();
+			m_State += seed;
+			NextUInt();
+		}
+
+		uint32_t NextUInt()
+		{
+			const uint64_t oldState{ m_State };
+			m_State = oldState * 6364136223846793005ull + 1442695040888963407ull;
+
+			const uint32_t xorShifted{ static_cast<uint32_t>(((oldState >> 18u) ^ oldState) >> 27u) };
+			const uint32_t rotation{ static_cast<uint32_t>(oldState >> 59u) };
+			return (xorShifted >> rotation) | (xorShifted << ((~rotation + 1u) & 31u));
+		}
+
+		// Uniform in [0, 1)
+		float NextFloat()
+		{
+			// 24 random bits -> every value is exactly representable and 1 is never reached
+			return (NextUInt() >> 8) * (1.f / 16777216.f);
+		}
+
+	private:
+		uint64_t m_State{ 0 };
+	};
+
+	namespace SampleUtils
+	{
+		// Mixes a pixel index and a sample index into one well spread seed
+		inline uint64_t GetSeed(uint32_t pixelIdx, uint32_t sampleIdx)
+		{
+			uint64_t seed{ (static_cast<uint64_t>(sampleIdx) << 32) | pixelIdx };
+			seed ^= seed >> 33;
+			seed *= 0xff51afd7ed558ccdull;
+			seed ^= seed >> 33;
+			return seed;
+		}
+
+		// Tangent and bitangent around a normalized normal ( Duff et al. 2017, no branch on the normal direction )
+		inline void CreateOrthonormalBasis(const Vector3& normal, Vector3& tangent, Vector3& bitangent)
+		{
+			const float sign{ std::copysign(1.f, normal.z) };
+			const float a{ -1.f / (sign + normal.z) };
+			const float b{ normal.x * normal.y * a };
+			tangent = Vector3{ 1.f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x };
+			bitangent = Vector3{ b, sign + normal.y * normal.y * a, -normal.y };
+		}
+
+		// Direction from local coordinates ( z along the normal ) to world space
+		inline Vector3 ToWorld(const Vector3& normal, float x, float y, float z)
+		{
+			Vector3 tangent{}, bitangent{};
+			CreateOrthonormalBasis(normal, tangent, bitangent);
+			return tangent * x + bitangent * y + normal * z;
+		}
+
+		// Cosine weighted hemisphere around the normal ( Importance sampling of a Lambert lobe )
+		inline Vector3 SampleCosineHemisphere(const Vector3& normal, float u1, float u2)
+		{
+			const float radius{ sqrtf(u1) };
+			const float phi{ PI_2 * u2 };
+			return ToWorld(normal, radius * cosf(phi), radius * sinf(phi), sqrtf(std::max(0.f, 1.f - u1)));
+		}
+
+		inline float CosineHemispherePdf(const Vector3& normal, const Vector3& direction)
+		{
+			return std::max(Vector3::Dot(normal, direction), 0.f) / PI;
+		}
+
+		// Every direction of the hemisphere equally likely ( Naive sampling, reference for the convergence )
+		inline Vector3 SampleUniformHemisphere(const Vector3& normal, float u1, float u2)
+		{
+			const float sinTheta{ sqrtf(std::max(0.f, 1.f - u1 * u1)) };
+			const float phi{ PI_2 * u2 };
+			return ToWorld(normal, sinTheta * cosf(phi), sinTheta * sinf(phi), u1);
+		}
+
+		constexpr float UniformHemispherePdf{ 1.f / PI_2 };
+	}
+}
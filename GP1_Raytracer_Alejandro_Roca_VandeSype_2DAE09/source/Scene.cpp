@@ -2,78 +2,300 @@
 #include "Utils.h"
 #include "Material.h"
 
+#include <filesystem>
+#include <random>
+
 namespace dae {
 
 #pragma region Base Scene
 	//Initialize Scene with Default Solid Color Material (RED)
 	Scene::Scene():
-		m_Materials({ new Material_SolidColor({1,0,0})}),
+		m_Materials({ Material::SolidColor({1,0,0}) }),
 		m_UseShadows{ true }
 	{
 		m_SphereGeometries.reserve(32);
 		m_PlaneGeometries.reserve(32);
 		m_TriangleMeshGeometries.reserve(32);
+		m_SphereSets.reserve(32);
 		m_Lights.reserve(32);
 	}
 
-	Scene::~Scene()
-	{
-		for(auto& pMaterial : m_Materials)
+	Scene::~Scene() = default;
+
+	void dae::Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit) const
+	{	
+		// Planes first ( Infinite, not in the top-level BVH )
+		for (const dae::Plane& plane : m_PlaneGeometries)
 		{
-			delete pMaterial;
-			pMaterial = nullptr;
+			GeometryUtils::HitTest_Plane(plane, ray, closestHit);
 		}
 
-		m_Materials.clear();
+		// .... spheres, triangle meshes and sphere sets through the top-level BVH
+		const uint32_t sphereCount{ static_cast<uint32_t>(m_SphereGeometries.size()) };
+		const uint32_t sphereSetOffset{ sphereCount + static_cast<uint32_t>(m_TriangleMeshGeometries.size()) };
+		float closestT{ std::min(ray.max, closestHit.t) };
+
+		GeometryUtils::TraverseBVH(m_TopLevelBVH, ray, closestT, false,
+			[&](uint32_t primitiveIdx, float& closestT)
+			{
+				bool didHit{ false };
+				if (primitiveIdx < sphereCount)
+					didHit = GeometryUtils::HitTest_Sphere(m_SphereGeometries[primitiveIdx], ray, closestHit);
+				else if (primitiveIdx < sphereSetOffset)
+					didHit = GeometryUtils::HitTest_TriangleMesh(m_TriangleMeshGeometries[primitiveIdx - sphereCount], ray, closestHit);
+				else
+					didHit = GeometryUtils::HitTest_SphereSet(m_SphereSets[primitiveIdx - sphereSetOffset], ray, closestHit);
+
+				closestT = std::min(closestT, closestHit.t);
+				return didHit;
+			});
 	}
 
-	void dae::Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit) const
-	{	
-		// Iterate over all spheres from the scene
-		for (const dae::Sphere& sphere : m_SphereGeometries)
+	void Scene::GetClosestHits(const RayPacket& packet, HitRecord* closestHits) const
+	{
+#ifdef PACKET_TRACING
+		// Planes first ( Infinite, not in the top-level BVH )
+		for (int rayIdx{ 0 }; rayIdx < packet.rayCount; ++rayIdx)
 		{
-			GeometryUtils::HitTest_Sphere(sphere, ray, closestHit);
+			const Ray ray{ packet.GetRay(rayIdx) };
+			for (const dae::Plane& plane : m_PlaneGeometries)
+			{
+				GeometryUtils::HitTest_Plane(plane, ray, closestHits[rayIdx]);
+			}
 		}
 
-		// ..... all planes
-		for (const dae::Plane& plane : m_PlaneGeometries)
+		// .... the top-level BVH is only culled with the packet frustum ( A handful of objects )
+		const std::vector<BVHNode>& nodes{ m_TopLevelBVH.GetNodes() };
+		if (nodes.empty())
+			return;
+
+		const std::vector<uint32_t>& primitiveIndices{ m_TopLevelBVH.GetPrimitiveIndices() };
+		const uint32_t sphereCount{ static_cast<uint32_t>(m_SphereGeometries.size()) };
+		const uint32_t sphereSetOffset{ sphereCount + static_cast<uint32_t>(m_TriangleMeshGeometries.size()) };
+
+		// Both children are pushed -> one more than the depth
+		uint32_t stack[BVH::MaxDepth + 1]{};
+		int stackSize{ 0 };
+		stack[stackSize++] = 0;
+		while (stackSize > 0)
 		{
-			GeometryUtils::HitTest_Plane(plane, ray, closestHit);
+			const BVHNode& node{ nodes[stack[--stackSize]] };
+			if (!GeometryUtils::IsBoxInFrustum(node.minAABB, node.maxAABB, packet.origin, packet.frustumNormals))
+				continue;
+
+			if (!node.IsLeaf())
+			{
+				// Closest child on top of the stack, so closer objects shrink the rays first
+				uint32_t nearIdx{ node.leftFirst };
+				uint32_t farIdx{ node.leftFirst + 1 };
+				const Vector3 toNear{ AABB{ nodes[nearIdx].minAABB, nodes[nearIdx].maxAABB }.Centroid() - packet.origin };
+				const Vector3 toFar{ AABB{ nodes[farIdx].minAABB, nodes[farIdx].maxAABB }.Centroid() - packet.origin };
+				if (toFar.SqrMagnitude() < toNear.SqrMagnitude())
+					std::swap(nearIdx, farIdx);
+
+				stack[stackSize++] = farIdx;
+				stack[stackSize++] = nearIdx;
+				continue;
+			}
+
+			for (uint32_t leafIdx{ 0 }; leafIdx < node.primitiveCount; ++leafIdx)
+			{
+				const uint32_t primitiveIdx{ primitiveIndices[node.leftFirst + leafIdx] };
+				if (primitiveIdx >= sphereCount && primitiveIdx < sphereSetOffset)
+				{
+					GeometryUtils::HitTest_TriangleMesh(m_TriangleMeshGeometries[primitiveIdx - sphereCount], packet, closestHits);
+					continue;
+				}
+
+				// Spheres and sphere sets : one ray at a time
+				for (int rayIdx{ 0 }; rayIdx < packet.rayCount; ++rayIdx)
+				{
+					if (primitiveIdx < sphereCount)
+						GeometryUtils::HitTest_Sphere(m_SphereGeometries[primitiveIdx], packet.GetRay(rayIdx), closestHits[rayIdx]);
+					else
+						GeometryUtils::HitTest_SphereSet(m_SphereSets[primitiveIdx - sphereSetOffset], packet.GetRay(rayIdx), closestHits[rayIdx]);
+				}
+			}
 		}
-
-		// .... all triangles meshes
-		for (const dae::TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
+#else
+		// No SIMD packets -> one ray at a time
+		for (int rayIdx{ 0 }; rayIdx < packet.rayCount; ++rayIdx)
 		{
-			GeometryUtils::HitTest_TriangleMesh(triangleMesh, ray, closestHit);
+			GetClosestHit(packet.GetRay(rayIdx), closestHits[rayIdx]);
 		}
-
+#endif
 	}
 
 	// Returns true on the first hit for the given ray. False otherwise
 	bool Scene::DoesHit(const Ray& ray) const
 	{
-		// Iterate over all spheres from the scene
-		for (const dae::Sphere& sphere : m_SphereGeometries)
+		Occluder occluder{};
+		return FindOccluder(ray, occluder);
+	}
+
+	bool Scene::IsOccluded(const Ray& ray, size_t lightIdx) const
+	{
+		// One cache per thread ( No locking needed ) and per light ( Every light has its own blockers )
+		// ... Shared by all scenes : a stale entry is just a miss, every index is checked before use
+		thread_local std::vector<Occluder> occluderCache{};
+		if (lightIdx >= occluderCache.size())
+			occluderCache.resize(std::max(lightIdx + 1, m_Lights.size()));
+
+		Occluder& cachedOccluder{ occluderCache[lightIdx] };
+		if (IsOccludedBy(cachedOccluder, ray))
+			return true;
+
+		// A miss keeps the old occluder, the next pixel may be behind it again
+		Occluder occluder{};
+		if (!FindOccluder(ray, occluder))
+			return false;
+
+		cachedOccluder = occluder;
+		return true;
+	}
+
+	bool Scene::IsOccludedBy(const Occluder& occluder, const Ray& ray) const
+	{
+		switch (occluder.type)
 		{
-			if (GeometryUtils::HitTest_Sphere(sphere, ray))
-				return true;
+		case Occluder::Type::Plane:
+			return occluder.objectIdx < m_PlaneGeometries.size()
+				&& GeometryUtils::HitTest_Plane(m_PlaneGeometries[occluder.objectIdx], ray);
+		case Occluder::Type::Sphere:
+			return occluder.objectIdx < m_SphereGeometries.size()
+				&& GeometryUtils::HitTest_Sphere(m_SphereGeometries[occluder.objectIdx], ray);
+		case Occluder::Type::Triangle:
+		{
+			if (occluder.objectIdx >= m_TriangleMeshGeometries.size())
+				return false;
+
+			const TriangleMesh& mesh{ m_TriangleMeshGeometries[occluder.objectIdx] };
+			return GeometryUtils::Occluded_MeshTriangle(mesh, occluder.elementIdx, GeometryUtils::ToObjectSpace(mesh, ray));
+		}
+		case Occluder::Type::SetSphere:
+			return occluder.objectIdx < m_SphereSets.size()
+				&& GeometryUtils::Occluded_SetSphere(m_SphereSets[occluder.objectIdx], occluder.elementIdx, ray);
+		default:
+			return false;
 		}
+	}
 
+	bool Scene::FindOccluder(const Ray& ray, Occluder& occluder) const
+	{
 		// ..... all planes
-		for (const dae::Plane& plane : m_PlaneGeometries)
+		for (uint32_t planeIdx{ 0 }; planeIdx < m_PlaneGeometries.size(); ++planeIdx)
 		{
-			if (GeometryUtils::HitTest_Plane(plane, ray))
+			if (GeometryUtils::HitTest_Plane(m_PlaneGeometries[planeIdx], ray))
+			{
+				occluder = { Occluder::Type::Plane, planeIdx };
 				return true;
+			}
 		}
 
-		//.... all triangles meshes
-		for (const dae::TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
-		{
-			if (GeometryUtils::HitTest_TriangleMesh(triangleMesh, ray))
+		// .... spheres, triangle meshes and sphere sets through the top-level BVH ( Stops at the first hit )
+		const uint32_t sphereCount{ static_cast<uint32_t>(m_SphereGeometries.size()) };
+		const uint32_t sphereSetOffset{ sphereCount + static_cast<uint32_t>(m_TriangleMeshGeometries.size()) };
+		float maxT{ ray.max };
+
+		return GeometryUtils::TraverseBVH(m_TopLevelBVH, ray, maxT, true,
+			[&](uint32_t primitiveIdx, float&)
+			{
+				if (primitiveIdx < sphereCount)
+				{
+					if (!GeometryUtils::HitTest_Sphere(m_SphereGeometries[primitiveIdx], ray))
+						return false;
+
+					occluder = { Occluder::Type::Sphere, primitiveIdx };
+					return true;
+				}
+
+				if (primitiveIdx >= sphereSetOffset)
+				{
+					const uint32_t sphereSetIdx{ primitiveIdx - sphereSetOffset };
+					uint32_t sphereIdx{};
+					if (!GeometryUtils::Occluded_SphereSet(m_SphereSets[sphereSetIdx], ray, sphereIdx))
+						return false;
+
+					occluder = { Occluder::Type::SetSphere, sphereSetIdx, sphereIdx };
+					return true;
+				}
+
+				const uint32_t meshIdx{ primitiveIdx - sphereCount };
+				const TriangleMesh& mesh{ m_TriangleMeshGeometries[meshIdx] };
+				uint32_t triangleIdx{};
+				if (!GeometryUtils::Occluded_TriangleMesh(mesh, GeometryUtils::ToObjectSpace(mesh, ray), triangleIdx))
+					return false;
+
+				occluder = { Occluder::Type::Triangle, meshIdx, triangleIdx };
 				return true;
+			});
+	}
+
+	bool Scene::UpdateAccelerationStructure()
+	{
+		// Lights were added -> new light hierarchy ( The lights never move )
+		const bool lightsChanged{ m_LightsNeedRebuild };
+		if (m_LightsNeedRebuild)
+		{
+			m_LightBVH.Build(m_Lights);
+			m_LightsNeedRebuild = false;
 		}
 
-		return false;
+		// Did any mesh move since the last frame ?
+		bool hasMoved{ false };
+		for (TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
+		{
+			hasMoved |= triangleMesh.transformChanged;
+			triangleMesh.transformChanged = false;
+		}
+
+		for (SphereSet& sphereSet : m_SphereSets)
+		{
+			hasMoved |= sphereSet.boundsChanged;
+			sphereSet.boundsChanged = false;
+		}
+
+		if (!hasMoved && !m_TopLevelNeedsRebuild)
+			return lightsChanged;		// Nothing changed -> keep the current structure
+
+		UpdateTopLevelBounds();
+
+		if (m_TopLevelNeedsRebuild)
+		{
+			// Primitives were added -> full build
+			m_TopLevelBVH.Build(m_TopLevelBounds);
+			m_TopLevelNeedsRebuild = false;
+		}
+		else
+		{
+			// Same primitives, they only moved -> refit, unless the tree degraded too much
+			m_TopLevelBVH.RefitOrRebuild(m_TopLevelBounds);
+		}
+
+		return true;
+	}
+
+	void Scene::UpdateTopLevelBounds()
+	{
+		m_TopLevelBounds.clear();
+		m_TopLevelBounds.reserve(m_SphereGeometries.size() + m_TriangleMeshGeometries.size() + m_SphereSets.size());
+
+		for (const Sphere& sphere : m_SphereGeometries)
+		{
+			const Vector3 radius{ sphere.radius, sphere.radius, sphere.radius };
+			m_TopLevelBounds.push_back({ sphere.origin - radius, sphere.origin + radius });
+		}
+
+		for (const TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
+		{
+			// World AABB of the instance ( Object-space root box, transformed )
+			m_TopLevelBounds.push_back({ triangleMesh.transformedMinAABB, triangleMesh.transformedMaxAABB });
+		}
+
+		for (const SphereSet& sphereSet : m_SphereSets)
+		{
+			m_TopLevelBounds.push_back({ sphereSet.minAABB, sphereSet.maxAABB });
+		}
 	}
 
 	// Enable / Disable Shadows
@@ -96,6 +318,7 @@ namespace dae {
 		s.materialIndex = materialIndex;
 
 		m_SphereGeometries.emplace_back(s);
+		m_TopLevelNeedsRebuild = true;
 		return &m_SphereGeometries.back();
 	}
 
@@ -117,9 +340,27 @@ namespace dae {
 		m.materialIndex = materialIndex;
 
 		m_TriangleMeshGeometries.emplace_back(m);
+		m_TopLevelNeedsRebuild = true;
 		return &m_TriangleMeshGeometries.back();
 	}
 
+	TriangleMesh* Scene::AddTriangleMesh(const std::shared_ptr<MeshGeometry>& pGeometry, TriangleCullMode cullMode, unsigned char materialIndex)
+	{
+		TriangleMesh m{ pGeometry, cullMode };
+		m.materialIndex = materialIndex;
+
+		m_TriangleMeshGeometries.emplace_back(m);
+		m_TopLevelNeedsRebuild = true;
+		return &m_TriangleMeshGeometries.back();
+	}
+
+	SphereSet* Scene::AddSphereSet()
+	{
+		m_SphereSets.emplace_back();
+		m_TopLevelNeedsRebuild = true;
+		return &m_SphereSets.back();
+	}
+
 	Light* Scene::AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color)
 	{
 		Light l;
@@ -129,6 +370,7 @@ namespace dae {
 		l.type = LightType::Point;
 
 		m_Lights.emplace_back(l);
+		m_LightsNeedRebuild = true;
 		return &m_Lights.back();
 	}
 
@@ -141,12 +383,13 @@ namespace dae {
 		l.type = LightType::Directional;
 
 		m_Lights.emplace_back(l);
+		m_LightsNeedRebuild = true;
 		return &m_Lights.back();
 	}
 
-	unsigned char Scene::AddMaterial(Material* pMaterial)
+	unsigned char Scene::AddMaterial(const Material& material)
 	{
-		m_Materials.push_back(pMaterial);
+		m_Materials.push_back(material);
 		return static_cast<unsigned char>(m_Materials.size() - 1);
 	}
 #pragma endregion
@@ -157,11 +400,11 @@ namespace dae {
 	{
 				//default: Material id0 >> SolidColor Material (RED)
 		constexpr unsigned char matId_Solid_Red = 0;
-		const unsigned char matId_Solid_Blue = AddMaterial(new Material_SolidColor{ colors::Blue });
+		const unsigned char matId_Solid_Blue = AddMaterial(Material::SolidColor(colors::Blue));
 
-		const unsigned char matId_Solid_Yellow = AddMaterial(new Material_SolidColor{ colors::Yellow });
-		const unsigned char matId_Solid_Green = AddMaterial(new Material_SolidColor{ colors::Green });
-		const unsigned char matId_Solid_Magenta = AddMaterial(new Material_SolidColor{ colors::Magenta });
+		const unsigned char matId_Solid_Yellow = AddMaterial(Material::SolidColor(colors::Yellow));
+		const unsigned char matId_Solid_Green = AddMaterial(Material::SolidColor(colors::Green));
+		const unsigned char matId_Solid_Magenta = AddMaterial(Material::SolidColor(colors::Magenta));
 
 		//Spheres
 		AddSphere({ -25.f, 0.f, 100.f }, 50.f, matId_Solid_Red);
@@ -182,14 +425,14 @@ namespace dae {
 	void Scene_W2::Initialize()
 	{
 		m_Camera.origin = { 0.f, 3.f, -9.f };
-		m_Camera.fovAngle = 45.f;
+		m_Camera.UpdateFovAngle(45.f);
 
 		constexpr unsigned char matId_Solid_Red = 0;
 
-		const unsigned char matId_Solid_Blue = AddMaterial(new Material_SolidColor{ colors::Blue });
-		const unsigned char matId_Solid_Yellow = AddMaterial(new Material_SolidColor{ colors::Yellow });
-		const unsigned char matId_Solid_Green = AddMaterial(new Material_SolidColor{ colors::Green });
-		const unsigned char matId_Solid_Magenta = AddMaterial(new Material_SolidColor{ colors::Magenta });
+		const unsigned char matId_Solid_Blue = AddMaterial(Material::SolidColor(colors::Blue));
+		const unsigned char matId_Solid_Yellow = AddMaterial(Material::SolidColor(colors::Yellow));
+		const unsigned char matId_Solid_Green = AddMaterial(Material::SolidColor(colors::Green));
+		const unsigned char matId_Solid_Magenta = AddMaterial(Material::SolidColor(colors::Magenta));
 
 		// planes
 		AddPlane(Vector3{ 0.f, 0.f, 10.f }, Vector3{ 0.f, 0.f, -1.f }, matId_Solid_Magenta); //BACK
@@ -217,10 +460,10 @@ namespace dae {
 			//m_Camera.fovAngle = 45.f;
 
 			////default: Material id0 >> SolidColor Material (RED)
-			//const unsigned char matId_Lambert_Red = AddMaterial(new Material_Lambert{ colors::Red, 1.f });
-			//const unsigned char matId_Lambert_Blue = AddMaterial(new Material_Lambert{ colors::Blue, 1.f });
-			//const unsigned char matId_Lambert_Yellow = AddMaterial(new Material_Lambert{ colors::Yellow, 1.f });
-			//const auto matLambertPhong_Blue = AddMaterial(new Material_LambertPhong(colors::Blue, 1.f, 1.f, 60.f));
+			//const unsigned char matId_Lambert_Red = AddMaterial(Material::Lambert(colors::Red, 1.f));
+			//const unsigned char matId_Lambert_Blue = AddMaterial(Material::Lambert(colors::Blue, 1.f));
+			//const unsigned char matId_Lambert_Yellow = AddMaterial(Material::Lambert(colors::Yellow, 1.f));
+			//const auto matLambertPhong_Blue = AddMaterial(Material::LambertPhong(colors::Blue, 1.f, 1.f, 60.f));
 			//
 
 			////Spheres
@@ -237,23 +480,23 @@ namespace dae {
 
 		sceneName = "Week 3";
 		m_Camera.origin = { 0,3,-9 };
-		m_Camera.fovAngle = 45.f;
+		m_Camera.UpdateFovAngle(45.f);
 
-		const auto matCT_GrayRoughMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, 1.f));
-		const auto matCT_GrayMediumMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .6f));
-		const auto matCT_GraySmoothMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .1f));
-		const auto matCT_GrayRoughPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, 1.f));
-		const auto matCT_GrayMediumPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, .6f));
-		const auto matCT_GraySmoothPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, .1f));
+		const auto matCT_GrayRoughMetal = AddMaterial(Material::CookTorrence({ .972f, .960f, .915f }, 1.f, 1.f));
+		const auto matCT_GrayMediumMetal = AddMaterial(Material::CookTorrence({ .972f, .960f, .915f }, 1.f, .6f));
+		const auto matCT_GraySmoothMetal = AddMaterial(Material::CookTorrence({ .972f, .960f, .915f }, 1.f, .1f));
+		const auto matCT_GrayRoughPlastic = AddMaterial(Material::CookTorrence({ .75f, .75f, .75f }, .0f, 1.f));
+		const auto matCT_GrayMediumPlastic = AddMaterial(Material::CookTorrence({ .75f, .75f, .75f }, .0f, .6f));
+		const auto matCT_GraySmoothPlastic = AddMaterial(Material::CookTorrence({ .75f, .75f, .75f }, .0f, .1f));
 
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, 0.57f, 0.57f }, 1.f));
-		const auto matLambert_White = AddMaterial(new Material_Lambert(colors::White, 1.f));
+		const auto matLambert_GrayBlue = AddMaterial(Material::Lambert({ .49f, 0.57f, 0.57f }, 1.f));
+		const auto matLambert_White = AddMaterial(Material::Lambert(colors::White, 1.f));
 
 
 		//// Temporary Lambert-Phong Spheres & Materials 
-		//const auto matLambertPhong1 = AddMaterial(new Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 3.f));
-		//const auto matLambertPhong2 = AddMaterial(new Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 15.f));
-		//const auto matLambertPhong3 = AddMaterial(new Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 50.f));
+		//const auto matLambertPhong1 = AddMaterial(Material::LambertPhong(colors::Blue, 0.5f, 0.5f, 3.f));
+		//const auto matLambertPhong2 = AddMaterial(Material::LambertPhong(colors::Blue, 0.5f, 0.5f, 15.f));
+		//const auto matLambertPhong3 = AddMaterial(Material::LambertPhong(colors::Blue, 0.5f, 0.5f, 50.f));
 		//AddSphere(Vector3{ -1.75f, 1.f, 0.f }, .75f, matLambertPhong1);
 		//AddSphere(Vector3{ 0.f, 1.f, 0.f }, .75f, matLambertPhong2);
 		//AddSphere(Vector3{ 1.75f, 1.f, 0.f }, .75f, matLambertPhong3);
@@ -283,12 +526,12 @@ namespace dae {
 	void Scene_W4_TestScene::Initialize()
 	{
 		m_Camera.origin = { 0.f,1.f,-5.f };
-		m_Camera.fovAngle = 45.f;
+		m_Camera.UpdateFovAngle(45.f);
 	
 
 		//Materials
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, 0.57f, 0.57f }, 1.f));
-		const auto matLambert_White = AddMaterial(new Material_Lambert(colors::White, 1.f));
+		const auto matLambert_GrayBlue = AddMaterial(Material::Lambert({ .49f, 0.57f, 0.57f }, 1.f));
+		const auto matLambert_White = AddMaterial(Material::Lambert(colors::White, 1.f));
 
 		//Planes
 		AddPlane(Vector3{ 0.f, 0.f, 10.f }, Vector3{ 0.f, 0.f, -1.f }, matLambert_GrayBlue); //BACK
@@ -308,18 +551,19 @@ namespace dae {
 		//Triangle Mesh
 		//=============
 		pMesh = AddTriangleMesh(TriangleCullMode::NoCulling, matLambert_White);
-		pMesh->positions = {
+		pMesh->pGeometry->positions = {
 			{-.75f,-1.f,.0f},  //V0
 			{-.75f,1.f, .0f},  //V2
 			{.75f,1.f,1.f},    //V3
 			{.75f,-1.f,0.f} }; //V4
 
-		pMesh->indices = {
+		pMesh->pGeometry->indices = {
 			0,1,2, //Triangle 1
 			0,2,3  //Triangle 2
 		};
 
-		pMesh->CalculateNormals();
+		pMesh->pGeometry->CalculateNormals();
+		pMesh->pGeometry->UpdateBVH();
 
 		pMesh->Translate({ 0.f,1.5f,0.f });
 		pMesh->RotateY(45);
@@ -370,15 +614,15 @@ namespace dae {
 		m_Camera.UpdateFovAngle(45.f);
 		//m_Camera.fovAngle = 45.f;
 
-		const auto matCT_GrayRoughMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, 1.f));
-		const auto matCT_GrayMediumMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .6f));
-		const auto matCT_GraySmoothMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .1f));
-		const auto matCT_GrayRoughPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, 1.f));
-		const auto matCT_GrayMediumPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, .6f));
-		const auto matCT_GraySmoothPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, .1f));
+		const auto matCT_GrayRoughMetal = AddMaterial(Material::CookTorrence({ .972f, .960f, .915f }, 1.f, 1.f));
+		const auto matCT_GrayMediumMetal = AddMaterial(Material::CookTorrence({ .972f, .960f, .915f }, 1.f, .6f));
+		const auto matCT_GraySmoothMetal = AddMaterial(Material::CookTorrence({ .972f, .960f, .915f }, 1.f, .1f));
+		const auto matCT_GrayRoughPlastic = AddMaterial(Material::CookTorrence({ .75f, .75f, .75f }, .0f, 1.f));
+		const auto matCT_GrayMediumPlastic = AddMaterial(Material::CookTorrence({ .75f, .75f, .75f }, .0f, .6f));
+		const auto matCT_GraySmoothPlastic = AddMaterial(Material::CookTorrence({ .75f, .75f, .75f }, .0f, .1f));
 
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, 0.57f, 0.57f }, 1.f));
-		const auto matLambert_White = AddMaterial(new Material_Lambert(colors::White, 1.f));
+		const auto matLambert_GrayBlue = AddMaterial(Material::Lambert({ .49f, 0.57f, 0.57f }, 1.f));
+		const auto matLambert_White = AddMaterial(Material::Lambert(colors::White, 1.f));
 
 		AddPlane(Vector3{ 0.f, 0.f, 10.f }, Vector3{ 0.f, 0.f, -1.f }, matLambert_GrayBlue); //BACK
 		AddPlane(Vector3{ 0.f, 0.f, 0.f }, Vector3{ 0.f, 1.f, 0.f }, matLambert_GrayBlue); //BOTTOM
@@ -396,22 +640,21 @@ namespace dae {
 		//CW Winding Order!
 		const Triangle baseTriangle = { Vector3(-.75f, 1.5f, 0.f), Vector3(.75f, 0.f, 0.f), Vector3(-.75f, 0.f, 0.f) };
 
-		m_Meshes[0] = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
-		m_Meshes[0]->AppendTriangle(baseTriangle, true);
+		// One geometry, three instances ( Only the transform and cull mode differ )
+		const auto pTriangleGeometry{ std::make_shared<MeshGeometry>() };
+		pTriangleGeometry->AppendTriangle(baseTriangle);
+		pTriangleGeometry->UpdateBVH();
+
+		m_Meshes[0] = AddTriangleMesh(pTriangleGeometry, TriangleCullMode::BackFaceCulling, matLambert_White);
 		m_Meshes[0]->Translate({ -1.75f,4.5f,0.f });
-		m_Meshes[0]->UpdateAABB();
 		m_Meshes[0]->UpdateTransforms();
 
-		m_Meshes[1] = AddTriangleMesh(TriangleCullMode::FrontFaceCulling, matLambert_White);
-		m_Meshes[1]->AppendTriangle(baseTriangle, true);
+		m_Meshes[1] = AddTriangleMesh(pTriangleGeometry, TriangleCullMode::FrontFaceCulling, matLambert_White);
 		m_Meshes[1]->Translate({ 0.f,4.5f,0.f });
-		m_Meshes[1]->UpdateAABB();
 		m_Meshes[1]->UpdateTransforms();
 
-		m_Meshes[2] = AddTriangleMesh(TriangleCullMode::NoCulling, matLambert_White);
-		m_Meshes[2]->AppendTriangle(baseTriangle, true);
+		m_Meshes[2] = AddTriangleMesh(pTriangleGeometry, TriangleCullMode::NoCulling, matLambert_White);
 		m_Meshes[2]->Translate({ 1.75f,4.5f,0.f });
-		m_Meshes[2]->UpdateAABB();
 		m_Meshes[2]->UpdateTransforms();
 
 		AddPointLight(Vector3{ 0.f, 5.f, 5.f }, 50.f, ColorRGB{ 1.f, .61f, .45f }); //Backlight
@@ -427,7 +670,6 @@ namespace dae {
 		for (const auto m : m_Meshes)
 		{
 			m->RotateY(m_YawAngle);
-			m->UpdateAABB();
 			m->UpdateTransforms();
 		}
 	}
@@ -444,15 +686,15 @@ namespace dae {
 		m_Camera.UpdateFovAngle(45.f);
 		//m_Camera.fovAngle = 45.f;
 
-		const auto matCT_GrayRoughMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, 1.f));
-		const auto matCT_GrayMediumMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .6f));
-		const auto matCT_GraySmoothMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .1f));
-		const auto matCT_GrayRoughPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, 1.f));
-		const auto matCT_GrayMediumPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, .6f));
-		const auto matCT_GraySmoothPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, .1f));
+		const auto matCT_GrayRoughMetal = AddMaterial(Material::CookTorrence({ .972f, .960f, .915f }, 1.f, 1.f));
+		const auto matCT_GrayMediumMetal = AddMaterial(Material::CookTorrence({ .972f, .960f, .915f }, 1.f, .6f));
+		const auto matCT_GraySmoothMetal = AddMaterial(Material::CookTorrence({ .972f, .960f, .915f }, 1.f, .1f));
+		const auto matCT_GrayRoughPlastic = AddMaterial(Material::CookTorrence({ .75f, .75f, .75f }, .0f, 1.f));
+		const auto matCT_GrayMediumPlastic = AddMaterial(Material::CookTorrence({ .75f, .75f, .75f }, .0f, .6f));
+		const auto matCT_GraySmoothPlastic = AddMaterial(Material::CookTorrence({ .75f, .75f, .75f }, .0f, .1f));
 
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, 0.57f, 0.57f }, 1.f));
-		const auto matLambert_White = AddMaterial(new Material_Lambert(colors::White, 1.f));
+		const auto matLambert_GrayBlue = AddMaterial(Material::Lambert({ .49f, 0.57f, 0.57f }, 1.f));
+		const auto matLambert_White = AddMaterial(Material::Lambert(colors::White, 1.f));
 
 		AddPlane(Vector3{ 0.f, 0.f, 10.f }, Vector3{ 0.f, 0.f, -1.f }, matLambert_GrayBlue); //BACK
 		AddPlane(Vector3{ 0.f, 0.f, 0.f }, Vector3{ 0.f, 1.f, 0.f }, matLambert_GrayBlue); //BOTTOM
@@ -464,14 +706,16 @@ namespace dae {
 		m_pBunnyMesh = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
 
 		// Parse the object file containing the bunny
-		Utils::ParseOBJ("Resources/lowpoly_bunny.obj", m_pBunnyMesh->positions, m_pBunnyMesh->normals, m_pBunnyMesh->indices);
+		MeshGeometry& bunnyGeometry{ *m_pBunnyMesh->pGeometry };
+		Utils::ParseOBJ("Resources/lowpoly_bunny.obj", bunnyGeometry.positions, bunnyGeometry.normals, bunnyGeometry.indices);
 
 		m_pBunnyMesh->Scale({ 2.f, 2.f, 2.f });
 		//m_pBunnyMesh->Translate({ 0.f, 1.f, 0.f });
 
 		// No need to calculate normals, already calculated in the obj file
 
-		m_pBunnyMesh->UpdateAABB();
+		// Object-space BVH, built once -> rotating the bunny only updates its matrices
+		bunnyGeometry.UpdateBVH();
 		m_pBunnyMesh->UpdateTransforms();
 
 		AddPointLight(Vector3{ 0.f, 5.f, 5.f }, 50.f, ColorRGB{ 1.f, .61f, .45f }); //Backlight
@@ -485,10 +729,183 @@ namespace dae {
 
 		const auto yawAngle = (cos(pTimer->GetTotal() + 1.f) / 2.f * PI_2);	
 		m_pBunnyMesh->RotateY(yawAngle);
-		m_pBunnyMesh->UpdateAABB();
 		m_pBunnyMesh->UpdateTransforms();
 		
 	}
 
 #pragma endregion
+
+#pragma region SCENE_PARTICLESCENE
+	void Scene_ParticleScene::Initialize()
+	{
+		sceneName = "Particle Scene";
+		m_Camera.origin = { 0.f, 3.f, -12.f };
+		m_Camera.UpdateFovAngle(45.f);
+
+		const auto matLambert_GrayBlue = AddMaterial(Material::Lambert({ .49f, 0.57f, 0.57f }, 1.f));
+		const unsigned char matParticles[]
+		{
+			AddMaterial(Material::LambertPhong(colors::Red, 1.f, 1.f, 60.f)),
+			AddMaterial(Material::LambertPhong(colors::Blue, 1.f, 1.f, 60.f)),
+			AddMaterial(Material::CookTorrence({ .972f, .960f, .915f }, 1.f, .3f)),
+			AddMaterial(Material::CookTorrence({ .75f, .75f, .75f }, .0f, .6f))
+		};
+
+		AddPlane(Vector3{ 0.f, 0.f, 0.f }, Vector3{ 0.f, 1.f, 0.f }, matLambert_GrayBlue); //BOTTOM
+
+		// Spheres spread inside a ball above the floor ( Fixed seed -> same scene every run )
+		SphereSet* pParticles{ AddSphereSet() };
+		pParticles->Reserve(ParticleCount);
+
+		std::mt19937 generator{ 2023 };
+		std::uniform_real_distribution<float> unitDistribution{ -1.f, 1.f };
+		std::uniform_real_distribution<float> radiusDistribution{ .01f, .03f };
+		std::uniform_int_distribution<int> materialDistribution{ 0, static_cast<int>(std::size(matParticles)) - 1 };
+
+		const Vector3 cloudCenter{ 0.f, 4.f, 0.f };
+		const float cloudRadius{ 3.5f };
+		while (pParticles->GetSphereCount() < ParticleCount)
+		{
+			const Vector3 offset{ unitDistribution(generator), unitDistribution(generator), unitDistribution(generator) };
+			if (offset.SqrMagnitude() > 1.f)
+				continue;	// Outside the unit ball -> try again
+
+			pParticles->AddSphere(cloudCenter + offset * cloudRadius, radiusDistribution(generator),
+				matParticles[materialDistribution(generator)]);
+		}
+
+		pParticles->UpdateBVH();
+
+		AddPointLight(Vector3{ 0.f, 12.f, -6.f }, 150.f, ColorRGB{ 1.f, .8f, .45f });
+		AddPointLight(Vector3{ -6.f, 4.f, -4.f }, 50.f, ColorRGB{ .34f, .47f, .68f });
+	}
+#pragma endregion
+
+#pragma region SCENE_MANYLIGHTS
+	void Scene_ManyLights::Initialize()
+	{
+		sceneName = "Many Lights Scene";
+		m_Camera.origin = { 0,3,-9 };
+		m_Camera.UpdateFovAngle(45.f);
+
+		const auto matCT_GrayMediumMetal = AddMaterial(Material::CookTorrence({ .972f, .960f, .915f }, 1.f, .6f));
+		const auto matCT_GrayRoughPlastic = AddMaterial(Material::CookTorrence({ .75f, .75f, .75f }, .0f, 1.f));
+		const auto matCT_GraySmoothPlastic = AddMaterial(Material::CookTorrence({ .75f, .75f, .75f }, .0f, .1f));
+		const auto matLambert_GrayBlue = AddMaterial(Material::Lambert({ .49f, 0.57f, 0.57f }, 1.f));
+
+		AddPlane(Vector3{ 0.f, 0.f, 10.f }, Vector3{ 0.f, 0.f, -1.f }, matLambert_GrayBlue); //BACK
+		AddPlane(Vector3{ 0.f, 0.f, 0.f }, Vector3{ 0.f, 1.f, 0.f }, matLambert_GrayBlue); //BOTTOM
+		AddPlane(Vector3{ 0.f, 10.f, 0.f }, Vector3{ 0.f, -1.f, 0.f }, matLambert_GrayBlue); //TOP
+		AddPlane(Vector3{ 5.f, 0.f, 0.f }, Vector3{ -1.f, 0.f, 0.f }, matLambert_GrayBlue); //RIGHT
+		AddPlane(Vector3{ -5.f, 0.f, 0.f }, Vector3{ 1.f, 0.f, 0.f }, matLambert_GrayBlue); //LEFT
+
+		AddSphere(Vector3{ -1.75f, 1.f, 0.f }, .75f, matCT_GrayMediumMetal);
+		AddSphere(Vector3{ 0.f, 1.f, 0.f }, .75f, matCT_GrayRoughPlastic);
+		AddSphere(Vector3{ 1.75f, 1.f, 0.f }, .75f, matCT_GraySmoothPlastic);
+
+		// Weak lights spread through the room, most of them only matter for the surfaces right next to them
+		// ( Fixed seed -> same scene every run )
+		std::mt19937 generator{ 2023 };
+		std::uniform_real_distribution<float> xDistribution{ -4.8f, 4.8f };
+		std::uniform_real_distribution<float> yDistribution{ .2f, 9.8f };
+		std::uniform_real_distribution<float> zDistribution{ -2.f, 9.8f };
+		std::uniform_real_distribution<float> unitDistribution{ 0.f, 1.f };
+
+		for (uint32_t lightIdx{ 0 }; lightIdx < LightCount; ++lightIdx)
+		{
+			const Vector3 origin{ xDistribution(generator), yDistribution(generator), zDistribution(generator) };
+			const ColorRGB color{ .3f + .7f * unitDistribution(generator), .3f + .7f * unitDistribution(generator), .3f + .7f * unitDistribution(generator) };
+			AddPointLight(origin, .1f + .3f * unitDistribution(generator), color);
+		}
+	}
+#pragma endregion
+
+#pragma region SCENE_FILE
+	Scene_File::Scene_File(SceneDescription&& description) :
+		m_Description{ std::move(description) }
+	{
+	}
+
+	void Scene_File::Initialize()
+	{
+		sceneName = m_Description.name;
+		m_Camera.origin = m_Description.cameraOrigin;
+		// Not UpdateFovAngle : it skips an angle equal to the default 90, and fov starts at 0 ( Every ray would be the same )
+		m_Camera.fovAngle = m_Description.cameraFovAngle;
+		m_Camera.fov = tanf(m_Description.cameraFovAngle * TO_RADIANS / 2.f);
+
+		// Material 0 of the file is the default red as well -> indices stay the same
+		m_Materials = m_Description.materials;
+
+		for (const Plane& plane : m_Description.planes)
+			AddPlane(plane.origin, plane.normal, plane.materialIndex);
+		for (const Sphere& sphere : m_Description.spheres)
+			AddSphere(sphere.origin, sphere.radius, sphere.materialIndex);
+
+		for (const Light& light : m_Description.lights)
+		{
+			if (light.type == LightType::Point)
+				AddPointLight(light.origin, light.intensity, light.color);
+			else
+				AddDirectionalLight(light.direction, light.intensity, light.color);
+		}
+
+		// The geometries come with their BVHs -> only the instance matrices are calculated here
+		for (const SceneInstance& instance : m_Description.instances)
+		{
+			TriangleMesh* pMesh{ AddTriangleMesh(m_Description.geometries[instance.geometryIdx], instance.cullMode, instance.materialIndex) };
+			pMesh->Scale(instance.scale);
+			pMesh->rotationTransform = Matrix::CreateRotation(instance.rotation);
+			pMesh->Translate(instance.translation);
+			pMesh->UpdateTransforms();
+
+			if (instance.spinSpeed != 0.f)
+				m_SpinningMeshes.push_back(m_TriangleMeshGeometries.size() - 1);
+		}
+	}
+
+	void Scene_File::Update(Timer* pTimer)
+	{
+		Scene::Update(pTimer);
+
+		for (size_t meshIdx : m_SpinningMeshes)
+		{
+			const SceneInstance& instance{ m_Description.instances[meshIdx] };
+			TriangleMesh& mesh{ m_TriangleMeshGeometries[meshIdx] };
+			mesh.rotationTransform = Matrix::CreateRotation(instance.rotation + Vector3{ 0.f, instance.spinSpeed * pTimer->GetTotal(), 0.f });
+			mesh.UpdateTransforms();
+		}
+	}
+#pragma endregion
+
+	std::unique_ptr<Scene> CreateScene(const std::string& sceneName)
+	{
+		const std::filesystem::path extension{ std::filesystem::path{ sceneName }.extension() };
+		if (extension == ".scene" || extension == ".scenebundle")
+		{
+			SceneDescription description{};
+			if (!SceneFile::Load(sceneName, description))
+				return nullptr;
+			return std::make_unique<Scene_File>(std::move(description));
+		}
+
+		if (sceneName == "W1")
+			return std::make_unique<Scene_W1>();
+		if (sceneName == "W2")
+			return std::make_unique<Scene_W2>();
+		if (sceneName == "W3")
+			return std::make_unique<Scene_W3>();
+		if (sceneName == "W4Test")
+			return std::make_unique<Scene_W4_TestScene>();
+		if (sceneName == "W4Reference")
+			return std::make_unique<Scene_W4_ReferenceScene>();
+		if (sceneName == "W4Bunny")
+			return std::make_unique<Scene_W4_BunnyScene>();
+		if (sceneName == "Particles")
+			return std::make_unique<Scene_ParticleScene>();
+		if (sceneName == "ManyLights")
+			return std::make_unique<Scene_ManyLights>();
+
+		return nullptr;
+	}
 }
@@ -1,16 +1,19 @@
 #pragma once
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "Math.h"
 #include "DataTypes.h"
 #include "Camera.h"
+#include "LightBVH.h"
+#include "Material.h"
+#include "SceneFile.h"
 
 namespace dae
 {
 	//Forward Declarations
 	class Timer;
-	class Material;
 	struct Plane;
 	struct Sphere;
 	struct Light;
@@ -35,12 +38,23 @@ namespace dae
 
 		Camera& GetCamera() { return m_Camera; }
 		void GetClosestHit(const Ray& ray, HitRecord& closestHit) const;
+		// Closest hit of every ray in the packet ( closestHits needs one record per ray )
+		void GetClosestHits(const RayPacket& packet, HitRecord* closestHits) const;
 		bool DoesHit(const Ray& ray) const;
+		// Shadow ray towards a light : the primitive that blocked the previous shadow ray of this light
+		// ... ( Same thread ) is tested first, neighbouring pixels are usually behind the same blocker
+		bool IsOccluded(const Ray& ray, size_t lightIdx) const;
+
+		// Rebuild / refit the top-level structure, only when something was added or moved
+		// ... Returns true when it changed ( The geometry is different from the previous frame )
+		bool UpdateAccelerationStructure();
 
 		const std::vector<Plane>& GetPlaneGeometries() const { return m_PlaneGeometries; }
 		const std::vector<Sphere>& GetSphereGeometries() const { return m_SphereGeometries; }
 		const std::vector<Light>& GetLights() const { return m_Lights; }
-		const std::vector<Material*> GetMaterials() const { return m_Materials; }
+		const LightBVH& GetLightBVH() const { return m_LightBVH; }
+		// Flat material table, indexed by HitRecord::materialIndex
+		const std::vector<Material>& GetMaterials() const { return m_Materials; }
 
 		void ToggleShadows();
 		bool UseShadows() const;
@@ -52,12 +66,24 @@ namespace dae
 		std::vector<Plane> m_PlaneGeometries{};
 		std::vector<Sphere> m_SphereGeometries{};
 		std::vector<TriangleMesh> m_TriangleMeshGeometries{};
+		std::vector<SphereSet> m_SphereSets{};
 		std::vector<Light> m_Lights{};
-		std::vector<Material*> m_Materials{};
+		std::vector<Material> m_Materials{};
 
 		//// Temp (Individual Triangle Testing )
 		std::vector<Triangle> m_Triangles{};
 
+		// Top-level acceleration structure over the spheres and triangle meshes
+		// ... [0, spheres) -> spheres, [spheres, spheres + meshes) -> meshes, the sphere sets after that
+		// ... Planes are infinite so they can't be bounded -> tested separately
+		BVH m_TopLevelBVH{};
+		std::vector<AABB> m_TopLevelBounds{};
+		bool m_TopLevelNeedsRebuild{ true };
+
+		// Hierarchy over the lights ( Shading with a few picked lights instead of all of them )
+		LightBVH m_LightBVH{};
+		bool m_LightsNeedRebuild{ true };
+
 		Camera m_Camera{};
 
 		bool m_UseShadows{};
@@ -65,10 +91,36 @@ namespace dae
 		Sphere* AddSphere(const Vector3& origin, float radius, unsigned char materialIndex = 0);
 		Plane* AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex = 0);
 		TriangleMesh* AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex = 0);
+		// Instance of an existing geometry ( No copy of the triangles )
+		TriangleMesh* AddTriangleMesh(const std::shared_ptr<MeshGeometry>& pGeometry, TriangleCullMode cullMode, unsigned char materialIndex = 0);
+		// Empty set, add the spheres and call UpdateBVH on it
+		SphereSet* AddSphereSet();
 
 		Light* AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color);
 		Light* AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color);
-		unsigned char AddMaterial(Material* pMaterial);
+		unsigned char AddMaterial(const Material& material);
+
+	private:
+		// Primitive that blocked a shadow ray
+		struct Occluder
+		{
+			enum class Type : uint8_t
+			{
+				None,
+				Plane,
+				Sphere,
+				Triangle,
+				SetSphere
+			};
+
+			Type type{ Type::None };
+			uint32_t objectIdx{};		// Plane, sphere, mesh or sphere set index
+			uint32_t elementIdx{};		// Triangle inside the mesh, sphere inside the set
+		};
+
+		void UpdateTopLevelBounds();
+		bool FindOccluder(const Ray& ray, Occluder& occluder) const;
+		bool IsOccludedBy(const Occluder& occluder, const Ray& ray) const;
 	};
 
 	//+++++++++++++++++++++++++++++++++++++++++
@@ -170,4 +222,62 @@ namespace dae
 	private:
 		TriangleMesh* m_pBunnyMesh{ nullptr };
 	};
+
+	// A million small spheres in one sphere set ( Particles )
+	class Scene_ParticleScene final : public Scene
+	{
+	public:
+		Scene_ParticleScene() = default;
+		~Scene_ParticleScene() override = default;
+
+		Scene_ParticleScene(const Scene_ParticleScene&) = delete;
+		Scene_ParticleScene(Scene_ParticleScene&&) noexcept = delete;
+		Scene_ParticleScene& operator=(const Scene_ParticleScene&) = delete;
+		Scene_ParticleScene& operator=(Scene_ParticleScene&&) noexcept = delete;
+
+		void Initialize() override;
+
+		static constexpr uint32_t ParticleCount{ 1'000'000 };
+	};
+
+	// Reference room lit by a few hundred small colored point lights ( Light BVH sampling )
+	class Scene_ManyLights final : public Scene
+	{
+	public:
+		Scene_ManyLights() = default;
+		~Scene_ManyLights() override = default;
+
+		Scene_ManyLights(const Scene_ManyLights&) = delete;
+		Scene_ManyLights(Scene_ManyLights&&) noexcept = delete;
+		Scene_ManyLights& operator=(const Scene_ManyLights&) = delete;
+		Scene_ManyLights& operator=(Scene_ManyLights&&) noexcept = delete;
+
+		void Initialize() override;
+
+		static constexpr uint32_t LightCount{ 512 };
+	};
+
+	// Scene described by a .scene / .scenebundle file ( See SceneFile.h )
+	class Scene_File final : public Scene
+	{
+	public:
+		explicit Scene_File(SceneDescription&& description);
+		~Scene_File() override = default;
+
+		Scene_File(const Scene_File&) = delete;
+		Scene_File(Scene_File&&) noexcept = delete;
+		Scene_File& operator=(const Scene_File&) = delete;
+		Scene_File& operator=(Scene_File&&) noexcept = delete;
+
+		void Initialize() override;
+		void Update(Timer* pTimer) override;
+	private:
+		SceneDescription m_Description;
+		// Instances that spin ( Instance i is mesh i in m_TriangleMeshGeometries )
+		std::vector<size_t> m_SpinningMeshes{};
+	};
+
+	// Scene by its short name ( W1, W2, W3, W4Test, W4Reference, W4Bunny, Particles, ManyLights )
+	// ... or by the path of a scene file ( .scene / .scenebundle ), nullptr when unknown or the file can't be loaded
+	std::unique_ptr<Scene> CreateScene(const std::string& sceneName);
 }
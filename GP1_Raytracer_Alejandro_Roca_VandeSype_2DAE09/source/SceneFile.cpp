@@ -0,0 +1,843 @@
+#include "SceneFile.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <type_traits>
+#include <unordered_map>
+
+#include "MappedFile.h"
+#include "ObjLoader.h"
+
+namespace dae
+{
+	size_t SceneDescription::GetTriangleCount() const
+	{
+		size_t triangleCount{ 0 };
+		for (const SceneInstance& instance : instances)
+			triangleCount += geometries[instance.geometryIdx]->indices.size() / 3;
+		return triangleCount;
+	}
+
+	namespace
+	{
+#pragma region Text
+		// Whitespace separated words of a line, up to a #
+		std::vector<std::string_view> SplitWords(std::string_view line)
+		{
+			const size_t commentStart{ line.find('#') };
+			if (commentStart != std::string_view::npos)
+				line = line.substr(0, commentStart);
+
+			std::vector<std::string_view> words{};
+			size_t start{ line.find_first_not_of(" \t\r") };
+			while (start != std::string_view::npos)
+			{
+				const size_t end{ std::min(line.find_first_of(" \t\r", start), line.size()) };
+				words.emplace_back(line.substr(start, end - start));
+				start = line.find_first_not_of(" \t\r", end);
+			}
+			return words;
+		}
+
+		// Reads the arguments of one statement front to back, every Read fails once a value is missing or malformed
+		class StatementReader final
+		{
+		public:
+			explicit StatementReader(const std::vector<std::string_view>& words) :
+				m_Words{ words }
+			{
+			}
+
+			bool Read(std::string_view& word)
+			{
+				if (m_WordIdx >= m_Words.size())
+					return false;
+				word = m_Words[m_WordIdx++];
+				return true;
+			}
+
+			bool Read(float& value)
+			{
+				std::string_view word{};
+				if (!Read(word))
+					return false;
+				if (!word.empty() && word.front() == '+')
+					word.remove_prefix(1);
+
+				const std::from_chars_result result{ std::from_chars(word.data(), word.data() + word.size(), value) };
+				return result.ec == std::errc{} && result.ptr == word.data() + word.size();
+			}
+
+			bool Read(Vector3& value)
+			{
+				return Read(value.x) && Read(value.y) && Read(value.z);
+			}
+
+			bool Read(ColorRGB& value)
+			{
+				return Read(value.r) && Read(value.g) && Read(value.b);
+			}
+
+			bool IsDone() const { return m_WordIdx >= m_Words.size(); }
+
+		private:
+			const std::vector<std::string_view>& m_Words;
+			size_t m_WordIdx{ 1 };		// Word 0 is the keyword
+		};
+
+		// Where the triangles of a "mesh" statement come from
+		struct MeshSource
+		{
+			std::string objPath{};		// Empty -> inline OBJ statements
+			std::string objText{};
+			int lineNumber{};
+		};
+
+		bool ParseMaterial(StatementReader& reader, Material& material)
+		{
+			std::string_view type{};
+			ColorRGB color{};
+			if (!reader.Read(type) || !reader.Read(color))
+				return false;
+
+			float kd{}, ks{}, exponent{}, metalness{}, roughness{};
+			if (type == "solid")
+				material = Material::SolidColor(color);
+			else if (type == "lambert" && reader.Read(kd))
+				material = Material::Lambert(color, kd);
+			else if (type == "phong" && reader.Read(kd) && reader.Read(ks) && reader.Read(exponent))
+				material = Material::LambertPhong(color, kd, ks, exponent);
+			else if (type == "cooktorrance" && reader.Read(metalness) && reader.Read(roughness))
+				material = Material::CookTorrence(color, metalness, roughness);
+			else
+				return false;
+
+			return reader.IsDone();
+		}
+
+		bool ParseInstanceOptions(StatementReader& reader, SceneInstance& instance)
+		{
+			std::string_view option{};
+			while (reader.Read(option))
+			{
+				bool isValid{ false };
+				if (option == "cull")
+				{
+					std::string_view cullMode{};
+					isValid = reader.Read(cullMode);
+					if (cullMode == "back")
+						instance.cullMode = TriangleCullMode::BackFaceCulling;
+					else if (cullMode == "front")
+						instance.cullMode = TriangleCullMode::FrontFaceCulling;
+					else if (cullMode == "none")
+						instance.cullMode = TriangleCullMode::NoCulling;
+					else
+						isValid = false;
+				}
+				else if (option == "translate")
+					isValid = reader.Read(instance.translation);
+				else if (option == "rotate")
+				{
+					isValid = reader.Read(instance.rotation);
+					instance.rotation *= TO_RADIANS;
+				}
+				else if (option == "scale")
+					isValid = reader.Read(instance.scale);
+				else if (option == "spin")
+				{
+					isValid = reader.Read(instance.spinSpeed);
+					instance.spinSpeed *= TO_RADIANS;
+				}
+
+				if (!isValid)
+					return false;
+			}
+			return true;
+		}
+
+		// OBJ file or inline statements -> geometry with its BVH
+		bool LoadMesh(const MeshSource& source, MeshGeometry& geometry, std::string& error)
+		{
+			ObjMesh mesh{};
+			if (source.objPath.empty())
+			{
+				if (!ObjLoader::Parse(source.objText, mesh, ObjLoader::DefaultChunkSize, &error))
+					return false;
+			}
+			else if (!ObjLoader::Load(source.objPath, mesh))
+			{
+				error = "could not load " + source.objPath;
+				return false;
+			}
+
+			if (mesh.indices.empty())
+			{
+				error = "the mesh has no triangles";
+				return false;
+			}
+
+			geometry.positions = std::move(mesh.positions);
+			geometry.indices = std::move(mesh.indices);
+			geometry.normals = std::move(mesh.normals);
+			geometry.UpdateBVH();
+			return true;
+		}
+#pragma endregion
+
+#pragma region Bundle
+		// Layout of every array in the file, a bundle written by a build with other struct sizes is refused
+		constexpr uint32_t GetBundleLayout()
+		{
+			uint32_t layout{ 2166136261u };
+			for (size_t size : { sizeof(Material), sizeof(Plane), sizeof(Sphere), sizeof(Light), sizeof(SceneInstance),
+				sizeof(Vector3), sizeof(BVHNode), sizeof(WideBVHNode), sizeof(TriangleBlock) })
+				layout = (layout ^ static_cast<uint32_t>(size)) * 16777619u;
+			return layout;
+		}
+
+		constexpr uint32_t BundleMagic{ 0x42435352 };		// "RSCB"
+		constexpr uint32_t BundleVersion{ 1 };
+		constexpr uint32_t BundleLayout{ GetBundleLayout() };
+		// Every array starts on a cache line
+		constexpr size_t BundleAlignment{ 64 };
+
+		static_assert(std::is_trivially_copyable_v<Material> && std::is_trivially_copyable_v<Light> && std::is_trivially_copyable_v<SceneInstance>
+			&& std::is_trivially_copyable_v<WideBVHNode> && std::is_trivially_copyable_v<TriangleBlock>, "Bundle arrays are copied as bytes");
+
+		struct BundleHeader
+		{
+			uint32_t magic{};
+			uint32_t version{};
+			uint32_t layout{};
+			uint32_t nameLength{};
+
+			Vector3 cameraOrigin{};
+			float cameraFovAngle{};
+
+			uint32_t materialCount{};
+			uint32_t planeCount{};
+			uint32_t sphereCount{};
+			uint32_t lightCount{};
+			uint32_t geometryCount{};
+			uint32_t instanceCount{};
+		};
+
+		// Array sizes of one geometry, the arrays follow in this order
+		struct BundleGeometry
+		{
+			uint64_t positionCount{};
+			uint64_t triangleCount{};
+			uint64_t nodeCount{};
+			uint64_t primitiveIndexCount{};
+			uint64_t wideNodeCount{};				// 0 when it was compiled without USE_WIDE_BVH
+			uint64_t widePrimitiveIndexCount{};
+			uint64_t triangleBlockCount{};
+			float buildCost{};
+			uint32_t padding{};
+		};
+
+		class BundleWriter final
+		{
+		public:
+			explicit BundleWriter(const std::string& filePath) :
+				m_File{ filePath, std::ios::binary | std::ios::trunc }
+			{
+			}
+
+			template<typename Type>
+			void Write(const Type* pValues, size_t count)
+			{
+				static constexpr char padding[BundleAlignment]{};
+				const size_t paddingSize{ (BundleAlignment - m_Offset % BundleAlignment) % BundleAlignment };
+				m_File.write(padding, static_cast<std::streamsize>(paddingSize));
+				m_File.write(reinterpret_cast<const char*>(pValues), static_cast<std::streamsize>(count * sizeof(Type)));
+				m_Offset += paddingSize + count * sizeof(Type);
+			}
+
+			template<typename Type>
+			void Write(const std::vector<Type>& values)
+			{
+				Write(values.data(), values.size());
+			}
+
+			bool Close()
+			{
+				m_File.close();
+				return !m_File.fail();
+			}
+
+		private:
+			std::ofstream m_File;
+			size_t m_Offset{ 0 };
+		};
+
+		// Mirror of BundleWriter over the mapped file, every Read fails once the file is too short
+		class BundleReader final
+		{
+		public:
+			explicit BundleReader(const MappedFile& file) :
+				m_pData{ file.GetData() }, m_Size{ file.GetSize() }
+			{
+			}
+
+			// Start of the next array, nullptr when it doesn't fit in the file
+			const char* Skip(size_t size)
+			{
+				const size_t start{ (m_Offset + BundleAlignment - 1) / BundleAlignment * BundleAlignment };
+				if (start > m_Size || size > m_Size - start)
+				{
+					m_Offset = m_Size + 1;
+					return nullptr;
+				}
+
+				m_Offset = start + size;
+				return m_pData + start;
+			}
+
+			template<typename Type>
+			bool Read(Type* pValues, size_t count)
+			{
+				const char* pSource{ Skip(count * sizeof(Type)) };
+				if (!pSource)
+					return false;
+
+				CopyBytes(pValues, pSource, count * sizeof(Type));
+				return true;
+			}
+
+			template<typename Type>
+			bool Read(std::vector<Type>& values, uint64_t count)
+			{
+				if (count > m_Size / sizeof(Type))
+					return false;
+
+				values.resize(static_cast<size_t>(count));
+				return Read(values.data(), values.size());
+			}
+
+		private:
+			const char* m_pData;
+			size_t m_Size;
+			size_t m_Offset{ 0 };
+
+			// Big arrays are copied in pieces on all threads : the page faults of the mapping and the copy are spread over them
+			static void CopyBytes(void* pDestination, const char* pSource, size_t size)
+			{
+				constexpr size_t pieceSize{ 4 << 20 };
+				if (size <= pieceSize)
+				{
+					if (size > 0)
+						std::memcpy(pDestination, pSource, size);
+					return;
+				}
+
+				std::vector<size_t> pieceOffsets((size + pieceSize - 1) / pieceSize);
+				for (size_t pieceIdx{ 0 }; pieceIdx < pieceOffsets.size(); ++pieceIdx)
+					pieceOffsets[pieceIdx] = pieceIdx * pieceSize;
+
+				std::for_each(std::execution::par, pieceOffsets.begin(), pieceOffsets.end(), [=](size_t offset)
+					{
+						std::memcpy(static_cast<char*>(pDestination) + offset, pSource + offset, std::min(pieceSize, size - offset));
+					});
+			}
+		};
+
+		// Every node reached once from the root, children after their parent, leaves inside the primitive list
+		// ... and no deeper than the traversal stacks allow
+		bool IsValidBVH(const std::vector<BVHNode>& nodes, const std::vector<uint32_t>& primitiveIndices, uint32_t primitiveCount)
+		{
+			// An empty mesh has no nodes at all
+			if (nodes.empty())
+				return primitiveCount == 0 && primitiveIndices.empty();
+			if (!std::all_of(std::execution::par_unseq, primitiveIndices.begin(), primitiveIndices.end(),
+				[primitiveCount](uint32_t index) { return index < primitiveCount; }))
+				return false;
+
+			struct StackEntry
+			{
+				uint32_t nodeIdx;
+				uint32_t depth;
+			};
+			std::vector<StackEntry> stack{ { 0, 0 } };
+			size_t visitCount{ 0 };
+			while (!stack.empty())
+			{
+				const StackEntry entry{ stack.back() };
+				stack.pop_back();
+				if (++visitCount > nodes.size() || entry.depth > BVH::MaxDepth)
+					return false;
+
+				const BVHNode& node{ nodes[entry.nodeIdx] };
+				if (node.IsLeaf())
+				{
+					if (node.primitiveCount > BVH::MaxLeafSize || uint64_t{ node.leftFirst } + node.primitiveCount > primitiveIndices.size())
+						return false;
+					continue;
+				}
+
+				if (node.leftFirst <= entry.nodeIdx || node.leftFirst >= nodes.size() - 1)
+					return false;
+				stack.push_back({ node.leftFirst, entry.depth + 1 });
+				stack.push_back({ node.leftFirst + 1, entry.depth + 1 });
+			}
+			return true;
+		}
+
+#ifdef USE_WIDE_BVH
+		// Same for the collapsed tree, plus the block layout : every leaf on its own aligned block, one block per LeafAlignment slots
+		bool IsValidWideBVH(const std::vector<WideBVHNode>& nodes, const std::vector<uint32_t>& primitiveIndices, uint32_t primitiveCount,
+			size_t blockCount)
+		{
+			if (nodes.empty() || primitiveIndices.size() % WideBVH::LeafAlignment != 0 || blockCount != primitiveIndices.size() / WideBVH::LeafAlignment
+				|| !std::all_of(std::execution::par_unseq, primitiveIndices.begin(), primitiveIndices.end(),
+					[primitiveCount](uint32_t index) { return index < primitiveCount || index == WideBVH::InvalidPrimitive; }))
+				return false;
+
+			struct StackEntry
+			{
+				uint32_t nodeIdx;
+				uint32_t depth;
+			};
+			std::vector<StackEntry> stack{ { 0, 0 } };
+			size_t visitCount{ 0 };
+			while (!stack.empty())
+			{
+				const StackEntry entry{ stack.back() };
+				stack.pop_back();
+				if (++visitCount > nodes.size() || entry.depth > BVH::MaxDepth)
+					return false;
+
+				const WideBVHNode& node{ nodes[entry.nodeIdx] };
+				for (int childIdx{ 0 }; childIdx < WideBVHNode::Width; ++childIdx)
+				{
+					const uint32_t child{ node.child[childIdx] };
+					if (node.IsInner(childIdx))
+					{
+						if (child <= entry.nodeIdx || child >= nodes.size())
+							return false;
+						stack.push_back({ child, entry.depth + 1 });
+						continue;
+					}
+
+					// The traversal reads primitiveCount lanes of the leaf block, every one of them has to be a real primitive
+					const uint32_t leafCount{ node.primitiveCount[childIdx] };
+					if (leafCount == 0)
+						continue;
+					if (leafCount > WideBVH::LeafAlignment || child % WideBVH::LeafAlignment != 0 || child >= primitiveIndices.size())
+						return false;
+					if (std::find(primitiveIndices.begin() + child, primitiveIndices.begin() + child + leafCount, WideBVH::InvalidPrimitive)
+						!= primitiveIndices.begin() + child + leafCount)
+						return false;
+				}
+			}
+			return true;
+		}
+#endif
+
+		// Every array is read and checked before anything uses it : a damaged bundle is refused instead of crashing the traversal
+		bool ReadGeometry(BundleReader& reader, const BundleGeometry& sizes, MeshGeometry& geometry)
+		{
+			std::vector<BVHNode> nodes{};
+			std::vector<uint32_t> primitiveIndices{};
+			if (!reader.Read(geometry.positions, sizes.positionCount) || !reader.Read(geometry.indices, sizes.triangleCount * 3)
+				|| !reader.Read(geometry.normals, sizes.triangleCount) || !reader.Read(nodes, sizes.nodeCount)
+				|| !reader.Read(primitiveIndices, sizes.primitiveIndexCount))
+				return false;
+
+			const uint32_t positionCount{ static_cast<uint32_t>(geometry.positions.size()) };
+			const uint32_t triangleCount{ static_cast<uint32_t>(geometry.normals.size()) };
+			if (!std::all_of(std::execution::par_unseq, geometry.indices.begin(), geometry.indices.end(),
+				[positionCount](int index) { return static_cast<uint32_t>(index) < positionCount; })
+				|| !IsValidBVH(nodes, primitiveIndices, triangleCount))
+				return false;
+
+#ifdef USE_WIDE_BVH
+			std::vector<WideBVHNode> wideNodes{};
+			std::vector<uint32_t> widePrimitiveIndices{};
+			if (sizes.wideNodeCount > 0 && (!reader.Read(wideNodes, sizes.wideNodeCount) || !reader.Read(widePrimitiveIndices, sizes.widePrimitiveIndexCount)
+				|| !reader.Read(geometry.triangleBlocks, sizes.triangleBlockCount)
+				|| !IsValidWideBVH(wideNodes, widePrimitiveIndices, triangleCount, geometry.triangleBlocks.size())))
+				return false;
+
+			geometry.bvh.SetPrimitiveBlockSize(TriangleBlock::Width);
+#else
+			// Not used by this build, skipped
+			reader.Skip(sizes.wideNodeCount * sizeof(WideBVHNode));
+			reader.Skip(sizes.widePrimitiveIndexCount * sizeof(uint32_t));
+			if (!reader.Skip(sizes.triangleBlockCount * sizeof(TriangleBlock)))
+				return false;
+#endif
+
+			geometry.bvh.SetNodes(std::move(nodes), std::move(primitiveIndices), sizes.buildCost);
+			geometry.UpdateAABB();
+
+#ifdef USE_WIDE_BVH
+			if (!wideNodes.empty())
+				geometry.wideBVH.SetNodes(std::move(wideNodes), std::move(widePrimitiveIndices));
+			else
+			{
+				// Compiled without the wide BVH -> collapse it here ( Linear, no build )
+				geometry.wideBVH.Build(geometry.bvh);
+				geometry.UpdateTriangleBlocks();
+			}
+#endif
+			return true;
+		}
+#pragma endregion
+	}
+
+	namespace SceneFile
+	{
+		bool Load(const std::string& filePath, SceneDescription& scene)
+		{
+			const bool isBundle{ std::filesystem::path{ filePath }.extension() == ".scenebundle" };
+			std::string error{};
+			if (isBundle ? !LoadBundle(filePath, scene) : !Parse(filePath, scene, &error))
+			{
+				std::cout << "Could not load " << filePath << ( error.empty() ? "" : " : " + error ) << std::endl;
+				return false;
+			}
+			return true;
+		}
+
+		bool Parse(const std::string& filePath, SceneDescription& scene, std::string* pError)
+		{
+			scene = SceneDescription{};
+			scene.materials.emplace_back(Material::SolidColor({ 1, 0, 0 }));
+
+			std::string error{};
+			const auto fail{ [&](int lineNumber, const std::string& message)
+				{
+					if (pError)
+						*pError = filePath + ":" + std::to_string(lineNumber) + " : " + message;
+					scene = SceneDescription{};
+					return false;
+				} };
+
+			MappedFile file{};
+			if (!file.Open(filePath))
+				return fail(0, "could not open the file");
+
+			const std::filesystem::path directory{ std::filesystem::path{ filePath }.parent_path() };
+			std::unordered_map<std::string, unsigned char> materialIndices{};
+			std::unordered_map<std::string, uint32_t> geometryIndices{};
+			std::vector<MeshSource> meshSources{};
+
+			const std::string_view text{ file.GetText() };
+			MeshSource* pInlineMesh{ nullptr };		// Inside a mesh block, collecting its lines
+			int lineNumber{ 0 };
+			for (size_t lineStart{ 0 }; lineStart < text.size();)
+			{
+				size_t lineEnd{ text.find('\n', lineStart) };
+				if (lineEnd == std::string_view::npos)
+					lineEnd = text.size();
+				const std::string_view line{ text.substr(lineStart, lineEnd - lineStart) };
+				lineStart = lineEnd + 1;
+				++lineNumber;
+
+				const std::vector<std::string_view> words{ SplitWords(line) };
+				if (words.empty())
+					continue;
+
+				const std::string_view keyword{ words[0] };
+				if (pInlineMesh)
+				{
+					if (keyword == "end")
+						pInlineMesh = nullptr;
+					else
+						pInlineMesh->objText.append(line).push_back('\n');
+					continue;
+				}
+
+				StatementReader reader{ words };
+				const auto findMaterial{ [&](unsigned char& materialIndex)
+					{
+						std::string_view materialName{};
+						if (!reader.Read(materialName))
+							return false;
+						const auto it{ materialIndices.find(std::string{ materialName }) };
+						if (it == materialIndices.end())
+							return false;
+						materialIndex = it->second;
+						return true;
+					} };
+
+				bool isValid{ false };
+				if (keyword == "name")
+				{
+					if (words.size() < 2)
+						return fail(lineNumber, "missing scene name");
+
+					// The rest of the line
+					scene.name = std::string{ words[1].data(), static_cast<size_t>(words.back().data() + words.back().size() - words[1].data()) };
+					isValid = true;
+				}
+				else if (keyword == "camera")
+					isValid = reader.Read(scene.cameraOrigin) && reader.Read(scene.cameraFovAngle) && reader.IsDone();
+				else if (keyword == "material")
+				{
+					std::string_view name{};
+					Material material{};
+					if (scene.materials.size() > UINT8_MAX)
+						return fail(lineNumber, "too many materials ( Material indices are 8 bit )");
+					if (reader.Read(name) && materialIndices.count(std::string{ name }) > 0)
+						return fail(lineNumber, "material " + std::string{ name } + " is defined twice");
+
+					isValid = !name.empty() && ParseMaterial(reader, material);
+					if (isValid)
+					{
+						materialIndices.emplace(name, static_cast<unsigned char>(scene.materials.size()));
+						scene.materials.emplace_back(material);
+					}
+				}
+				else if (keyword == "plane")
+				{
+					Plane& plane{ scene.planes.emplace_back() };
+					isValid = reader.Read(plane.origin) && reader.Read(plane.normal) && findMaterial(plane.materialIndex) && reader.IsDone();
+					plane.normal.Normalize();
+				}
+				else if (keyword == "sphere")
+				{
+					Sphere& sphere{ scene.spheres.emplace_back() };
+					isValid = reader.Read(sphere.origin) && reader.Read(sphere.radius) && findMaterial(sphere.materialIndex) && reader.IsDone();
+				}
+				else if (keyword == "pointlight" || keyword == "directionallight")
+				{
+					Light& light{ scene.lights.emplace_back() };
+					light.type = keyword == "pointlight" ? LightType::Point : LightType::Directional;
+					isValid = reader.Read(light.type == LightType::Point ? light.origin : light.direction) && reader.Read(light.intensity)
+						&& reader.Read(light.color) && reader.IsDone();
+					if (light.type == LightType::Directional)
+						light.direction.Normalize();
+				}
+				else if (keyword == "mesh")
+				{
+					std::string_view name{}, objPath{};
+					if (reader.Read(name) && geometryIndices.count(std::string{ name }) > 0)
+						return fail(lineNumber, "mesh " + std::string{ name } + " is defined twice");
+
+					isValid = !name.empty();
+					if (isValid)
+					{
+						geometryIndices.emplace(name, static_cast<uint32_t>(meshSources.size()));
+						MeshSource& source{ meshSources.emplace_back() };
+						source.lineNumber = lineNumber;
+						if (reader.Read(objPath))
+							source.objPath = (directory / objPath).string();
+						else
+							pInlineMesh = &source;
+						isValid = reader.IsDone();
+					}
+				}
+				else if (keyword == "instance")
+				{
+					std::string_view meshName{};
+					SceneInstance& instance{ scene.instances.emplace_back() };
+					const auto it{ reader.Read(meshName) ? geometryIndices.find(std::string{ meshName }) : geometryIndices.end() };
+					if (it == geometryIndices.end())
+						return fail(lineNumber, "unknown mesh " + std::string{ meshName });
+
+					instance.geometryIdx = it->second;
+					isValid = findMaterial(instance.materialIndex) && ParseInstanceOptions(reader, instance);
+				}
+				else
+					return fail(lineNumber, "unknown statement " + std::string{ keyword });
+
+				if (!isValid)
+					return fail(lineNumber, "invalid " + std::string{ keyword } + " ( Missing or wrong values, or an unknown material )");
+			}
+
+			if (pInlineMesh)
+				return fail(pInlineMesh->lineNumber, "mesh without end");
+
+			// The slow part : OBJ files and BVH builds, one mesh per thread
+			scene.geometries.resize(meshSources.size());
+			std::vector<std::string> meshErrors(meshSources.size());
+			std::vector<size_t> meshIndices(meshSources.size());
+			std::iota(meshIndices.begin(), meshIndices.end(), size_t{ 0 });
+			std::for_each(std::execution::par, meshIndices.begin(), meshIndices.end(), [&](size_t meshIdx)
+				{
+					scene.geometries[meshIdx] = std::make_shared<MeshGeometry>();
+					LoadMesh(meshSources[meshIdx], *scene.geometries[meshIdx], meshErrors[meshIdx]);
+				});
+
+			for (size_t meshIdx{ 0 }; meshIdx < meshSources.size(); ++meshIdx)
+			{
+				if (!meshErrors[meshIdx].empty())
+					return fail(meshSources[meshIdx].lineNumber, meshErrors[meshIdx]);
+			}
+
+			return true;
+		}
+
+		bool WriteBundle(const std::string& bundlePath, const SceneDescription& scene)
+		{
+			BundleHeader header{};
+			header.magic = BundleMagic;
+			header.version = BundleVersion;
+			header.layout = BundleLayout;
+			header.nameLength = static_cast<uint32_t>(scene.name.size());
+			header.cameraOrigin = scene.cameraOrigin;
+			header.cameraFovAngle = scene.cameraFovAngle;
+			header.materialCount = static_cast<uint32_t>(scene.materials.size());
+			header.planeCount = static_cast<uint32_t>(scene.planes.size());
+			header.sphereCount = static_cast<uint32_t>(scene.spheres.size());
+			header.lightCount = static_cast<uint32_t>(scene.lights.size());
+			header.geometryCount = static_cast<uint32_t>(scene.geometries.size());
+			header.instanceCount = static_cast<uint32_t>(scene.instances.size());
+
+			std::vector<BundleGeometry> geometrySizes{};
+			for (const std::shared_ptr<MeshGeometry>& pGeometry : scene.geometries)
+			{
+				BundleGeometry& sizes{ geometrySizes.emplace_back() };
+				sizes.positionCount = pGeometry->positions.size();
+				sizes.triangleCount = pGeometry->indices.size() / 3;
+				sizes.nodeCount = pGeometry->bvh.GetNodes().size();
+				sizes.primitiveIndexCount = pGeometry->bvh.GetPrimitiveIndices().size();
+				sizes.buildCost = pGeometry->bvh.GetBuildCost();
+#ifdef USE_WIDE_BVH
+				sizes.wideNodeCount = pGeometry->wideBVH.GetNodes().size();
+				sizes.widePrimitiveIndexCount = pGeometry->wideBVH.GetPrimitiveIndices().size();
+				sizes.triangleBlockCount = pGeometry->triangleBlocks.size();
+#endif
+			}
+
+			// Written next to it first -> a half written bundle never replaces a good one
+			const std::string temporaryPath{ bundlePath + ".tmp" };
+			BundleWriter writer{ temporaryPath };
+			writer.Write(&header, 1);
+			writer.Write(scene.name.data(), scene.name.size());
+			writer.Write(scene.materials);
+			writer.Write(scene.planes);
+			writer.Write(scene.spheres);
+			writer.Write(scene.lights);
+			writer.Write(scene.instances);
+			writer.Write(geometrySizes);
+			for (const std::shared_ptr<MeshGeometry>& pGeometry : scene.geometries)
+			{
+				writer.Write(pGeometry->positions);
+				writer.Write(pGeometry->indices);
+				writer.Write(pGeometry->normals);
+				writer.Write(pGeometry->bvh.GetNodes());
+				writer.Write(pGeometry->bvh.GetPrimitiveIndices());
+#ifdef USE_WIDE_BVH
+				writer.Write(pGeometry->wideBVH.GetNodes());
+				writer.Write(pGeometry->wideBVH.GetPrimitiveIndices());
+				writer.Write(pGeometry->triangleBlocks);
+#endif
+			}
+
+			std::error_code error{};
+			if (writer.Close())
+				std::filesystem::rename(temporaryPath, bundlePath, error);
+			else
+				error = std::make_error_code(std::errc::io_error);
+
+			if (error)
+			{
+				std::filesystem::remove(temporaryPath, error);
+				return false;
+			}
+			return true;
+		}
+
+		bool LoadBundle(const std::string& bundlePath, SceneDescription& scene)
+		{
+			scene = SceneDescription{};
+
+			MappedFile file{};
+			if (!file.Open(bundlePath))
+				return false;
+
+			BundleReader reader{ file };
+			BundleHeader header{};
+			if (!reader.Read(&header, 1) || header.magic != BundleMagic || header.version != BundleVersion || header.layout != BundleLayout)
+			{
+				std::cout << bundlePath << " is not a scene bundle of this version, compile the scene again" << std::endl;
+				return false;
+			}
+
+			scene.name.resize(header.nameLength);
+			scene.cameraOrigin = header.cameraOrigin;
+			scene.cameraFovAngle = header.cameraFovAngle;
+
+			std::vector<BundleGeometry> geometrySizes{};
+			bool isValid{ reader.Read(scene.name.data(), scene.name.size()) && reader.Read(scene.materials, header.materialCount)
+				&& reader.Read(scene.planes, header.planeCount) && reader.Read(scene.spheres, header.sphereCount)
+				&& reader.Read(scene.lights, header.lightCount) && reader.Read(scene.instances, header.instanceCount)
+				&& reader.Read(geometrySizes, header.geometryCount) };
+
+			for (size_t geometryIdx{ 0 }; isValid && geometryIdx < geometrySizes.size(); ++geometryIdx)
+			{
+				const std::shared_ptr<MeshGeometry>& pGeometry{ scene.geometries.emplace_back(std::make_shared<MeshGeometry>()) };
+				isValid = ReadGeometry(reader, geometrySizes[geometryIdx], *pGeometry);
+			}
+
+			// Every reference has to point inside the tables
+			const auto hasMaterial{ [&](unsigned char materialIndex) { return materialIndex < scene.materials.size(); } };
+			isValid = isValid
+				&& std::all_of(scene.planes.begin(), scene.planes.end(), [&](const Plane& plane) { return hasMaterial(plane.materialIndex); })
+				&& std::all_of(scene.spheres.begin(), scene.spheres.end(), [&](const Sphere& sphere) { return hasMaterial(sphere.materialIndex); })
+				&& std::all_of(scene.instances.begin(), scene.instances.end(), [&](const SceneInstance& instance)
+					{
+						return hasMaterial(instance.materialIndex) && instance.geometryIdx < scene.geometries.size();
+					});
+
+			if (!isValid)
+			{
+				std::cout << bundlePath << " is damaged, compile the scene again" << std::endl;
+				scene = SceneDescription{};
+				return false;
+			}
+			return true;
+		}
+
+		bool Compile(const std::string& scenePath, const std::string& bundlePath)
+		{
+			const auto startTime{ std::chrono::high_resolution_clock::now() };
+
+			SceneDescription scene{};
+			std::string error{};
+			if (!Parse(scenePath, scene, &error))
+			{
+				std::cout << "Could not compile " << scenePath << " : " << error << std::endl;
+				return false;
+			}
+
+			const auto parseTime{ std::chrono::high_resolution_clock::now() };
+			if (!WriteBundle(bundlePath, scene))
+			{
+				std::cout << "Could not write " << bundlePath << std::endl;
+				return false;
+			}
+
+			// Read back what was written : the startup cost of the bundle against the parse and build it replaces
+			// ... ( The file was just written, so this is a load from the file cache, not from the disk )
+			const auto writeTime{ std::chrono::high_resolution_clock::now() };
+			SceneDescription loaded{};
+			if (!LoadBundle(bundlePath, loaded))
+				return false;
+
+			const auto endTime{ std::chrono::high_resolution_clock::now() };
+			std::error_code sizeError{};
+			std::cout << scenePath << " -> " << bundlePath << " : " << scene.geometries.size() << " meshes, " << scene.GetTriangleCount() << " triangles, "
+				<< std::filesystem::file_size(bundlePath, sizeError) / (1024.f * 1024.f) << " MB\n"
+				<< "Parse and build " << std::chrono::duration<float, std::milli>(parseTime - startTime).count() << " ms, write "
+				<< std::chrono::duration<float, std::milli>(writeTime - parseTime).count() << " ms, load "
+				<< std::chrono::duration<float, std::milli>(endTime - writeTime).count() << " ms" << std::endl;
+			return true;
+		}
+
+		std::string GetBundlePath(const std::string& scenePath)
+		{
+			return std::filesystem::path{ scenePath }.replace_extension(".scenebundle").string();
+		}
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DataTypes.h"
+#include "Material.h"
+
+namespace dae
+{
+	// Placement of a shared geometry ( TriangleMesh ), rotation in radians ( Pitch, yaw, roll )
+	struct SceneInstance
+	{
+		uint32_t geometryIdx{};
+		unsigned char materialIndex{};
+		TriangleCullMode cullMode{ TriangleCullMode::BackFaceCulling };
+
+		Vector3 translation{};
+		Vector3 rotation{};
+		Vector3 scale{ 1.f, 1.f, 1.f };
+		float spinSpeed{};			// Extra yaw per second ( Radians ), 0 = static
+	};
+
+	// Everything a scene file describes, in the form the Scene keeps it
+	// ... Material 0 is the default red every Scene starts with, the file materials follow it
+	struct SceneDescription
+	{
+		std::string name{};
+
+		Vector3 cameraOrigin{};
+		float cameraFovAngle{ 90.f };
+
+		std::vector<Material> materials{};
+		std::vector<Plane> planes{};
+		std::vector<Sphere> spheres{};
+		std::vector<Light> lights{};
+
+		// Object-space geometry with its BVHs built, shared by the instances that reference it
+		std::vector<std::shared_ptr<MeshGeometry>> geometries{};
+		std::vector<SceneInstance> instances{};
+
+		size_t GetTriangleCount() const;
+	};
+
+	// Text scenes ( .scene ) and their compiled binary form ( .scenebundle )
+	// ... The text form is parsed, its OBJ files loaded and every mesh BVH built when it is opened
+	// ... The bundle stores the flattened geometry with its finished BVHs : loading it maps the file and copies the
+	// arrays out of it, without parsing or building anything
+	//
+	// Text format, one statement per line, # starts a comment, angles in degrees :
+	//   name <scene name>
+	//   camera <x y z> <fov>
+	//   material <name> solid <r g b>
+	//   material <name> lambert <r g b> <kd>
+	//   material <name> phong <r g b> <kd> <ks> <exponent>
+	//   material <name> cooktorrance <r g b> <metalness> <roughness>
+	//   plane <x y z> <normal x y z> <material>
+	//   sphere <x y z> <radius> <material>
+	//   pointlight <x y z> <intensity> <r g b>
+	//   directionallight <direction x y z> <intensity> <r g b>
+	//   mesh <name> <file.obj>				OBJ path relative to the scene file
+	//   mesh <name>						Followed by OBJ statements ( v, f, ... ) up to a line with "end"
+	//   instance <mesh> <material> [cull back|front|none] [translate x y z] [rotate x y z] [scale x y z] [spin degrees per second]
+	namespace SceneFile
+	{
+		// By extension : .scenebundle -> LoadBundle, anything else -> Parse
+		bool Load(const std::string& filePath, SceneDescription& scene);
+
+		// Returns false with the reason ( file:line : message ) when the file can't be read or has an invalid statement
+		bool Parse(const std::string& filePath, SceneDescription& scene, std::string* pError = nullptr);
+
+		bool WriteBundle(const std::string& bundlePath, const SceneDescription& scene);
+		bool LoadBundle(const std::string& bundlePath, SceneDescription& scene);
+
+		// Offline step : text scene -> bundle, prints what it did and how long parsing, writing and loading it back took
+		bool Compile(const std::string& scenePath, const std::string& bundlePath);
+		// "Scenes/Bunny.scene" -> "Scenes/Bunny.scenebundle"
+		std::string GetBundlePath(const std::string& scenePath);
+	}
+}
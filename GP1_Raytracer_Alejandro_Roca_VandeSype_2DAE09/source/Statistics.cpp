@@ -0,0 +1,58 @@
+#include "Statistics.h"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace dae
+{
+	namespace Statistics
+	{
+		namespace
+		{
+			struct Registry
+			{
+				std::mutex mutex{};
+				std::vector<ThreadCounters*> threads{};
+				RayCounters stoppedThreads{};
+			};
+
+			// Function static -> constructed before the first thread registers, whatever the initialization order
+			Registry& GetRegistry()
+			{
+				static Registry registry{};
+				return registry;
+			}
+		}
+
+		ThreadCounters::ThreadCounters()
+		{
+			Registry& registry{ GetRegistry() };
+			const std::lock_guard<std::mutex> lock{ registry.mutex };
+			registry.threads.emplace_back(this);
+		}
+
+		ThreadCounters::~ThreadCounters()
+		{
+			Registry& registry{ GetRegistry() };
+			const std::lock_guard<std::mutex> lock{ registry.mutex };
+			registry.stoppedThreads += counters;
+			registry.threads.erase(std::remove(registry.threads.begin(), registry.threads.end(), this), registry.threads.end());
+		}
+
+		RayCounters CollectCounters()
+		{
+			Registry& registry{ GetRegistry() };
+			const std::lock_guard<std::mutex> lock{ registry.mutex };
+
+			RayCounters total{ registry.stoppedThreads };
+			registry.stoppedThreads = {};
+			for (ThreadCounters* pThread : registry.threads)
+			{
+				total += pThread->counters;
+				pThread->counters = {};
+			}
+			return total;
+		}
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+
+// RAY_STATISTICS ( Project define ) : count the rays and intersection tests of every thread ( Benchmarks, traversal cost heatmap )
+// ... The counters cost a bit of performance in the traversal loops -> on in the headless and Debug builds, off in the RayTracer Release build
+
+namespace dae
+{
+	struct RayCounters
+	{
+		uint64_t primaryRays{};
+		uint64_t shadowRays{};
+		uint64_t bounceRays{};		// Path tracing : rays after the first hit
+		uint64_t aabbTests{};		// Ray / box slab tests ( BVH nodes, mesh bounds )
+		uint64_t triangleTests{};
+		uint64_t sphereTests{};
+		uint64_t planeTests{};
+		uint64_t shadingCalls{};
+
+		uint64_t GetRayCount() const { return primaryRays + shadowRays + bounceRays; }
+		uint64_t GetPrimitiveTestCount() const { return triangleTests + sphereTests + planeTests; }
+		// Everything a ray tests on its way through the scene
+		uint64_t GetTraversalCost() const { return aabbTests + GetPrimitiveTestCount(); }
+
+		RayCounters& operator+=(const RayCounters& other)
+		{
+			primaryRays += other.primaryRays;
+			shadowRays += other.shadowRays;
+			bounceRays += other.bounceRays;
+			aabbTests += other.aabbTests;
+			triangleTests += other.triangleTests;
+			sphereTests += other.sphereTests;
+			planeTests += other.planeTests;
+			shadingCalls += other.shadingCalls;
+			return *this;
+		}
+	};
+
+	namespace Statistics
+	{
+		// Every thread counts in its own block ( No atomics or locks while tracing )
+		// ... The blocks register themselves on first use, CollectCounters sums them
+		struct ThreadCounters
+		{
+			ThreadCounters();
+			~ThreadCounters();	// Counts of a thread that stops are kept for the next CollectCounters
+
+			ThreadCounters(const ThreadCounters&) = delete;
+			ThreadCounters(ThreadCounters&&) noexcept = delete;
+			ThreadCounters& operator=(const ThreadCounters&) = delete;
+			ThreadCounters& operator=(ThreadCounters&&) noexcept = delete;
+
+			RayCounters counters{};
+		};
+
+		inline thread_local ThreadCounters g_ThreadCounters{};
+
+		// Counters of the calling thread
+		inline RayCounters& GetThreadCounters() { return g_ThreadCounters.counters; }
+
+		// Sum of all threads since the previous call, every thread starts from 0 again
+		// ... Only call while nothing is being traced ( Between frames )
+		RayCounters CollectCounters();
+
+#ifdef RAY_STATISTICS
+		constexpr bool IsEnabled{ true };
+#else
+		constexpr bool IsEnabled{ false };
+#endif
+	}
+}
@@ -0,0 +1,159 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace dae
+{
+	ThreadPool::ThreadPool(uint32_t threadCount)
+	{
+		StartWorkers(threadCount);
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		StopWorkers();
+	}
+
+	void ThreadPool::SetThreadCount(uint32_t threadCount)
+	{
+		StopWorkers();
+		StartWorkers(threadCount);
+	}
+
+	void ThreadPool::Run(uint32_t taskCount, const std::function<void(uint32_t)>& task)
+	{
+		if (taskCount == 0)
+			return;
+
+		// Set before any task is handed out, a worker can pick up a task as soon as it is in a queue
+		m_pTask = &task;
+		m_RemainingTasks = taskCount;
+
+		// Contiguous range per thread, the first ones get one task more when it doesn't divide evenly
+		const uint32_t threadCount{ GetThreadCount() };
+		uint32_t taskIdx{ 0 };
+		for (uint32_t threadIdx{ 0 }; threadIdx < threadCount; ++threadIdx)
+		{
+			const uint32_t rangeSize{ taskCount / threadCount + (threadIdx < taskCount % threadCount ? 1 : 0) };
+
+			WorkQueue& queue{ *m_Queues[threadIdx] };
+			const std::lock_guard<std::mutex> lock{ queue.mutex };
+			for (uint32_t index{ 0 }; index < rangeSize; ++index)
+				queue.tasks.push_back(taskIdx++);
+		}
+
+		{
+			const std::lock_guard<std::mutex> lock{ m_Mutex };
+			++m_Batch;
+		}
+		m_WakeUp.notify_all();
+
+		// The calling thread helps instead of waiting
+		ProcessTasks(0);
+
+		// Wait for the last tasks, and for every worker to be out of ProcessTasks ( task is about to go out of scope )
+		std::unique_lock<std::mutex> lock{ m_Mutex };
+		m_Done.wait(lock, [this] { return m_RemainingTasks == 0 && m_BusyWorkers == 0; });
+	}
+
+	void ThreadPool::StartWorkers(uint32_t threadCount)
+	{
+		if (threadCount == 0)
+			threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+		m_Stop = false;
+		m_Queues.clear();
+		for (uint32_t threadIdx{ 0 }; threadIdx < threadCount; ++threadIdx)
+			m_Queues.emplace_back(std::make_unique<WorkQueue>());
+
+		// Queue 0 is the one of the thread calling Run
+		for (uint32_t threadIdx{ 1 }; threadIdx < threadCount; ++threadIdx)
+			m_Workers.emplace_back(&ThreadPool::WorkerLoop, this, threadIdx);
+	}
+
+	void ThreadPool::StopWorkers()
+	{
+		{
+			const std::lock_guard<std::mutex> lock{ m_Mutex };
+			m_Stop = true;
+		}
+		m_WakeUp.notify_all();
+
+		for (std::thread& worker : m_Workers)
+			worker.join();
+
+		m_Workers.clear();
+	}
+
+	void ThreadPool::WorkerLoop(uint32_t threadIdx)
+	{
+		uint64_t lastBatch{ 0 };
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock{ m_Mutex };
+				m_WakeUp.wait(lock, [&] { return m_Stop || m_Batch != lastBatch; });
+				if (m_Stop)
+					return;
+
+				lastBatch = m_Batch;
+				++m_BusyWorkers;
+			}
+
+			ProcessTasks(threadIdx);
+
+			{
+				const std::lock_guard<std::mutex> lock{ m_Mutex };
+				--m_BusyWorkers;
+			}
+			m_Done.notify_all();
+		}
+	}
+
+	void ThreadPool::ProcessTasks(uint32_t threadIdx)
+	{
+		uint32_t taskIdx{};
+		while (PopTask(threadIdx, taskIdx))
+		{
+			(*m_pTask.load())(taskIdx);
+
+			// Last task of the batch -> wake up the thread waiting in Run
+			if (m_RemainingTasks.fetch_sub(1) == 1)
+			{
+				const std::lock_guard<std::mutex> lock{ m_Mutex };
+				m_Done.notify_all();
+			}
+		}
+	}
+
+	bool ThreadPool::PopTask(uint32_t threadIdx, uint32_t& taskIdx)
+	{
+		// Own queue first, in order
+		{
+			WorkQueue& queue{ *m_Queues[threadIdx] };
+			const std::lock_guard<std::mutex> lock{ queue.mutex };
+			if (!queue.tasks.empty())
+			{
+				taskIdx = queue.tasks.front();
+				queue.tasks.pop_front();
+				return true;
+			}
+		}
+
+		// Steal from the back of the others ( Furthest away from what their owner is working on )
+		const uint32_t threadCount{ GetThreadCount() };
+		for (uint32_t offset{ 1 }; offset < threadCount; ++offset)
+		{
+			WorkQueue& queue{ *m_Queues[(threadIdx + offset) % threadCount] };
+			const std::lock_guard<std::mutex> lock{ queue.mutex };
+			if (!queue.tasks.empty())
+			{
+				taskIdx = queue.tasks.back();
+				queue.tasks.pop_back();
+				return true;
+			}
+		}
+
+		return false;
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	// Fixed set of worker threads that run batches of tasks ( A task is just an index in [0, taskCount) )
+	// Work stealing : every thread owns a deque filled with a contiguous range of the tasks
+	// ... it takes tasks from the front of its own deque, once that one is empty it steals from the back of the others
+	// ... Neighbouring tasks stay on the same thread, only the tail of a slow range moves to an idle one
+	class ThreadPool final
+	{
+	public:
+		// 0 -> one thread per hardware thread. The thread calling Run counts as one of them
+		explicit ThreadPool(uint32_t threadCount = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) noexcept = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool& operator=(ThreadPool&&) noexcept = delete;
+
+		// Runs task(taskIdx) for every taskIdx in [0, taskCount) and returns once all of them are done
+		void Run(uint32_t taskCount, const std::function<void(uint32_t)>& task);
+
+		void SetThreadCount(uint32_t threadCount);
+		uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_Queues.size()); }
+
+	private:
+		struct WorkQueue
+		{
+			std::mutex mutex{};
+			std::deque<uint32_t> tasks{};
+		};
+
+		std::vector<std::thread> m_Workers{};
+		std::vector<std::unique_ptr<WorkQueue>> m_Queues{};		// One per thread, [0] belongs to the thread calling Run
+
+		std::atomic<const std::function<void(uint32_t)>*> m_pTask{ nullptr };
+		std::atomic<uint32_t> m_RemainingTasks{ 0 };
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_WakeUp{};		// New batch ( Or shutting down )
+		std::condition_variable m_Done{};		// Batch finished
+		uint64_t m_Batch{ 0 };
+		uint32_t m_BusyWorkers{ 0 };
+		bool m_Stop{ false };
+
+		void StartWorkers(uint32_t threadCount);
+		void StopWorkers();
+		void WorkerLoop(uint32_t threadIdx);
+		void ProcessTasks(uint32_t threadIdx);
+		bool PopTask(uint32_t threadIdx, uint32_t& taskIdx);
+	};
+}
@@ -1,35 +1,48 @@
 #include "Timer.h"
 
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
 #include <iostream>
 #include <numeric>
 
 #include <iostream>
 #include <fstream>
 
-#include "SDL.h"
 using namespace dae;
 
+namespace
+{
+	// Steady clock instead of the SDL performance counter -> the timer works without SDL ( Headless )
+	using Clock = std::chrono::steady_clock;
+
+	uint64_t GetPerformanceCounter()
+	{
+		return static_cast<uint64_t>(Clock::now().time_since_epoch().count());
+	}
+}
+
 Timer::Timer()
 {
-	const uint64_t countsPerSecond = SDL_GetPerformanceFrequency();
-	m_SecondsPerCount = 1.0f / static_cast<float>(countsPerSecond);
+	m_SecondsPerCount = static_cast<float>(Clock::period::num) / static_cast<float>(Clock::period::den);
 }
 
 void Timer::Reset()
 {
-	const uint64_t currentTime = SDL_GetPerformanceCounter();
+	const uint64_t currentTime = GetPerformanceCounter();
 
 	m_BaseTime = currentTime;
 	m_PreviousTime = currentTime;
 	m_StopTime = 0;
 	m_FPSTimer = 0.0f;
 	m_FPSCount = 0;
+	m_FixedTotalTime = 0.0f;
 	m_IsStopped = false;
 }
 
 void Timer::Start()
 {
-	const uint64_t startTime = SDL_GetPerformanceCounter();
+	const uint64_t startTime = GetPerformanceCounter();
 
 	if (m_IsStopped)
 	{
@@ -74,7 +87,7 @@ void Timer::Update()
 		return;
 	}
 
-	const uint64_t currentTime = SDL_GetPerformanceCounter();
+	const uint64_t currentTime = GetPerformanceCounter();
 	m_CurrentTime = currentTime;
 
 	m_ElapsedTime = (float)((m_CurrentTime - m_PreviousTime) * m_SecondsPerCount);
@@ -90,6 +103,14 @@ void Timer::Update()
 
 	m_TotalTime = (float)(((m_CurrentTime - m_PausedTime) - m_BaseTime) * m_SecondsPerCount);
 
+	// Simulated time ( The FPS below follow it as well )
+	if (m_FixedTimeStep > 0.0f)
+	{
+		m_ElapsedTime = m_FixedTimeStep;
+		m_FixedTotalTime += m_FixedTimeStep;
+		m_TotalTime = m_FixedTotalTime;
+	}
+
 	//FPS LOGIC
 	m_FPSTimer += m_ElapsedTime;
 	++m_FPSCount;
@@ -135,7 +156,7 @@ void Timer::Stop()
 {
 	if (!m_IsStopped)
 	{
-		const uint64_t currentTime = SDL_GetPerformanceCounter();
+		const uint64_t currentTime = GetPerformanceCounter();
 
 		m_StopTime = currentTime;
 		m_IsStopped = true;
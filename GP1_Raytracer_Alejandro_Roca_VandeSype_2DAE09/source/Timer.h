@@ -30,6 +30,10 @@ namespace dae
 		float GetTotal() const { return m_TotalTime; };
 		bool IsRunning() const { return !m_IsStopped; };
 
+		// Every Update advances the time by exactly this many seconds, whatever the real time was ( 0 = real time )
+		// ... Offline renders animate the same no matter how long a frame takes
+		void SetFixedTimeStep(float timeStep) { m_FixedTimeStep = timeStep; };
+
 	private:
 		uint64_t m_BaseTime = 0;
 		uint64_t m_PausedTime = 0;
@@ -47,6 +51,9 @@ namespace dae
 		float m_ElapsedUpperBound = 0.03f;
 		float m_FPSTimer = 0.0f;
 
+		float m_FixedTimeStep = 0.0f;
+		float m_FixedTotalTime = 0.0f;
+
 		bool m_IsStopped = true;
 		bool m_ForceElapsedUpperBound = false;
 
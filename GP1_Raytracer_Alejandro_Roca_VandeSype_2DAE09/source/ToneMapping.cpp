@@ -0,0 +1,176 @@
+#include "ToneMapping.h"
+
+#include <array>
+#include <cmath>
+
+#include "RenderTarget.h"
+#include "VectorBatch.h"
+
+namespace dae
+{
+	namespace
+	{
+		// Linear values are quantized to 4096 steps before the lookup ( Less than one 8 bit step apart, even in the dark part )
+		constexpr int SRGBTableSize{ 4096 };
+		constexpr float SRGBTableScale{ SRGBTableSize - 1 };
+
+		// Function static -> built on first use, from any thread
+		const std::array<uint32_t, SRGBTableSize>& GetSRGBTable()
+		{
+			static const std::array<uint32_t, SRGBTableSize> table{ []()
+				{
+					std::array<uint32_t, SRGBTableSize> values{};
+					for (int idx{ 0 }; idx < SRGBTableSize; ++idx)
+					{
+						const float linear{ idx / SRGBTableScale };
+						const float encoded{ linear <= 0.0031308f ? 12.92f * linear : 1.055f * std::pow(linear, 1.f / 2.4f) - 0.055f };
+						values[idx] = static_cast<uint32_t>(encoded * 255.f + 0.5f);
+					}
+					return values;
+				}() };
+			return table;
+		}
+
+		// Scalar version of every step, the AVX2 path below does the same operations in the same order
+		float ToneMapChannel(float value, ToneMapper toneMapper)
+		{
+			switch (toneMapper)
+			{
+			case ToneMapper::Reinhard:
+				return value / (1.f + value);
+			case ToneMapper::ACES:
+				return (value * (2.51f * value + 0.03f)) / (value * (2.43f * value + 0.59f) + 0.14f);
+			default:
+				return value;
+			}
+		}
+
+		// [0, 1], NaN -> 0
+		float Saturate(float value)
+		{
+			value = value > 0.f ? value : 0.f;
+			return value < 1.f ? value : 1.f;
+		}
+
+		uint32_t EncodeChannel(float value, bool sRGB)
+		{
+			if (sRGB)
+				return GetSRGBTable()[static_cast<int>(value * SRGBTableScale + 0.5f)];
+			return static_cast<uint32_t>(value * 255.f);
+		}
+
+#ifdef MATH_AVX2
+		__m256 ToneMapChannel(__m256 value, ToneMapper toneMapper)
+		{
+			switch (toneMapper)
+			{
+			case ToneMapper::Reinhard:
+				return _mm256_div_ps(value, _mm256_add_ps(_mm256_set1_ps(1.f), value));
+			case ToneMapper::ACES:
+			{
+				const __m256 numerator{ _mm256_mul_ps(value, _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(2.51f), value), _mm256_set1_ps(0.03f))) };
+				const __m256 denominator{ _mm256_add_ps(_mm256_mul_ps(value,
+					_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(2.43f), value), _mm256_set1_ps(0.59f))), _mm256_set1_ps(0.14f)) };
+				return _mm256_div_ps(numerator, denominator);
+			}
+			default:
+				return value;
+			}
+		}
+
+		// max / min return their second operand for NaN -> same as Saturate
+		__m256 Saturate(__m256 value)
+		{
+			return _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(1.f));
+		}
+
+		__m256i EncodeChannel(__m256 value, bool sRGB)
+		{
+			if (sRGB)
+			{
+				const __m256i index{ _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(value, _mm256_set1_ps(SRGBTableScale)), _mm256_set1_ps(0.5f))) };
+				return _mm256_i32gather_epi32(reinterpret_cast<const int*>(GetSRGBTable().data()), index, 4);
+			}
+			return _mm256_cvttps_epi32(_mm256_mul_ps(value, _mm256_set1_ps(255.f)));
+		}
+#endif
+	}
+
+	void DisplayMapper::Update(const RenderTarget& target, const DisplaySettings& settings)
+	{
+		m_Settings = settings;
+		m_RedShift = target.GetRedShift();
+		m_GreenShift = target.GetGreenShift();
+		m_BlueShift = target.GetBlueShift();
+		m_AlphaMask = target.GetAlphaMask();
+	}
+
+	uint32_t DisplayMapper::PackPixel(const ColorRGB& color) const
+	{
+		ColorRGB mapped{ color * m_Settings.exposure };
+		if (m_Settings.toneMapper == ToneMapper::MaxToOne)
+		{
+			mapped.MaxToOne();
+		}
+		else
+		{
+			mapped.r = ToneMapChannel(mapped.r, m_Settings.toneMapper);
+			mapped.g = ToneMapChannel(mapped.g, m_Settings.toneMapper);
+			mapped.b = ToneMapChannel(mapped.b, m_Settings.toneMapper);
+		}
+
+		return (EncodeChannel(Saturate(mapped.r), m_Settings.sRGB) << m_RedShift)
+			| (EncodeChannel(Saturate(mapped.g), m_Settings.sRGB) << m_GreenShift)
+			| (EncodeChannel(Saturate(mapped.b), m_Settings.sRGB) << m_BlueShift) | m_AlphaMask;
+	}
+
+	void DisplayMapper::PackPixels(const ColorRGB* pColors, uint32_t* pPixels, uint32_t count) const
+	{
+		uint32_t idx{ 0 };
+#ifdef MATH_AVX2
+		const __m256 exposure{ _mm256_set1_ps(m_Settings.exposure) };
+		const __m128i redShift{ _mm_cvtsi32_si128(m_RedShift) };
+		const __m128i greenShift{ _mm_cvtsi32_si128(m_GreenShift) };
+		const __m128i blueShift{ _mm_cvtsi32_si128(m_BlueShift) };
+		const __m256i alphaMask{ _mm256_set1_epi32(static_cast<int>(m_AlphaMask)) };
+
+		for (; idx + 8 <= count; idx += 8)
+		{
+			__m256 r, g, b;
+			VectorBatch::LoadSoA8(&pColors[idx].r, r, g, b);
+			r = _mm256_mul_ps(r, exposure);
+			g = _mm256_mul_ps(g, exposure);
+			b = _mm256_mul_ps(b, exposure);
+
+			if (m_Settings.toneMapper == ToneMapper::MaxToOne)
+			{
+				// Divide only the colors brighter than 1 ( Same division as ColorRGB::MaxToOne )
+				const __m256 maxValue{ _mm256_max_ps(r, _mm256_max_ps(g, b)) };
+				const __m256 divisor{ _mm256_blendv_ps(_mm256_set1_ps(1.f), maxValue, _mm256_cmp_ps(maxValue, _mm256_set1_ps(1.f), _CMP_GT_OQ)) };
+				r = _mm256_div_ps(r, divisor);
+				g = _mm256_div_ps(g, divisor);
+				b = _mm256_div_ps(b, divisor);
+			}
+			else
+			{
+				r = ToneMapChannel(r, m_Settings.toneMapper);
+				g = ToneMapChannel(g, m_Settings.toneMapper);
+				b = ToneMapChannel(b, m_Settings.toneMapper);
+			}
+
+			const __m256i pixels{ _mm256_or_si256(_mm256_or_si256(
+				_mm256_sll_epi32(EncodeChannel(Saturate(r), m_Settings.sRGB), redShift),
+				_mm256_sll_epi32(EncodeChannel(Saturate(g), m_Settings.sRGB), greenShift)),
+				_mm256_or_si256(_mm256_sll_epi32(EncodeChannel(Saturate(b), m_Settings.sRGB), blueShift), alphaMask)) };
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(pPixels + idx), pixels);
+		}
+#endif
+		for (; idx < count; ++idx)
+			pPixels[idx] = PackPixel(pColors[idx]);
+	}
+
+	uint8_t DisplayMapper::EncodeSRGB(float value)
+	{
+		return static_cast<uint8_t>(EncodeChannel(Saturate(value), true));
+	}
+}
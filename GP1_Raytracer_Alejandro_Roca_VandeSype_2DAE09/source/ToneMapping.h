@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+
+#include "ColorRGB.h"
+
+namespace dae
+{
+	class RenderTarget;
+
+	// HDR color ( Radiance ) -> [0, 1] display value
+	enum class ToneMapper : uint8_t
+	{
+		MaxToOne,		// Scale the color down until its biggest channel is 1 ( Keeps the hue, what ColorRGB::MaxToOne does )
+		Reinhard,		// c / (1 + c) per channel
+		ACES			// Filmic curve ( Narkowicz fit of the ACES reference transform )
+	};
+
+	// How the linear colors of the renderer end up on screen
+	// ... The defaults give the same pixels as clamping the color and writing it without gamma
+	struct DisplaySettings
+	{
+		float exposure{ 1.f };		// Multiplies the color before the tone mapping
+		ToneMapper toneMapper{ ToneMapper::MaxToOne };
+		bool sRGB{ false };			// Encode with the sRGB curve instead of writing the linear value
+
+		bool operator==(const DisplaySettings& other) const = default;
+	};
+
+	// Converts whole rows of HDR colors to the 32 bit pixels of a render target
+	// ... Exposure, tone mapping, sRGB table and channel packing in one pass, 8 pixels at a time with AVX2
+	class DisplayMapper final
+	{
+	public:
+		// Channel layout of the target + settings, call before a frame is packed
+		void Update(const RenderTarget& target, const DisplaySettings& settings);
+		const DisplaySettings& GetSettings() const { return m_Settings; }
+
+		void PackPixels(const ColorRGB* pColors, uint32_t* pPixels, uint32_t count) const;
+		uint32_t PackPixel(const ColorRGB& color) const;
+
+		// Linear [0, 1] -> 8 bit sRGB, through the same table as the packing
+		static uint8_t EncodeSRGB(float value);
+
+	private:
+		DisplaySettings m_Settings{};
+		uint8_t m_RedShift{ 16 };
+		uint8_t m_GreenShift{ 8 };
+		uint8_t m_BlueShift{ 0 };
+		uint32_t m_AlphaMask{ 0 };
+	};
+}
@@ -0,0 +1,906 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "FastMath.h"
+#include "Math.h"
+#include "Material.h"
+#include "ObjLoader.h"
+#include "Renderer.h"
+#include "RenderTarget.h"
+#include "Scene.h"
+#include "SceneFile.h"
+#include "ToneMapping.h"
+#include "Utils.h"
+
+
+namespace dae
+{
+	namespace
+	{
+		// Only for types without padding
+		template<typename Type>
+		bool AreSameBytes(const std::vector<Type>& a, const std::vector<Type>& b)
+		{
+			return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(Type)) == 0);
+		}
+
+		// Random shading setup : light and view on the front side of the normal ( Like the renderer shades them )
+		struct ShadingSample
+		{
+			HitRecord hit{};
+			Vector3 l{};
+			Vector3 v{};
+		};
+
+		std::vector<ShadingSample> CreateShadingSamples(uint32_t count)
+		{
+			std::mt19937 generator{ 7 };
+			std::uniform_real_distribution<float> distribution{ -1.f, 1.f };
+			const auto randomDirection = [&]() { return Vector3{ distribution(generator), distribution(generator), distribution(generator) }.Normalized(); };
+
+			std::vector<ShadingSample> samples(count);
+			for (ShadingSample& sample : samples)
+			{
+				sample.hit.normal = randomDirection();
+				sample.l = randomDirection();
+				if (Vector3::Dot(sample.l, sample.hit.normal) < 0.f)
+					sample.l = -sample.l;
+				sample.v = randomDirection();
+				if (Vector3::Dot(sample.v, sample.hit.normal) > 0.f)
+					sample.v = -sample.v;
+			}
+			return samples;
+		}
+
+		// Largest error of the fast BRDF, relative to the exact one ( Absolute below 1 )
+		float GetMaxShadingError(const Material& material)
+		{
+			float maxError{ 0.f };
+			for (const ShadingSample& sample : CreateShadingSamples(100000))
+			{
+				const ColorRGB exact{ MaterialUtils::Shade(material, sample.hit, sample.l, sample.v, ShadingMode::Exact) };
+				const ColorRGB fast{ MaterialUtils::Shade(material, sample.hit, sample.l, sample.v, ShadingMode::Fast) };
+				maxError = std::max(maxError, std::abs(fast.r - exact.r) / std::max(exact.r, 1.f));
+				maxError = std::max(maxError, std::abs(fast.g - exact.g) / std::max(exact.g, 1.f));
+				maxError = std::max(maxError, std::abs(fast.b - exact.b) / std::max(exact.b, 1.f));
+			}
+			return maxError;
+		}
+
+		std::vector<uint8_t> RenderImage(const std::string& sceneName, Renderer::Integrator integrator, bool wavefront, ShadingMode shadingMode)
+		{
+			const std::unique_ptr<Scene> pScene{ CreateScene(sceneName) };
+			pScene->Initialize();
+
+			MemoryRenderTarget renderTarget{ 160, 120 };
+			Renderer renderer{ &renderTarget };
+			renderer.SetIntegrator(integrator);
+			renderer.SetWavefront(wavefront);
+			renderer.SetShadingMode(shadingMode);
+			renderer.Render(pScene.get());
+
+			std::vector<uint8_t> channels{};
+			for (int pixelIdx{ 0 }; pixelIdx < renderTarget.GetWidth() * renderTarget.GetHeight(); ++pixelIdx)
+			{
+				uint8_t r{}, g{}, b{};
+				renderTarget.UnpackColor(renderTarget.GetPixels()[pixelIdx], r, g, b);
+				channels.insert(channels.end(), { r, g, b });
+			}
+			return channels;
+		}
+
+		// Not a multiple of 8 or 4 -> the AVX2, SSE and scalar loops all run
+		constexpr int BatchVectorCount{ 27 };
+
+		std::vector<Vector3> CreateRandomVectors(uint32_t seed)
+		{
+			std::mt19937 generator{ seed };
+			std::uniform_real_distribution<float> distribution{ -10.f, 10.f };
+
+			std::vector<Vector3> vectors(BatchVectorCount);
+			for (Vector3& vector : vectors)
+				vector = Vector3{ distribution(generator), distribution(generator), distribution(generator) };
+			return vectors;
+		}
+
+		Matrix CreateTestMatrix()
+		{
+			return Matrix::CreateScale(1.f, 2.f, 0.5f) * Matrix::CreateRotation(0.3f, 1.1f, -0.4f) * Matrix::CreateTranslation(1.f, -2.f, 3.f);
+		}
+
+		// The math types work at compile time
+		constexpr Matrix ConstantMatrix{ Matrix::CreateTranslation(1.f, 2.f, 3.f) * Matrix::CreateScale(2.f, 2.f, 2.f) };
+		static_assert(Vector3::Dot(Vector3::UnitX, Vector3{ 3.f, 4.f, 5.f }) == 3.f);
+		static_assert(Vector3::Cross(Vector3::UnitX, Vector3::UnitY).z == 1.f);
+		static_assert((Vector3{ 1.f, 2.f, 3.f } * 2.f - Vector3{ 2.f, 4.f, 6.f }).SqrMagnitude() == 0.f);
+		static_assert(ConstantMatrix.TransformPoint(Vector3{ 1.f, 1.f, 1.f }).x == 4.f);
+		static_assert(ConstantMatrix.TransformVector(Vector3{ 1.f, 1.f, 1.f }).z == 2.f);
+		static_assert(Matrix::Transpose(ConstantMatrix)[0].w == 2.f);
+
+		// Fast shading against exact shading, same scene and settings ( Every sample uses the same random numbers )
+		void ExpectImageErrorBounded(const std::string& sceneName, Renderer::Integrator integrator, bool wavefront)
+		{
+			const std::vector<uint8_t> exact{ RenderImage(sceneName, integrator, wavefront, ShadingMode::Exact) };
+			const std::vector<uint8_t> fast{ RenderImage(sceneName, integrator, wavefront, ShadingMode::Fast) };
+			ASSERT_EQ(exact.size(), fast.size());
+
+			int maxError{ 0 };
+			double totalError{ 0.0 };
+			for (size_t channelIdx{ 0 }; channelIdx < exact.size(); ++channelIdx)
+			{
+				const int error{ std::abs(static_cast<int>(exact[channelIdx]) - static_cast<int>(fast[channelIdx])) };
+				maxError = std::max(maxError, error);
+				totalError += error;
+			}
+
+			EXPECT_LE(maxError, 2) << sceneName;
+			EXPECT_LE(totalError / exact.size(), 0.01) << sceneName;
+		}
+
+		// Vector3 has no operator== ( Floats are compared with AreEqual ), the loader has to give the exact values back
+		bool AreSame(const Vector3& a, const Vector3& b)
+		{
+			return a.x == b.x && a.y == b.y && a.z == b.z;
+		}
+
+		bool AreSame(const std::vector<Vector3>& a, const std::vector<Vector3>& b)
+		{
+			return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const Vector3& left, const Vector3& right) { return AreSame(left, right); });
+		}
+	}
+
+	TEST(FastMath, Log2AndExp2)
+	{
+		for (float x{ 0.001f }; x < 1000.f; x *= 1.01f)
+		{
+			EXPECT_NEAR(FastMath::Log2(x), std::log2(x), 2e-5f) << x;
+		}
+		for (float x{ -20.f }; x < 20.f; x += 0.01f)
+		{
+			EXPECT_NEAR(FastMath::Exp2(x) / std::exp2(x), 1.f, 1e-5f) << x;
+		}
+		EXPECT_EQ(FastMath::Exp2(-200.f), 0.f);
+	}
+
+	TEST(FastMath, Pow)
+	{
+		for (float exponent : { 1.f, 3.f, 15.f, 60.f })
+		{
+			for (float base{ 0.01f }; base <= 1.f; base += 0.01f)
+			{
+				const float exact{ std::pow(base, exponent) };
+				EXPECT_NEAR(FastMath::Pow(base, exponent), exact, 1e-3f * exact + 1e-30f) << base << " ^ " << exponent;
+			}
+		}
+		EXPECT_EQ(FastMath::Pow(0.f, 60.f), 0.f);
+	}
+
+	TEST(FastMath, InvSqrt)
+	{
+		for (float x{ 0.001f }; x < 1000.f; x *= 1.01f)
+			EXPECT_NEAR(FastMath::InvSqrt(x) * std::sqrt(x), 1.f, 1e-5f) << x;
+	}
+
+	TEST(VectorBatch, DotMatchesVector3)
+	{
+		const std::vector<Vector3> a{ CreateRandomVectors(1) };
+		const std::vector<Vector3> b{ CreateRandomVectors(2) };
+
+		float dots[8]{};
+		VectorBatch::Dot4(a.data(), b.data(), dots);
+		for (int idx{ 0 }; idx < 4; ++idx)
+			EXPECT_FLOAT_EQ(dots[idx], Vector3::Dot(a[idx], b[idx])) << idx;
+
+		VectorBatch::Dot8(a.data() + 8, b.data() + 8, dots);
+		for (int idx{ 0 }; idx < 8; ++idx)
+			EXPECT_FLOAT_EQ(dots[idx], Vector3::Dot(a[idx + 8], b[idx + 8])) << idx;
+
+		std::vector<float> ax, ay, az, bx, by, bz;
+		for (int idx{ 0 }; idx < BatchVectorCount; ++idx)
+		{
+			ax.emplace_back(a[idx].x); ay.emplace_back(a[idx].y); az.emplace_back(a[idx].z);
+			bx.emplace_back(b[idx].x); by.emplace_back(b[idx].y); bz.emplace_back(b[idx].z);
+		}
+		std::vector<float> soaDots(BatchVectorCount);
+		VectorBatch::Dot(ax.data(), ay.data(), az.data(), bx.data(), by.data(), bz.data(), soaDots.data(), BatchVectorCount);
+		for (int idx{ 0 }; idx < BatchVectorCount; ++idx)
+			EXPECT_FLOAT_EQ(soaDots[idx], Vector3::Dot(a[idx], b[idx])) << idx;
+	}
+
+	TEST(VectorBatch, TransformMatchesMatrix)
+	{
+		const Matrix matrix{ CreateTestMatrix() };
+		const std::vector<Vector3> vectors{ CreateRandomVectors(3) };
+
+		std::vector<Vector3> points(BatchVectorCount);
+		VectorBatch::TransformPoints(matrix, vectors.data(), points.data(), BatchVectorCount);
+
+		// In place
+		std::vector<Vector3> directions{ vectors };
+		VectorBatch::TransformVectors(matrix, directions.data(), directions.data(), BatchVectorCount);
+
+		for (int idx{ 0 }; idx < BatchVectorCount; ++idx)
+		{
+			const Vector3 point{ matrix.TransformPoint(vectors[idx]) };
+			const Vector3 direction{ matrix.TransformVector(vectors[idx]) };
+			for (int axis{ 0 }; axis < 3; ++axis)
+			{
+				EXPECT_FLOAT_EQ(points[idx][axis], point[axis]) << idx;
+				EXPECT_FLOAT_EQ(directions[idx][axis], direction[axis]) << idx;
+			}
+		}
+	}
+
+	TEST(VectorBatch, TransformSoAMatchesMatrix)
+	{
+		const Matrix matrix{ CreateTestMatrix() };
+		const std::vector<Vector3> vectors{ CreateRandomVectors(4) };
+
+		std::vector<float> x, y, z;
+		for (const Vector3& vector : vectors)
+		{
+			x.emplace_back(vector.x);
+			y.emplace_back(vector.y);
+			z.emplace_back(vector.z);
+		}
+
+		std::vector<float> outX(BatchVectorCount), outY(BatchVectorCount), outZ(BatchVectorCount);
+		VectorBatch::TransformVectors(matrix, x.data(), y.data(), z.data(), outX.data(), outY.data(), outZ.data(), BatchVectorCount);
+		for (int idx{ 0 }; idx < BatchVectorCount; ++idx)
+		{
+			const Vector3 direction{ matrix.TransformVector(vectors[idx]) };
+			EXPECT_FLOAT_EQ(outX[idx], direction.x) << idx;
+			EXPECT_FLOAT_EQ(outY[idx], direction.y) << idx;
+			EXPECT_FLOAT_EQ(outZ[idx], direction.z) << idx;
+		}
+	}
+
+	TEST(Matrix, InverseAndProduct)
+	{
+		const Matrix matrix{ CreateTestMatrix() };
+		const Matrix identity{ matrix * Matrix::Inverse(matrix) };
+		for (int row{ 0 }; row < 4; ++row)
+		{
+			for (int column{ 0 }; column < 4; ++column)
+				EXPECT_NEAR(identity[row][column], row == column ? 1.f : 0.f, 1e-5f) << row << ", " << column;
+		}
+
+		// Every component of the translation ends up in the last row
+		const Vector3 translation{ Matrix::CreateTranslation(1.f, 2.f, 3.f).GetTranslation() };
+		EXPECT_EQ(translation.y, 2.f);
+		EXPECT_EQ(translation.z, 3.f);
+	}
+
+	TEST(BVH, DegenerateInput)
+	{
+		// Thousands of coincident centroids ( No SAH split possible ) next to boxes that each double in size
+		std::vector<AABB> bounds(10000);
+		for (size_t boxIdx{ 0 }; boxIdx < bounds.size(); ++boxIdx)
+		{
+			const float size{ boxIdx < 100 ? std::ldexp(1.f, static_cast<int>(boxIdx)) : 1.f };
+			bounds[boxIdx].Grow(Vector3{ size, 0.f, 0.f });
+			bounds[boxIdx].Grow(Vector3{ 2.f * size, 1.f, 1.f });
+		}
+
+		BVH bvh{};
+		bvh.Build(bounds);
+
+		// Depth of every node, children always come after their parent
+		const std::vector<BVHNode>& nodes{ bvh.GetNodes() };
+		std::vector<uint32_t> depths(nodes.size());
+		uint32_t maxDepth{ 0 };
+		uint32_t primitiveCount{ 0 };
+		for (size_t nodeIdx{ 0 }; nodeIdx < nodes.size(); ++nodeIdx)
+		{
+			maxDepth = std::max(maxDepth, depths[nodeIdx]);
+			if (nodes[nodeIdx].IsLeaf())
+			{
+				EXPECT_LE(nodes[nodeIdx].primitiveCount, BVH::MaxLeafSize);
+				primitiveCount += nodes[nodeIdx].primitiveCount;
+				continue;
+			}
+
+			depths[nodes[nodeIdx].leftFirst] = depths[nodeIdx] + 1;
+			depths[nodes[nodeIdx].leftFirst + 1] = depths[nodeIdx] + 1;
+		}
+
+		// Every primitive in exactly one leaf, no leaf deeper than the traversal stacks allow
+		EXPECT_EQ(primitiveCount, bounds.size());
+		EXPECT_LE(maxDepth, BVH::MaxDepth);
+	}
+
+	namespace
+	{
+		// Waves over the grid : same triangles, every vertex moved along y
+		void MoveWaves(MeshGeometry& geometry, float phase)
+		{
+			for (Vector3& position : geometry.positions)
+				position.y = .2f * sinf(6.f * position.x + phase) * cosf(4.f * position.z);
+
+			geometry.normals.clear();
+			geometry.CalculateNormals();
+		}
+
+		// Grid of quads over [-1, 1] on x and z, with waves at phase 0
+		std::shared_ptr<MeshGeometry> CreateGridGeometry(int quadCount)
+		{
+			const auto pGeometry{ std::make_shared<MeshGeometry>() };
+			for (int z{ 0 }; z <= quadCount; ++z)
+			{
+				for (int x{ 0 }; x <= quadCount; ++x)
+					pGeometry->positions.emplace_back(-1.f + 2.f * x / quadCount, 0.f, -1.f + 2.f * z / quadCount);
+			}
+
+			for (int z{ 0 }; z < quadCount; ++z)
+			{
+				for (int x{ 0 }; x < quadCount; ++x)
+				{
+					const int corner{ z * (quadCount + 1) + x };
+					pGeometry->indices.insert(pGeometry->indices.end(), { corner, corner + quadCount + 1, corner + 1 });
+					pGeometry->indices.insert(pGeometry->indices.end(), { corner + 1, corner + quadCount + 1, corner + quadCount + 2 });
+				}
+			}
+
+			MoveWaves(*pGeometry, 0.f);
+			pGeometry->UpdateBVH();
+			return pGeometry;
+		}
+
+		// Vertical rays down onto the grid, closest hit of each
+		std::vector<HitRecord> TraceGrid(const std::shared_ptr<MeshGeometry>& pGeometry)
+		{
+			const TriangleMesh mesh{ pGeometry, TriangleCullMode::NoCulling };
+
+			std::mt19937 generator{ 11 };
+			std::uniform_real_distribution<float> distribution{ -1.f, 1.f };
+			std::vector<HitRecord> hits(2000);
+			for (HitRecord& hit : hits)
+			{
+				const Ray ray{ Vector3{ distribution(generator), 5.f, distribution(generator) }, Vector3{ 0.f, -1.f, 0.f } };
+				GeometryUtils::HitTest_TriangleMesh(mesh, ray, hit);
+			}
+			return hits;
+		}
+	}
+
+	TEST(BVH, RefitMatchesBuild)
+	{
+		// One animation step of a deforming mesh
+		const std::shared_ptr<MeshGeometry> pRefitted{ CreateGridGeometry(100) };
+		const size_t nodeCount{ pRefitted->bvh.GetNodeCount() };
+#ifdef USE_WIDE_BVH
+		const std::vector<WideBVHNode> wideNodes{ pRefitted->wideBVH.GetNodes() };
+		const std::vector<uint32_t> widePrimitiveIndices{ pRefitted->wideBVH.GetPrimitiveIndices() };
+#endif
+		MoveWaves(*pRefitted, .5f);
+		pRefitted->RefitBVH();
+
+#ifdef USE_WIDE_BVH
+		// Wide nodes refitted in place : same nodes and leaves, only the quantized boxes moved
+		EXPECT_EQ(pRefitted->wideBVH.GetNodeCount(), wideNodes.size());
+		EXPECT_EQ(pRefitted->wideBVH.GetPrimitiveIndices(), widePrimitiveIndices);
+		EXPECT_FALSE(AreSameBytes(pRefitted->wideBVH.GetNodes(), wideNodes));
+		for (size_t nodeIdx{ 0 }; nodeIdx < wideNodes.size(); ++nodeIdx)
+		{
+			const WideBVHNode& node{ pRefitted->wideBVH.GetNodes()[nodeIdx] };
+			EXPECT_EQ(std::memcmp(node.child, wideNodes[nodeIdx].child, sizeof(node.child)), 0) << nodeIdx;
+			EXPECT_EQ(node.innerMask, wideNodes[nodeIdx].innerMask) << nodeIdx;
+		}
+#endif
+
+		const auto pBuilt{ std::make_shared<MeshGeometry>(pRefitted->positions, pRefitted->indices) };
+
+		// Refitted, not rebuilt : same tree, worse than a fresh build of the moved triangles
+		const float costRatio{ pRefitted->bvh.GetCostRatio() };
+		EXPECT_EQ(pRefitted->bvh.GetNodeCount(), nodeCount);
+		EXPECT_GT(costRatio, 1.f);
+		EXPECT_LE(costRatio, BVH::DefaultRebuildThreshold);
+		EXPECT_GE(costRatio * pRefitted->bvh.GetBuildCost(), pBuilt->bvh.GetBuildCost());
+		EXPECT_TRUE(AreSame(pRefitted->minAABB, pBuilt->minAABB));
+		EXPECT_TRUE(AreSame(pRefitted->maxAABB, pBuilt->maxAABB));
+
+		const std::vector<HitRecord> refittedHits{ TraceGrid(pRefitted) };
+		const std::vector<HitRecord> builtHits{ TraceGrid(pBuilt) };
+		for (size_t rayIdx{ 0 }; rayIdx < refittedHits.size(); ++rayIdx)
+		{
+			ASSERT_TRUE(refittedHits[rayIdx].didHit) << rayIdx;
+			EXPECT_EQ(refittedHits[rayIdx].t, builtHits[rayIdx].t) << rayIdx;
+			EXPECT_TRUE(AreSame(refittedHits[rayIdx].normal, builtHits[rayIdx].normal)) << rayIdx;
+		}
+	}
+
+	TEST(BVH, RefitRebuildsWhenTooSlow)
+	{
+		// Vertices shuffled : every triangle spans the whole grid, the old tree is useless
+		const std::shared_ptr<MeshGeometry> pGeometry{ CreateGridGeometry(50) };
+		std::shuffle(pGeometry->positions.begin(), pGeometry->positions.end(), std::mt19937{ 3 });
+		for (Vector3& position : pGeometry->positions)
+			position.y = .1f * position.x * position.z;
+		pGeometry->normals.clear();
+		pGeometry->CalculateNormals();
+		pGeometry->RefitBVH();
+
+		// Rebuilt -> the cost is relative to the new tree again
+		EXPECT_EQ(pGeometry->bvh.GetCostRatio(), 1.f);
+
+		const auto pBuilt{ std::make_shared<MeshGeometry>(pGeometry->positions, pGeometry->indices) };
+		EXPECT_EQ(pGeometry->bvh.GetBuildCost(), pBuilt->bvh.GetBuildCost());
+
+		const std::vector<HitRecord> rebuiltHits{ TraceGrid(pGeometry) };
+		const std::vector<HitRecord> builtHits{ TraceGrid(pBuilt) };
+		for (size_t rayIdx{ 0 }; rayIdx < rebuiltHits.size(); ++rayIdx)
+		{
+			EXPECT_EQ(rebuiltHits[rayIdx].didHit, builtHits[rayIdx].didHit) << rayIdx;
+			EXPECT_EQ(rebuiltHits[rayIdx].t, builtHits[rayIdx].t) << rayIdx;
+		}
+	}
+
+	TEST(ToneMapping, DefaultMatchesClampedOutput)
+	{
+		MemoryRenderTarget target{ 1, 1 };
+		DisplayMapper mapper{};
+		mapper.Update(target, DisplaySettings{});
+
+		const std::vector<Vector3> values{ CreateRandomVectors(5) };
+		for (const Vector3& value : values)
+		{
+			// What the renderer wrote before the HDR buffer
+			ColorRGB clamped{ std::abs(value.x) * 0.2f, std::abs(value.y) * 0.2f, std::abs(value.z) * 0.2f };
+			const ColorRGB color{ clamped };
+			clamped.MaxToOne();
+			const uint32_t expected{ target.PackColor(static_cast<uint8_t>(clamped.r * 255), static_cast<uint8_t>(clamped.g * 255),
+				static_cast<uint8_t>(clamped.b * 255)) };
+
+			EXPECT_EQ(mapper.PackPixel(color), expected);
+		}
+	}
+
+	TEST(ToneMapping, BatchMatchesPerPixel)
+	{
+		MemoryRenderTarget target{ 1, 1 };
+		const std::vector<Vector3> values{ CreateRandomVectors(6) };
+		std::vector<ColorRGB> colors{};
+		for (const Vector3& value : values)
+			colors.emplace_back(ColorRGB{ std::abs(value.x), std::abs(value.y), std::abs(value.z) * 0.01f });
+
+		for (ToneMapper toneMapper : { ToneMapper::MaxToOne, ToneMapper::Reinhard, ToneMapper::ACES })
+		{
+			for (bool sRGB : { false, true })
+			{
+				DisplayMapper mapper{};
+				mapper.Update(target, DisplaySettings{ 0.7f, toneMapper, sRGB });
+
+				std::vector<uint32_t> pixels(colors.size());
+				mapper.PackPixels(colors.data(), pixels.data(), static_cast<uint32_t>(colors.size()));
+				for (size_t idx{ 0 }; idx < colors.size(); ++idx)
+					EXPECT_EQ(pixels[idx], mapper.PackPixel(colors[idx])) << idx << ( sRGB ? " sRGB" : " linear" );
+			}
+		}
+	}
+
+	TEST(ToneMapping, SRGBTable)
+	{
+		int previous{ 0 };
+		for (float linear{ 0.f }; linear <= 1.f; linear += 1.f / 8192.f)
+		{
+			const float exact{ linear <= 0.0031308f ? 12.92f * linear : 1.055f * std::pow(linear, 1.f / 2.4f) - 0.055f };
+			const int encoded{ DisplayMapper::EncodeSRGB(linear) };
+			EXPECT_NEAR(encoded, exact * 255.f, 1.f) << linear;
+			EXPECT_GE(encoded, previous) << linear;
+			previous = encoded;
+		}
+		EXPECT_EQ(DisplayMapper::EncodeSRGB(0.f), 0);
+		EXPECT_EQ(DisplayMapper::EncodeSRGB(1.f), 255);
+		EXPECT_EQ(DisplayMapper::EncodeSRGB(5.f), 255);
+	}
+
+	TEST(ObjLoader, FaceSyntax)
+	{
+		// Every face form, a quad, relative indices, CRLF line ends and statements that are skipped
+		const std::string text{
+			"# comment\r\n"
+			"o object\n"
+			"v 0 0 0\nv 1 0 0\nv 1 1 0\n  v\t0 1 0 1.0\n"
+			"vt 0 0\nvt 1 0\nvt 1 1 0\nvt 0.5\n"
+			"vn 0 0 1\nvn +0 0 -1\n"
+			"usemtl white\ns off\n"
+			"f 1 2 3\r\n"
+			"f 1/1 2/2 3/3\n"
+			"f 1//1 2//2 3//1\n"
+			"f 1/1/1 2/2/1 3/3/2 4/4/2\n"
+			"f -4/-4/-2 -3/-3/-2 -2/-2/-1\n" };
+
+		ObjMesh mesh{};
+		ASSERT_TRUE(ObjLoader::Parse(text, mesh));
+		ASSERT_EQ(mesh.positions.size(), 4u);
+		ASSERT_EQ(mesh.GetTriangleCount(), 6u);
+		EXPECT_EQ(mesh.indices, (std::vector<int>{ 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 2, 3, 0, 1, 2 }));
+
+		ASSERT_EQ(mesh.normals.size(), 6u);
+		for (const Vector3& normal : mesh.normals)
+			EXPECT_TRUE(AreSame(normal, Vector3{ 0.f, 0.f, 1.f }));
+
+		// Per corner, zero for the corners that didn't have one
+		ASSERT_EQ(mesh.texCoords.size(), 18u);
+		EXPECT_EQ(mesh.texCoords[0].u, 0.f);
+		EXPECT_EQ(mesh.texCoords[5].u, 1.f);
+		EXPECT_EQ(mesh.texCoords[5].v, 1.f);
+		EXPECT_EQ(mesh.texCoords[14].u, 0.5f);
+		EXPECT_EQ(mesh.texCoords[14].v, 0.f);
+		ASSERT_EQ(mesh.vertexNormals.size(), 18u);
+		EXPECT_TRUE(AreSame(mesh.vertexNormals[3], Vector3{}));
+		EXPECT_TRUE(AreSame(mesh.vertexNormals[8], Vector3{ 0.f, 0.f, 1.f }));
+		EXPECT_TRUE(AreSame(mesh.vertexNormals[11], Vector3{ 0.f, 0.f, -1.f }));
+		EXPECT_TRUE(AreSame(mesh.vertexNormals[17], Vector3{ 0.f, 0.f, -1.f }));
+	}
+
+	TEST(ObjLoader, ChunksMatchSingleChunk)
+	{
+		// Relative indices reach back into earlier chunks
+		std::string text{};
+		for (int quadIdx{ 0 }; quadIdx < 50; ++quadIdx)
+		{
+			const float offset{ quadIdx * 0.5f };
+			text += "v " + std::to_string(offset) + " 0 0\nv " + std::to_string(offset) + " 1 0\nv 0 " + std::to_string(offset) + " 1\n";
+			text += "vn 0 1 0\nf -3//-1 -2//-1 -1//-1\nf " + std::to_string(quadIdx * 3 + 1) + " 1 2\n";
+		}
+
+		ObjMesh reference{};
+		ASSERT_TRUE(ObjLoader::Parse(text, reference, text.size()));
+		for (size_t chunkSize : { size_t{ 1 }, size_t{ 7 }, size_t{ 64 }, size_t{ 1000 } })
+		{
+			ObjMesh mesh{};
+			ASSERT_TRUE(ObjLoader::Parse(text, mesh, chunkSize));
+			EXPECT_TRUE(AreSame(mesh.positions, reference.positions)) << chunkSize;
+			EXPECT_EQ(mesh.indices, reference.indices) << chunkSize;
+			EXPECT_TRUE(AreSame(mesh.vertexNormals, reference.vertexNormals)) << chunkSize;
+		}
+	}
+
+	TEST(ObjLoader, Errors)
+	{
+		ObjMesh mesh{};
+		std::string error{};
+		EXPECT_FALSE(ObjLoader::Parse("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 0\n", mesh, 4, &error));
+		EXPECT_EQ(error, "line 4 : invalid or out of range face index");
+		EXPECT_FALSE(ObjLoader::Parse("v 0 0 0\nv 1 0 0\nf 1 2 3\n", mesh, 4, &error));
+		EXPECT_FALSE(ObjLoader::Parse("v 0 0 0\nv 1 0 0\nf 1 2\n", mesh, 4, &error));
+		EXPECT_EQ(error, "line 3 : a face needs at least 3 corners");
+		EXPECT_FALSE(ObjLoader::Parse("v 0 0\n", mesh));
+		EXPECT_FALSE(ObjLoader::Parse("v 0 0 0\nf 1/x 1 1\n", mesh));
+		EXPECT_TRUE(mesh.positions.empty());
+
+		EXPECT_TRUE(ObjLoader::Parse("", mesh));
+		EXPECT_EQ(mesh.GetTriangleCount(), 0u);
+	}
+
+	TEST(ObjLoader, Cache)
+	{
+		const std::filesystem::path directory{ std::filesystem::temp_directory_path() / "RayTracer_ObjLoader" };
+		std::filesystem::create_directories(directory);
+		const std::string filePath{ (directory / "quad.obj").string() };
+		const std::string cachePath{ ObjLoader::GetCachePath(filePath) };
+		std::filesystem::remove(cachePath);
+
+		std::ofstream{ filePath } << "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nvt 0 0\nf 1/1 2/1 3/1 4/1\n";
+		ObjMesh parsed{};
+		ASSERT_TRUE(ObjLoader::Load(filePath, parsed));
+		ASSERT_TRUE(std::filesystem::exists(cachePath));
+
+		ObjMesh cached{};
+		ASSERT_TRUE(ObjLoader::ReadCache(cachePath, filePath, cached));
+		EXPECT_TRUE(AreSame(cached.positions, parsed.positions));
+		EXPECT_EQ(cached.indices, parsed.indices);
+		EXPECT_TRUE(AreSame(cached.normals, parsed.normals));
+		EXPECT_EQ(cached.texCoords.size(), parsed.texCoords.size());
+		EXPECT_TRUE(cached.vertexNormals.empty());
+
+		// A changed OBJ is parsed again
+		std::ofstream{ filePath } << "v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1 2 3\n";
+		EXPECT_FALSE(ObjLoader::ReadCache(cachePath, filePath, cached));
+		ASSERT_TRUE(ObjLoader::Load(filePath, parsed));
+		EXPECT_EQ(parsed.GetTriangleCount(), 1u);
+		ASSERT_TRUE(ObjLoader::ReadCache(cachePath, filePath, cached));
+		EXPECT_EQ(cached.GetTriangleCount(), 1u);
+
+		std::filesystem::remove_all(directory);
+	}
+
+	namespace
+	{
+		const std::filesystem::path SceneDirectory{ std::filesystem::temp_directory_path() / "RayTracer_SceneFile" };
+
+		// Scene with every statement, its mesh comes from an OBJ file next to it
+		std::string WriteTestScene()
+		{
+			std::filesystem::create_directories(SceneDirectory);
+			std::ofstream{ SceneDirectory / "quad.obj" } << "v -1 0 -1\nv 1 0 -1\nv 1 0 1\nv -1 0 1\nf 1 4 3 2\n";
+
+			const std::string scenePath{ (SceneDirectory / "test.scene").string() };
+			std::ofstream{ scenePath } << "# Test scene\n"
+				<< "name Test Scene\n"
+				<< "camera 0 1 -5 60\n"
+				<< "material white lambert 1 1 1 1\n"
+				<< "material gold cooktorrance 1 .8 .3 1 .4	# Metal\n"
+				<< "plane 0 0 0 0 2 0 white\n"
+				<< "sphere 0 1 0 .5 gold\n"
+				<< "pointlight 0 5 -2 40 1 1 1\n"
+				<< "directionallight 0 -3 0 2 1 .9 .8\n"
+				<< "mesh quad quad.obj\n"
+				<< "mesh triangle\n"
+				<< "v 0 0 0\nv 1 0 0\nv 0 1 0\n"
+				<< "f 1 3 2\n"
+				<< "end\n"
+				<< "instance quad white translate 0 .01 0\n"
+				<< "instance triangle gold cull none translate 1 1 0 rotate 0 90 0 scale 2 2 2 spin 180\n"
+				<< "instance triangle white\n";
+			return scenePath;
+		}
+	}
+
+	TEST(SceneFile, Parse)
+	{
+		SceneDescription scene{};
+		std::string error{};
+		ASSERT_TRUE(SceneFile::Parse(WriteTestScene(), scene, &error)) << error;
+
+		EXPECT_EQ(scene.name, "Test Scene");
+		EXPECT_TRUE(AreSame(scene.cameraOrigin, Vector3{ 0.f, 1.f, -5.f }));
+		EXPECT_EQ(scene.cameraFovAngle, 60.f);
+
+		// Default red first, then the file materials in order
+		ASSERT_EQ(scene.materials.size(), 3u);
+		EXPECT_EQ(scene.materials[1].type, MaterialType::Lambert);
+		EXPECT_EQ(scene.materials[2].type, MaterialType::CookTorrence);
+		ASSERT_EQ(scene.planes.size(), 1u);
+		EXPECT_TRUE(AreSame(scene.planes[0].normal, Vector3{ 0.f, 1.f, 0.f }));
+		EXPECT_EQ(scene.planes[0].materialIndex, 1);
+		ASSERT_EQ(scene.spheres.size(), 1u);
+		EXPECT_EQ(scene.spheres[0].materialIndex, 2);
+		ASSERT_EQ(scene.lights.size(), 2u);
+		EXPECT_EQ(scene.lights[1].type, LightType::Directional);
+		EXPECT_TRUE(AreSame(scene.lights[1].direction, Vector3{ 0.f, -1.f, 0.f }));
+
+		ASSERT_EQ(scene.geometries.size(), 2u);
+		EXPECT_EQ(scene.geometries[0]->indices.size(), 6u);
+		EXPECT_FALSE(scene.geometries[0]->bvh.IsEmpty());
+		EXPECT_EQ(scene.geometries[1]->indices.size(), 3u);
+		EXPECT_EQ(scene.GetTriangleCount(), 4u);
+
+		ASSERT_EQ(scene.instances.size(), 3u);
+		const SceneInstance& instance{ scene.instances[1] };
+		EXPECT_EQ(instance.geometryIdx, 1u);
+		EXPECT_EQ(instance.materialIndex, 2);
+		EXPECT_EQ(instance.cullMode, TriangleCullMode::NoCulling);
+		EXPECT_TRUE(AreSame(instance.scale, Vector3{ 2.f, 2.f, 2.f }));
+		EXPECT_FLOAT_EQ(instance.rotation.y, PI_DIV_2);
+		EXPECT_FLOAT_EQ(instance.spinSpeed, PI);
+		EXPECT_EQ(scene.instances[2].cullMode, TriangleCullMode::BackFaceCulling);
+
+		std::filesystem::remove_all(SceneDirectory);
+	}
+
+	TEST(SceneFile, Errors)
+	{
+		std::filesystem::create_directories(SceneDirectory);
+		const std::string scenePath{ (SceneDirectory / "broken.scene").string() };
+		const auto parse{ [&](const std::string& text, std::string& error)
+			{
+				std::ofstream{ scenePath } << text;
+				SceneDescription scene{};
+				const bool isParsed{ SceneFile::Parse(scenePath, scene, &error) };
+				EXPECT_TRUE(isParsed || scene.instances.empty());
+				return isParsed;
+			} };
+
+		std::string error{};
+		EXPECT_FALSE(parse("material white lambert 1 1 1 1\n\nsphere 0 0 0 1 black\n", error));
+		EXPECT_EQ(error, scenePath + ":3 : invalid sphere ( Missing or wrong values, or an unknown material )");
+		EXPECT_FALSE(parse("camera 0 0 0\n", error));
+		EXPECT_EQ(error, scenePath + ":1 : invalid camera ( Missing or wrong values, or an unknown material )");
+		EXPECT_FALSE(parse("name\n", error));
+		EXPECT_EQ(error, scenePath + ":1 : missing scene name");
+		EXPECT_FALSE(parse("cube 0 0 0\n", error));
+		EXPECT_EQ(error, scenePath + ":1 : unknown statement cube");
+		EXPECT_FALSE(parse("mesh triangle\nv 0 0 0\n", error));
+		EXPECT_EQ(error, scenePath + ":1 : mesh without end");
+		EXPECT_FALSE(parse("# Comment\nmesh triangle\nv 0 0 0\nf 1 1 2\nend\n", error));
+		EXPECT_EQ(error, scenePath + ":2 : line 2 : invalid or out of range face index");
+		EXPECT_FALSE(parse("material white lambert 1 1 1 1\ninstance bunny white\n", error));
+		EXPECT_EQ(error, scenePath + ":2 : unknown mesh bunny");
+		SceneDescription scene{};
+		EXPECT_FALSE(SceneFile::Parse((SceneDirectory / "missing.scene").string(), scene));
+
+		std::filesystem::remove_all(SceneDirectory);
+	}
+
+	TEST(SceneFile, Bundle)
+	{
+		const std::string scenePath{ WriteTestScene() };
+		const std::string bundlePath{ SceneFile::GetBundlePath(scenePath) };
+		EXPECT_EQ(std::filesystem::path{ bundlePath }.filename(), "test.scenebundle");
+		ASSERT_TRUE(SceneFile::Compile(scenePath, bundlePath));
+
+		SceneDescription parsed{};
+		SceneDescription loaded{};
+		ASSERT_TRUE(SceneFile::Parse(scenePath, parsed));
+		ASSERT_TRUE(SceneFile::LoadBundle(bundlePath, loaded));
+
+		// Written again from what was loaded -> the same file ( Padding bytes included )
+		const std::string rewrittenPath{ (SceneDirectory / "rewritten.scenebundle").string() };
+		ASSERT_TRUE(SceneFile::WriteBundle(rewrittenPath, loaded));
+		const auto readFile{ [](const std::string& filePath)
+			{
+				std::ifstream file{ filePath, std::ios::binary };
+				return std::string{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+			} };
+		EXPECT_EQ(readFile(rewrittenPath), readFile(bundlePath));
+
+		EXPECT_EQ(loaded.name, parsed.name);
+		EXPECT_EQ(loaded.materials.size(), parsed.materials.size());
+		EXPECT_EQ(loaded.planes.size(), parsed.planes.size());
+		EXPECT_EQ(loaded.spheres.size(), parsed.spheres.size());
+		EXPECT_EQ(loaded.lights.size(), parsed.lights.size());
+		EXPECT_EQ(loaded.instances.size(), parsed.instances.size());
+
+		// The same geometry and BVHs as a fresh build
+		ASSERT_EQ(loaded.geometries.size(), parsed.geometries.size());
+		for (size_t geometryIdx{ 0 }; geometryIdx < parsed.geometries.size(); ++geometryIdx)
+		{
+			const MeshGeometry& expected{ *parsed.geometries[geometryIdx] };
+			const MeshGeometry& geometry{ *loaded.geometries[geometryIdx] };
+			EXPECT_TRUE(AreSame(geometry.positions, expected.positions));
+			EXPECT_EQ(geometry.indices, expected.indices);
+			EXPECT_TRUE(AreSame(geometry.normals, expected.normals));
+			EXPECT_TRUE(AreSameBytes(geometry.bvh.GetNodes(), expected.bvh.GetNodes()));
+			EXPECT_EQ(geometry.bvh.GetPrimitiveIndices(), expected.bvh.GetPrimitiveIndices());
+			EXPECT_TRUE(AreSame(geometry.minAABB, expected.minAABB));
+			EXPECT_TRUE(AreSame(geometry.maxAABB, expected.maxAABB));
+#ifdef USE_WIDE_BVH
+			EXPECT_TRUE(AreSameBytes(geometry.wideBVH.GetNodes(), expected.wideBVH.GetNodes()));
+			EXPECT_TRUE(AreSameBytes(geometry.triangleBlocks, expected.triangleBlocks));
+#endif
+		}
+
+		EXPECT_EQ(RenderImage(bundlePath, Renderer::Integrator::Direct, false, ShadingMode::Exact),
+			RenderImage(scenePath, Renderer::Integrator::Direct, false, ShadingMode::Exact));
+
+		// A node pointing outside the arrays is refused, before anything traverses it
+		const std::string bundle{ readFile(bundlePath) };
+		const auto expectRefused{ [&](const void* pNode, size_t nodeSize, const auto& corrupt)
+			{
+				std::string damaged{ bundle };
+				const size_t nodeOffset{ damaged.find(std::string_view{ static_cast<const char*>(pNode), nodeSize }) };
+				ASSERT_NE(nodeOffset, std::string::npos);
+				corrupt(damaged.data() + nodeOffset);
+				std::ofstream{ bundlePath, std::ios::binary }.write(damaged.data(), damaged.size());
+
+				EXPECT_FALSE(SceneFile::LoadBundle(bundlePath, loaded));
+				EXPECT_TRUE(loaded.geometries.empty());
+			} };
+
+		const BVHNode& root{ parsed.geometries[0]->bvh.GetNodes()[0] };
+		expectRefused(&root, sizeof(BVHNode), [](char* pNode)
+			{
+				BVHNode node{};
+				std::memcpy(&node, pNode, sizeof(BVHNode));
+				node.leftFirst = 0xFFFFFF00;
+				std::memcpy(pNode, &node, sizeof(BVHNode));
+			});
+		expectRefused(&root, sizeof(BVHNode), [](char* pNode)
+			{
+				// An inner node pointing back at itself : a cycle
+				BVHNode node{};
+				std::memcpy(&node, pNode, sizeof(BVHNode));
+				node.leftFirst = 0;
+				node.primitiveCount = 0;
+				std::memcpy(pNode, &node, sizeof(BVHNode));
+			});
+#ifdef USE_WIDE_BVH
+		expectRefused(&parsed.geometries[0]->wideBVH.GetNodes()[0], sizeof(WideBVHNode), [](char* pNode)
+			{
+				WideBVHNode node{};
+				std::memcpy(&node, pNode, sizeof(WideBVHNode));
+				node.child[0] = 0xFFFFFF00;
+				std::memcpy(pNode, &node, sizeof(WideBVHNode));
+			});
+#endif
+
+		// A cut off bundle is refused
+		std::ofstream{ bundlePath, std::ios::binary }.write(bundle.data(), bundle.size());
+		std::filesystem::resize_file(bundlePath, std::filesystem::file_size(bundlePath) - 8);
+		EXPECT_FALSE(SceneFile::LoadBundle(bundlePath, loaded));
+		EXPECT_TRUE(loaded.geometries.empty());
+
+		std::filesystem::remove_all(SceneDirectory);
+	}
+
+	TEST(SceneFile, ReferenceMatchesBuiltIn)
+	{
+		EXPECT_EQ(RenderImage("Resources/Scenes/Reference.scene", Renderer::Integrator::Direct, false, ShadingMode::Exact),
+			RenderImage("W4Reference", Renderer::Integrator::Direct, false, ShadingMode::Exact));
+	}
+
+	TEST(SceneFile, DefaultFieldOfView)
+	{
+		// The reference scene at 90 degrees, and without a camera line ( Also 90 degrees, from the origin )
+		std::ifstream referenceFile{ "Resources/Scenes/Reference.scene" };
+		const std::string reference{ std::istreambuf_iterator<char>{ referenceFile }, std::istreambuf_iterator<char>{} };
+		const size_t cameraStart{ reference.find("camera ") };
+		ASSERT_NE(cameraStart, std::string::npos);
+		const size_t cameraEnd{ reference.find('\n', cameraStart) + 1 };
+
+		std::filesystem::create_directories(SceneDirectory);
+		const std::string scenePaths[]{ (SceneDirectory / "fov90.scene").string(), (SceneDirectory / "nocamera.scene").string() };
+		std::ofstream{ scenePaths[0] } << reference.substr(0, cameraStart) << "camera 0 3 -9 90\n" << reference.substr(cameraEnd);
+		std::ofstream{ scenePaths[1] } << reference.substr(0, cameraStart) << reference.substr(cameraEnd);
+
+		for (const std::string& scenePath : scenePaths)
+		{
+			const std::unique_ptr<Scene> pScene{ CreateScene(scenePath) };
+			ASSERT_NE(pScene, nullptr) << scenePath;
+			pScene->Initialize();
+			EXPECT_EQ(pScene->GetCamera().fovAngle, 90.f) << scenePath;
+			EXPECT_FLOAT_EQ(pScene->GetCamera().fov, 1.f) << scenePath;
+
+			// A real perspective : the rays fan out over the room instead of all hitting the same spot
+			const std::vector<uint8_t> channels{ RenderImage(scenePath, Renderer::Integrator::Direct, false, ShadingMode::Exact) };
+			std::vector<uint32_t> colors{};
+			for (size_t channelIdx{ 0 }; channelIdx < channels.size(); channelIdx += 3)
+				colors.emplace_back(channels[channelIdx] << 16 | channels[channelIdx + 1] << 8 | channels[channelIdx + 2]);
+			std::sort(colors.begin(), colors.end());
+			EXPECT_GT(std::unique(colors.begin(), colors.end()) - colors.begin(), 100) << scenePath;
+		}
+
+		std::filesystem::remove_all(SceneDirectory);
+	}
+
+	TEST(FastShading, BRDFError)
+	{
+		EXPECT_LE(GetMaxShadingError(Material::LambertPhong(colors::Red, 1.f, 1.f, 60.f)), 1e-3f);
+		EXPECT_LE(GetMaxShadingError(Material::LambertPhong(colors::Blue, 0.5f, 0.5f, 3.f)), 1e-3f);
+		for (float roughness : { 1.f, 0.6f, 0.3f, 0.1f })
+		{
+			EXPECT_LE(GetMaxShadingError(Material::CookTorrence({ .972f, .960f, .915f }, 1.f, roughness)), 1e-2f) << roughness;
+			EXPECT_LE(GetMaxShadingError(Material::CookTorrence({ .75f, .75f, .75f }, 0.f, roughness)), 1e-2f) << roughness;
+		}
+
+		// No approximation in the constant BRDFs
+		EXPECT_EQ(GetMaxShadingError(Material::Lambert(colors::White, 1.f)), 0.f);
+		EXPECT_EQ(GetMaxShadingError(Material::SolidColor(colors::Red)), 0.f);
+	}
+
+	TEST(FastShading, ImageErrorDirect)
+	{
+		for (const char* sceneName : { "W3", "W4Reference", "Particles" })
+		{
+			ExpectImageErrorBounded(sceneName, Renderer::Integrator::Direct, false);
+		}
+	}
+
+	TEST(FastShading, ImageErrorWavefront)
+	{
+		for (const char* sceneName : { "W3", "W4Reference", "Particles" })
+		{
+			ExpectImageErrorBounded(sceneName, Renderer::Integrator::Direct, true);
+		}
+	}
+
+	TEST(FastShading, ImageErrorPathTracing)
+	{
+		for (const char* sceneName : { "W4Reference", "Particles" })
+		{
+			ExpectImageErrorBounded(sceneName, Renderer::Integrator::PathTracing, false);
+		}
+	}
+}
@@ -1,8 +1,19 @@
 #pragma once
 #include <cassert>
-#include <fstream>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <immintrin.h>
 #include "Math.h"
 #include "DataTypes.h"
+#include "ObjLoader.h"
+#include "Statistics.h"
+
+// Packets need the wide BVH and AVX2 ( 8 rays per instruction ), otherwise they are traced ray by ray
+#if defined(USE_WIDE_BVH) && defined(__AVX2__)
+#define PACKET_TRACING
+#endif
 
 namespace dae
 {
@@ -10,49 +21,120 @@ namespace dae
 	{
 #pragma region Sphere HitTest
 		//SPHERE HIT-TESTS
+		/**
+		 * \brief Ray against a sphere given by its squared radius ( Shared by the single spheres and the sphere sets )
+		 * \param center Center of the sphere
+		 * \param radiusSquared Squared radius, negative -> never hit
+		 * \param ray Ray to test, its direction has to be normalized
+		 * \param tMax Only hits closer than this count
+		 * \param t Distance of the first intersection
+		 * \return true if the first intersection lies in [ray.min, min(ray.max, tMax)]
+		 */
+		inline bool HitTest_SphereSquared(const Vector3& center, float radiusSquared, const Ray& ray, float tMax, float& t)
+		{
+#ifdef RAY_STATISTICS
+			++Statistics::GetThreadCounters().sphereTests;
+#endif
+			// Normalized direction -> a = 1, and using half of b the factors 2 and 4 cancel out
+			const Vector3 toCenter{ center - ray.origin };
+			const float b{ Vector3::Dot(ray.direction, toCenter) };
+			const float c{ Vector3::Dot(toCenter, toCenter) - radiusSquared };
+
+			// Discriminant > 0 -> FULL INTERSECTION OF THE RAY ( 2 intersection points )
+			const float discriminant{ b * b - c };
+			if (discriminant <= 0.f)
+				return false;
+
+			// Closest of the 2 points, it has to be inside [tMin, tMax]
+			t = b - sqrtf(discriminant);
+			return t >= ray.min && t <= ray.max && t <= tMax;
+		}
+
 		inline bool HitTest_Sphere(const Sphere& sphere, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
 		{	
-			Vector3 sphereToRay{ ray.origin - sphere.origin };
-
-			//// Calculate Discriminant to see if there is a full Intersection ( Discriminant > 0 )
-			float a{ Vector3::Dot(ray.direction, ray.direction) };
-			//float b{ Vector3::Dot((2 * ray.direction), sphereToRay) };
-			float b{ 2.0f * Vector3::Dot(ray.direction, sphereToRay) };
-			float c{ (Vector3::Dot(sphereToRay, sphereToRay)) - (sphere.radius * sphere.radius) };
+			float t{};
+			if (!HitTest_SphereSquared(sphere.origin, sphere.radius * sphere.radius, ray, ray.max, t))
+				return false;
 
-			float discriminant{ (b * b) - (4 * a * c) };
-			if (discriminant > 0)
+			// VALID RANGE
+			// ... Check if smaller than the previous t saved
+			if (!ignoreHitRecord && hitRecord.t >= t)
 			{
-				// FULL INTERSECTION OF THE RAY ( 2 intersection points)
-				float sqrtDiscriminant{ sqrt(discriminant) };
-				float inv2a{ 1.0f / (2.0f * a) };
+				hitRecord.t = t;
+				hitRecord.origin = ray.origin + (t * ray.direction);
+				hitRecord.normal = (hitRecord.origin - sphere.origin).Normalized();
+				hitRecord.didHit = true;
+				hitRecord.materialIndex = sphere.materialIndex;
+			}
+			return true;
+		}
 
-				float t0{ (-b - sqrtDiscriminant) * inv2a };
-				float t1{ (-b + sqrtDiscriminant) * inv2a };
+		/**
+		 * \brief Ray against the 8 spheres of a block at once ( AVX2, scalar loop without it )
+		 * \param block Spheres to test
+		 * \param sphereCount Lanes in use
+		 * \param ray Ray to test, its direction has to be normalized
+		 * \param tMax Only hits closer than this count
+		 * \param tHit Distance of the closest hit in the block
+		 * \param hitLane Lane of the closest hit in the block
+		 * \return true if any sphere was hit
+		 */
+		inline bool HitTest_SphereBlock(const SphereBlock& block, uint32_t sphereCount, const Ray& ray, float tMax,
+			float& tHit, int& hitLane)
+		{
+			alignas(32) float t[SphereBlock::Width]{};
+			int hitMask{ 0 };
+
+#ifdef __AVX2__
+#ifdef RAY_STATISTICS
+			Statistics::GetThreadCounters().sphereTests += sphereCount;
+#endif
+			const __m256 toCenterX{ _mm256_sub_ps(_mm256_load_ps(block.centerX), _mm256_set1_ps(ray.origin.x)) };
+			const __m256 toCenterY{ _mm256_sub_ps(_mm256_load_ps(block.centerY), _mm256_set1_ps(ray.origin.y)) };
+			const __m256 toCenterZ{ _mm256_sub_ps(_mm256_load_ps(block.centerZ), _mm256_set1_ps(ray.origin.z)) };
+
+			const __m256 b{ _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(ray.direction.x), toCenterX),
+				_mm256_mul_ps(_mm256_set1_ps(ray.direction.y), toCenterY)), _mm256_mul_ps(_mm256_set1_ps(ray.direction.z), toCenterZ)) };
+			const __m256 c{ _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(toCenterX, toCenterX), _mm256_mul_ps(toCenterY, toCenterY)),
+				_mm256_mul_ps(toCenterZ, toCenterZ)), _mm256_load_ps(block.radiusSquared)) };
+
+			const __m256 discriminant{ _mm256_sub_ps(_mm256_mul_ps(b, b), c) };
+			// sqrt of a negative discriminant is NaN, those lanes are masked out anyway
+			const __m256 distance{ _mm256_sub_ps(b, _mm256_sqrt_ps(discriminant)) };
+
+			__m256 hit{ _mm256_cmp_ps(discriminant, _mm256_setzero_ps(), _CMP_GT_OQ) };
+			hit = _mm256_and_ps(hit, _mm256_cmp_ps(distance, _mm256_set1_ps(ray.min), _CMP_GE_OQ));
+			hit = _mm256_and_ps(hit, _mm256_cmp_ps(distance, _mm256_set1_ps(std::min(ray.max, tMax)), _CMP_LE_OQ));
+
+			hitMask = _mm256_movemask_ps(hit) & ((1 << sphereCount) - 1);
+			if (hitMask == 0)
+				return false;
+
+			_mm256_store_ps(t, distance);
+#else
+			for (uint32_t lane{ 0 }; lane < sphereCount; ++lane)
+			{
+				const Vector3 center{ block.centerX[lane], block.centerY[lane], block.centerZ[lane] };
+				if (HitTest_SphereSquared(center, block.radiusSquared[lane], ray, tMax, t[lane]))
+					hitMask |= 1 << lane;
+			}
 
-				// If t0 smaller than t1 then we take t0. 
-				// Otherwise t1 is smaller and we take this one
-				float tClosest{ t0 < t1 ? t0 : t1 };
+			if (hitMask == 0)
+				return false;
+#endif
 
-				// Check if it is in [tMin, tMax]	
-				if (tClosest >= ray.min && tClosest <= ray.max)
+			// Closest lane that hit
+			tHit = FLT_MAX;
+			for (int lane{ 0 }; lane < SphereBlock::Width; ++lane)
+			{
+				if ((hitMask & (1 << lane)) && t[lane] < tHit)
 				{
-					// VALID RANGE
-					// ... Check if smaller than the previous t saved
-					if (!ignoreHitRecord)
-					{
-						hitRecord.t = tClosest;
-						hitRecord.origin = ray.origin + ( tClosest * ray.direction );
-						hitRecord.normal = (hitRecord.origin - sphere.origin).Normalized();
-						hitRecord.didHit = true;
-						hitRecord.materialIndex = sphere.materialIndex;
-					}
-					return true;
+					tHit = t[lane];
+					hitLane = lane;
 				}
 			}
-			
-			// No intersection or not a full intersection of the ray
-			return false;
+
+			return true;
 		}
 
 		inline bool HitTest_Sphere(const Sphere& sphere, const Ray& ray)
@@ -65,6 +147,9 @@ namespace dae
 		//PLANE HIT-TESTS
 		inline bool HitTest_Plane(const Plane& plane, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
 		{
+#ifdef RAY_STATISTICS
+			++Statistics::GetThreadCounters().planeTests;
+#endif
 			Vector3 toOrigin{ plane.origin - ray.origin };
 
 			float t{ Vector3::Dot(toOrigin, plane.normal) / Vector3::Dot(ray.direction, plane.normal) };
@@ -100,6 +185,9 @@ namespace dae
 		//TRIANGLE HIT-TESTS
 		inline bool HitTest_Triangle(const Triangle& triangle, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
 		{
+#ifdef RAY_STATISTICS
+			++Statistics::GetThreadCounters().triangleTests;
+#endif
 			
 			// 1 Check if the ray hit the triangle plane
 			//..... Calculate normal with triangle edges 
@@ -198,11 +286,157 @@ namespace dae
 			HitRecord temp{};
 			return HitTest_Triangle(triangle, ray, temp, true);
 		}
+
+		// Moller-Trumbore det has the opposite sign of dot(normal, direction)
+		// ... Shadow rays use the opposite cull mode ( Same as HitTest_Triangle )
+		inline float GetCullSign(TriangleCullMode cullMode, bool shadowRay)
+		{
+			float cullSign{ 0.f };
+			if (cullMode == TriangleCullMode::BackFaceCulling)
+				cullSign = 1.f;
+			else if (cullMode == TriangleCullMode::FrontFaceCulling)
+				cullSign = -1.f;
+
+			return shadowRay ? -cullSign : cullSign;
+		}
+
+		// Scalar Moller-Trumbore on precomputed edges, same conventions as HitTest_TriangleBlock
+		inline bool HitTest_TriangleEdges(const Vector3& v0, const Vector3& edge1, const Vector3& edge2, const Ray& ray, float cullSign,
+			float tMax, float& t)
+		{
+#ifdef RAY_STATISTICS
+			++Statistics::GetThreadCounters().triangleTests;
+#endif
+			const Vector3 p{ Vector3::Cross(ray.direction, edge2) };
+			const float det{ Vector3::Dot(edge1, p) };
+			if (cullSign == 0.f ? det == 0.f : det * cullSign <= 0.f)
+				return false;
+
+			const float invDet{ 1.f / det };
+			const Vector3 toOrigin{ ray.origin - v0 };
+
+			const float u{ Vector3::Dot(toOrigin, p) * invDet };
+			if (u < 0.f || u > 1.f)
+				return false;
+
+			const Vector3 q{ Vector3::Cross(toOrigin, edge1) };
+			const float v{ Vector3::Dot(ray.direction, q) * invDet };
+			if (v < 0.f || u + v > 1.f)
+				return false;
+
+			t = Vector3::Dot(edge2, q) * invDet;
+			return t >= ray.min && t <= ray.max && t <= tMax;
+		}
+
+		/**
+		 * \brief Moller-Trumbore against the 8 triangles of a block at once ( AVX2, scalar loop without it )
+		 * \param block Triangles to test
+		 * \param triangleCount Lanes in use
+		 * \param ray Ray to test
+		 * \param cullSign 1 -> only hit when det > 0, -1 -> only when det < 0, 0 -> no culling
+		 * \param tMax Only hits closer than this count
+		 * \param tHit Distance of the closest hit in the block
+		 * \param hitLane Lane of the closest hit in the block
+		 * \return true if any triangle was hit
+		 */
+		inline bool HitTest_TriangleBlock(const TriangleBlock& block, uint32_t triangleCount, const Ray& ray, float cullSign, float tMax,
+			float& tHit, int& hitLane)
+		{
+			alignas(32) float t[TriangleBlock::Width]{};
+			int hitMask{ 0 };
+
+#ifdef __AVX2__
+#ifdef RAY_STATISTICS
+			Statistics::GetThreadCounters().triangleTests += triangleCount;
+#endif
+			const __m256 directionX{ _mm256_set1_ps(ray.direction.x) };
+			const __m256 directionY{ _mm256_set1_ps(ray.direction.y) };
+			const __m256 directionZ{ _mm256_set1_ps(ray.direction.z) };
+
+			const __m256 edge1X{ _mm256_load_ps(block.edge1X) };
+			const __m256 edge1Y{ _mm256_load_ps(block.edge1Y) };
+			const __m256 edge1Z{ _mm256_load_ps(block.edge1Z) };
+			const __m256 edge2X{ _mm256_load_ps(block.edge2X) };
+			const __m256 edge2Y{ _mm256_load_ps(block.edge2Y) };
+			const __m256 edge2Z{ _mm256_load_ps(block.edge2Z) };
+
+			// P = direction x edge2
+			const __m256 pX{ _mm256_sub_ps(_mm256_mul_ps(directionY, edge2Z), _mm256_mul_ps(directionZ, edge2Y)) };
+			const __m256 pY{ _mm256_sub_ps(_mm256_mul_ps(directionZ, edge2X), _mm256_mul_ps(directionX, edge2Z)) };
+			const __m256 pZ{ _mm256_sub_ps(_mm256_mul_ps(directionX, edge2Y), _mm256_mul_ps(directionY, edge2X)) };
+
+			const __m256 det{ _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(edge1X, pX), _mm256_mul_ps(edge1Y, pY)), _mm256_mul_ps(edge1Z, pZ)) };
+			const __m256 invDet{ _mm256_div_ps(_mm256_set1_ps(1.f), det) };
+
+			// T = origin - v0
+			const __m256 toOriginX{ _mm256_sub_ps(_mm256_set1_ps(ray.origin.x), _mm256_load_ps(block.v0X)) };
+			const __m256 toOriginY{ _mm256_sub_ps(_mm256_set1_ps(ray.origin.y), _mm256_load_ps(block.v0Y)) };
+			const __m256 toOriginZ{ _mm256_sub_ps(_mm256_set1_ps(ray.origin.z), _mm256_load_ps(block.v0Z)) };
+
+			const __m256 u{ _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(toOriginX, pX), _mm256_mul_ps(toOriginY, pY)),
+				_mm256_mul_ps(toOriginZ, pZ)), invDet) };
+
+			// Q = T x edge1
+			const __m256 qX{ _mm256_sub_ps(_mm256_mul_ps(toOriginY, edge1Z), _mm256_mul_ps(toOriginZ, edge1Y)) };
+			const __m256 qY{ _mm256_sub_ps(_mm256_mul_ps(toOriginZ, edge1X), _mm256_mul_ps(toOriginX, edge1Z)) };
+			const __m256 qZ{ _mm256_sub_ps(_mm256_mul_ps(toOriginX, edge1Y), _mm256_mul_ps(toOriginY, edge1X)) };
+
+			const __m256 v{ _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(directionX, qX), _mm256_mul_ps(directionY, qY)),
+				_mm256_mul_ps(directionZ, qZ)), invDet) };
+			const __m256 distance{ _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(edge2X, qX), _mm256_mul_ps(edge2Y, qY)),
+				_mm256_mul_ps(edge2Z, qZ)), invDet) };
+
+			const __m256 zero{ _mm256_setzero_ps() };
+			const __m256 facing{ cullSign == 0.f ? _mm256_cmp_ps(det, zero, _CMP_NEQ_OQ)
+				: _mm256_cmp_ps(_mm256_mul_ps(det, _mm256_set1_ps(cullSign)), zero, _CMP_GT_OQ) };
+
+			__m256 hit{ _mm256_and_ps(facing, _mm256_cmp_ps(u, zero, _CMP_GE_OQ)) };
+			hit = _mm256_and_ps(hit, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+			hit = _mm256_and_ps(hit, _mm256_cmp_ps(_mm256_add_ps(u, v), _mm256_set1_ps(1.f), _CMP_LE_OQ));
+			hit = _mm256_and_ps(hit, _mm256_cmp_ps(distance, _mm256_set1_ps(ray.min), _CMP_GE_OQ));
+			hit = _mm256_and_ps(hit, _mm256_cmp_ps(distance, _mm256_set1_ps(std::min(ray.max, tMax)), _CMP_LE_OQ));
+
+			hitMask = _mm256_movemask_ps(hit) & ((1 << triangleCount) - 1);
+			if (hitMask == 0)
+				return false;
+
+			_mm256_store_ps(t, distance);
+#else
+			for (uint32_t lane{ 0 }; lane < triangleCount; ++lane)
+			{
+				const Vector3 v0{ block.v0X[lane], block.v0Y[lane], block.v0Z[lane] };
+				const Vector3 edge1{ block.edge1X[lane], block.edge1Y[lane], block.edge1Z[lane] };
+				const Vector3 edge2{ block.edge2X[lane], block.edge2Y[lane], block.edge2Z[lane] };
+
+				if (HitTest_TriangleEdges(v0, edge1, edge2, ray, cullSign, tMax, t[lane]))
+					hitMask |= 1 << lane;
+			}
+
+			if (hitMask == 0)
+				return false;
+#endif
+
+			// Closest lane that hit
+			tHit = FLT_MAX;
+			for (int lane{ 0 }; lane < TriangleBlock::Width; ++lane)
+			{
+				if ((hitMask & (1 << lane)) && t[lane] < tHit)
+				{
+					tHit = t[lane];
+					hitLane = lane;
+				}
+			}
+
+			return true;
+		}
 #pragma endregion
 #pragma region TriangeMesh HitTest
 
 		inline bool SlabTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray)
 		{
+#ifdef RAY_STATISTICS
+			++Statistics::GetThreadCounters().aabbTests;
+#endif
 			float tx1{ (mesh.transformedMinAABB.x - ray.origin.x) / ray.direction.x };
 			float tx2{ (mesh.transformedMaxAABB.x - ray.origin.x) / ray.direction.x };
 
@@ -225,27 +459,384 @@ namespace dae
 
 		}
 
-		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		// Slab test against an AABB using the precomputed inverse ray direction ( No divisions )
+		// Returns the distance where the ray enters the box, FLT_MAX if it misses or enters after tMax
+		inline float SlabTest_AABB(const Vector3& minAABB, const Vector3& maxAABB, const Ray& ray, const Vector3& invDirection, float tMax)
 		{
-			// slabtest for performance
-			if (!SlabTest_TriangleMesh(mesh, ray))
+#ifdef RAY_STATISTICS
+			++Statistics::GetThreadCounters().aabbTests;
+#endif
+			const float tx1{ (minAABB.x - ray.origin.x) * invDirection.x };
+			const float tx2{ (maxAABB.x - ray.origin.x) * invDirection.x };
+
+			float tNear{ std::min(tx1, tx2) };
+			float tFar{ std::max(tx1, tx2) };
+
+			const float ty1{ (minAABB.y - ray.origin.y) * invDirection.y };
+			const float ty2{ (maxAABB.y - ray.origin.y) * invDirection.y };
+
+			tNear = std::max(tNear, std::min(ty1, ty2));
+			tFar = std::min(tFar, std::max(ty1, ty2));
+
+			const float tz1{ (minAABB.z - ray.origin.z) * invDirection.z };
+			const float tz2{ (maxAABB.z - ray.origin.z) * invDirection.z };
+
+			tNear = std::max(tNear, std::min(tz1, tz2));
+			tFar = std::min(tFar, std::max(tz1, tz2));
+
+			if (tFar >= tNear && tFar > 0.f && tNear < tMax)
+				return tNear;
+
+			return FLT_MAX;
+		}
+
+		/**
+		 * \brief Front-to-back traversal of a BVH, shared by the meshes and the scene top-level structure
+		 * \param bvh BVH to traverse
+		 * \param ray Ray to test
+		 * \param closestT Closest hit found so far, nodes further away are skipped ( Updated by the leaf test )
+		 * \param anyHit Stop at the first hit ( Shadow rays )
+		 * \param leafTest bool(uint32_t primitiveIdx, float& closestT) -> Tests one primitive, returns true on a hit
+		 * \return true if any primitive was hit
+		 */
+		template<typename LeafTest>
+		inline bool TraverseBVH(const BVH& bvh, const Ray& ray, float& closestT, bool anyHit, LeafTest&& leafTest)
+		{
+			const std::vector<BVHNode>& nodes{ bvh.GetNodes() };
+			if (nodes.empty())
+				return false;
+
+			const std::vector<uint32_t>& primitiveIndices{ bvh.GetPrimitiveIndices() };
+			const Vector3 invDirection{ 1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z };
+
+			if (SlabTest_AABB(nodes[0].minAABB, nodes[0].maxAABB, ray, invDirection, closestT) == FLT_MAX)
 				return false;		// No hit
 
+			// Nodes still to visit + the distance where the ray enters them
+			struct StackEntry
+			{
+				uint32_t nodeIdx;
+				float tEntry;
+			};
+			// At most one entry ( The far child ) per inner node on the path down
+			StackEntry stack[BVH::MaxDepth]{};
+			int stackSize{ 0 };
+
+			bool didHit{ false };
+			uint32_t nodeIdx{ 0 };
+			while (true)
+			{
+				const BVHNode& node{ nodes[nodeIdx] };
+				if (node.IsLeaf())
+				{
+					for (uint32_t leafIdx{ 0 }; leafIdx < node.primitiveCount; ++leafIdx)
+					{
+						if (leafTest(primitiveIndices[node.leftFirst + leafIdx], closestT))
+						{
+							if (anyHit)
+								return true; // Return the first hit
+
+							didHit = true;
+						}
+					}
+				}
+				else
+				{
+					// Front-to-back : visit the closest child first
+					uint32_t nearIdx{ node.leftFirst };
+					uint32_t farIdx{ node.leftFirst + 1 };
+					float tNear{ SlabTest_AABB(nodes[nearIdx].minAABB, nodes[nearIdx].maxAABB, ray, invDirection, closestT) };
+					float tFar{ SlabTest_AABB(nodes[farIdx].minAABB, nodes[farIdx].maxAABB, ray, invDirection, closestT) };
+
+					if (tFar < tNear)
+					{
+						std::swap(nearIdx, farIdx);
+						std::swap(tNear, tFar);
+					}
+
+					if (tNear != FLT_MAX)
+					{
+						if (tFar != FLT_MAX)
+							stack[stackSize++] = { farIdx, tFar };
+
+						nodeIdx = nearIdx;
+						continue;
+					}
+				}
+
+				// Pop the next node, skip the ones behind the closest hit
+				bool foundNode{ false };
+				while (stackSize > 0)
+				{
+					const StackEntry& entry{ stack[--stackSize] };
+					if (entry.tEntry < closestT)
+					{
+						nodeIdx = entry.nodeIdx;
+						foundNode = true;
+						break;
+					}
+				}
+
+				if (!foundNode)
+					break;
+			}
+
+			return didHit;
+		}
+
+		// 8-bit quantized child bounds -> 4 floats
+		inline __m128 DecodeQuantized_SSE(const uint8_t* pQuantized)
+		{
+			int packed{};
+			std::memcpy(&packed, pQuantized, sizeof(packed));
+
+			const __m128i zero{ _mm_setzero_si128() };
+			__m128i values{ _mm_cvtsi32_si128(packed) };
+			values = _mm_unpacklo_epi8(values, zero);
+			values = _mm_unpacklo_epi16(values, zero);
+			return _mm_cvtepi32_ps(values);
+		}
+
+		// 2^exponent, built straight from the float bits
+		inline __m128 ExponentToStep_SSE(int8_t exponent)
+		{
+			return _mm_castsi128_ps(_mm_set1_epi32((exponent + 127) << 23));
+		}
+
+		/**
+		 * \brief Front-to-back traversal of a 4-wide BVH, the 4 child boxes of a node are tested at once with SSE
+		 * \param bvh Wide BVH to traverse
+		 * \param ray Ray to test
+		 * \param closestT Closest hit found so far, nodes further away are skipped ( Updated by the leaf test )
+		 * \param anyHit Stop at the first hit ( Shadow rays )
+		 * \param leafTest bool(uint32_t leafFirst, uint32_t primitiveCount, float& closestT) -> Tests a whole leaf, returns true on a hit
+		 *        ... leafFirst is the slot in the primitive index list ( Multiple of WideBVH::LeafAlignment )
+		 * \param startNodeIdx Node to start from ( Root by default, subtree when a packet falls back to single rays )
+		 * \return true if any primitive was hit
+		 */
+		template<typename LeafTest>
+		inline bool TraverseWideBVH(const WideBVH& bvh, const Ray& ray, float& closestT, bool anyHit, LeafTest&& leafTest,
+			uint32_t startNodeIdx = 0)
+		{
+			const std::vector<WideBVHNode>& nodes{ bvh.GetNodes() };
+			if (nodes.empty())
+				return false;
+
+			// Everything that only depends on the ray, splatted once
+			const __m128 originX{ _mm_set1_ps(ray.origin.x) };
+			const __m128 originY{ _mm_set1_ps(ray.origin.y) };
+			const __m128 originZ{ _mm_set1_ps(ray.origin.z) };
+			const __m128 invDirectionX{ _mm_set1_ps(1.f / ray.direction.x) };
+			const __m128 invDirectionY{ _mm_set1_ps(1.f / ray.direction.y) };
+			const __m128 invDirectionZ{ _mm_set1_ps(1.f / ray.direction.z) };
+			const __m128 zero{ _mm_setzero_ps() };
+
+			struct StackEntry
+			{
+				uint32_t nodeIdx;
+				float tEntry;
+			};
+			// At most Width - 1 entries per wide node on the path down ( Never deeper than the binary tree )
+			StackEntry stack[(WideBVHNode::Width - 1) * BVH::MaxDepth]{};
+			int stackSize{ 0 };
+
 			bool didHit{ false };
+			uint32_t nodeIdx{ startNodeIdx };
+			while (true)
+			{
+				const WideBVHNode& node{ nodes[nodeIdx] };
+#ifdef RAY_STATISTICS
+				Statistics::GetThreadCounters().aabbTests += WideBVHNode::Width;	// Empty children included, they are tested too
+#endif
+
+				// Slab test against the 4 children
+				const __m128 stepX{ ExponentToStep_SSE(node.exponent[0]) };
+				const __m128 stepY{ ExponentToStep_SSE(node.exponent[1]) };
+				const __m128 stepZ{ ExponentToStep_SSE(node.exponent[2]) };
+				const __m128 nodeOriginX{ _mm_set1_ps(node.origin.x) };
+				const __m128 nodeOriginY{ _mm_set1_ps(node.origin.y) };
+				const __m128 nodeOriginZ{ _mm_set1_ps(node.origin.z) };
+
+				const __m128 minX{ _mm_add_ps(nodeOriginX, _mm_mul_ps(DecodeQuantized_SSE(node.childMinX), stepX)) };
+				const __m128 minY{ _mm_add_ps(nodeOriginY, _mm_mul_ps(DecodeQuantized_SSE(node.childMinY), stepY)) };
+				const __m128 minZ{ _mm_add_ps(nodeOriginZ, _mm_mul_ps(DecodeQuantized_SSE(node.childMinZ), stepZ)) };
+				const __m128 maxX{ _mm_add_ps(nodeOriginX, _mm_mul_ps(DecodeQuantized_SSE(node.childMaxX), stepX)) };
+				const __m128 maxY{ _mm_add_ps(nodeOriginY, _mm_mul_ps(DecodeQuantized_SSE(node.childMaxY), stepY)) };
+				const __m128 maxZ{ _mm_add_ps(nodeOriginZ, _mm_mul_ps(DecodeQuantized_SSE(node.childMaxZ), stepZ)) };
+
+				const __m128 tx1{ _mm_mul_ps(_mm_sub_ps(minX, originX), invDirectionX) };
+				const __m128 tx2{ _mm_mul_ps(_mm_sub_ps(maxX, originX), invDirectionX) };
+				const __m128 ty1{ _mm_mul_ps(_mm_sub_ps(minY, originY), invDirectionY) };
+				const __m128 ty2{ _mm_mul_ps(_mm_sub_ps(maxY, originY), invDirectionY) };
+				const __m128 tz1{ _mm_mul_ps(_mm_sub_ps(minZ, originZ), invDirectionZ) };
+				const __m128 tz2{ _mm_mul_ps(_mm_sub_ps(maxZ, originZ), invDirectionZ) };
+
+				const __m128 tNear{ _mm_max_ps(_mm_max_ps(_mm_min_ps(tx1, tx2), _mm_min_ps(ty1, ty2)), _mm_min_ps(tz1, tz2)) };
+				const __m128 tFar{ _mm_min_ps(_mm_min_ps(_mm_max_ps(tx1, tx2), _mm_max_ps(ty1, ty2)), _mm_max_ps(tz1, tz2)) };
+
+				// Same conditions as SlabTest_AABB
+				const __m128 hit{ _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(tFar, tNear), _mm_cmpgt_ps(tFar, zero)),
+					_mm_cmplt_ps(tNear, _mm_set1_ps(closestT))) };
+
+				int hitMask{ _mm_movemask_ps(hit) };
+				for (int childIdx{ 0 }; childIdx < WideBVHNode::Width; ++childIdx)
+				{
+					if (node.IsEmpty(childIdx))
+						hitMask &= ~(1 << childIdx);
+				}
+
+				alignas(16) float tEntry[WideBVHNode::Width]{};
+				_mm_store_ps(tEntry, tNear);
+
+				// Leaves first, a hit shrinks closestT before the inner children are pushed
+				StackEntry innerChildren[WideBVHNode::Width]{};
+				int innerCount{ 0 };
+				for (int childIdx{ 0 }; childIdx < WideBVHNode::Width; ++childIdx)
+				{
+					if (!(hitMask & (1 << childIdx)))
+						continue;
+
+					if (node.IsInner(childIdx))
+					{
+						innerChildren[innerCount++] = { node.child[childIdx], tEntry[childIdx] };
+						continue;
+					}
+
+					if (leafTest(node.child[childIdx], node.primitiveCount[childIdx], closestT))
+					{
+						if (anyHit)
+							return true; // Return the first hit
+
+						didHit = true;
+					}
+				}
+
+				// Front-to-back : sort the inner children by distance ( Insertion sort, max 4 )
+				for (int sortIdx{ 1 }; sortIdx < innerCount; ++sortIdx)
+				{
+					const StackEntry entry{ innerChildren[sortIdx] };
+					int insertIdx{ sortIdx };
+					while (insertIdx > 0 && innerChildren[insertIdx - 1].tEntry > entry.tEntry)
+					{
+						innerChildren[insertIdx] = innerChildren[insertIdx - 1];
+						--insertIdx;
+					}
+					innerChildren[insertIdx] = entry;
+				}
+
+				// Farthest on the stack first, continue with the closest one
+				for (int childIdx{ innerCount - 1 }; childIdx > 0; --childIdx)
+				{
+					if (innerChildren[childIdx].tEntry < closestT)
+						stack[stackSize++] = innerChildren[childIdx];
+				}
+
+				if (innerCount > 0 && innerChildren[0].tEntry < closestT)
+				{
+					nodeIdx = innerChildren[0].nodeIdx;
+					continue;
+				}
+
+				// Pop the next node, skip the ones behind the closest hit
+				bool foundNode{ false };
+				while (stackSize > 0)
+				{
+					const StackEntry& entry{ stack[--stackSize] };
+					if (entry.tEntry < closestT)
+					{
+						nodeIdx = entry.nodeIdx;
+						foundNode = true;
+						break;
+					}
+				}
+
+				if (!foundNode)
+					break;
+			}
+
+			return didHit;
+		}
+
+		// Ray in the object space of the mesh ( Direction not normalized -> same t )
+		inline Ray ToObjectSpace(const TriangleMesh& mesh, const Ray& ray)
+		{
+			Ray objectRay{ ray };
+			objectRay.origin = mesh.inverseTransform.TransformPoint(ray.origin);
+			objectRay.direction = mesh.inverseTransform.TransformVector(ray.direction);
+			return objectRay;
+		}
+
+		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		{
+			const MeshGeometry& geometry{ *mesh.pGeometry };
+
+			// Move the ray into object space instead of moving every triangle into world space
+			// ... The direction is NOT normalized again, so t is the same in both spaces
+			const Ray objectRay{ ToObjectSpace(mesh, ray) };
+
+			// Closest hit found so far, nodes further away than this can be skipped
+			float closestT{ ignoreHitRecord ? ray.max : std::min(ray.max, hitRecord.t) };
+			const float previousT{ hitRecord.t };
+
+#ifdef USE_WIDE_BVH
+			const float cullSign{ GetCullSign(mesh.cullMode, ignoreHitRecord) };
+
+			const bool didHit{ TraverseWideBVH(geometry.wideBVH, objectRay, closestT, ignoreHitRecord,
+				[&](uint32_t leafFirst, uint32_t triangleCount, float& closestT)
+				{
+					const TriangleBlock& block{ geometry.triangleBlocks[leafFirst / TriangleBlock::Width] };
+
+					float t{};
+					int hitLane{};
+					if (!HitTest_TriangleBlock(block, triangleCount, objectRay, cullSign, closestT, t, hitLane))
+						return false;
+
+					if (!ignoreHitRecord)
+					{
+						closestT = t;
+						hitRecord.normal = block.GetNormal(hitLane);
+						hitRecord.t = t;
+						hitRecord.didHit = true;
+						hitRecord.materialIndex = mesh.materialIndex;
+					}
+					return true;
+				}) };
+#else
 			Triangle triangle{};
-			for (size_t index{ 0 }; index < mesh.indices.size(); index += 3)
+			triangle.cullMode = mesh.cullMode;
+			triangle.materialIndex = mesh.materialIndex;
+
+			const bool didHit{ TraverseBVH(geometry.bvh, objectRay, closestT, ignoreHitRecord,
+				[&](uint32_t triangleIdx, float& closestT)
+				{
+					const size_t index{ triangleIdx * 3 };
+
+					// V0 , V1 , V2 and normal
+					triangle.v0 = geometry.positions[geometry.indices[index]];
+					triangle.v1 = geometry.positions[geometry.indices[index + 1]];
+					triangle.v2 = geometry.positions[geometry.indices[index + 2]];
+					triangle.normal = geometry.normals[triangleIdx];
+
+					if (!HitTest_Triangle(triangle, objectRay, hitRecord, ignoreHitRecord))
+						return false;
+
+					if (!ignoreHitRecord)
+						closestT = std::min(closestT, hitRecord.t);
+					return true;
+				}) };
+#endif
+
+			// This mesh wrote the hit record -> bring it back to world space
+			if (didHit && !ignoreHitRecord && hitRecord.t < previousT)
 			{
-				// V0 , V1 , V2 and normal
-				triangle.v0 = mesh.transformedPositions[mesh.indices[index]];
-				triangle.v1 = mesh.transformedPositions[mesh.indices[index + 1]];
-				triangle.v2 = mesh.transformedPositions[mesh.indices[index + 2]];
-				triangle.normal = mesh.transformedNormals[index / 3];
-				triangle.cullMode = mesh.cullMode;
-				triangle.materialIndex = mesh.materialIndex;
-
-				didHit = HitTest_Triangle(triangle, ray, hitRecord, ignoreHitRecord);		
-				if (ignoreHitRecord && didHit == true)
-					return didHit; // Return the first hit
+				hitRecord.origin = ray.origin + ray.direction * hitRecord.t;
+
+				// Normals need the inverse transpose ( Non-uniform scale )
+				const Vector3 objectNormal{ hitRecord.normal };
+				hitRecord.normal = Vector3{
+					Vector3::Dot(mesh.inverseTransform.GetAxisX(), objectNormal),
+					Vector3::Dot(mesh.inverseTransform.GetAxisY(), objectNormal),
+					Vector3::Dot(mesh.inverseTransform.GetAxisZ(), objectNormal) }.Normalized();
 			}
 
 			return didHit;
@@ -256,6 +847,527 @@ namespace dae
 			HitRecord temp{};
 			return HitTest_TriangleMesh(mesh, ray, temp, true);
 		}
+
+		/**
+		 * \brief Shadow ray against one triangle of a mesh ( The cached occluder of the previous shadow ray )
+		 * \param mesh Mesh the triangle belongs to
+		 * \param triangleIdx Triangle to test, out of range -> no hit ( Stale cache )
+		 * \param objectRay Shadow ray, already in the object space of the mesh
+		 * \return true if the triangle blocks the ray
+		 */
+		inline bool Occluded_MeshTriangle(const TriangleMesh& mesh, uint32_t triangleIdx, const Ray& objectRay)
+		{
+			const MeshGeometry& geometry{ *mesh.pGeometry };
+			const size_t index{ static_cast<size_t>(triangleIdx) * 3 };
+			if (index + 2 >= geometry.indices.size())
+				return false;
+
+			const Vector3& v0{ geometry.positions[geometry.indices[index]] };
+			const Vector3& v1{ geometry.positions[geometry.indices[index + 1]] };
+			const Vector3& v2{ geometry.positions[geometry.indices[index + 2]] };
+
+#ifdef USE_WIDE_BVH
+			// Same test as the triangle blocks, so the cache never changes the result
+			float t{};
+			return HitTest_TriangleEdges(v0, v1 - v0, v2 - v0, objectRay, GetCullSign(mesh.cullMode, true), objectRay.max, t);
+#else
+			Triangle triangle{ v0, v1, v2, geometry.normals[triangleIdx] };
+			triangle.cullMode = mesh.cullMode;
+			return HitTest_Triangle(triangle, objectRay);
+#endif
+		}
+
+		/**
+		 * \brief Shadow ray against a whole mesh : stops at the first triangle and never touches a hit record
+		 * \param mesh Mesh to test
+		 * \param objectRay Shadow ray, already in the object space of the mesh
+		 * \param occluderIdx Triangle that blocked the ray ( Only written on a hit )
+		 * \return true if any triangle blocks the ray
+		 */
+		inline bool Occluded_TriangleMesh(const TriangleMesh& mesh, const Ray& objectRay, uint32_t& occluderIdx)
+		{
+			const MeshGeometry& geometry{ *mesh.pGeometry };
+			float closestT{ objectRay.max };
+
+#ifdef USE_WIDE_BVH
+			const float cullSign{ GetCullSign(mesh.cullMode, true) };
+			const std::vector<uint32_t>& primitiveIndices{ geometry.wideBVH.GetPrimitiveIndices() };
+
+			return TraverseWideBVH(geometry.wideBVH, objectRay, closestT, true,
+				[&](uint32_t leafFirst, uint32_t triangleCount, float& closestT)
+				{
+					float t{};
+					int hitLane{};
+					if (!HitTest_TriangleBlock(geometry.triangleBlocks[leafFirst / TriangleBlock::Width], triangleCount, objectRay,
+						cullSign, closestT, t, hitLane))
+						return false;
+
+					occluderIdx = primitiveIndices[leafFirst + hitLane];
+					return true;
+				});
+#else
+			Triangle triangle{};
+			triangle.cullMode = mesh.cullMode;
+
+			return TraverseBVH(geometry.bvh, objectRay, closestT, true,
+				[&](uint32_t triangleIdx, float&)
+				{
+					const size_t index{ triangleIdx * 3 };
+					triangle.v0 = geometry.positions[geometry.indices[index]];
+					triangle.v1 = geometry.positions[geometry.indices[index + 1]];
+					triangle.v2 = geometry.positions[geometry.indices[index + 2]];
+					triangle.normal = geometry.normals[triangleIdx];
+
+					if (!HitTest_Triangle(triangle, objectRay))
+						return false;
+
+					occluderIdx = triangleIdx;
+					return true;
+				});
+#endif
+		}
+#pragma endregion
+#pragma region SphereSet HitTest
+		inline bool HitTest_SphereSet(const SphereSet& sphereSet, const Ray& ray, HitRecord& hitRecord)
+		{
+			// Closest hit found so far, nodes further away than this can be skipped
+			float closestT{ std::min(ray.max, hitRecord.t) };
+			uint32_t hitSphereIdx{ WideBVH::InvalidPrimitive };
+
+#ifdef USE_WIDE_BVH
+			const std::vector<uint32_t>& primitiveIndices{ sphereSet.wideBVH.GetPrimitiveIndices() };
+
+			TraverseWideBVH(sphereSet.wideBVH, ray, closestT, false,
+				[&](uint32_t leafFirst, uint32_t sphereCount, float& closestT)
+				{
+					float t{};
+					int hitLane{};
+					if (!HitTest_SphereBlock(sphereSet.sphereBlocks[leafFirst / SphereBlock::Width], sphereCount, ray, closestT, t, hitLane))
+						return false;
+
+					closestT = t;
+					hitSphereIdx = primitiveIndices[leafFirst + hitLane];
+					return true;
+				});
+#else
+			TraverseBVH(sphereSet.bvh, ray, closestT, false,
+				[&](uint32_t sphereIdx, float& closestT)
+				{
+					float t{};
+					if (!HitTest_SphereSquared(sphereSet.GetCenter(sphereIdx), sphereSet.radiusSquared[sphereIdx], ray, closestT, t))
+						return false;
+
+					closestT = t;
+					hitSphereIdx = sphereIdx;
+					return true;
+				});
+#endif
+
+			if (hitSphereIdx == WideBVH::InvalidPrimitive)
+				return false;
+
+			// Only the closest sphere fills in the hit record
+			hitRecord.t = closestT;
+			hitRecord.origin = ray.origin + (closestT * ray.direction);
+			hitRecord.normal = (hitRecord.origin - sphereSet.GetCenter(hitSphereIdx)).Normalized();
+			hitRecord.didHit = true;
+			hitRecord.materialIndex = sphereSet.materialIndices[hitSphereIdx];
+			return true;
+		}
+
+		// Shadow ray against one sphere of the set ( The cached occluder ), out of range -> no hit
+		inline bool Occluded_SetSphere(const SphereSet& sphereSet, uint32_t sphereIdx, const Ray& ray)
+		{
+			float t{};
+			return sphereIdx < sphereSet.GetSphereCount()
+				&& HitTest_SphereSquared(sphereSet.GetCenter(sphereIdx), sphereSet.radiusSquared[sphereIdx], ray, ray.max, t);
+		}
+
+		// Shadow ray against the whole set : stops at the first sphere, occluderIdx receives the sphere that blocked the ray
+		inline bool Occluded_SphereSet(const SphereSet& sphereSet, const Ray& ray, uint32_t& occluderIdx)
+		{
+			float closestT{ ray.max };
+
+#ifdef USE_WIDE_BVH
+			const std::vector<uint32_t>& primitiveIndices{ sphereSet.wideBVH.GetPrimitiveIndices() };
+
+			return TraverseWideBVH(sphereSet.wideBVH, ray, closestT, true,
+				[&](uint32_t leafFirst, uint32_t sphereCount, float& closestT)
+				{
+					float t{};
+					int hitLane{};
+					if (!HitTest_SphereBlock(sphereSet.sphereBlocks[leafFirst / SphereBlock::Width], sphereCount, ray, closestT, t, hitLane))
+						return false;
+
+					occluderIdx = primitiveIndices[leafFirst + hitLane];
+					return true;
+				});
+#else
+			return TraverseBVH(sphereSet.bvh, ray, closestT, true,
+				[&](uint32_t sphereIdx, float&)
+				{
+					if (!Occluded_SetSphere(sphereSet, sphereIdx, ray))
+						return false;
+
+					occluderIdx = sphereIdx;
+					return true;
+				});
+#endif
+		}
+#pragma endregion
+
+#pragma region Packet HitTest
+		// Box completely behind one of the side planes of the frustum -> none of the rays can hit it
+		inline bool IsBoxInFrustum(const Vector3& minAABB, const Vector3& maxAABB, const Vector3& origin, const Vector3 (&frustumNormals)[4])
+		{
+			for (const Vector3& normal : frustumNormals)
+			{
+				// Corner of the box furthest along the normal
+				const Vector3 corner{
+					normal.x >= 0.f ? maxAABB.x : minAABB.x,
+					normal.y >= 0.f ? maxAABB.y : minAABB.y,
+					normal.z >= 0.f ? maxAABB.z : minAABB.z };
+
+				// Small tolerance for the rays that lie exactly on the plane
+				if (Vector3::Dot(normal, corner - origin) < -0.0001f)
+					return false;
+			}
+
+			return true;
+		}
+
+#ifdef PACKET_TRACING
+		// One bit per ray of the packet
+		using RayMask = uint64_t;
+
+		// Fewer rays than this left in a node -> trace them one by one, the packet overhead isn't worth it
+		constexpr int PacketFallbackRayCount{ 2 };
+
+		// Packet moved into the object space of a mesh + the closest hit of every ray in that mesh
+		struct MeshPacket
+		{
+			static constexpr uint32_t NoHit{ UINT32_MAX };
+
+			// Only the first rayCount entries are filled in ( Not cleared, this is created per mesh per packet )
+			Vector3 origin{};
+			alignas(32) float directionX[RayPacket::MaxRays];
+			alignas(32) float directionY[RayPacket::MaxRays];
+			alignas(32) float directionZ[RayPacket::MaxRays];
+			alignas(32) float invDirectionX[RayPacket::MaxRays];
+			alignas(32) float invDirectionY[RayPacket::MaxRays];
+			alignas(32) float invDirectionZ[RayPacket::MaxRays];
+			alignas(32) float closestT[RayPacket::MaxRays];
+			uint32_t hitSlot[RayPacket::MaxRays];		// Triangle block slot of the closest hit ( block * 8 + lane )
+
+			Vector3 frustumNormals[4]{};
+			float min{};
+			float max{};
+			float cullSign{};
+
+			Ray GetRay(int rayIdx) const
+			{
+				return Ray{ origin, Vector3{ directionX[rayIdx], directionY[rayIdx], directionZ[rayIdx] }, min, max };
+			}
+		};
+
+		// Slab test of 8 rays against one box, returns one bit per ray that enters it before its closest hit
+		inline int SlabTest_AABB_8(const Vector3& minAABB, const Vector3& maxAABB, const MeshPacket& packet, int rayOffset, __m256& tNear)
+		{
+#ifdef RAY_STATISTICS
+			Statistics::GetThreadCounters().aabbTests += 8;
+#endif
+			const __m256 invDirectionX{ _mm256_load_ps(packet.invDirectionX + rayOffset) };
+			const __m256 invDirectionY{ _mm256_load_ps(packet.invDirectionY + rayOffset) };
+			const __m256 invDirectionZ{ _mm256_load_ps(packet.invDirectionZ + rayOffset) };
+
+			// Same origin for every ray -> ( bound - origin ) is the same for all lanes
+			const __m256 tx1{ _mm256_mul_ps(_mm256_set1_ps(minAABB.x - packet.origin.x), invDirectionX) };
+			const __m256 tx2{ _mm256_mul_ps(_mm256_set1_ps(maxAABB.x - packet.origin.x), invDirectionX) };
+			const __m256 ty1{ _mm256_mul_ps(_mm256_set1_ps(minAABB.y - packet.origin.y), invDirectionY) };
+			const __m256 ty2{ _mm256_mul_ps(_mm256_set1_ps(maxAABB.y - packet.origin.y), invDirectionY) };
+			const __m256 tz1{ _mm256_mul_ps(_mm256_set1_ps(minAABB.z - packet.origin.z), invDirectionZ) };
+			const __m256 tz2{ _mm256_mul_ps(_mm256_set1_ps(maxAABB.z - packet.origin.z), invDirectionZ) };
+
+			tNear = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(tx1, tx2), _mm256_min_ps(ty1, ty2)), _mm256_min_ps(tz1, tz2));
+			const __m256 tFar{ _mm256_min_ps(_mm256_min_ps(_mm256_max_ps(tx1, tx2), _mm256_max_ps(ty1, ty2)), _mm256_max_ps(tz1, tz2)) };
+
+			// Same conditions as SlabTest_AABB
+			__m256 hit{ _mm256_cmp_ps(tFar, tNear, _CMP_GE_OQ) };
+			hit = _mm256_and_ps(hit, _mm256_cmp_ps(tFar, _mm256_setzero_ps(), _CMP_GT_OQ));
+			hit = _mm256_and_ps(hit, _mm256_cmp_ps(tNear, _mm256_load_ps(packet.closestT + rayOffset), _CMP_LT_OQ));
+			return _mm256_movemask_ps(hit);
+		}
+
+		// Moller-Trumbore of 8 rays against one triangle of a block, keeps the closest hit of every ray
+		inline void HitTest_Triangle_8(const TriangleBlock& block, int lane, uint32_t slot, MeshPacket& packet, int rayOffset, int rayBits)
+		{
+#ifdef RAY_STATISTICS
+			Statistics::GetThreadCounters().triangleTests += std::popcount(static_cast<uint32_t>(rayBits));
+#endif
+			const Vector3 edge1{ block.edge1X[lane], block.edge1Y[lane], block.edge1Z[lane] };
+			const Vector3 edge2{ block.edge2X[lane], block.edge2Y[lane], block.edge2Z[lane] };
+
+			// Shared origin -> T and Q = T x edge1 are the same for every ray
+			const Vector3 toOrigin{ packet.origin - Vector3{ block.v0X[lane], block.v0Y[lane], block.v0Z[lane] } };
+			const Vector3 q{ Vector3::Cross(toOrigin, edge1) };
+
+			const __m256 directionX{ _mm256_load_ps(packet.directionX + rayOffset) };
+			const __m256 directionY{ _mm256_load_ps(packet.directionY + rayOffset) };
+			const __m256 directionZ{ _mm256_load_ps(packet.directionZ + rayOffset) };
+
+			// P = direction x edge2
+			const __m256 pX{ _mm256_sub_ps(_mm256_mul_ps(directionY, _mm256_set1_ps(edge2.z)), _mm256_mul_ps(directionZ, _mm256_set1_ps(edge2.y))) };
+			const __m256 pY{ _mm256_sub_ps(_mm256_mul_ps(directionZ, _mm256_set1_ps(edge2.x)), _mm256_mul_ps(directionX, _mm256_set1_ps(edge2.z))) };
+			const __m256 pZ{ _mm256_sub_ps(_mm256_mul_ps(directionX, _mm256_set1_ps(edge2.y)), _mm256_mul_ps(directionY, _mm256_set1_ps(edge2.x))) };
+
+			const __m256 det{ _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(edge1.x), pX), _mm256_mul_ps(_mm256_set1_ps(edge1.y), pY)),
+				_mm256_mul_ps(_mm256_set1_ps(edge1.z), pZ)) };
+			const __m256 invDet{ _mm256_div_ps(_mm256_set1_ps(1.f), det) };
+
+			const __m256 u{ _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(toOrigin.x), pX),
+				_mm256_mul_ps(_mm256_set1_ps(toOrigin.y), pY)), _mm256_mul_ps(_mm256_set1_ps(toOrigin.z), pZ)), invDet) };
+			const __m256 v{ _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(directionX, _mm256_set1_ps(q.x)),
+				_mm256_mul_ps(directionY, _mm256_set1_ps(q.y))), _mm256_mul_ps(directionZ, _mm256_set1_ps(q.z))), invDet) };
+			const __m256 distance{ _mm256_mul_ps(_mm256_set1_ps(Vector3::Dot(edge2, q)), invDet) };
+
+			const __m256 zero{ _mm256_setzero_ps() };
+			const __m256 closestT{ _mm256_load_ps(packet.closestT + rayOffset) };
+			const __m256 facing{ packet.cullSign == 0.f ? _mm256_cmp_ps(det, zero, _CMP_NEQ_OQ)
+				: _mm256_cmp_ps(_mm256_mul_ps(det, _mm256_set1_ps(packet.cullSign)), zero, _CMP_GT_OQ) };
+
+			__m256 hit{ _mm256_and_ps(facing, _mm256_cmp_ps(u, zero, _CMP_GE_OQ)) };
+			hit = _mm256_and_ps(hit, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+			hit = _mm256_and_ps(hit, _mm256_cmp_ps(_mm256_add_ps(u, v), _mm256_set1_ps(1.f), _CMP_LE_OQ));
+			hit = _mm256_and_ps(hit, _mm256_cmp_ps(distance, _mm256_set1_ps(packet.min), _CMP_GE_OQ));
+			hit = _mm256_and_ps(hit, _mm256_cmp_ps(distance, _mm256_min_ps(closestT, _mm256_set1_ps(packet.max)), _CMP_LE_OQ));
+
+			int hitMask{ _mm256_movemask_ps(hit) & rayBits };
+			if (hitMask == 0)
+				return;
+
+			_mm256_store_ps(packet.closestT + rayOffset, _mm256_blendv_ps(closestT, distance, hit));
+			while (hitMask)
+			{
+				const int rayIdx{ std::countr_zero(static_cast<unsigned>(hitMask)) };
+				packet.hitSlot[rayOffset + rayIdx] = slot;
+				hitMask &= hitMask - 1;
+			}
+		}
+
+		/**
+		 * \brief Closest hits of a packet of rays against a mesh instance, through the wide BVH
+		 * Nodes are culled for the whole packet with the frustum first, then per ray ( 8 at a time ) with the slab test
+		 * \param mesh Mesh instance to test
+		 * \param rayPacket Rays to test ( Sharing one origin )
+		 * \param hitRecords One per ray, only overwritten when this mesh is closer
+		 */
+		inline void HitTest_TriangleMesh(const TriangleMesh& mesh, const RayPacket& rayPacket, HitRecord* hitRecords)
+		{
+			const MeshGeometry& geometry{ *mesh.pGeometry };
+			const std::vector<WideBVHNode>& nodes{ geometry.wideBVH.GetNodes() };
+			if (nodes.empty() || rayPacket.rayCount == 0)
+				return;
+
+			// Move the packet into object space ( Same as the single ray version, t stays the same )
+			MeshPacket packet;
+			packet.origin = mesh.inverseTransform.TransformPoint(rayPacket.origin);
+			packet.min = rayPacket.min;
+			packet.max = rayPacket.max;
+			VectorBatch::TransformVectors(mesh.inverseTransform,
+				rayPacket.directionX, rayPacket.directionY, rayPacket.directionZ,
+				packet.directionX, packet.directionY, packet.directionZ, rayPacket.rayCount);
+			for (int rayIdx{ 0 }; rayIdx < rayPacket.rayCount; ++rayIdx)
+			{
+				packet.invDirectionX[rayIdx] = 1.f / packet.directionX[rayIdx];
+				packet.invDirectionY[rayIdx] = 1.f / packet.directionY[rayIdx];
+				packet.invDirectionZ[rayIdx] = 1.f / packet.directionZ[rayIdx];
+				packet.closestT[rayIdx] = std::min(rayPacket.max, hitRecords[rayIdx].t);
+				packet.hitSlot[rayIdx] = MeshPacket::NoHit;
+			}
+
+			// Planes through the origin : normals move with the transpose of the world matrix
+			for (int planeIdx{ 0 }; planeIdx < 4; ++planeIdx)
+			{
+				const Vector3& normal{ rayPacket.frustumNormals[planeIdx] };
+				packet.frustumNormals[planeIdx] = Vector3{
+					Vector3::Dot(mesh.worldTransform.GetAxisX(), normal),
+					Vector3::Dot(mesh.worldTransform.GetAxisY(), normal),
+					Vector3::Dot(mesh.worldTransform.GetAxisZ(), normal) }.Normalized();
+			}
+
+			// Same cull convention as the single ray version ( Primary rays only )
+			packet.cullSign = GetCullSign(mesh.cullMode, false);
+
+			const int groupCount{ (rayPacket.rayCount + 7) / 8 };
+			const RayMask allRays{ rayPacket.rayCount == RayPacket::MaxRays ? ~RayMask{ 0 } : (RayMask{ 1 } << rayPacket.rayCount) - 1 };
+
+			// Divergent rays : finish the subtree one ray at a time
+			const auto traceSingleRays{ [&](RayMask rays, uint32_t startNodeIdx)
+				{
+					while (rays)
+					{
+						const int rayIdx{ std::countr_zero(rays) };
+						rays &= rays - 1;
+
+						const Ray ray{ packet.GetRay(rayIdx) };
+						TraverseWideBVH(geometry.wideBVH, ray, packet.closestT[rayIdx], false,
+							[&](uint32_t leafFirst, uint32_t triangleCount, float& closestT)
+							{
+								float t{};
+								int hitLane{};
+								if (!HitTest_TriangleBlock(geometry.triangleBlocks[leafFirst / TriangleBlock::Width], triangleCount, ray,
+									packet.cullSign, closestT, t, hitLane))
+									return false;
+
+								closestT = t;
+								packet.hitSlot[rayIdx] = leafFirst + hitLane;
+								return true;
+							}, startNodeIdx);
+					}
+				} };
+
+			struct StackEntry
+			{
+				uint32_t nodeIdx;
+				RayMask activeRays;
+				float tEntry;
+			};
+			// At most Width - 1 entries per wide node on the path down ( Never deeper than the binary tree )
+			StackEntry stack[(WideBVHNode::Width - 1) * BVH::MaxDepth]{};
+			int stackSize{ 0 };
+
+			uint32_t nodeIdx{ 0 };
+			RayMask activeRays{ allRays };
+			while (true)
+			{
+				const WideBVHNode& node{ nodes[nodeIdx] };
+				const float step[3]{ ldexpf(1.f, node.exponent[0]), ldexpf(1.f, node.exponent[1]), ldexpf(1.f, node.exponent[2]) };
+
+				StackEntry innerChildren[WideBVHNode::Width]{};
+				int innerCount{ 0 };
+				for (int childIdx{ 0 }; childIdx < WideBVHNode::Width; ++childIdx)
+				{
+					if (node.IsEmpty(childIdx))
+						continue;
+
+					// Same decoding as the SSE version
+					const Vector3 minAABB{
+						node.origin.x + node.childMinX[childIdx] * step[0],
+						node.origin.y + node.childMinY[childIdx] * step[1],
+						node.origin.z + node.childMinZ[childIdx] * step[2] };
+					const Vector3 maxAABB{
+						node.origin.x + node.childMaxX[childIdx] * step[0],
+						node.origin.y + node.childMaxY[childIdx] * step[1],
+						node.origin.z + node.childMaxZ[childIdx] * step[2] };
+
+					// Whole packet misses the child
+					if (!IsBoxInFrustum(minAABB, maxAABB, packet.origin, packet.frustumNormals))
+						continue;
+
+					// Which rays really enter it ( And before their closest hit )
+					RayMask childRays{ 0 };
+					float childEntry{ FLT_MAX };
+					for (int groupIdx{ 0 }; groupIdx < groupCount; ++groupIdx)
+					{
+						const int groupRays{ static_cast<int>((activeRays >> (groupIdx * 8)) & 0xFF) };
+						if (groupRays == 0)
+							continue;
+
+						__m256 tNear{};
+						int hitMask{ SlabTest_AABB_8(minAABB, maxAABB, packet, groupIdx * 8, tNear) & groupRays };
+						if (hitMask == 0)
+							continue;
+
+						childRays |= RayMask(hitMask) << (groupIdx * 8);
+
+						alignas(32) float tEntry[8]{};
+						_mm256_store_ps(tEntry, tNear);
+						while (hitMask)
+						{
+							childEntry = std::min(childEntry, tEntry[std::countr_zero(static_cast<unsigned>(hitMask))]);
+							hitMask &= hitMask - 1;
+						}
+					}
+
+					if (childRays == 0)
+						continue;
+
+					if (node.IsInner(childIdx))
+					{
+						if (std::popcount(childRays) <= PacketFallbackRayCount)
+							traceSingleRays(childRays, node.child[childIdx]);
+						else
+							innerChildren[innerCount++] = { node.child[childIdx], childRays, childEntry };
+						continue;
+					}
+
+					// Leaf : every remaining triangle against the rays that entered
+					const uint32_t leafFirst{ node.child[childIdx] };
+					const TriangleBlock& block{ geometry.triangleBlocks[leafFirst / TriangleBlock::Width] };
+					for (int groupIdx{ 0 }; groupIdx < groupCount; ++groupIdx)
+					{
+						const int groupRays{ static_cast<int>((childRays >> (groupIdx * 8)) & 0xFF) };
+						if (groupRays == 0)
+							continue;
+
+						for (int lane{ 0 }; lane < node.primitiveCount[childIdx]; ++lane)
+							HitTest_Triangle_8(block, lane, leafFirst + lane, packet, groupIdx * 8, groupRays);
+					}
+				}
+
+				// Front-to-back : closest entry first ( Insertion sort, max 4 )
+				for (int sortIdx{ 1 }; sortIdx < innerCount; ++sortIdx)
+				{
+					const StackEntry entry{ innerChildren[sortIdx] };
+					int insertIdx{ sortIdx };
+					while (insertIdx > 0 && innerChildren[insertIdx - 1].tEntry > entry.tEntry)
+					{
+						innerChildren[insertIdx] = innerChildren[insertIdx - 1];
+						--insertIdx;
+					}
+					innerChildren[insertIdx] = entry;
+				}
+
+				for (int childIdx{ innerCount - 1 }; childIdx > 0; --childIdx)
+					stack[stackSize++] = innerChildren[childIdx];
+
+				if (innerCount > 0)
+				{
+					nodeIdx = innerChildren[0].nodeIdx;
+					activeRays = innerChildren[0].activeRays;
+					continue;
+				}
+
+				if (stackSize == 0)
+					break;
+
+				--stackSize;
+				nodeIdx = stack[stackSize].nodeIdx;
+				activeRays = stack[stackSize].activeRays;
+			}
+
+			// Write the hits of this mesh back in world space
+			for (int rayIdx{ 0 }; rayIdx < rayPacket.rayCount; ++rayIdx)
+			{
+				const uint32_t slot{ packet.hitSlot[rayIdx] };
+				if (slot == MeshPacket::NoHit)
+					continue;
+
+				const Vector3 worldDirection{ rayPacket.directionX[rayIdx], rayPacket.directionY[rayIdx], rayPacket.directionZ[rayIdx] };
+				const Vector3 objectNormal{ geometry.triangleBlocks[slot / TriangleBlock::Width].GetNormal(slot % TriangleBlock::Width) };
+
+				HitRecord& hitRecord{ hitRecords[rayIdx] };
+				hitRecord.t = packet.closestT[rayIdx];
+				hitRecord.origin = rayPacket.origin + worldDirection * hitRecord.t;
+				hitRecord.normal = Vector3{
+					Vector3::Dot(mesh.inverseTransform.GetAxisX(), objectNormal),
+					Vector3::Dot(mesh.inverseTransform.GetAxisY(), objectNormal),
+					Vector3::Dot(mesh.inverseTransform.GetAxisZ(), objectNormal) }.Normalized();
+				hitRecord.didHit = true;
+				hitRecord.materialIndex = mesh.materialIndex;
+			}
+		}
+#endif // PACKET_TRACING
 #pragma endregion
 	}
 
@@ -287,77 +1399,19 @@ namespace dae
 
 	namespace Utils
 	{
-		//Just parses vertices and indices
-#pragma warning(push)
-#pragma warning(disable : 4505) //Warning unreferenced local function
-		static bool ParseOBJ(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices)
+		// Positions, indices and one normal per triangle ( See ObjLoader for texture coordinates and vertex normals )
+		// ... Parsed in parallel from the mapped file, or read from its binary cache when that one is up to date
+		inline bool ParseOBJ(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices)
 		{
-			std::ifstream file(filename);
-			if (!file)
+			ObjMesh mesh{};
+			if (!ObjLoader::Load(filename, mesh))
 				return false;
 
-			std::string sCommand;
-			// start a while iteration ending when the end of file is reached (ios::eof)
-			while (!file.eof())
-			{
-				//read the first word of the string, use the >> operator (istream::operator>>) 
-				file >> sCommand;
-				//use conditional statements to process the different commands	
-				if (sCommand == "#")
-				{
-					// Ignore Comment
-				}
-				else if (sCommand == "v")
-				{
-					//Vertex
-					float x, y, z;
-					file >> x >> y >> z;
-					positions.push_back({ x, y, z });
-				}
-				else if (sCommand == "f")
-				{
-					float i0, i1, i2;
-					file >> i0 >> i1 >> i2;
-
-					indices.push_back((int)i0 - 1);
-					indices.push_back((int)i1 - 1);
-					indices.push_back((int)i2 - 1);
-				}
-				//read till end of line and ignore all remaining chars
-				file.ignore(1000, '\n');
-
-				if (file.eof()) 
-					break;
-			}
-
-			//Precompute normals
-			for (uint64_t index = 0; index < indices.size(); index += 3)
-			{
-				uint32_t i0 = indices[index];
-				uint32_t i1 = indices[index + 1];
-				uint32_t i2 = indices[index + 2];
-
-				Vector3 edgeV0V1 = positions[i1] - positions[i0];
-				Vector3 edgeV0V2 = positions[i2] - positions[i0];
-				Vector3 normal = Vector3::Cross(edgeV0V1, edgeV0V2);
-
-				if(isnan(normal.x))
-				{
-					int k = 0;
-				}
-
-				normal.Normalize();
-				if (isnan(normal.x))
-				{
-					int k = 0;
-				}
-
-				normals.push_back(normal);
-			}
-
+			positions = std::move(mesh.positions);
+			normals = std::move(mesh.normals);
+			indices = std::move(mesh.indices);
 			return true;
 		}
-#pragma warning(pop)
 
 
 	}
@@ -0,0 +1,269 @@
+#pragma once
+#include "MathHelpers.h"
+#include "Vector3.h"
+#include "Matrix.h"
+
+namespace dae
+{
+	// Math on several vectors at once ( SSE 4 wide, AVX2 8 wide, plain loops with SCALAR_MATH )
+	// ... Every lane does the same operations in the same order as the Vector3 / Matrix version -> same results
+	namespace VectorBatch
+	{
+#ifdef MATH_SSE
+		// 4 packed triplets ( 12 floats, AoS : Vector3, ColorRGB ) -> x, y and z registers
+		inline void LoadSoA4(const float* pFloats, __m128& x, __m128& y, __m128& z)
+		{
+			const __m128 m03{ _mm_loadu_ps(pFloats) };		// x0 y0 z0 x1
+			const __m128 m14{ _mm_loadu_ps(pFloats + 4) };	// y1 z1 x2 y2
+			const __m128 m25{ _mm_loadu_ps(pFloats + 8) };	// z2 x3 y3 z3
+
+			const __m128 xy{ _mm_shuffle_ps(m14, m25, _MM_SHUFFLE(2, 1, 3, 2)) };	// x2 y2 x3 y3
+			const __m128 yz{ _mm_shuffle_ps(m03, m14, _MM_SHUFFLE(1, 0, 2, 1)) };	// y0 z0 y1 z1
+			x = _mm_shuffle_ps(m03, xy, _MM_SHUFFLE(2, 0, 3, 0));
+			y = _mm_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+			z = _mm_shuffle_ps(yz, m25, _MM_SHUFFLE(3, 0, 3, 1));
+		}
+
+		inline void LoadSoA4(const Vector3* pVectors, __m128& x, __m128& y, __m128& z)
+		{
+			LoadSoA4(&pVectors[0].x, x, y, z);
+		}
+
+		// Inverse of LoadSoA4
+		inline void StoreSoA4(Vector3* pVectors, __m128 x, __m128 y, __m128 z)
+		{
+			float* pFloats{ &pVectors[0].x };
+			const __m128 xy01{ _mm_shuffle_ps(x, y, _MM_SHUFFLE(1, 0, 1, 0)) };	// x0 x1 y0 y1
+			const __m128 zx01{ _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)) };	// z0 z0 x1 x1
+			const __m128 yz1{ _mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)) };	// y1 y1 z1 z1
+			const __m128 xy2{ _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)) };	// x2 x2 y2 y2
+			const __m128 zx23{ _mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)) };	// z2 z2 x3 x3
+			const __m128 yz3{ _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)) };	// y3 y3 z3 z3
+
+			_mm_storeu_ps(pFloats, _mm_shuffle_ps(xy01, zx01, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(pFloats + 4, _mm_shuffle_ps(yz1, xy2, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(pFloats + 8, _mm_shuffle_ps(zx23, yz3, _MM_SHUFFLE(2, 0, 2, 0)));
+		}
+
+		inline __m128 Dot(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz)
+		{
+			return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+		}
+#endif
+
+#ifdef MATH_AVX2
+		// 8 packed triplets -> the 4 wide shuffles work per 128 bit lane : low lane = triplets 0-3, high lane = 4-7
+		inline void LoadSoA8(const float* pFloats, __m256& x, __m256& y, __m256& z)
+		{
+			const __m256 m03{ _mm256_set_m128(_mm_loadu_ps(pFloats + 12), _mm_loadu_ps(pFloats)) };
+			const __m256 m14{ _mm256_set_m128(_mm_loadu_ps(pFloats + 16), _mm_loadu_ps(pFloats + 4)) };
+			const __m256 m25{ _mm256_set_m128(_mm_loadu_ps(pFloats + 20), _mm_loadu_ps(pFloats + 8)) };
+
+			const __m256 xy{ _mm256_shuffle_ps(m14, m25, _MM_SHUFFLE(2, 1, 3, 2)) };
+			const __m256 yz{ _mm256_shuffle_ps(m03, m14, _MM_SHUFFLE(1, 0, 2, 1)) };
+			x = _mm256_shuffle_ps(m03, xy, _MM_SHUFFLE(2, 0, 3, 0));
+			y = _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+			z = _mm256_shuffle_ps(yz, m25, _MM_SHUFFLE(3, 0, 3, 1));
+		}
+
+		inline void LoadSoA8(const Vector3* pVectors, __m256& x, __m256& y, __m256& z)
+		{
+			LoadSoA8(&pVectors[0].x, x, y, z);
+		}
+
+		// Inverse of LoadSoA8
+		inline void StoreSoA8(Vector3* pVectors, __m256 x, __m256 y, __m256 z)
+		{
+			float* pFloats{ &pVectors[0].x };
+			const __m256 xy01{ _mm256_shuffle_ps(x, y, _MM_SHUFFLE(1, 0, 1, 0)) };
+			const __m256 zx01{ _mm256_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)) };
+			const __m256 yz1{ _mm256_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)) };
+			const __m256 xy2{ _mm256_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)) };
+			const __m256 zx23{ _mm256_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)) };
+			const __m256 yz3{ _mm256_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)) };
+
+			const __m256 m03{ _mm256_shuffle_ps(xy01, zx01, _MM_SHUFFLE(2, 0, 2, 0)) };
+			const __m256 m14{ _mm256_shuffle_ps(yz1, xy2, _MM_SHUFFLE(2, 0, 2, 0)) };
+			const __m256 m25{ _mm256_shuffle_ps(zx23, yz3, _MM_SHUFFLE(2, 0, 2, 0)) };
+			_mm_storeu_ps(pFloats, _mm256_castps256_ps128(m03));
+			_mm_storeu_ps(pFloats + 4, _mm256_castps256_ps128(m14));
+			_mm_storeu_ps(pFloats + 8, _mm256_castps256_ps128(m25));
+			_mm_storeu_ps(pFloats + 12, _mm256_extractf128_ps(m03, 1));
+			_mm_storeu_ps(pFloats + 16, _mm256_extractf128_ps(m14, 1));
+			_mm_storeu_ps(pFloats + 20, _mm256_extractf128_ps(m25, 1));
+		}
+
+		inline __m256 Dot(__m256 ax, __m256 ay, __m256 az, __m256 bx, __m256 by, __m256 bz)
+		{
+			return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, bx), _mm256_mul_ps(ay, by)), _mm256_mul_ps(az, bz));
+		}
+#endif
+
+		/**
+		 * \brief Dot products of 4 pairs of vectors
+		 * \param pA First vectors ( 4, contiguous )
+		 * \param pB Second vectors ( 4, contiguous )
+		 * \param pResults pResults[i] = Dot(pA[i], pB[i])
+		 */
+		inline void Dot4(const Vector3* pA, const Vector3* pB, float* pResults)
+		{
+#ifdef MATH_SSE
+			__m128 ax, ay, az, bx, by, bz;
+			LoadSoA4(pA, ax, ay, az);
+			LoadSoA4(pB, bx, by, bz);
+			_mm_storeu_ps(pResults, Dot(ax, ay, az, bx, by, bz));
+#else
+			for (int idx{ 0 }; idx < 4; ++idx)
+				pResults[idx] = Vector3::Dot(pA[idx], pB[idx]);
+#endif
+		}
+
+		// Dot4 for 8 pairs ( One AVX2 register )
+		inline void Dot8(const Vector3* pA, const Vector3* pB, float* pResults)
+		{
+#ifdef MATH_AVX2
+			__m256 ax, ay, az, bx, by, bz;
+			LoadSoA8(pA, ax, ay, az);
+			LoadSoA8(pB, bx, by, bz);
+			_mm256_storeu_ps(pResults, Dot(ax, ay, az, bx, by, bz));
+#else
+			Dot4(pA, pB, pResults);
+			Dot4(pA + 4, pB + 4, pResults + 4);
+#endif
+		}
+
+		// Dot products of count vectors stored as separate x, y and z arrays ( SoA )
+		inline void Dot(const float* pAX, const float* pAY, const float* pAZ,
+			const float* pBX, const float* pBY, const float* pBZ, float* pResults, int count)
+		{
+			int idx{ 0 };
+#ifdef MATH_AVX2
+			for (; idx + 8 <= count; idx += 8)
+			{
+				_mm256_storeu_ps(pResults + idx, Dot(
+					_mm256_loadu_ps(pAX + idx), _mm256_loadu_ps(pAY + idx), _mm256_loadu_ps(pAZ + idx),
+					_mm256_loadu_ps(pBX + idx), _mm256_loadu_ps(pBY + idx), _mm256_loadu_ps(pBZ + idx)));
+			}
+#endif
+#ifdef MATH_SSE
+			for (; idx + 4 <= count; idx += 4)
+			{
+				_mm_storeu_ps(pResults + idx, Dot(
+					_mm_loadu_ps(pAX + idx), _mm_loadu_ps(pAY + idx), _mm_loadu_ps(pAZ + idx),
+					_mm_loadu_ps(pBX + idx), _mm_loadu_ps(pBY + idx), _mm_loadu_ps(pBZ + idx)));
+			}
+#endif
+			for (; idx < count; ++idx)
+				pResults[idx] = pAX[idx] * pBX[idx] + pAY[idx] * pBY[idx] + pAZ[idx] * pBZ[idx];
+		}
+
+		/**
+		 * \brief Matrix::TransformPoint / TransformVector on an array of vectors, 8 ( AVX2 ) or 4 at a time
+		 * \param isPoint Add the translation ( TransformPoint ) or not ( TransformVector )
+		 * \param pIn Vectors to transform
+		 * \param pOut Transformed vectors ( Can be the same array as pIn )
+		 */
+		inline void Transform(const Matrix& matrix, bool isPoint, const Vector3* pIn, Vector3* pOut, int count)
+		{
+			int idx{ 0 };
+#ifdef MATH_SSE
+			const Vector4 row0{ matrix[0] };
+			const Vector4 row1{ matrix[1] };
+			const Vector4 row2{ matrix[2] };
+			const Vector4 row3{ matrix[3] };
+#endif
+#ifdef MATH_AVX2
+			for (; idx + 8 <= count; idx += 8)
+			{
+				__m256 x, y, z;
+				LoadSoA8(pIn + idx, x, y, z);
+
+				// Same sums as Matrix::TransformPoint, one component of 8 vectors per register
+				__m256 outX{ Dot(_mm256_set1_ps(row0.x), _mm256_set1_ps(row1.x), _mm256_set1_ps(row2.x), x, y, z) };
+				__m256 outY{ Dot(_mm256_set1_ps(row0.y), _mm256_set1_ps(row1.y), _mm256_set1_ps(row2.y), x, y, z) };
+				__m256 outZ{ Dot(_mm256_set1_ps(row0.z), _mm256_set1_ps(row1.z), _mm256_set1_ps(row2.z), x, y, z) };
+				if (isPoint)
+				{
+					outX = _mm256_add_ps(outX, _mm256_set1_ps(row3.x));
+					outY = _mm256_add_ps(outY, _mm256_set1_ps(row3.y));
+					outZ = _mm256_add_ps(outZ, _mm256_set1_ps(row3.z));
+				}
+
+				StoreSoA8(pOut + idx, outX, outY, outZ);
+			}
+#endif
+#ifdef MATH_SSE
+			for (; idx + 4 <= count; idx += 4)
+			{
+				__m128 x, y, z;
+				LoadSoA4(pIn + idx, x, y, z);
+
+				__m128 outX{ Dot(_mm_set1_ps(row0.x), _mm_set1_ps(row1.x), _mm_set1_ps(row2.x), x, y, z) };
+				__m128 outY{ Dot(_mm_set1_ps(row0.y), _mm_set1_ps(row1.y), _mm_set1_ps(row2.y), x, y, z) };
+				__m128 outZ{ Dot(_mm_set1_ps(row0.z), _mm_set1_ps(row1.z), _mm_set1_ps(row2.z), x, y, z) };
+				if (isPoint)
+				{
+					outX = _mm_add_ps(outX, _mm_set1_ps(row3.x));
+					outY = _mm_add_ps(outY, _mm_set1_ps(row3.y));
+					outZ = _mm_add_ps(outZ, _mm_set1_ps(row3.z));
+				}
+
+				StoreSoA4(pOut + idx, outX, outY, outZ);
+			}
+#endif
+			for (; idx < count; ++idx)
+				pOut[idx] = isPoint ? matrix.TransformPoint(pIn[idx]) : matrix.TransformVector(pIn[idx]);
+		}
+
+		inline void TransformPoints(const Matrix& matrix, const Vector3* pIn, Vector3* pOut, int count)
+		{
+			Transform(matrix, true, pIn, pOut, count);
+		}
+
+		inline void TransformVectors(const Matrix& matrix, const Vector3* pIn, Vector3* pOut, int count)
+		{
+			Transform(matrix, false, pIn, pOut, count);
+		}
+
+		// TransformVectors for SoA arrays ( Ray packet directions ), 8 at a time with AVX2
+		inline void TransformVectors(const Matrix& matrix, const float* pInX, const float* pInY, const float* pInZ,
+			float* pOutX, float* pOutY, float* pOutZ, int count)
+		{
+			const Vector4 row0{ matrix[0] };
+			const Vector4 row1{ matrix[1] };
+			const Vector4 row2{ matrix[2] };
+
+			int idx{ 0 };
+#ifdef MATH_AVX2
+			for (; idx + 8 <= count; idx += 8)
+			{
+				const __m256 x{ _mm256_loadu_ps(pInX + idx) };
+				const __m256 y{ _mm256_loadu_ps(pInY + idx) };
+				const __m256 z{ _mm256_loadu_ps(pInZ + idx) };
+
+				_mm256_storeu_ps(pOutX + idx, Dot(_mm256_set1_ps(row0.x), _mm256_set1_ps(row1.x), _mm256_set1_ps(row2.x), x, y, z));
+				_mm256_storeu_ps(pOutY + idx, Dot(_mm256_set1_ps(row0.y), _mm256_set1_ps(row1.y), _mm256_set1_ps(row2.y), x, y, z));
+				_mm256_storeu_ps(pOutZ + idx, Dot(_mm256_set1_ps(row0.z), _mm256_set1_ps(row1.z), _mm256_set1_ps(row2.z), x, y, z));
+			}
+#endif
+#ifdef MATH_SSE
+			for (; idx + 4 <= count; idx += 4)
+			{
+				const __m128 x{ _mm_loadu_ps(pInX + idx) };
+				const __m128 y{ _mm_loadu_ps(pInY + idx) };
+				const __m128 z{ _mm_loadu_ps(pInZ + idx) };
+
+				_mm_storeu_ps(pOutX + idx, Dot(_mm_set1_ps(row0.x), _mm_set1_ps(row1.x), _mm_set1_ps(row2.x), x, y, z));
+				_mm_storeu_ps(pOutY + idx, Dot(_mm_set1_ps(row0.y), _mm_set1_ps(row1.y), _mm_set1_ps(row2.y), x, y, z));
+				_mm_storeu_ps(pOutZ + idx, Dot(_mm_set1_ps(row0.z), _mm_set1_ps(row1.z), _mm_set1_ps(row2.z), x, y, z));
+			}
+#endif
+			for (; idx < count; ++idx)
+			{
+				pOutX[idx] = row0.x * pInX[idx] + row1.x * pInY[idx] + row2.x * pInZ[idx];
+				pOutY[idx] = row0.y * pInX[idx] + row1.y * pInY[idx] + row2.y * pInZ[idx];
+				pOutZ[idx] = row0.z * pInX[idx] + row1.z * pInY[idx] + row2.z * pInZ[idx];
+			}
+		}
+	}
+}
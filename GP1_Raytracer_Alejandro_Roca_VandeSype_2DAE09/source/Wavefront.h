@@ -0,0 +1,152 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "ColorRGB.h"
+#include "Math.h"
+
+namespace dae
+{
+	// Queues of the wavefront pipeline ( Renderer, wavefront mode )
+	// ... Every stage runs over a whole queue before the next stage starts, and only touches the fields it needs
+	// ... One array per field ( SoA ), same layout as the sphere sets
+
+	// Primary rays of a wave and their closest hits, one entry per pixel
+	struct RayQueue
+	{
+		std::vector<uint32_t> pixelIndices{};
+		std::vector<float> directionX{};
+		std::vector<float> directionY{};
+		std::vector<float> directionZ{};
+
+		// Closest hit ( Extension stage )
+		std::vector<float> hitX{};
+		std::vector<float> hitY{};
+		std::vector<float> hitZ{};
+		std::vector<float> normalX{};
+		std::vector<float> normalY{};
+		std::vector<float> normalZ{};
+		std::vector<unsigned char> materialIndices{};
+		std::vector<uint8_t> didHit{};
+
+		// Only grows, a smaller wave reuses the memory
+		void Resize(size_t rayCount)
+		{
+			if (rayCount <= pixelIndices.size())
+				return;
+
+			pixelIndices.resize(rayCount);
+			directionX.resize(rayCount);
+			directionY.resize(rayCount);
+			directionZ.resize(rayCount);
+			hitX.resize(rayCount);
+			hitY.resize(rayCount);
+			hitZ.resize(rayCount);
+			normalX.resize(rayCount);
+			normalY.resize(rayCount);
+			normalZ.resize(rayCount);
+			materialIndices.resize(rayCount);
+			didHit.resize(rayCount);
+		}
+
+		Vector3 GetDirection(uint32_t rayIdx) const { return { directionX[rayIdx], directionY[rayIdx], directionZ[rayIdx] }; }
+		Vector3 GetHit(uint32_t rayIdx) const { return { hitX[rayIdx], hitY[rayIdx], hitZ[rayIdx] }; }
+		Vector3 GetNormal(uint32_t rayIdx) const { return { normalX[rayIdx], normalY[rayIdx], normalZ[rayIdx] }; }
+	};
+
+	// Light samples of the hits : a fixed number of slots per primary ray ( Slot = rayIdx * lightSampleCount + sampleIdx )
+	// ... Fixed slots -> no counting or compaction between the stages, and the light order of a pixel never changes
+	struct ShadowQueue
+	{
+		enum class State : uint8_t
+		{
+			Empty,		// No light for this slot ( Miss, below the horizon, nothing picked, shadowed )
+			Pending,	// Shadow ray still to trace
+			Lit			// Light reaches the hit -> gets shaded
+		};
+
+		std::vector<State> states{};
+		std::vector<uint32_t> lightIndices{};
+		std::vector<float> weights{};
+
+		// Shadow ray ( Origin already offset from the surface )
+		std::vector<float> originX{};
+		std::vector<float> originY{};
+		std::vector<float> originZ{};
+		std::vector<float> directionX{};
+		std::vector<float> directionY{};
+		std::vector<float> directionZ{};
+		std::vector<float> maxDistances{};
+
+		// Shading : normalized direction from the hit to the light, and its cosine with the normal
+		std::vector<float> lightX{};
+		std::vector<float> lightY{};
+		std::vector<float> lightZ{};
+		std::vector<float> cosines{};
+
+		// Contribution to the pixel ( Shading stage )
+		std::vector<float> colorR{};
+		std::vector<float> colorG{};
+		std::vector<float> colorB{};
+
+		void Resize(size_t slotCount)
+		{
+			if (slotCount <= states.size())
+				return;
+
+			states.resize(slotCount);
+			lightIndices.resize(slotCount);
+			weights.resize(slotCount);
+			originX.resize(slotCount);
+			originY.resize(slotCount);
+			originZ.resize(slotCount);
+			directionX.resize(slotCount);
+			directionY.resize(slotCount);
+			directionZ.resize(slotCount);
+			maxDistances.resize(slotCount);
+			lightX.resize(slotCount);
+			lightY.resize(slotCount);
+			lightZ.resize(slotCount);
+			cosines.resize(slotCount);
+			colorR.resize(slotCount);
+			colorG.resize(slotCount);
+			colorB.resize(slotCount);
+		}
+
+		Vector3 GetLightDirection(uint32_t slot) const { return { lightX[slot], lightY[slot], lightZ[slot] }; }
+		ColorRGB GetColor(uint32_t slot) const { return { colorR[slot], colorG[slot], colorB[slot] }; }
+	};
+
+	// Lit slots of one material, shaded with a single call ( MaterialUtils::ShadeBatch )
+	// ... Gathered from the queues into small fixed arrays, so the material loop runs over contiguous memory
+	struct ShadingBatch
+	{
+		static constexpr uint32_t MaxSize{ 256 };
+		uint32_t count{};
+
+		alignas(32) float normalX[MaxSize];
+		alignas(32) float normalY[MaxSize];
+		alignas(32) float normalZ[MaxSize];
+		alignas(32) float lightX[MaxSize];
+		alignas(32) float lightY[MaxSize];
+		alignas(32) float lightZ[MaxSize];
+		alignas(32) float viewX[MaxSize];
+		alignas(32) float viewY[MaxSize];
+		alignas(32) float viewZ[MaxSize];
+
+		// Output : BRDF of every entry
+		alignas(32) float brdfR[MaxSize];
+		alignas(32) float brdfG[MaxSize];
+		alignas(32) float brdfB[MaxSize];
+
+		Vector3 GetNormal(uint32_t idx) const { return { normalX[idx], normalY[idx], normalZ[idx] }; }
+		Vector3 GetLight(uint32_t idx) const { return { lightX[idx], lightY[idx], lightZ[idx] }; }
+		Vector3 GetView(uint32_t idx) const { return { viewX[idx], viewY[idx], viewZ[idx] }; }
+		void SetBRDF(uint32_t idx, const ColorRGB& brdf)
+		{
+			brdfR[idx] = brdf.r;
+			brdfG[idx] = brdf.g;
+			brdfB[idx] = brdf.b;
+		}
+	};
+}
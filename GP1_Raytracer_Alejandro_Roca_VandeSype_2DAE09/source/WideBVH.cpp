@@ -0,0 +1,177 @@
+#include "WideBVH.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace dae
+{
+	void WideBVH::Build(const BVH& bvh)
+	{
+		Clear();
+		if (bvh.IsEmpty())
+			return;
+
+		const std::vector<BVHNode>& binaryNodes{ bvh.GetNodes() };
+
+		// Every wide node replaces at least one binary inner node
+		m_Nodes.reserve(binaryNodes.size() / 2 + 1);
+		m_Nodes.emplace_back();
+		m_SourceNodes.reserve(m_Nodes.capacity());
+		m_SourceNodes.emplace_back();
+		m_PrimitiveIndices.reserve(bvh.GetPrimitiveIndices().size() * 2);
+
+		CollapseNode(binaryNodes, bvh.GetPrimitiveIndices(), 0, 0);
+	}
+
+	bool WideBVH::Refit(const BVH& bvh)
+	{
+		if (m_SourceNodes.empty() || m_SourceNodes.size() != m_Nodes.size())
+			return false;
+
+		// Every node only reads binary nodes -> no order between them
+		const std::vector<BVHNode>& binaryNodes{ bvh.GetNodes() };
+		for (size_t nodeIdx{ 0 }; nodeIdx < m_Nodes.size(); ++nodeIdx)
+			QuantizeChildren(binaryNodes, m_SourceNodes[nodeIdx], m_Nodes[nodeIdx]);
+
+		return true;
+	}
+
+	void WideBVH::SetNodes(std::vector<WideBVHNode>&& nodes, std::vector<uint32_t>&& primitiveIndices)
+	{
+		Clear();
+		m_Nodes = std::move(nodes);
+		m_PrimitiveIndices = std::move(primitiveIndices);
+	}
+
+	void WideBVH::Clear()
+	{
+		m_Nodes.clear();
+		m_PrimitiveIndices.clear();
+		m_SourceNodes.clear();
+	}
+
+	size_t WideBVH::GetMemoryUsage() const
+	{
+		return m_Nodes.size() * sizeof(WideBVHNode) + m_PrimitiveIndices.size() * sizeof(uint32_t) + m_SourceNodes.size() * sizeof(SourceNodes);
+	}
+
+	void WideBVH::QuantizeChildren(const std::vector<BVHNode>& binaryNodes, const SourceNodes& source, WideBVHNode& wideNode)
+	{
+		const BVHNode& binaryNode{ binaryNodes[source.node] };
+
+		// Quantization grid : 255 steps over the node box, rounded up to a power of 2
+		const Vector3 extent{ binaryNode.maxAABB - binaryNode.minAABB };
+		float step[3]{};
+		for (int axis{ 0 }; axis < 3; ++axis)
+		{
+			int exponent{};
+			frexpf(extent[axis] / 255.f, &exponent);
+			exponent = std::clamp(exponent, -126, 127);
+			wideNode.exponent[axis] = static_cast<int8_t>(exponent);
+			step[axis] = ldexpf(1.f, exponent);
+		}
+		wideNode.origin = binaryNode.minAABB;
+
+		uint8_t* childMin[3]{ wideNode.childMinX, wideNode.childMinY, wideNode.childMinZ };
+		uint8_t* childMax[3]{ wideNode.childMaxX, wideNode.childMaxY, wideNode.childMaxZ };
+		for (int childIdx{ 0 }; childIdx < WideBVHNode::Width; ++childIdx)
+		{
+			if (source.children[childIdx] == InvalidPrimitive)
+				continue;
+
+			// Round outwards -> the quantized box always contains the real one
+			const BVHNode& child{ binaryNodes[source.children[childIdx]] };
+			for (int axis{ 0 }; axis < 3; ++axis)
+			{
+				const float quantizedMin{ std::floor((child.minAABB[axis] - wideNode.origin[axis]) / step[axis]) };
+				const float quantizedMax{ std::ceil((child.maxAABB[axis] - wideNode.origin[axis]) / step[axis]) };
+				childMin[axis][childIdx] = static_cast<uint8_t>(std::clamp(quantizedMin, 0.f, 255.f));
+				childMax[axis][childIdx] = static_cast<uint8_t>(std::clamp(quantizedMax, 0.f, 255.f));
+			}
+		}
+	}
+
+	void WideBVH::CollapseNode(const std::vector<BVHNode>& binaryNodes, const std::vector<uint32_t>& binaryPrimitiveIndices,
+		uint32_t binaryNodeIdx, uint32_t wideNodeIdx)
+	{
+		const BVHNode& binaryNode{ binaryNodes[binaryNodeIdx] };
+
+		// Gather up to 4 children : keep opening the biggest inner child
+		// ... A leaf root simply becomes a node with a single leaf child
+		uint32_t children[WideBVHNode::Width]{ binaryNodeIdx };
+		int childCount{ 1 };
+		if (!binaryNode.IsLeaf())
+		{
+			children[0] = binaryNode.leftFirst;
+			children[1] = binaryNode.leftFirst + 1;
+			childCount = 2;
+		}
+
+		while (childCount < WideBVHNode::Width)
+		{
+			int openIdx{ -1 };
+			float largestArea{ -1.f };
+			for (int childIdx{ 0 }; childIdx < childCount; ++childIdx)
+			{
+				const BVHNode& child{ binaryNodes[children[childIdx]] };
+				if (child.IsLeaf())
+					continue;
+
+				const float area{ AABB{ child.minAABB, child.maxAABB }.HalfArea() };
+				if (area > largestArea)
+				{
+					largestArea = area;
+					openIdx = childIdx;
+				}
+			}
+
+			if (openIdx == -1)
+				break;	// Only leaves left
+
+			const uint32_t openedNodeIdx{ children[openIdx] };
+			children[openIdx] = binaryNodes[openedNodeIdx].leftFirst;
+			children[childCount++] = binaryNodes[openedNodeIdx].leftFirst + 1;
+		}
+
+		SourceNodes source{ binaryNodeIdx, { InvalidPrimitive, InvalidPrimitive, InvalidPrimitive, InvalidPrimitive } };
+		for (int childIdx{ 0 }; childIdx < childCount; ++childIdx)
+			source.children[childIdx] = children[childIdx];
+
+		WideBVHNode wideNode{};
+		QuantizeChildren(binaryNodes, source, wideNode);
+
+		uint32_t innerChildren[WideBVHNode::Width]{};
+		for (int childIdx{ 0 }; childIdx < childCount; ++childIdx)
+		{
+			const BVHNode& child{ binaryNodes[children[childIdx]] };
+			if (child.IsLeaf())
+			{
+				// Copy the primitives of the leaf into its own aligned slot
+				wideNode.child[childIdx] = static_cast<uint32_t>(m_PrimitiveIndices.size());
+				wideNode.primitiveCount[childIdx] = static_cast<uint8_t>(child.primitiveCount);
+
+				m_PrimitiveIndices.insert(m_PrimitiveIndices.end(), binaryPrimitiveIndices.begin() + child.leftFirst,
+					binaryPrimitiveIndices.begin() + child.leftFirst + child.primitiveCount);
+				m_PrimitiveIndices.resize((m_PrimitiveIndices.size() + LeafAlignment - 1) / LeafAlignment * LeafAlignment, InvalidPrimitive);
+			}
+			else
+			{
+				// Reserve the slot now, the subtree is collapsed afterwards
+				wideNode.innerMask |= 1 << childIdx;
+				wideNode.child[childIdx] = static_cast<uint32_t>(m_Nodes.size());
+				innerChildren[childIdx] = children[childIdx];
+				m_Nodes.emplace_back();
+				m_SourceNodes.emplace_back();
+			}
+		}
+
+		m_Nodes[wideNodeIdx] = wideNode;
+		m_SourceNodes[wideNodeIdx] = source;
+
+		for (int childIdx{ 0 }; childIdx < childCount; ++childIdx)
+		{
+			if (wideNode.IsInner(childIdx))
+				CollapseNode(binaryNodes, binaryPrimitiveIndices, innerChildren[childIdx], wideNode.child[childIdx]);
+		}
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "BVH.h"
+
+// Comment out to trace the triangle meshes through the binary BVH instead
+#define USE_WIDE_BVH
+
+namespace dae
+{
+#pragma region WIDE BVH
+	// 4-wide BVH node, exactly one cache line
+	// The child boxes are stored in SoA so one ray can be tested against the 4 of them at once
+	// ... Quantized to 8 bits relative to the node box : childMin = origin + q * 2^exponent
+	struct alignas(64) WideBVHNode
+	{
+		static constexpr int Width{ 4 };
+
+		Vector3 origin{};					// Min corner of the node box
+		int8_t exponent[3]{};				// Quantization step per axis ( Power of 2 -> exact decoding )
+		uint8_t innerMask{};				// Bit i set -> child i is a node, otherwise a leaf
+
+		uint8_t childMinX[Width]{};
+		uint8_t childMinY[Width]{};
+		uint8_t childMinZ[Width]{};
+		uint8_t childMaxX[Width]{};
+		uint8_t childMaxY[Width]{};
+		uint8_t childMaxZ[Width]{};
+
+		uint32_t child[Width]{};			// Inner : index of the child node, leaf : first entry in the primitive index list
+		uint8_t primitiveCount[Width]{};	// Leaf primitive count, 0 for inner children and empty slots
+		uint32_t padding{};
+
+		bool IsInner(int childIdx) const { return (innerMask >> childIdx) & 1; }
+		bool IsEmpty(int childIdx) const { return !IsInner(childIdx) && primitiveCount[childIdx] == 0; }
+	};
+
+	// Collapsed version of a binary BVH : every node has up to 4 children
+	// Every leaf starts on a multiple of LeafAlignment in the primitive index list ( Padded with InvalidPrimitive )
+	// ... so leaf data can be packed in fixed-size blocks : block = leafFirst / LeafAlignment
+	class WideBVH final
+	{
+	public:
+		WideBVH() = default;
+		~WideBVH() = default;
+
+		void Build(const BVH& bvh);
+		// Same binary tree as the last Build, only its bounds changed ( BVH::Refit ) : re-quantizes the child boxes in place
+		// ... Nodes, leaves and primitive indices stay where they are
+		// ... Returns false when there is no Build to refit ( SetNodes ), Build instead
+		bool Refit(const BVH& bvh);
+		// Collapsed tree that was built earlier ( Scene bundles ), as GetNodes / GetPrimitiveIndices gave it
+		void SetNodes(std::vector<WideBVHNode>&& nodes, std::vector<uint32_t>&& primitiveIndices);
+		void Clear();
+
+		const std::vector<WideBVHNode>& GetNodes() const { return m_Nodes; }
+		const std::vector<uint32_t>& GetPrimitiveIndices() const { return m_PrimitiveIndices; }
+
+		uint32_t GetNodeCount() const { return static_cast<uint32_t>(m_Nodes.size()); }
+		size_t GetMemoryUsage() const;
+		bool IsEmpty() const { return m_Nodes.empty(); }
+
+		static constexpr uint32_t LeafAlignment{ BVH::MaxLeafSize };
+		static constexpr uint32_t InvalidPrimitive{ UINT32_MAX };
+
+	private:
+		// The binary nodes a wide node was collapsed from, InvalidPrimitive for unused child slots
+		struct SourceNodes
+		{
+			uint32_t node;
+			uint32_t children[WideBVHNode::Width];
+		};
+
+		std::vector<WideBVHNode> m_Nodes{};
+		std::vector<uint32_t> m_PrimitiveIndices{};
+		std::vector<SourceNodes> m_SourceNodes{};	// Same order as m_Nodes, empty after SetNodes
+
+		static void QuantizeChildren(const std::vector<BVHNode>& binaryNodes, const SourceNodes& source, WideBVHNode& wideNode);
+		void CollapseNode(const std::vector<BVHNode>& binaryNodes, const std::vector<uint32_t>& binaryPrimitiveIndices,
+			uint32_t binaryNodeIdx, uint32_t wideNodeIdx);
+	};
+#pragma endregion
+}
@@ -11,6 +11,7 @@
 #include "Timer.h"
 #include "Renderer.h"
 #include "Scene.h"
+#include "SDLRenderTarget.h"
 
 using namespace dae;
 
@@ -22,10 +23,6 @@ void ShutDown(SDL_Window* pWindow)
 
 int main(int argc, char* args[])
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
-
 	//Create window + surfaces
 	SDL_Init(SDL_INIT_VIDEO);
 
@@ -43,9 +40,13 @@ int main(int argc, char* args[])
 
 	//Initialize "framework"
 	const auto pTimer = new Timer();
-	const auto pRenderer = new Renderer(pWindow);
+	const auto pRenderTarget = new SDLRenderTarget(pWindow);
+	const auto pRenderer = new Renderer(pRenderTarget);
 
-	const auto pScene = new Scene_W4_ReferenceScene();
+	// Scene name or scene file ( .scene / .scenebundle ) as first argument, the reference scene otherwise
+	Scene* pScene{ argc > 1 ? CreateScene(args[1]).release() : nullptr };
+	if (!pScene)
+		pScene = new Scene_W4_ReferenceScene();
 	pScene->Initialize();
 
 	//Start loop
@@ -73,8 +74,38 @@ int main(int argc, char* args[])
 						pRenderer->ToggleShadows();
 					if (e.key.keysym.scancode == SDL_SCANCODE_F3)
 						pRenderer->CycleLightingMode();
+					if (e.key.keysym.scancode == SDL_SCANCODE_F4)
+						pRenderer->CycleAccumulationMode();
+					if (e.key.keysym.scancode == SDL_SCANCODE_F5)
+						pRenderer->CyclePacketMode();
 					if(e.key.keysym.scancode == SDL_SCANCODE_F6)
 						pTimer->StartBenchmark(); 		// Start Benchmark
+					if (e.key.keysym.scancode == SDL_SCANCODE_F7)
+						pRenderer->CycleThreadCount();
+					if (e.key.keysym.scancode == SDL_SCANCODE_F8)
+						pRenderer->PrintTileTimes();
+					if (e.key.keysym.scancode == SDL_SCANCODE_F9)
+						pRenderer->CycleAdaptiveSampling();
+					if (e.key.keysym.scancode == SDL_SCANCODE_F10)
+						pRenderer->ToggleDynamicResolution();
+					if (e.key.keysym.scancode == SDL_SCANCODE_F11)
+						pRenderer->PrintRayStatistics();
+					if (e.key.keysym.scancode == SDL_SCANCODE_F1)
+						pRenderer->CycleIntegrator();
+					if (e.key.keysym.scancode == SDL_SCANCODE_F12)
+						pRenderer->CycleLightSampling();
+					if (e.key.keysym.scancode == SDL_SCANCODE_V)
+						pRenderer->ToggleWavefront();
+					if (e.key.keysym.scancode == SDL_SCANCODE_B)
+						pRenderer->ToggleShadingMode();
+					if (e.key.keysym.scancode == SDL_SCANCODE_T)
+						pRenderer->CycleToneMapper();
+					if (e.key.keysym.scancode == SDL_SCANCODE_G)
+						pRenderer->ToggleSRGB();
+					if (e.key.keysym.scancode == SDL_SCANCODE_EQUALS)
+						pRenderer->AdjustExposure(0.5f);
+					if (e.key.keysym.scancode == SDL_SCANCODE_MINUS)
+						pRenderer->AdjustExposure(-0.5f);
 					break;
 				}
 			}
@@ -88,17 +119,22 @@ int main(int argc, char* args[])
 
 		//--------- Timer ---------
 		pTimer->Update();
+		pRenderer->UpdateResolutionScale(pTimer->GetElapsed());
 		printTimer += pTimer->GetElapsed();
 		if (printTimer >= 1.f)
 		{
 			printTimer = 0.f;
-			std::cout << "dFPS: " << pTimer->GetdFPS() << std::endl;
+			std::cout << "dFPS: " << pTimer->GetdFPS();
+			if (pRenderer->IsDynamicResolutionEnabled())
+				std::cout << " | Resolution scale: " << pRenderer->GetResolutionScale()
+					<< " ( Frame " << pRenderer->GetLastFrameTime() * 1000.f << " ms )";
+			std::cout << std::endl;
 		}
 
 		//Save screenshot after full render
 		if (takeScreenshot)
 		{
-			if (!pRenderer->SaveBufferToImage())
+			if (pRenderer->SaveBufferToImage())
 				std::cout << "Screenshot saved!" << std::endl;
 			else
 				std::cout << "Something went wrong. Screenshot not saved!" << std::endl;
@@ -110,6 +146,7 @@ int main(int argc, char* args[])
 	//Shutdown "framework"
 	delete pScene;
 	delete pRenderer;
+	delete pRenderTarget;
 	delete pTimer;
 
 	ShutDown(pWindow);
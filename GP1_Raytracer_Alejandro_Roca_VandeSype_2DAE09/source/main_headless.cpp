@@ -0,0 +1,344 @@
+// Offline renderer : no window, no input, renders a fixed number of frames to image files and exits
+// ... Built by RayTracer_Headless.vcxproj ( HEADLESS defined, no SDL )
+
+//Standard includes
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+//Project includes
+#include "Benchmark.h"
+#include "Timer.h"
+#include "Renderer.h"
+#include "RenderTarget.h"
+#include "Scene.h"
+
+using namespace dae;
+
+namespace
+{
+	struct Settings
+	{
+		std::string sceneName{ "W4Reference" };
+		int width{ 640 };
+		int height{ 480 };
+		uint32_t sampleCount{ 1 };
+		uint32_t frameCount{ 1 };
+		uint32_t threadCount{ 0 };
+		float frameTime{ 1.f / 30.f };
+		std::string outputPath{ "render.png" };
+		bool showTraversalCost{ false };
+		bool wavefront{ false };
+		bool fastShading{ false };
+		DisplaySettings display{};
+		Renderer::Integrator integrator{ Renderer::Integrator::Direct };
+		Renderer::LightSampling lightSampling{ Renderer::LightSampling::Auto };
+
+		// Benchmark mode : the options that were given restrict the benchmark to that scene / resolution / thread count
+		std::string benchmarkPath{};
+		bool mathBenchmark{ false };
+		std::string objBenchmarkPath{};
+		std::string compileScenePath{};
+		bool isSceneSet{ false };
+		bool isResolutionSet{ false };
+		bool isFrameCountSet{ false };
+		bool isThreadCountSet{ false };
+	};
+
+	void PrintUsage()
+	{
+		std::cout << "Usage : RayTracer_Headless [options]\n"
+			<< "  --scene <name>      W1, W2, W3, W4Test, W4Reference, W4Bunny, Particles or ManyLights ( Default W4Reference )\n"
+			<< "                      or the path of a .scene / .scenebundle file\n"
+			<< "  --width <pixels>    Default 640\n"
+			<< "  --height <pixels>   Default 480\n"
+			<< "  --samples <count>   Samples per pixel, accumulated progressively ( Default 1 )\n"
+			<< "  --frames <count>    Animation frames ( Default 1 )\n"
+			<< "  --fps <count>       Animation time step = 1 / fps ( Default 30 )\n"
+			<< "  --threads <count>   Render threads, 0 = one per hardware thread ( Default 0 )\n"
+			<< "  --output <file>     .png, .ppm or .bmp, numbered when there are several frames ( Default render.png )\n"
+			<< "  --heatmap           Traversal cost per pixel instead of the shading\n"
+			<< "  --wavefront         Stage by stage over big ray queues, shading sorted by material ( Direct integrator )\n"
+			<< "  --fast-shading      Approximated BRDFs ( FastMath ) instead of the exact ones\n"
+			<< "  --exposure <stops>  Exposure of the HDR image, x 2^stops ( Default 0 )\n"
+			<< "  --tonemap <name>    max ( Scale down to the brightest channel ), reinhard or aces ( Default max )\n"
+			<< "  --srgb              Encode the output with the sRGB curve instead of linear values\n"
+			<< "  --integrator <name> direct, path or uniform ( Path tracing with naive bounces ) ( Default direct )\n"
+			<< "  --lights <mode>     all, bvh ( A few lights per hit, picked by the light BVH ) or auto ( bvh above 16 point lights )\n"
+			<< "                      ( Default auto )\n"
+			<< "  --benchmark <file>  Render every W scene at several resolutions and thread counts along a fixed camera path\n"
+			<< "                      and write the timings as JSON ( --scene, --width / --height, --threads and --frames limit it )\n"
+			<< "  --math-benchmark    Time the vector / matrix kernels and the display pass, per element against the batch versions\n"
+			<< "  --obj-benchmark <file>\n"
+			<< "                      Time loading an OBJ file, parsed from its text and read from its binary cache\n"
+			<< "  --compile-scene <file>\n"
+			<< "                      Compile a .scene file into a .scenebundle next to it ( Meshes with their BVHs built )\n";
+	}
+
+	bool ParseArguments(int argc, char* args[], Settings& settings)
+	{
+		for (int argIdx{ 1 }; argIdx < argc; ++argIdx)
+		{
+			const std::string option{ args[argIdx] };
+			if (option == "--help" || option == "-h")
+				return false;
+			if (option == "--heatmap")
+			{
+				settings.showTraversalCost = true;
+				continue;
+			}
+			if (option == "--wavefront")
+			{
+				settings.wavefront = true;
+				continue;
+			}
+			if (option == "--fast-shading")
+			{
+				settings.fastShading = true;
+				continue;
+			}
+			if (option == "--srgb")
+			{
+				settings.display.sRGB = true;
+				continue;
+			}
+			if (option == "--math-benchmark")
+			{
+				settings.mathBenchmark = true;
+				continue;
+			}
+
+			// Every other option takes a value
+			if (argIdx + 1 >= argc)
+			{
+				std::cout << "Missing value for " << option << std::endl;
+				return false;
+			}
+			const std::string value{ args[++argIdx] };
+
+			try
+			{
+				if (option == "--scene")
+				{
+					settings.sceneName = value;
+					settings.isSceneSet = true;
+				}
+				else if (option == "--width")
+				{
+					settings.width = std::stoi(value);
+					settings.isResolutionSet = true;
+				}
+				else if (option == "--height")
+				{
+					settings.height = std::stoi(value);
+					settings.isResolutionSet = true;
+				}
+				else if (option == "--samples")
+					settings.sampleCount = static_cast<uint32_t>(std::stoul(value));
+				else if (option == "--frames")
+				{
+					settings.frameCount = static_cast<uint32_t>(std::stoul(value));
+					settings.isFrameCountSet = true;
+				}
+				else if (option == "--fps")
+					settings.frameTime = 1.f / std::stof(value);
+				else if (option == "--threads")
+				{
+					settings.threadCount = static_cast<uint32_t>(std::stoul(value));
+					settings.isThreadCountSet = true;
+				}
+				else if (option == "--output")
+					settings.outputPath = value;
+				else if (option == "--benchmark")
+					settings.benchmarkPath = value;
+				else if (option == "--obj-benchmark")
+					settings.objBenchmarkPath = value;
+				else if (option == "--compile-scene")
+					settings.compileScenePath = value;
+				else if (option == "--integrator")
+				{
+					if (value == "direct")
+						settings.integrator = Renderer::Integrator::Direct;
+					else if (value == "path")
+						settings.integrator = Renderer::Integrator::PathTracing;
+					else if (value == "uniform")
+						settings.integrator = Renderer::Integrator::PathTracingUniform;
+					else
+						throw std::invalid_argument{ value };
+				}
+				else if (option == "--exposure")
+					settings.display.exposure = std::exp2(std::stof(value));
+				else if (option == "--tonemap")
+				{
+					if (value == "max")
+						settings.display.toneMapper = ToneMapper::MaxToOne;
+					else if (value == "reinhard")
+						settings.display.toneMapper = ToneMapper::Reinhard;
+					else if (value == "aces")
+						settings.display.toneMapper = ToneMapper::ACES;
+					else
+						throw std::invalid_argument{ value };
+				}
+				else if (option == "--lights")
+				{
+					if (value == "all")
+						settings.lightSampling = Renderer::LightSampling::All;
+					else if (value == "bvh")
+						settings.lightSampling = Renderer::LightSampling::LightBVH;
+					else if (value == "auto")
+						settings.lightSampling = Renderer::LightSampling::Auto;
+					else
+						throw std::invalid_argument{ value };
+				}
+				else
+				{
+					std::cout << "Unknown option " << option << std::endl;
+					return false;
+				}
+			}
+			catch (const std::exception&)
+			{
+				std::cout << "Invalid value for " << option << " : " << value << std::endl;
+				return false;
+			}
+		}
+
+		if (settings.width <= 0 || settings.height <= 0 || settings.sampleCount == 0 || settings.frameCount == 0
+			|| !(settings.frameTime > 0.f))
+		{
+			std::cout << "Resolution, samples, frames and fps have to be bigger than 0" << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+
+	// render.png -> render_0003.png, only when there is more than one frame
+	std::string GetFramePath(const std::string& outputPath, uint32_t frameIdx, uint32_t frameCount)
+	{
+		if (frameCount == 1)
+			return outputPath;
+
+		char frameNumber[16]{};
+		std::snprintf(frameNumber, sizeof(frameNumber), "_%04u", frameIdx);
+
+		const size_t extensionStart{ outputPath.find_last_of('.') };
+		if (extensionStart == std::string::npos)
+			return outputPath + frameNumber;
+
+		return outputPath.substr(0, extensionStart) + frameNumber + outputPath.substr(extensionStart);
+	}
+
+	int RunBenchmark(const Settings& settings)
+	{
+		BenchmarkSettings benchmarkSettings{};
+		benchmarkSettings.frameTime = settings.frameTime;
+		if (settings.isSceneSet)
+			benchmarkSettings.sceneNames = { settings.sceneName };
+		if (settings.isResolutionSet)
+			benchmarkSettings.resolutions = { { settings.width, settings.height } };
+		if (settings.isThreadCountSet)
+			benchmarkSettings.threadCounts = { settings.threadCount };
+		if (settings.isFrameCountSet)
+			benchmarkSettings.frameCount = settings.frameCount;
+
+		return Benchmark::Run(benchmarkSettings, settings.benchmarkPath) ? 0 : 1;
+	}
+}
+
+int main(int argc, char* args[])
+{
+	Settings settings{};
+	if (!ParseArguments(argc, args, settings))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	if (settings.mathBenchmark)
+	{
+		Benchmark::RunMath();
+		return 0;
+	}
+
+	if (!settings.objBenchmarkPath.empty())
+		return Benchmark::RunOBJ(settings.objBenchmarkPath) ? 0 : 1;
+
+	if (!settings.compileScenePath.empty())
+		return SceneFile::Compile(settings.compileScenePath, SceneFile::GetBundlePath(settings.compileScenePath)) ? 0 : 1;
+
+	if (!settings.benchmarkPath.empty())
+		return RunBenchmark(settings);
+
+	const std::unique_ptr<Scene> pScene{ CreateScene(settings.sceneName) };
+	if (!pScene)
+	{
+		std::cout << "Unknown scene " << settings.sceneName << std::endl;
+		PrintUsage();
+		return 1;
+	}
+	pScene->Initialize();
+
+	MemoryRenderTarget renderTarget{ settings.width, settings.height };
+	Renderer renderer{ &renderTarget, settings.threadCount };
+	renderer.SetMaxAccumulatedSamples(settings.sampleCount);
+	renderer.SetTraversalCostView(settings.showTraversalCost);
+	renderer.SetIntegrator(settings.integrator);
+	renderer.SetLightSampling(settings.lightSampling);
+	renderer.SetWavefront(settings.wavefront);
+	renderer.SetShadingMode(settings.fastShading ? ShadingMode::Fast : ShadingMode::Exact);
+	renderer.SetDisplaySettings(settings.display);
+
+	// Fixed time step -> the animation doesn't depend on how long the frames take
+	Timer timer{};
+	timer.SetFixedTimeStep(settings.frameTime);
+	timer.Reset();
+	timer.Start();
+
+	std::cout << "Rendering " << settings.sceneName << " at " << settings.width << "x" << settings.height << ", "
+		<< settings.sampleCount << " samples, " << settings.frameCount << " frames, " << renderer.GetThreadCount() << " threads" << std::endl;
+
+	float totalRenderTime{ 0.f };
+	float minRenderTime{ FLT_MAX };
+	float maxRenderTime{ 0.f };
+	for (uint32_t frameIdx{ 0 }; frameIdx < settings.frameCount; ++frameIdx)
+	{
+		pScene->Update(&timer);
+
+		// Only the rendering is timed ( Scene update and file output excluded )
+		const auto startTime{ std::chrono::high_resolution_clock::now() };
+
+		renderer.ResetAccumulation();
+		for (uint32_t sampleIdx{ 0 }; sampleIdx < settings.sampleCount; ++sampleIdx)
+			renderer.Render(pScene.get());
+
+		const auto endTime{ std::chrono::high_resolution_clock::now() };
+		const float renderTime{ std::chrono::duration<float, std::milli>(endTime - startTime).count() };
+		totalRenderTime += renderTime;
+		minRenderTime = std::min(minRenderTime, renderTime);
+		maxRenderTime = std::max(maxRenderTime, renderTime);
+
+		const std::string framePath{ GetFramePath(settings.outputPath, frameIdx, settings.frameCount) };
+		if (!renderer.SaveBufferToImage(framePath))
+		{
+			std::cout << "Could not write " << framePath << std::endl;
+			return 1;
+		}
+
+		std::cout << "Frame " << frameIdx << " : " << renderTime << " ms -> " << framePath << std::endl;
+		renderer.PrintRayStatistics();
+
+		timer.Update();
+	}
+
+	std::cout << "Render time : avg " << totalRenderTime / settings.frameCount << " ms, min " << minRenderTime
+		<< " ms, max " << maxRenderTime << " ms, total " << totalRenderTime << " ms" << std::endl;
+
+	return 0;
+}